@@ -1,15 +1,155 @@
 
 #include "bag_of_words.hpp"
 
+#include <fstream>
+#include <thread>
+
 #include "features/features.hpp"
 #include "binaryio/binaryio.hpp"
+#include "binaryio/feature_file_stream.hpp"
+#include "clustering/training_set.hpp"
 #include "histogram/histogram.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+#include "query_engine/query_cache.hpp"
+#include "tools/sampling.hpp"
+#include "tools/simd.hpp"
 #include "web/web.hpp"
 #include "web/html_writer.hpp"
 
 
 namespace igg {
 
+namespace {
+
+// Histograms are encoded with unit L2 norm, so inner products are cosine similarities
+std::vector<float> NormalizedDenseHistogram(const SparseHistogram<float>& kHistogram) {
+  auto histogram = kHistogram.ToDense();
+  const auto kNorm = std::sqrt(DenseDotProduct(histogram.data(), histogram.data(), histogram.size()));
+  if (kNorm>0.0f) {
+    for (auto& weight: histogram) {weight /= kNorm;}
+  }
+  return histogram;
+}
+
+// Same with the non-zero bins only, the points of the graph over the histograms
+SparseHistogram<float> NormalizedSparseHistogram(const SparseHistogram<float>& kHistogram) {
+  auto weights = kHistogram.Weights();
+  const auto kNorm = std::sqrt(DenseDotProduct(weights.data(), weights.data(), weights.size()));
+  if (kNorm>0.0f) {
+    for (auto& weight: weights) {weight /= kNorm;}
+  }
+  return SparseHistogram<float>(kHistogram.NumBins(), kHistogram.Bins(), std::move(weights));
+}
+
+// Number of histograms the product quantizer is trained on at most
+const size_t kMaxProductQuantizationTrainingSize = 10000;
+
+// Number of images whose VLAD vectors the projection is computed from at most. These
+// are kept in memory with the full dimension, e.g. 32k for 256 words.
+const size_t kMaxVladPcaTrainingSize = 2000;
+
+// Stored with the image index, queries pass their own candidate list size
+const size_t kImageIndexEfSearch = 100;
+
+// Number of images an image index contains and a hash of their filenames in order,
+// stored next to the index to tell if it can be extended
+struct ImageIndexItems {
+  uint64_t num_items;
+  uint64_t hash;
+};
+
+std::string ImageIndexItemsPath(const std::string& kIndexPath) {return kIndexPath+".items";}
+
+ImageIndexItems HashImageIndexItems
+  (const std::vector<std::shared_ptr<const ImageItem>>& kItems, const size_t kNumItems)
+{
+  std::string filenames;
+  for (size_t index = 0; index<kNumItems; index++) {
+    filenames += kItems[index]->ImageFilename();
+    filenames += '\0';
+  }
+  return {kNumItems, QueryCache::ContentHash(filenames.data(), filenames.size())};
+}
+
+// False if there is no readable file
+bool ReadImageIndexItems(const std::string& kIndexPath, ImageIndexItems& items) {
+  std::ifstream file(ImageIndexItemsPath(kIndexPath), std::ios::binary);
+  file.read(reinterpret_cast<char*>(&items.num_items), sizeof(uint64_t));
+  file.read(reinterpret_cast<char*>(&items.hash), sizeof(uint64_t));
+  return static_cast<bool>(file);
+}
+
+void WriteImageIndexItems(const std::string& kIndexPath, const ImageIndexItems& kItems) {
+  std::ofstream file(ImageIndexItemsPath(kIndexPath), std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&kItems.num_items), sizeof(uint64_t));
+  file.write(reinterpret_cast<const char*>(&kItems.hash), sizeof(uint64_t));
+  if (!file) {throw std::runtime_error("Cannot write "+ImageIndexItemsPath(kIndexPath)+".");}
+}
+
+// Insert the images missing from the index at kIndexPath, which is built from scratch
+// if it was not built over the first images of the dataset
+template <class PointType, class ImagePointFunction>
+void ExtendImageIndex
+  (const std::string& kIndexPath,
+   const std::vector<std::shared_ptr<const ImageItem>>& kItems,
+   const ImagePointFunction& ImagePoint,
+   const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const int kSeed,
+   const bool kRebuild,
+   const bool kVerbose)
+{
+  std::unique_ptr<HnswIndex<PointType>> index;
+  ImageIndexItems previous_items;
+  if (!kRebuild && FileExists(kIndexPath)) {
+    auto previous_index = HnswIndex<PointType>::ReadFromBinary(kIndexPath);
+    const auto kNumPrevious = previous_index.Size();
+    if (kNumPrevious>0 && kNumPrevious<=kItems.size() &&
+        ReadImageIndexItems(kIndexPath, previous_items) &&
+        previous_items.num_items==kNumPrevious &&
+        previous_items.hash==HashImageIndexItems(kItems, kNumPrevious).hash) {
+      // Graph parameters differ only if a new index was asked for, instead of silently using the stored ones
+      if (previous_index.MaxConnections()!=kMaxConnections || previous_index.EfConstruction()!=kEfConstruction) {
+        throw std::invalid_argument
+          ("Image index "+kIndexPath+" was built with M="+std::to_string(previous_index.MaxConnections())+
+           " and efConstruction="+std::to_string(previous_index.EfConstruction())+", rebuild it to change them.");
+      }
+      if (kVerbose) {std::cout << "* Extend image index " << kIndexPath << " of " << kNumPrevious << " images.\n";}
+      index = std::make_unique<HnswIndex<PointType>>(std::move(previous_index));
+    } else {
+      std::cerr << "Image index does not match the images and is rebuilt.\n";
+    }
+  }
+  if (!index) {
+    index = std::make_unique<HnswIndex<PointType>>
+      (std::vector<PointType>(), kMaxConnections, kEfConstruction, kImageIndexEfSearch, kSeed);
+  }
+
+  if (kVerbose) {std::cout << "* Insert " << kItems.size()-index->Size() << " images.\n";}
+  for (size_t item_index = index->Size(); item_index<kItems.size(); item_index++) {
+    index->Insert(ImagePoint(item_index));
+  }
+
+  index->WriteToBinary(kIndexPath);
+  WriteImageIndexItems(kIndexPath, HashImageIndexItems(kItems, kItems.size()));
+  if (kVerbose) {std::cout << "* Write image index to " << kIndexPath << ".\n";}
+}
+
+} // namespace
+
+
+QueryMode QueryModeFromString(const std::string& kName) {
+  if (kName=="exhaustive") {return QueryMode::kExhaustive;}
+  if (kName=="pruned") {return QueryMode::kPruned;}
+  if (kName=="quantized") {return QueryMode::kQuantized;}
+  if (kName=="product-quantized") {return QueryMode::kProductQuantized;}
+  if (kName=="vlad") {return QueryMode::kVlad;}
+  if (kName=="graph") {return QueryMode::kGraph;}
+  if (kName=="vlad-graph") {return QueryMode::kVladGraph;}
+  throw std::invalid_argument("Query mode "+kName+" not recognized.");
+}
+
+
 BagOfWords::BagOfWords
   (const std::shared_ptr<const Dataset> kDataset, const bool kVerbose):
   kDataset_{kDataset}, verbose_{kVerbose}
@@ -36,22 +176,8 @@ void BagOfWords::CreateDictionary
 std::vector<float> BagOfWords::Similarities
   (const std::shared_ptr<const ImageItem> kQueryItem) const
 {
-  const auto kNumImages = this->kDataset_->Items().size();
+  const auto kIndex = this->LoadSimilarityIndex();
 
-  // Read histograms
-  std::vector<Histogram<float>> histograms;
-  histograms.reserve(kNumImages);
-  for(const auto& kItem: this->kDataset_->Items()) {
-    Histogram<float> histogram;
-    try {
-      histogram = kItem->LoadHistogram();
-    } catch (const std::runtime_error&) {
-      throw DictionaryIncomplete
-        ("Expected to find histogram binary "+kItem->HistogramBinaryFilename()+
-         ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
-    }
-    histograms.emplace_back(std::move(histogram));
-  }
   Histogram<float> query_histogram;
   try {
     query_histogram = kQueryItem->LoadHistogram();
@@ -61,7 +187,91 @@ std::vector<float> BagOfWords::Similarities
        ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
   }
 
-  return ComputeSimilarities<float>(query_histogram, histograms);
+  return kIndex->Similarities(query_histogram);
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarItems
+  (const std::shared_ptr<const ImageItem> kQueryItem,
+   const size_t kNumResults,
+   const QueryMode kMode,
+   const size_t kNumCandidates) const
+{
+  if (kMode==QueryMode::kVlad) {
+    return this->LoadVladIndex()->TopK(this->LoadVladVector(kQueryItem), kNumResults);
+  }
+  if (kMode==QueryMode::kVladGraph) {
+    return this->MostSimilarInGraph(this->LoadVladVector(kQueryItem), kNumResults, kNumCandidates);
+  }
+  if (kMode==QueryMode::kGraph) {
+    return this->MostSimilarInGraph
+      (NormalizedSparseHistogram(this->LoadQueryHistogram(kQueryItem)), kNumResults, kNumCandidates);
+  }
+  return this->MostSimilarToHistogram(this->LoadQueryHistogram(kQueryItem), kNumResults, kMode, kNumCandidates);
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarItems
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures,
+   const size_t kNumResults,
+   const QueryMode kMode,
+   const size_t kNumCandidates) const
+{
+  if (kMode==QueryMode::kVlad) {
+    return this->LoadVladIndex()->TopK(this->LoadVladEncoder()->Encode(kQueryFeatures), kNumResults);
+  }
+  if (kMode==QueryMode::kVladGraph) {
+    return this->MostSimilarInGraph(this->LoadVladEncoder()->Encode(kQueryFeatures), kNumResults, kNumCandidates);
+  }
+  return this->MostSimilarItems
+    (this->LoadQueryEngine()->QueryHistogram(kQueryFeatures), kNumResults, kMode, kNumCandidates);
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarItems
+  (const SparseHistogram<float>& kQueryHistogram,
+   const size_t kNumResults,
+   const QueryMode kMode,
+   const size_t kNumCandidates) const
+{
+  if (kMode==QueryMode::kVlad || kMode==QueryMode::kVladGraph) {
+    throw std::invalid_argument("VLAD queries need the features of the query image.");
+  }
+  if (kMode==QueryMode::kGraph) {
+    return this->MostSimilarInGraph(NormalizedSparseHistogram(kQueryHistogram), kNumResults, kNumCandidates);
+  }
+  return this->MostSimilarToHistogram(kQueryHistogram, kNumResults, kMode, kNumCandidates);
+}
+
+
+void BagOfWords::PrepareQueries(const QueryMode kMode) const {
+  switch (kMode) {
+    case QueryMode::kVlad:
+      this->LoadVladEncoder();
+      this->LoadVladIndex();
+      return;
+    case QueryMode::kVladGraph:
+      this->LoadVladEncoder();
+      this->LoadVladGraph();
+      return;
+    case QueryMode::kGraph:
+      this->LoadHistogramGraph();
+      break;
+    case QueryMode::kPruned:
+      this->LoadInvertedIndex();
+      break;
+    case QueryMode::kQuantized:
+      this->LoadQuantizedIndex();
+      break;
+    case QueryMode::kProductQuantized:
+      this->LoadProductQuantizedIndex();
+      break;
+    case QueryMode::kExhaustive:
+    default:
+      this->LoadSimilarityIndex();
+      break;
+  }
+  this->LoadQueryEngine();
 }
 
 
@@ -78,17 +288,7 @@ std::pair
       ("Number of similarities does not match number of images in dataset.");
   }
 
-  // Perform argsort (get the indices that would sort the similarities vector)
-  // Reference: https://stackoverflow.com/questions/1577475/
-  // c-sorting-and-keeping-track-of-indexes
-  std::vector<size_t> indices(kNumImages);
-  // Populate with indices in increasing order
-  std::iota(indices.begin(), indices.end(), 0);
-  // Use lambda expression for sorting
-  std::sort
-    (indices.begin(), indices.end(),
-     [&kSimilarities](const size_t kIndex1, const size_t kIndex2)
-       {return kSimilarities[kIndex1]>kSimilarities[kIndex2];});
+  const auto kRanking = TopKScores(kSimilarities, kNumImages);
 
   // Return items in order and corresponding similarities
   std::vector<std::shared_ptr<const ImageItem>> items_ordered_by_similarity;
@@ -97,15 +297,29 @@ std::pair
   std::vector<float> ordered_similarities;
   ordered_similarities.reserve(kNumImages);
 
-  for(const auto kIndex: indices) {
-    items_ordered_by_similarity.emplace_back(this->kDataset_->Items()[kIndex]);
-    ordered_similarities.emplace_back(kSimilarities[kIndex]);
+  for(const auto& kResult: kRanking) {
+    items_ordered_by_similarity.emplace_back(this->kDataset_->Items()[kResult.first]);
+    ordered_similarities.emplace_back(kResult.second);
   }
 
   return std::make_pair(items_ordered_by_similarity, ordered_similarities);
 }
 
 
+Ranking<float> BagOfWords::RankItemsBySimilarity
+  (const std::vector<float>& kSimilarities,
+   const size_t kNumMostSimilar,
+   const size_t kNumLeastSimilar) const
+{
+  if (kSimilarities.size()!=this->kDataset_->Items().size()) {
+    throw std::invalid_argument
+      ("Number of similarities does not match number of images in dataset.");
+  }
+
+  return RankScores(kSimilarities, kNumMostSimilar, kNumLeastSimilar);
+}
+
+
 bool BagOfWords::DictionaryComplete() const
 {
   if (!this->kDataset_->HasHistogramWeights()) {return false;}
@@ -138,40 +352,140 @@ void BagOfWords::ExtractFeatures() const {
 }
 
 
-void BagOfWords::ComputeClusterCentroids(const ClusteringStrategy<float>& kStrategy) const {
-  if (this->verbose_) {std::cout << "Start clustering.\n";}
+void BagOfWords::ExtractFeatures
+  (const std::string& kQueueDir,
+   const size_t kBatchSize,
+   const std::chrono::milliseconds kLeaseDuration,
+   const std::string& kWorkerId) const
+{
+  const auto kItems = this->kDataset_->Items();
+  FileWorkQueue queue(kQueueDir, kItems.size(), kBatchSize, kLeaseDuration, kWorkerId);
+  if (this->verbose_) {
+    std::cout << "Start extracting features as worker " << kWorkerId << " (" << queue.NumBatches() <<
+      " batches of " << queue.BatchSize() << " images, " << queue.NumDone() << " done).\n";
+  }
 
-  // Collect extracted features from all images
-  const auto kNumImages = this->kDataset_->Items().size();
-  std::vector<std::vector<FeaturePoint<float>>> features_per_image;
-  features_per_image.reserve(kNumImages);
+  // Wait for batches leased by other workers to be done or to expire
+  const auto kPollInterval = std::min(kLeaseDuration/4, std::chrono::milliseconds(1000));
+  WorkBatch batch;
+  while (!queue.Done()) {
+    if (!queue.Claim(batch)) {
+      std::this_thread::sleep_for(kPollInterval);
+      continue;
+    }
+    if (this->verbose_) {
+      std::cout << "* Claimed batch " << batch.index << " (images " << batch.begin << " to " << batch.end-1 << ").\n";
+    }
 
-  for (const auto& kItem: this->kDataset_->Items()) {
-    if (this->verbose_) {std::cout << "* Load features binary " << kItem->FeaturesBinaryFilename() << ".\n";}
-    cv::Mat mat;
-    try {
-      mat = kItem->LoadFeatures();
-    } catch (const std::runtime_error&) {
-      throw DictionaryIncomplete
-        ("Expected to find features binary "+kItem->FeaturesBinaryFilename()+
-         ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
+    bool leased = true;
+    auto renewed = std::chrono::steady_clock::now();
+    for (size_t index = batch.begin; index<batch.end; index++) {
+      if (std::chrono::steady_clock::now()-renewed>kLeaseDuration/2) {
+        leased = queue.Renew(batch);
+        if (!leased) {break;}
+        renewed = std::chrono::steady_clock::now();
+      }
+
+      const auto& kItem = kItems[index];
+      if (this->verbose_) {std::cout << "* Load image " << kItem->ImageFilename() << ".\n";}
+      const auto kFeatures = ComputeFeatures(kItem->LoadImage());
+
+      // Other workers never see a partially written file
+      const auto kTemporaryPath = kItem->FeaturesBinaryPath()+"."+kWorkerId+".tmp";
+      WriteMatToBinary(kTemporaryPath, kFeatures);
+      boost::filesystem::rename(kTemporaryPath, kItem->FeaturesBinaryPath());
+    }
+
+    if (leased) {
+      queue.Complete(batch);
+    } else if (this->verbose_) {
+      std::cout << "* Lost lease of batch " << batch.index << ", it is left to another worker.\n";
     }
-    features_per_image.emplace_back(std::move(FromMat<float>(std::move(mat))));
   }
 
-  const auto kFeatures = Flatten(std::move(features_per_image));
+  if (this->verbose_) {std::cout << "Done extracting features.\n";}
+}
+
 
-  // Perform actual clustering
-  std::vector<FeaturePoint<float>> centroids = kStrategy.ClusterCentroids(kFeatures);
+void BagOfWords::ComputeClusterCentroids
+  (const ClusteringStrategy<float>& kStrategy,
+   const size_t kMaxTrainingDescriptors,
+   const bool kStratified,
+   const int kSeed) const
+{
+  if (this->verbose_) {std::cout << "Start clustering.\n";}
 
-  WriteCentroidsToBinary(this->kDataset_->CentroidsPath(), centroids);
-  if (this->verbose_) {std::cout << "* Write cluster centroids to " << this->kDataset_->CentroidsPath() << ".\n";}
+  this->WriteClusterCentroids(this->ClusterFeatures(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed));
 
   if (this->verbose_) {std::cout << "Done clustering.\n";}
 }
 
 
-void BagOfWords::MakeHistograms() const {
+void BagOfWords::ComputeClusterCentroids
+  (const DistributedKmeans& kKmeans,
+   const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers) const
+{
+  if (this->verbose_) {std::cout << "Start clustering on " << kWorkers.size() << " workers.\n";}
+
+  this->WriteClusterCentroids(kKmeans.ClusterCentroids(kWorkers));
+
+  if (this->verbose_) {std::cout << "Done clustering.\n";}
+}
+
+
+void BagOfWords::WriteClusterCentroids(const std::vector<FeaturePoint<float>>& kCentroids) const {
+  WriteCentroidsToBinary(this->kDataset_->CentroidsPath(), kCentroids);
+  if (this->verbose_) {std::cout << "* Write cluster centroids to " << this->kDataset_->CentroidsPath() << ".\n";}
+
+  // A word index built over previous centroids is no longer valid
+  if (this->kDataset_->HasWordIndex()) {
+    boost::filesystem::remove(this->kDataset_->WordIndexPath());
+    if (this->verbose_) {std::cout << "* Remove outdated word index " << this->kDataset_->WordIndexPath() << ".\n";}
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->query_engine_mutex_);
+    this->query_engine_.reset();
+  }
+}
+
+
+void BagOfWords::BuildWordIndex
+  (const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const size_t kEfSearch,
+   const int kSeed) const
+{
+  if (this->verbose_) {std::cout << "Start building word index.\n";}
+
+  std::vector<FeaturePoint<float>> centroids;
+  try {
+    centroids = this->kDataset_->LoadCentroids();
+  } catch (const std::runtime_error&) {
+    throw DictionaryIncomplete
+      ("Expected to find centroids binary, but it seems like it cannot be loaded. "
+       "Did you call CreateDictionary()?");
+  }
+
+  if (this->verbose_) {std::cout << "* Index " << centroids.size() << " cluster centroids.\n";}
+  const HnswIndex<FeaturePoint<float>> kIndex
+    (centroids, kMaxConnections, kEfConstruction, kEfSearch, kSeed);
+
+  kIndex.WriteToBinary(this->kDataset_->WordIndexPath());
+  if (this->verbose_) {std::cout << "* Write word index to " << this->kDataset_->WordIndexPath() << ".\n";}
+
+  {
+    std::lock_guard<std::mutex> lock(this->query_engine_mutex_);
+    this->query_engine_.reset();
+  }
+
+  if (this->verbose_) {std::cout << "Done building word index.\n";}
+}
+
+
+void BagOfWords::MakeHistograms
+  (const double kMaxDocumentFrequency, const size_t kMaxWordCount) const
+{
   if (this->verbose_) {std::cout << "Start computing histograms.\n";}
 
   if (this->verbose_) {std::cout << "* Read cluster centroids.\n";}
@@ -187,6 +501,18 @@ void BagOfWords::MakeHistograms() const {
   const auto kNumClusters = centroids.size();
   if (this->verbose_) {std::cout << "* Number of clusters (= words): " << kNumClusters << "\n";}
 
+  // Use the word index for approximate assignment if one was built for these centroids
+  std::unique_ptr<const HnswIndex<FeaturePoint<float>>> word_index;
+  if (this->kDataset_->HasWordIndex()) {
+    auto index = this->kDataset_->LoadWordIndex();
+    if (index.Size()==kNumClusters) {
+      if (this->verbose_) {std::cout << "* Use word index " << this->kDataset_->WordIndexPath() << ".\n";}
+      word_index = std::make_unique<const HnswIndex<FeaturePoint<float>>>(std::move(index));
+    } else {
+      std::cerr << "Word index does not match cluster centroids and is ignored.\n";
+    }
+  }
+
   // Track which images occur in each cluster (needed to reweight histogram bins)
   // Only need to rembember each images once, therefor we use std::set
   std::vector<std::set<std::shared_ptr<const ImageItem>>> cluster_occurences
@@ -210,7 +536,8 @@ void BagOfWords::MakeHistograms() const {
 
     for (const auto& kFeature: kFeatures) {
       // Find the cluster this feature belongs to
-      const size_t kCluster = NearestNeighbor(kFeature, centroids);
+      const size_t kCluster = word_index ?
+        word_index->NearestNeighbor(kFeature) : NearestNeighbor(kFeature, centroids);
 
       // Update histrogram
       histogram[kCluster] += 1.0f;
@@ -220,23 +547,35 @@ void BagOfWords::MakeHistograms() const {
     }
 
     if (this->verbose_) {std::cout << "* Write histogram to binary.\n";}
-    WriteToBinary(kItem->HistogramBinaryPath(), histogram);
+    WriteHistogramToBinary(kItem->HistogramBinaryPath(), histogram);
   }
 
   // Number of images in each cluster for re-weighting
-  std::vector<float> cluster_counts;
+  std::vector<size_t> cluster_counts;
   cluster_counts.reserve(kNumClusters);
   for (const auto& kClusterOccurence: cluster_occurences) {
-    cluster_counts.emplace_back(static_cast<float>(kClusterOccurence.size()));
+    cluster_counts.emplace_back(kClusterOccurence.size());
+  }
+
+  // Drop words contained in too many images and limit counts within an image
+  const auto kPruning = VocabularyPruning::FromDocumentFrequencies
+    (cluster_counts, this->kDataset_->Items().size(), kMaxDocumentFrequency, kMaxWordCount);
+  if (this->verbose_) {
+    std::cout << "* Number of stop words: " << kPruning.StopWords().size() << "\n";
+    std::cout << "* Write vocabulary pruning to binary " <<
+    this->kDataset_->VocabularyPruningPath() << ".\n";
   }
+  kPruning.WriteToBinary(this->kDataset_->VocabularyPruningPath());
 
   // Compute histogram re-weighting factors
   // (Logarithm of total number of images over number images in which the cluster occured)
+  // Words in no image, e.g. of an empty cluster, are weighted zero like stop words
   const float kNumImages = static_cast<float>(this->kDataset_->Items().size());
   std::vector<float> histogram_weights;
   histogram_weights.reserve(kNumClusters);
-  for (const auto& kClusterOccurence: cluster_occurences) {
-    histogram_weights.emplace_back(std::log(kNumImages/static_cast<float>(kClusterOccurence.size())));
+  for (size_t cluster = 0; cluster<kNumClusters; cluster++) {
+    histogram_weights.emplace_back(kPruning.IsStopWord(cluster) || cluster_counts[cluster]==0 ?
+      0.0f : std::log(kNumImages/static_cast<float>(cluster_counts[cluster])));
   }
 
   // Write weights to file
@@ -251,7 +590,7 @@ void BagOfWords::MakeHistograms() const {
     if (this->verbose_) {std::cout << "* Load histogram binary " << kItem->HistogramBinaryFilename() << ".\n";}
     Histogram<float> histogram;
     try {
-      histogram = igg::ReadFromBinary<float>(kItem->HistogramBinaryPath());
+      histogram = igg::ReadHistogramFromBinary<float>(kItem->HistogramBinaryPath());
     } catch (const std::runtime_error&) {
       throw DictionaryIncomplete
         ("Expected to find histogram binary "+kItem->HistogramBinaryFilename()+
@@ -259,22 +598,225 @@ void BagOfWords::MakeHistograms() const {
     }
 
     if (this->verbose_) {std::cout << "* Perfrom re-weighting.\n";}
-    // Number of features in this image for re-weighting
+    kPruning.Apply(histogram);
+
+    // Number of remaining features in this image for re-weighting
     const float kNumFeatures = std::accumulate
       (histogram.begin(), histogram.end(), 0.0f); // 0.0f is initial value
 
-    for (size_t cluster = 0; cluster<kNumClusters; cluster++) {
-      histogram[cluster] = histogram[cluster]/kNumFeatures*histogram_weights[cluster];
+    if (kNumFeatures>0.0f) {
+      for (size_t cluster = 0; cluster<kNumClusters; cluster++) {
+        histogram[cluster] = histogram[cluster]/kNumFeatures*histogram_weights[cluster];
+      }
     }
 
     if (this->verbose_) {std::cout << "* Write re-weighted histogram to binary file.\n";}
-    igg::WriteToBinary<float>(kItem->HistogramBinaryPath(), histogram);
+    igg::WriteHistogramToBinary<float>(kItem->HistogramBinaryPath(), histogram);
+  }
+
+  // Histograms changed, the inverted index is outdated and reloaded on the next query
+  if (this->kDataset_->HasInvertedIndex()) {
+    boost::filesystem::remove(this->kDataset_->InvertedIndexPath());
+    if (this->verbose_) {std::cout << "* Remove outdated inverted index " << this->kDataset_->InvertedIndexPath() << ".\n";}
+  }
+  if (this->kDataset_->HasProductQuantization()) {
+    boost::filesystem::remove(this->kDataset_->ProductQuantizationPath());
+    if (this->verbose_) {std::cout << "* Remove outdated product quantization " << this->kDataset_->ProductQuantizationPath() << ".\n";}
+  }
+  if (this->kDataset_->HasHistogramIndex()) {
+    boost::filesystem::remove(this->kDataset_->HistogramIndexPath());
+    boost::filesystem::remove(ImageIndexItemsPath(this->kDataset_->HistogramIndexPath()));
+    if (this->verbose_) {std::cout << "* Remove outdated image index " << this->kDataset_->HistogramIndexPath() << ".\n";}
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->inverted_index_mutex_);
+    this->inverted_index_.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->quantized_index_mutex_);
+    this->quantized_index_.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->product_quantized_index_mutex_);
+    this->product_quantized_index_.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->graph_mutex_);
+    this->histogram_graph_.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->query_engine_mutex_);
+    this->query_engine_.reset();
   }
 
   if (this->verbose_) {std::cout << "Done computing histograms.\n";}
 }
 
 
+void BagOfWords::BuildInvertedIndex() const {
+  if (this->verbose_) {std::cout << "Start building inverted index.\n";}
+
+  const InvertedIndex kIndex(this->LoadSparseHistograms());
+  if (this->verbose_) {
+    std::cout << "* Index " << kIndex.NumImages() << " images and " << kIndex.NumWords() <<
+      " words in " << kIndex.MemoryBytes()/1024 << " KiB.\n";
+  }
+
+  kIndex.WriteToBinary(this->kDataset_->InvertedIndexPath());
+  if (this->verbose_) {std::cout << "* Write inverted index to " << this->kDataset_->InvertedIndexPath() << ".\n";}
+  {
+    std::lock_guard<std::mutex> lock(this->inverted_index_mutex_);
+    this->inverted_index_.reset();
+  }
+
+  if (this->verbose_) {std::cout << "Done building inverted index.\n";}
+}
+
+
+void BagOfWords::BuildProductQuantization
+  (const size_t kCodeSize, const int kNumIterations, const int kSeed) const
+{
+  if (this->verbose_) {std::cout << "Start building product quantization.\n";}
+
+  // Train on a sample of the histograms
+  const auto kItems = this->kDataset_->Items();
+  std::mt19937 engine(kSeed);
+  const auto kTrainingIndices = SampleIndicesWithoutReplacement
+    (std::min(kItems.size(), kMaxProductQuantizationTrainingSize), kItems.size(), engine);
+  std::vector<std::vector<float>> training_histograms;
+  training_histograms.reserve(kTrainingIndices.size());
+  for (const auto kIndex: kTrainingIndices) {
+    training_histograms.emplace_back(NormalizedDenseHistogram(this->LoadQueryHistogram(kItems[kIndex])));
+  }
+  if (this->verbose_) {
+    std::cout << "* Train " << 2*kCodeSize << " subquantizers on " << training_histograms.size() << " histograms.\n";
+  }
+  ProductQuantizedIndex index(ProductQuantizer::Train(training_histograms, 2*kCodeSize, kNumIterations, kSeed));
+  // Release the training vectors and their storage before encoding
+  std::vector<std::vector<float>>().swap(training_histograms);
+
+  // Encode one histogram after the other
+  for (const auto& kItem: kItems) {index.Add(NormalizedDenseHistogram(this->LoadQueryHistogram(kItem)));}
+  if (this->verbose_) {
+    std::cout << "* Encode " << index.Size() << " images in " << index.MemoryBytes()/1024 << " KiB.\n";
+  }
+
+  index.WriteToBinary(this->kDataset_->ProductQuantizationPath());
+  if (this->verbose_) {std::cout << "* Write product quantization to " << this->kDataset_->ProductQuantizationPath() << ".\n";}
+  {
+    std::lock_guard<std::mutex> lock(this->product_quantized_index_mutex_);
+    this->product_quantized_index_.reset();
+  }
+
+  if (this->verbose_) {std::cout << "Done building product quantization.\n";}
+}
+
+
+void BagOfWords::MakeVladVectors
+  (const ClusteringStrategy<float>& kStrategy,
+   const size_t kNumComponents,
+   const size_t kMaxTrainingDescriptors,
+   const int kSeed) const
+{
+  if (this->verbose_) {std::cout << "Start computing VLAD vectors.\n";}
+
+  VladEncoder encoder(this->ClusterFeatures(kStrategy, kMaxTrainingDescriptors, false, kSeed));
+  if (this->verbose_) {
+    std::cout << "* Vocabulary of " << encoder.NumClusters() << " words, " <<
+      encoder.RawDimension() << " dimensions.\n";
+  }
+
+  // Compute the projection from a sample of the images
+  const auto kItems = this->kDataset_->Items();
+  if (kNumComponents>0) {
+    std::mt19937 engine(kSeed);
+    const auto kTrainingIndices = SampleIndicesWithoutReplacement
+      (std::min(kItems.size(), kMaxVladPcaTrainingSize), kItems.size(), engine);
+    std::vector<std::vector<float>> training_vectors;
+    training_vectors.reserve(kTrainingIndices.size());
+    for (const auto kIndex: kTrainingIndices) {
+      training_vectors.emplace_back(encoder.EncodeRaw(this->LoadItemFeatures(kItems[kIndex])));
+    }
+    if (this->verbose_) {
+      std::cout << "* Compute " << kNumComponents << " main components of " << training_vectors.size() << " images.\n";
+    }
+    encoder.TrainPca(training_vectors, kNumComponents);
+  }
+
+  std::vector<std::vector<float>> vectors;
+  vectors.reserve(kItems.size());
+  for (const auto& kItem: kItems) {
+    if (this->verbose_) {std::cout << "* Encode features binary " << kItem->FeaturesBinaryFilename() << ".\n";}
+    vectors.emplace_back(encoder.Encode(this->LoadItemFeatures(kItem)));
+  }
+
+  encoder.WriteToBinary(this->kDataset_->VladEncoderPath());
+  WriteCentroidsToBinary(this->kDataset_->VladVectorsPath(), vectors);
+  if (this->verbose_) {
+    std::cout << "* Write " << vectors.size() << " vectors of " << encoder.Dimension() <<
+      " dimensions to " << this->kDataset_->VladVectorsPath() << ".\n";
+  }
+  if (this->kDataset_->HasVladIndex()) {
+    boost::filesystem::remove(this->kDataset_->VladIndexPath());
+    boost::filesystem::remove(ImageIndexItemsPath(this->kDataset_->VladIndexPath()));
+    if (this->verbose_) {std::cout << "* Remove outdated image index " << this->kDataset_->VladIndexPath() << ".\n";}
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->vlad_mutex_);
+    this->vlad_encoder_.reset();
+    this->vlad_index_.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->graph_mutex_);
+    this->vlad_graph_.reset();
+  }
+
+  if (this->verbose_) {std::cout << "Done computing VLAD vectors.\n";}
+}
+
+
+void BagOfWords::BuildImageIndex
+  (const ImageEncoding kEncoding,
+   const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const int kSeed,
+   const bool kRebuild) const
+{
+  if (this->verbose_) {std::cout << "Start building image index.\n";}
+
+  const bool kVlad = kEncoding==ImageEncoding::kVlad;
+  const auto kPath = kVlad ? this->kDataset_->VladIndexPath() : this->kDataset_->HistogramIndexPath();
+  const auto kItems = this->kDataset_->Items();
+
+  // VLAD vectors are stored in one file, histograms are read one after another
+  std::vector<std::vector<float>> vlad_vectors;
+  if (kVlad) {
+    if (!this->kDataset_->HasVladVectors()) {
+      throw DictionaryIncomplete
+        ("Expected to find VLAD vectors "+this->kDataset_->VladVectorsPath()+
+         ", but they do not exist. Did you call MakeVladVectors()?");
+    }
+    vlad_vectors = this->kDataset_->LoadVladVectors();
+  }
+  if (kVlad) {
+    ExtendImageIndex<std::vector<float>>
+      (kPath, kItems, [&vlad_vectors](const size_t kIndex) {return vlad_vectors[kIndex];},
+       kMaxConnections, kEfConstruction, kSeed, kRebuild, this->verbose_);
+  } else {
+    ExtendImageIndex<SparseHistogram<float>>
+      (kPath, kItems,
+       [this, &kItems](const size_t kIndex) {return NormalizedSparseHistogram(this->LoadQueryHistogram(kItems[kIndex]));},
+       kMaxConnections, kEfConstruction, kSeed, kRebuild, this->verbose_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->graph_mutex_);
+    if (kVlad) {this->vlad_graph_.reset();} else {this->histogram_graph_.reset();}
+  }
+
+  if (this->verbose_) {std::cout << "Done building image index.\n";}
+}
+
+
 void BagOfWords::MakeWebOutput
   (const size_t kNumExamples,
    const size_t kNumExamplesSimilar,
@@ -347,13 +889,9 @@ void BagOfWords::MakeWebOutput
 
     if (this->verbose_) {std::cout << "* Get similarities: " << kItem->ImageFilestem() << ".\n";}
     const auto kSimilarities = this->Similarities(kItem);
-    const auto kOrderedResults = this->OrderItemsBySimilarity(kSimilarities);
-    // Returns pair of ordered items and corresponding similarities
-
-    // Unpack pair
-    std::vector<std::shared_ptr<const igg::ImageItem>> items_ordered_by_similarity;
-    std::vector<float> ordered_similarities;
-    std::tie(items_ordered_by_similarity, ordered_similarities) = kOrderedResults;
+    // The query itself is expected to be the most similar image and is skipped below
+    const auto kRanking = this->RankItemsBySimilarity
+      (kSimilarities, kNumExamplesSimilar+1, kNumExamplesDifferent);
 
     if (this->verbose_) {std::cout << "* Add to html output: " << kItem->ImageFilestem() << ".\n";}
 
@@ -365,20 +903,22 @@ void BagOfWords::MakeWebOutput
     html_writer << HtmlWriter::CloseImageDiv{""} << HtmlWriter::CloseImageGroupDiv{};
 
     html_writer << HtmlWriter::OpenImageGroupDiv{} << HtmlWriter::Title{"Most similar:"};
-    for (size_t image_index = 1; image_index<=kNumExamplesSimilar && image_index<kNumImages; image_index++) {
+    for (size_t rank = 1; rank<kRanking.top.size(); rank++) {
+      const auto kSimilarItem = this->kDataset_->Items()[kRanking.top[rank].first];
       html_writer << HtmlWriter::OpenImageDiv{};
-      html_writer << HtmlWriter::Image{"images/"+items_ordered_by_similarity[image_index]->ImageFilestem()+"_small.jpg"};
-      html_writer << HtmlWriter::Image{"images/"+items_ordered_by_similarity[image_index]->ImageFilestem()+"_hist_small.jpg"};
-      html_writer << HtmlWriter::CloseImageDiv{std::to_string(ordered_similarities[image_index])};
+      html_writer << HtmlWriter::Image{"images/"+kSimilarItem->ImageFilestem()+"_small.jpg"};
+      html_writer << HtmlWriter::Image{"images/"+kSimilarItem->ImageFilestem()+"_hist_small.jpg"};
+      html_writer << HtmlWriter::CloseImageDiv{std::to_string(kRanking.top[rank].second)};
     }
     html_writer << HtmlWriter::CloseImageGroupDiv{};
 
     html_writer << HtmlWriter::OpenImageGroupDiv{} << HtmlWriter::Title{"Most different:"};
-    for (size_t image_index = kNumImages-1; image_index>=kNumImages-kNumExamplesDifferent; image_index--) {
+    for (const auto& kResult: kRanking.bottom) {
+      const auto kDifferentItem = this->kDataset_->Items()[kResult.first];
       html_writer << HtmlWriter::OpenImageDiv{};
-      html_writer << HtmlWriter::Image{"images/"+items_ordered_by_similarity[image_index]->ImageFilestem()+"_small.jpg"};
-      html_writer << HtmlWriter::Image{"images/"+items_ordered_by_similarity[image_index]->ImageFilestem()+"_hist_small.jpg"};
-      html_writer << HtmlWriter::CloseImageDiv{std::to_string(ordered_similarities[image_index])};
+      html_writer << HtmlWriter::Image{"images/"+kDifferentItem->ImageFilestem()+"_small.jpg"};
+      html_writer << HtmlWriter::Image{"images/"+kDifferentItem->ImageFilestem()+"_hist_small.jpg"};
+      html_writer << HtmlWriter::CloseImageDiv{std::to_string(kResult.second)};
     }
     html_writer << HtmlWriter::CloseImageGroupDiv{} << HtmlWriter::CloseItemDiv{};
   }
@@ -391,4 +931,281 @@ void BagOfWords::MakeWebOutput
   if (this->verbose_) {std::cout << "Done generating web output.\n";}
 }
 
+
+std::shared_ptr<const QueryEngine> BagOfWords::LoadQueryEngine() const {
+  std::lock_guard<std::mutex> lock(this->query_engine_mutex_);
+  if (this->query_engine_) {return this->query_engine_;}
+
+  try {
+    this->query_engine_ = QueryEngine::Load(*this->kDataset_);
+  } catch (const std::runtime_error& kError) {
+    throw DictionaryIncomplete
+      (std::string("Expected to find the visual dictionary, but it seems like it cannot be loaded (")+
+       kError.what()+"). Did you call CreateDictionary()?");
+  }
+  return this->query_engine_;
+}
+
+
+std::shared_ptr<const SimilarityIndex<float>> BagOfWords::LoadSimilarityIndex() const {
+  // Shares ownership of the snapshot it is part of
+  const auto kEngine = this->LoadQueryEngine();
+  return std::shared_ptr<const SimilarityIndex<float>>(kEngine, &kEngine->Index());
+}
+
+
+std::shared_ptr<const QuantizedSimilarityIndex<float>> BagOfWords::LoadQuantizedIndex() const {
+  std::lock_guard<std::mutex> lock(this->quantized_index_mutex_);
+  if (this->quantized_index_) {return this->quantized_index_;}
+
+  // Quantize one histogram after the other, so the full-precision ones are never all in memory
+  std::unique_ptr<QuantizedSimilarityIndex<float>> index;
+  for (const auto& kItem: this->kDataset_->Items()) {
+    const auto kHistogram = this->LoadQueryHistogram(kItem);
+    if (!index) {index = std::make_unique<QuantizedSimilarityIndex<float>>(kHistogram.NumBins());}
+    index->Add(kHistogram);
+  }
+  if (!index) {index = std::make_unique<QuantizedSimilarityIndex<float>>(0);}
+
+  this->quantized_index_ = std::move(index);
+  return this->quantized_index_;
+}
+
+
+std::shared_ptr<const InvertedIndex> BagOfWords::LoadInvertedIndex() const {
+  std::lock_guard<std::mutex> lock(this->inverted_index_mutex_);
+  if (this->inverted_index_) {return this->inverted_index_;}
+
+  if (!this->kDataset_->HasInvertedIndex()) {
+    throw DictionaryIncomplete
+      ("Expected to find inverted index "+this->kDataset_->InvertedIndexPath()+
+       ", but it does not exist. Did you call BuildInvertedIndex()?");
+  }
+  this->inverted_index_ = std::make_shared<const InvertedIndex>(this->kDataset_->LoadInvertedIndex());
+  return this->inverted_index_;
+}
+
+
+std::shared_ptr<const ProductQuantizedIndex> BagOfWords::LoadProductQuantizedIndex() const {
+  std::lock_guard<std::mutex> lock(this->product_quantized_index_mutex_);
+  if (this->product_quantized_index_) {return this->product_quantized_index_;}
+
+  if (!this->kDataset_->HasProductQuantization()) {
+    throw DictionaryIncomplete
+      ("Expected to find product quantization "+this->kDataset_->ProductQuantizationPath()+
+       ", but it does not exist. Did you call BuildProductQuantization()?");
+  }
+  this->product_quantized_index_ = std::make_shared<const ProductQuantizedIndex>
+    (this->kDataset_->LoadProductQuantization());
+  return this->product_quantized_index_;
+}
+
+
+std::shared_ptr<const VladEncoder> BagOfWords::LoadVladEncoder() const {
+  std::lock_guard<std::mutex> lock(this->vlad_mutex_);
+  if (this->vlad_encoder_) {return this->vlad_encoder_;}
+
+  if (!this->kDataset_->HasVladVectors()) {
+    throw DictionaryIncomplete
+      ("Expected to find VLAD encoder "+this->kDataset_->VladEncoderPath()+
+       ", but it does not exist. Did you call MakeVladVectors()?");
+  }
+  this->vlad_encoder_ = std::make_shared<const VladEncoder>(this->kDataset_->LoadVladEncoder());
+  return this->vlad_encoder_;
+}
+
+
+std::shared_ptr<const SimilarityIndex<float>> BagOfWords::LoadVladIndex() const {
+  std::lock_guard<std::mutex> lock(this->vlad_mutex_);
+  if (this->vlad_index_) {return this->vlad_index_;}
+
+  if (!this->kDataset_->HasVladVectors()) {
+    throw DictionaryIncomplete
+      ("Expected to find VLAD vectors "+this->kDataset_->VladVectorsPath()+
+       ", but they do not exist. Did you call MakeVladVectors()?");
+  }
+  this->vlad_index_ = std::make_shared<const SimilarityIndex<float>>(this->kDataset_->LoadVladVectors());
+  return this->vlad_index_;
+}
+
+
+std::shared_ptr<const HnswIndex<SparseHistogram<float>>> BagOfWords::LoadHistogramGraph() const {
+  std::lock_guard<std::mutex> lock(this->graph_mutex_);
+  if (this->histogram_graph_) {return this->histogram_graph_;}
+
+  if (!this->kDataset_->HasHistogramIndex()) {
+    throw DictionaryIncomplete
+      ("Expected to find image index "+this->kDataset_->HistogramIndexPath()+
+       ", but it does not exist. Did you call BuildImageIndex()?");
+  }
+  this->histogram_graph_ = std::make_shared<const HnswIndex<SparseHistogram<float>>>
+    (this->kDataset_->LoadHistogramIndex());
+  return this->histogram_graph_;
+}
+
+
+std::shared_ptr<const HnswIndex<std::vector<float>>> BagOfWords::LoadVladGraph() const {
+  std::lock_guard<std::mutex> lock(this->graph_mutex_);
+  if (this->vlad_graph_) {return this->vlad_graph_;}
+
+  if (!this->kDataset_->HasVladIndex()) {
+    throw DictionaryIncomplete
+      ("Expected to find image index "+this->kDataset_->VladIndexPath()+
+       ", but it does not exist. Did you call BuildImageIndex()?");
+  }
+  this->vlad_graph_ = std::make_shared<const HnswIndex<std::vector<float>>>(this->kDataset_->LoadVladIndex());
+  return this->vlad_graph_;
+}
+
+
+std::vector<float> BagOfWords::LoadVladVector(const std::shared_ptr<const ImageItem> kItem) const {
+  return this->LoadVladEncoder()->Encode(this->LoadItemFeatures(kItem));
+}
+
+
+std::vector<FeaturePoint<float>> BagOfWords::ClusterFeatures
+  (const ClusteringStrategy<float>& kStrategy,
+   const size_t kMaxTrainingDescriptors,
+   const bool kStratified,
+   const int kSeed) const
+{
+  // Collect the feature files of all images
+  const auto kNumImages = this->kDataset_->Items().size();
+  std::vector<std::string> features_paths;
+  features_paths.reserve(kNumImages);
+
+  for (const auto& kItem: this->kDataset_->Items()) {
+    if (!kItem->HasFeatures()) {
+      throw DictionaryIncomplete
+        ("Expected to find features binary "+kItem->FeaturesBinaryFilename()+
+         ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
+    }
+    features_paths.emplace_back(kItem->FeaturesBinaryPath());
+  }
+
+  // Features are streamed from the files, strategies which cannot work on chunks
+  // load all of them into memory
+  const size_t kChunkSize = 100000;
+  FeatureFileStream stream(features_paths, kChunkSize);
+  if (this->verbose_) {std::cout << "* Stream " << stream.Size() << " features of " << kNumImages << " images.\n";}
+
+  // Perform actual clustering
+  std::vector<FeaturePoint<float>> centroids;
+  if (kMaxTrainingDescriptors>0 && stream.Size()>kMaxTrainingDescriptors) {
+    std::mt19937 engine(kSeed);
+    const auto kTrainingSet = kStratified ?
+      SampleTrainingSetStratified(stream, stream.NumFeaturesPerFile(), kMaxTrainingDescriptors, engine) :
+      SampleTrainingSet(stream, kMaxTrainingDescriptors, engine);
+    if (this->verbose_) {
+      std::cout << "* Sample " << kTrainingSet.size() << " features" <<
+        (kStratified ? " (stratified by image)" : "") << " for training.\n";
+    }
+    centroids = kStrategy.ClusterCentroids(kTrainingSet);
+  } else {
+    centroids = kStrategy.ClusterCentroidsFromStream(stream);
+  }
+
+  return centroids;
+}
+
+
+std::vector<FeaturePoint<float>> BagOfWords::LoadItemFeatures
+  (const std::shared_ptr<const ImageItem> kItem) const
+{
+  cv::Mat mat;
+  try {
+    mat = kItem->LoadFeatures();
+  } catch (const std::runtime_error&) {
+    throw DictionaryIncomplete
+      ("Expected to find features binary "+kItem->FeaturesBinaryFilename()+
+       ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
+  }
+  return FromMat<float>(std::move(mat));
+}
+
+
+SparseHistogram<float> BagOfWords::LoadQueryHistogram
+  (const std::shared_ptr<const ImageItem> kQueryItem) const
+{
+  try {
+    return kQueryItem->LoadSparseHistogram();
+  } catch (const std::runtime_error&) {
+    throw DictionaryIncomplete
+      ("Expected to find histogram binary "+kQueryItem->HistogramBinaryFilename()+
+       ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
+  }
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarToHistogram
+  (const SparseHistogram<float>& kQueryHistogram,
+   const size_t kNumResults,
+   const QueryMode kMode,
+   const size_t kNumCandidates) const
+{
+  switch (kMode) {
+    case QueryMode::kPruned:
+      return this->LoadInvertedIndex()->TopKPruned(kQueryHistogram, kNumResults);
+    case QueryMode::kQuantized: {
+      // Re-rank with the full-precision histograms from their files
+      const auto kItems = this->kDataset_->Items();
+      return this->LoadQuantizedIndex()->TopK(kQueryHistogram, kNumResults, kNumCandidates,
+        [this, &kItems](const size_t kIndex) {return this->LoadQueryHistogram(kItems[kIndex]);});
+    }
+    case QueryMode::kProductQuantized:
+      return this->LoadProductQuantizedIndex()->TopK
+        (NormalizedDenseHistogram(kQueryHistogram), kNumResults, kNumCandidates);
+    case QueryMode::kExhaustive:
+    default:
+      return this->LoadSimilarityIndex()->TopK(kQueryHistogram, kNumResults);
+  }
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarInGraph
+  (const SparseHistogram<float>& kQueryHistogram,
+   const size_t kNumResults,
+   const size_t kNumCandidates) const
+{
+  const auto kIndex = this->LoadHistogramGraph();
+  std::vector<ScoredIndex<float>> results;
+  for (const auto kNeighbor: kIndex->NearestNeighbors(kQueryHistogram, kNumResults, kNumCandidates)) {
+    results.emplace_back(kNeighbor, SparseDotProduct(kQueryHistogram, kIndex->Point(kNeighbor)));
+  }
+  return results;
+}
+
+
+std::vector<ScoredIndex<float>> BagOfWords::MostSimilarInGraph
+  (const std::vector<float>& kQueryVlad,
+   const size_t kNumResults,
+   const size_t kNumCandidates) const
+{
+  const auto kIndex = this->LoadVladGraph();
+  std::vector<ScoredIndex<float>> results;
+  for (const auto kNeighbor: kIndex->NearestNeighbors(kQueryVlad, kNumResults, kNumCandidates)) {
+    results.emplace_back
+      (kNeighbor, DenseDotProduct(kQueryVlad.data(), kIndex->Point(kNeighbor).data(), kQueryVlad.size()));
+  }
+  return results;
+}
+
+
+std::vector<SparseHistogram<float>> BagOfWords::LoadSparseHistograms() const {
+  std::vector<SparseHistogram<float>> histograms;
+  histograms.reserve(this->kDataset_->Items().size());
+  for(const auto& kItem: this->kDataset_->Items()) {
+    SparseHistogram<float> histogram;
+    try {
+      histogram = kItem->LoadSparseHistogram();
+    } catch (const std::runtime_error&) {
+      throw DictionaryIncomplete
+        ("Expected to find histogram binary "+kItem->HistogramBinaryFilename()+
+         ", but it seems like it cannot be loaded. Did you call CreateDictionary()?");
+    }
+    histograms.emplace_back(std::move(histogram));
+  }
+  return histograms;
+}
+
 } // namespace igg
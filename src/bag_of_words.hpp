@@ -1,12 +1,55 @@
 #ifndef CPP_FINAL_PROJECT_BAG_OF_WORDS_HPP_
 #define CPP_FINAL_PROJECT_BAG_OF_WORDS_HPP_
 
+#include <chrono>
+#include <memory>
+#include <mutex>
+
 #include "dataset/dataset.hpp"
 #include "clustering/clustering_strategy.hpp"
+#include "clustering/distributed_kmeans/distributed_kmeans.hpp"
+#include "histogram/similarity_index.hpp"
+#include "histogram/quantized_similarity_index.hpp"
+#include "histogram/ranking.hpp"
+#include "inverted_index/inverted_index.hpp"
+#include "product_quantization/product_quantized_index.hpp"
+#include "query_engine/query_engine.hpp"
+#include "vlad/vlad_encoder.hpp"
+#include "work_queue/file_work_queue.hpp"
 
 
 namespace igg {
 
+/**
+ * How BagOfWords::MostSimilarItems() finds the most similar images.
+ */
+enum class QueryMode {
+  kExhaustive, // Score all images, see SimilarityIndex
+  kPruned, // Skip images which cannot be among the results, see InvertedIndex::TopKPruned
+  kQuantized, // Score all images approximately, re-rank the best, see QuantizedSimilarityIndex
+  kProductQuantized, // Score compact codes of all images, see ProductQuantizedIndex
+  kVlad, // Score the VLAD vectors of all images instead of histograms, see VladEncoder
+  kGraph, // Search a graph over the histograms approximately, see HnswIndex
+  kVladGraph // Search a graph over the VLAD vectors approximately, see HnswIndex
+};
+
+/**
+ * Fixed-length vectors representing the images, see BagOfWords::BuildImageIndex().
+ */
+enum class ImageEncoding {
+  kHistogram, // Normalized tf-idf histograms, see BagOfWords::MakeHistograms()
+  kVlad // See BagOfWords::MakeVladVectors()
+};
+
+/**
+ * Parse a query mode from its name as used on the command line,
+ * i.e. "exhaustive", "pruned", "quantized", "product-quantized", "vlad", "graph"
+ * or "vlad-graph".
+ *
+ * Throws an instance of std::invalid_argument if the name is not recognized.
+ */
+QueryMode QueryModeFromString(const std::string& kName);
+
 /**
  * Provides a bag of visual words approach for similarity search over a set of images.
  *
@@ -50,6 +93,9 @@ public:
    * An execption of type igg::DictionaryIncomplete is thrown if the visual dictionary
    * was not completely created beforehand.
    *
+   * The histograms of the dataset are loaded into a SimilarityIndex on the first call
+   * and kept for subsequent calls, until MakeHistograms() is called again.
+   *
    * @param kQueryImage The query image.
    *
    * @return A vector of similarity measures. Order corresponds to the order
@@ -58,6 +104,100 @@ public:
   std::vector<float> Similarities
     (const std::shared_ptr<const ImageItem> kQueryItem) const;
 
+  /*
+   * Get the most similar images of the dataset to the query image.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if the visual dictionary
+   * was not completely created beforehand, or for QueryMode::kPruned, if the inverted
+   * index was not built (see BuildInvertedIndex()).
+   *
+   * Like the SimilarityIndex, the inverted index is loaded on the first call and kept
+   * for subsequent calls. Its similarities are approximate, see InvertedIndex.
+   *
+   * For QueryMode::kQuantized, only 8 bit histograms are kept in memory, and the
+   * histograms of the best candidates are read from their files for exact re-ranking.
+   * The results may miss images which were not among the candidates.
+   *
+   * QueryMode::kProductQuantized requires the codes built by BuildProductQuantization().
+   * Its similarities are approximate, kNumCandidates are scored with the exact lookup
+   * tables, see ProductQuantizedIndex.
+   *
+   * QueryMode::kVlad requires the vectors built by MakeVladVectors(). The query image
+   * is encoded from its features, histograms are not used at all.
+   *
+   * QueryMode::kGraph and QueryMode::kVladGraph require the index built by
+   * BuildImageIndex() for the histograms or VLAD vectors respectively. They visit a
+   * small part of the images only, kNumCandidates is the size of the candidate list
+   * (efSearch), larger values find more of the most similar images, but take longer.
+   *
+   * @param kQueryItem The query image.
+   * @param kNumResults Number of most similar images.
+   * @param kMode How to find the images.
+   * @param kNumCandidates Number of candidates re-ranked for QueryMode::kQuantized
+   * and QueryMode::kProductQuantized, or considered by the graph search.
+   * A good value may be a few hundred.
+   *
+   * @return Pairs of index of the image in the dataset and similarity, most similar first.
+   */
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const std::shared_ptr<const ImageItem> kQueryItem,
+     const size_t kNumResults,
+     const QueryMode kMode = QueryMode::kExhaustive,
+     const size_t kNumCandidates = 200) const;
+
+  /*
+   * Get the most similar images of the dataset to an image given by its features,
+   * e.g. one which is not part of the dataset, see ComputeFeatures().
+   *
+   * For all but the VLAD modes the features are assigned to the visual words, pruned
+   * and re-weighted the same way as the histograms of the dataset, see MakeHistograms().
+   * The cluster centroids, word index and weights are loaded on the first call and kept
+   * for subsequent calls, until ComputeClusterCentroids(), BuildWordIndex() or
+   * MakeHistograms() is called again.
+   *
+   * Otherwise like the function above.
+   */
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const std::vector<FeaturePoint<float>>& kQueryFeatures,
+     const size_t kNumResults,
+     const QueryMode kMode = QueryMode::kExhaustive,
+     const size_t kNumCandidates = 200) const;
+
+  /*
+   * Get the most similar images of the dataset to an image given by its re-weighted
+   * histogram, see QueryEngine::QueryHistogram(), e.g. one cached from a previous query.
+   *
+   * Throws an instance of std::invalid_argument for the VLAD modes, which need the features.
+   *
+   * Otherwise like the functions above.
+   */
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const SparseHistogram<float>& kQueryHistogram,
+     const size_t kNumResults,
+     const QueryMode kMode = QueryMode::kExhaustive,
+     const size_t kNumCandidates = 200) const;
+
+  /*
+   * Get a snapshot of the visual dictionary and the histograms of the dataset, which
+   * many threads can query concurrently, see QueryEngine.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if the visual dictionary
+   * was not completely created beforehand.
+   *
+   * The snapshot is loaded on the first call and kept for subsequent calls (and the other
+   * queries above), until ComputeClusterCentroids(), BuildWordIndex() or MakeHistograms()
+   * is called again. Snapshots handed out before stay unchanged.
+   */
+  std::shared_ptr<const QueryEngine> LoadQueryEngine() const;
+
+  /*
+   * Load everything queries with the given mode need, so the first query does not
+   * have to. Useful for long running processes, see QueryServer.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if something is missing.
+   */
+  void PrepareQueries(const QueryMode kMode) const;
+
   /*
    * Order images in the dataset by provided similarities.
    *
@@ -72,6 +212,25 @@ public:
      std::vector<float>>
     OrderItemsBySimilarity (const std::vector<float>& kSimilarities) const;
 
+  /*
+   * Get only the most and least similar images by provided similarities, without
+   * ordering all of them. Prefer this over OrderItemsBySimilarity() if only a few
+   * results are needed.
+   *
+   * @param kSimilarity A vector of similarity measures. Its size and order
+   * is expected to be equal to the number and order of images in the the dataset.
+   * In case of a size mismatch an exception of type std::invalid_argument is thrown.
+   * @param kNumMostSimilar Number of most similar images.
+   * @param kNumLeastSimilar Number of least similar images.
+   *
+   * @return Pairs of index of the image in the dataset and similarity. The most similar
+   * images are ordered most similar first, the least similar ones least similar first.
+   */
+  Ranking<float> RankItemsBySimilarity
+    (const std::vector<float>& kSimilarities,
+     const size_t kNumMostSimilar,
+     const size_t kNumLeastSimilar) const;
+
 
   /*
    * Check if the visual dictionary for similarity queries is in place.
@@ -88,6 +247,26 @@ public:
    */
   void ExtractFeatures() const;
 
+  /*
+   * Execute the feature extraction step together with other worker processes, possibly
+   * on other hosts, which share the queue directory, see FileWorkQueue. Each worker
+   * extracts the features of the batches of images it claims, until the features of all
+   * images are extracted. Batches of workers which stopped are extracted again once their
+   * lease expired. Feature files are written to a temporary file first and renamed, so
+   * they are complete or missing.
+   *
+   * The lease is renewed after each image, so extracting the features of a single image
+   * has to take less than half the lease duration.
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk.
+   */
+  void ExtractFeatures
+    (const std::string& kQueueDir,
+     const size_t kBatchSize,
+     const std::chrono::milliseconds kLeaseDuration,
+     const std::string& kWorkerId = FileWorkQueue::DefaultWorkerId()) const;
+
   /*
    * Execute the clustering step to create a visual dictionary of the given dataset.
    *
@@ -98,8 +277,56 @@ public:
    * extracted yet.
    *
    * @param kStrategy The clustering strategy to use.
+   * @param kMaxTrainingDescriptors If non-zero and there are more features, cluster a
+   * random sample of this many features instead of all of them.
+   * @param kStratified If true, the sample contains about the same number of features
+   * of each image, so images with many features do not dominate.
+   * @param kSeed For the random sample.
+   */
+  void ComputeClusterCentroids
+    (const ClusteringStrategy<float>& kStrategy,
+     const size_t kMaxTrainingDescriptors = 0,
+     const bool kStratified = false,
+     const int kSeed = 0) const;
+
+  /*
+   * Same as above, but the features are clustered by worker processes, each of which
+   * owns the features of some of the images (see DistributedKmeans and the executable
+   * kmeans_worker). Only the resulting centroids pass through this process.
+   *
+   * An exception of type std::runtime_error is thrown if a worker fails. With a checkpoint
+   * set in kKmeans, call again once the workers are running to continue the clustering.
+   *
+   * @param kKmeans The coordinator of the clustering.
+   * @param kWorkers Connections to the workers, in the order of the images they own.
    */
-  void ComputeClusterCentroids(const ClusteringStrategy<float>& kStrategy) const;
+  void ComputeClusterCentroids
+    (const DistributedKmeans& kKmeans,
+     const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers) const;
+
+  /*
+   * Build a search index over the cluster centroids (the visual words) and store it
+   * alongside the centroids. If available, the index is used by MakeHistograms() to
+   * assign features to words, which is considerably faster for large vocabularies.
+   * The assignment is approximate, how close it is to the exact one depends on the
+   * parameters below.
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk. A previously built index is removed by ComputeClusterCentroids().
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if features have not been
+   * clustered yet.
+   *
+   * @param kMaxConnections Graph parameter M, see HnswIndex. A good value may be 16.
+   * @param kEfConstruction Graph parameter efConstruction, see HnswIndex. A good value may be 200.
+   * @param kEfSearch Graph parameter efSearch, see HnswIndex. A good value may be 50.
+   * @param kSeed For the random construction of the graph.
+   */
+  void BuildWordIndex
+    (const size_t kMaxConnections,
+     const size_t kEfConstruction,
+     const size_t kEfSearch,
+     const int kSeed) const;
 
   /*
    * Execute the histogram generation and re-weighting step to create a visual dictionary
@@ -108,10 +335,110 @@ public:
    * Note that this function may overwrite results associated with the dataset
    * on the harddisk.
    *
+   * Words contained in more than kMaxDocumentFrequency of the images (stop words) are
+   * dropped and the count of each word in an image is limited to kMaxWordCount (bursts),
+   * before the histograms are normalized. The pruning is stored alongside the histogram
+   * weights, see Dataset::LoadVocabularyPruning(), so query histograms can be pruned
+   * the same way.
+   *
    * An execption of type igg::DictionaryIncomplete is thrown if features have not been
    * extracted and clustered yet.
+   *
+   * @param kMaxDocumentFrequency Fraction of images in [0, 1]. Use 1.0 to keep all words.
+   * @param kMaxWordCount Largest count of a word in a single image, 0 for no limit.
+   */
+  void MakeHistograms
+    (const double kMaxDocumentFrequency = 1.0, const size_t kMaxWordCount = 0) const;
+
+  /*
+   * Build an inverted index (compressed lists of the images containing each visual word)
+   * from the histograms and store it alongside. A previously built index is removed by
+   * MakeHistograms().
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if histograms have not been
+   * computed yet.
+   */
+  void BuildInvertedIndex() const;
+
+  /*
+   * Encode the normalized histogram of each image to a compact code of kCodeSize bytes
+   * (product quantization) and store the codes alongside. The quantizer is trained on
+   * a sample of the histograms. A previously built encoding is removed by MakeHistograms().
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if histograms have not been
+   * computed yet.
+   *
+   * @param kCodeSize Bytes per image, e.g. 64. At most 128 and half the number of words.
+   * @param kNumIterations Maximum number of K-means iterations to train the quantizer.
+   * @param kSeed For the training of the quantizer.
+   */
+  void BuildProductQuantization
+    (const size_t kCodeSize, const int kNumIterations, const int kSeed) const;
+
+  /*
+   * Encode the features of each image to a single dense vector (VLAD) as an alternative
+   * to the histograms, and store the vectors and the encoder alongside. The vocabulary
+   * of the encoder is clustered separately and should be small, e.g. 64 to 256 words.
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if features have not been
+   * extracted yet.
+   *
+   * @param kStrategy The clustering strategy for the vocabulary.
+   * @param kNumComponents If non-zero, project the vectors onto this many main components
+   * (PCA), e.g. 128 to 512. The components are computed from a sample of the images.
+   * @param kMaxTrainingDescriptors If non-zero and there are more features, cluster a
+   * random sample of this many features instead of all of them.
+   * @param kSeed For the random samples.
    */
-  void MakeHistograms() const;
+  void MakeVladVectors
+    (const ClusteringStrategy<float>& kStrategy,
+     const size_t kNumComponents,
+     const size_t kMaxTrainingDescriptors,
+     const int kSeed) const;
+
+  /*
+   * Build a graph based search index over the normalized histograms or VLAD vectors of
+   * all images and store it alongside, see HnswIndex. Queries then visit only a small
+   * part of the images, see MostSimilarItems().
+   *
+   * The histograms are stored with their non-zero bins only. If an index was built
+   * before and the images it contains are still the first ones of the dataset, as told
+   * by a hash of their filenames stored alongside, only the images added since are
+   * inserted. Otherwise, or if kRebuild
+   * is true, the index is built from scratch. The index is removed by MakeHistograms()
+   * and MakeVladVectors() respectively.
+   *
+   * Extending an index keeps its graph parameters. An exception of type
+   * std::invalid_argument is thrown if kMaxConnections or kEfConstruction differ from
+   * them, pass kRebuild to change them. The seed only applies to a new index.
+   *
+   * Note that this function may overwrite results associated with the dataset
+   * on the harddisk.
+   *
+   * An execption of type igg::DictionaryIncomplete is thrown if the histograms or VLAD
+   * vectors have not been computed yet.
+   *
+   * @param kEncoding Which vectors to index.
+   * @param kMaxConnections Graph parameter M, see HnswIndex. A good value may be 16.
+   * @param kEfConstruction Graph parameter efConstruction, see HnswIndex. A good value may be 200.
+   * @param kSeed For the random construction of the graph.
+   * @param kRebuild Discard a previously built index.
+   */
+  void BuildImageIndex
+    (const ImageEncoding kEncoding,
+     const size_t kMaxConnections,
+     const size_t kEfConstruction,
+     const int kSeed,
+     const bool kRebuild = false) const;
 
   /*
    * Generated a web output for the given dataset showing the most similar and most
@@ -156,6 +483,85 @@ public:
 private:
   const std::shared_ptr<const Dataset> kDataset_;
   bool verbose_;
+
+  // Vocabulary and normalized histograms of the dataset, loaded on demand
+  mutable std::shared_ptr<const QueryEngine> query_engine_;
+  mutable std::mutex query_engine_mutex_;
+
+  // Inverted index of the dataset, loaded on demand
+  mutable std::shared_ptr<const InvertedIndex> inverted_index_;
+  mutable std::mutex inverted_index_mutex_;
+
+  // Quantized histograms of the dataset, loaded on demand
+  mutable std::shared_ptr<const QuantizedSimilarityIndex<float>> quantized_index_;
+  mutable std::mutex quantized_index_mutex_;
+
+  // Compact codes of the histograms of the dataset, loaded on demand
+  mutable std::shared_ptr<const ProductQuantizedIndex> product_quantized_index_;
+  mutable std::mutex product_quantized_index_mutex_;
+
+  // VLAD encoder and vectors of the dataset, loaded on demand
+  mutable std::shared_ptr<const VladEncoder> vlad_encoder_;
+  mutable std::shared_ptr<const SimilarityIndex<float>> vlad_index_;
+  mutable std::mutex vlad_mutex_;
+
+  // Graphs over the histograms and VLAD vectors of the dataset, loaded on demand
+  mutable std::shared_ptr<const HnswIndex<SparseHistogram<float>>> histogram_graph_;
+  mutable std::shared_ptr<const HnswIndex<std::vector<float>>> vlad_graph_;
+  mutable std::mutex graph_mutex_;
+
+  std::shared_ptr<const SimilarityIndex<float>> LoadSimilarityIndex() const;
+
+  std::shared_ptr<const QuantizedSimilarityIndex<float>> LoadQuantizedIndex() const;
+
+  std::shared_ptr<const InvertedIndex> LoadInvertedIndex() const;
+
+  std::shared_ptr<const ProductQuantizedIndex> LoadProductQuantizedIndex() const;
+
+  std::shared_ptr<const VladEncoder> LoadVladEncoder() const;
+
+  std::shared_ptr<const SimilarityIndex<float>> LoadVladIndex() const;
+
+  std::shared_ptr<const HnswIndex<SparseHistogram<float>>> LoadHistogramGraph() const;
+
+  std::shared_ptr<const HnswIndex<std::vector<float>>> LoadVladGraph() const;
+
+  // VLAD vector of an image as indexed by BuildImageIndex()
+  std::vector<float> LoadVladVector(const std::shared_ptr<const ImageItem> kItem) const;
+
+  // Cluster the features of all images, or a sample of them
+  std::vector<FeaturePoint<float>> ClusterFeatures
+    (const ClusteringStrategy<float>& kStrategy,
+     const size_t kMaxTrainingDescriptors,
+     const bool kStratified,
+     const int kSeed) const;
+
+  // Store new centroids, invalidating everything derived from the previous ones
+  void WriteClusterCentroids(const std::vector<FeaturePoint<float>>& kCentroids) const;
+
+  std::vector<FeaturePoint<float>> LoadItemFeatures(const std::shared_ptr<const ImageItem> kItem) const;
+
+  SparseHistogram<float> LoadQueryHistogram(const std::shared_ptr<const ImageItem> kQueryItem) const;
+
+  std::vector<ScoredIndex<float>> MostSimilarToHistogram
+    (const SparseHistogram<float>& kQueryHistogram,
+     const size_t kNumResults,
+     const QueryMode kMode,
+     const size_t kNumCandidates) const;
+
+  // Search the graph over the histograms with a normalized histogram
+  std::vector<ScoredIndex<float>> MostSimilarInGraph
+    (const SparseHistogram<float>& kQueryHistogram,
+     const size_t kNumResults,
+     const size_t kNumCandidates) const;
+
+  // Search the graph over the VLAD vectors
+  std::vector<ScoredIndex<float>> MostSimilarInGraph
+    (const std::vector<float>& kQueryVlad,
+     const size_t kNumResults,
+     const size_t kNumCandidates) const;
+
+  std::vector<SparseHistogram<float>> LoadSparseHistograms() const;
 };
 
 /*
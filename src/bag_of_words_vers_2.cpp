@@ -1,6 +1,10 @@
 
 #include "bag_of_words_vers_2.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include "binaryio/binaryio.hpp"
 #include "features/features.hpp"
 #include "histogram/histogram.hpp"
 #include "clustering/clustering_strategy_kmeans.hpp"
@@ -13,11 +17,39 @@ namespace igg
 namespace vers_2
 {
 
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Shares of the remaining time of a query with a deadline for feature extraction and for
+// assigning the features to words, the rest is left for scoring
+const double kExtractionShare = 0.5;
+const double kQuantizationShare = 0.6;
+// Queries with a deadline are never reduced further
+const int kMinImageSide = 64;
+const int kMinKeypoints = 10;
+// Weight of the latest measurement in the running cost estimates
+const double kCostSmoothing = 0.2;
+// Rough costs assumed until the first query with a deadline was measured: SIFT on a
+// 640x480 image takes about 100 ms, a dot product of 128 floats about 30 ns
+const double kPriorExtractionNsPerPixel = 300.0;
+const double kPriorNsPerFeatureAndCluster = 30.0;
+const double kPriorScoringNsPerPosting = 5.0;
+
+void UpdateCostEstimate(double& estimate, const double kMeasured)
+{
+    estimate = estimate > 0.0 ? (1.0-kCostSmoothing)*estimate+kCostSmoothing*kMeasured : kMeasured;
+}
+
+} // namespace
+
 bagofwords::bagofwords():
     kNumIterations_{100},
     kEpsilon_{1e-3},
     kNumClusters_{100},
-    kVerbose_{true}
+    kVerbose_{true},
+    query_cache_{kDefaultQueryCacheBytes}
 {
     dataset_ = Dataset::Default();
     features_per_image_.reserve(dataset_->Items().size());
@@ -25,13 +57,21 @@ bagofwords::bagofwords():
     histogram_per_image_.reserve(kNumClusters_);
 }
 
-bagofwords::bagofwords(const int NumIterations, const double Epsilon, const int NumClusters, const bool Verbose):
+bagofwords::bagofwords(const int NumIterations, const double Epsilon, const int NumClusters, const bool Verbose,
+                       const size_t QueryCacheBytes):
+    bagofwords(Dataset::Default(), NumIterations, Epsilon, NumClusters, Verbose, QueryCacheBytes)
+{
+}
+
+bagofwords::bagofwords(const std::shared_ptr<const igg::Dataset> Dataset, const int NumIterations, const double Epsilon,
+                       const int NumClusters, const bool Verbose, const size_t QueryCacheBytes):
+    dataset_{Dataset},
     kNumIterations_{NumIterations},
     kEpsilon_{Epsilon},
     kNumClusters_{NumClusters},
-    kVerbose_{Verbose}
+    kVerbose_{Verbose},
+    query_cache_{QueryCacheBytes}
 {
-    dataset_ = Dataset::Default();
     features_per_image_.reserve(dataset_->Items().size());
     centroids_.reserve(kNumClusters_);
     histogram_per_image_.reserve(kNumClusters_);
@@ -53,8 +93,9 @@ void bagofwords::CreateDictionary(const int LoadFeatures, const std::string& kSe
     SaveHistogramImageDataset();
 }
 
-std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchImage(const cv::Mat& QuerriedImage)
+uint64_t bagofwords::LoadSearchData()
 {
+    std::lock_guard<std::mutex> lock(load_mutex_);
     if (centroids_.empty())
     {
         if (!dataset_->HasCentroids())
@@ -75,7 +116,7 @@ std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchImage(const cv::
             if (kItem->HasHistogram())
             {
                 std::cout << "  * Load histogram binary file " << kItem->HistogramBinaryFilename() << ".\n";
-                std::vector<float> histogram = igg::ReadFromBinary<float>(kHistogramPath);
+                std::vector<float> histogram = igg::ReadHistogramFromBinary<float>(kHistogramPath);
                 histogram_per_image_.emplace_back(histogram);
             }
             else
@@ -85,50 +126,270 @@ std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchImage(const cv::
         }
     }
 
-    //Computer Features in Querried Image
-    cv::Mat features = igg::ComputeFeatures(QuerriedImage);
-    std::vector<std::vector<float>> qFeatures = igg::FromMat<float>(std::move(features));
-    //Compute histogram of the querried Image from the dictionary
-    std::vector<float> qhistogram(kNumClusters_);
-    qhistogram = ComputeHistogram(qFeatures, kNumClusters_);
-    const std::vector<float> kSimilarities = CompareHistogram(qhistogram);
-
-    // Perform argsort (get the indices that would sort the similarities vector)
-    // Reference: https://stackoverflow.com/questions/1577475/
-    // c-sorting-and-keeping-track-of-indexes
-    const size_t kNumImages = dataset_->Items().size();
-    std::vector<size_t> indices(kNumImages);
-    // Populate with indices in increasing order
-    std::iota(indices.begin(), indices.end(), 0);
-    // Use lambda expression for sorting
-    std::sort(indices.begin(), indices.end(),
-              [&kSimilarities](const size_t kIndex1, const size_t kIndex2)
-              {return kSimilarities[kIndex1]>kSimilarities[kIndex2];});
-
-    // Return items in order and corresponding similarities
+    return index_version_;
+}
+
+std::shared_ptr<const igg::InvertedIndex> bagofwords::GetInvertedIndex()
+{
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    if (!inverted_index_)
+    {
+        std::vector<SparseHistogram<float>> histograms;
+        histograms.reserve(histogram_per_image_.size());
+        for (const auto& kHistogram : histogram_per_image_)
+        {
+            histograms.emplace_back(SparseHistogram<float>::FromDense(kHistogram));
+        }
+        inverted_index_ = std::make_shared<const igg::InvertedIndex>(histograms);
+    }
+
+    return inverted_index_;
+}
+
+std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchImage(const cv::Mat& QuerriedImage, const size_t NumResults)
+{
+    const uint64_t kIndexVersion = LoadSearchData();
+
+    // Repeated images are answered from the cache, without computing features
+    const cv::Mat kContinuousImage = QuerriedImage.isContinuous() ? QuerriedImage : QuerriedImage.clone();
+    const uint64_t kImageKey[] =
+        {igg::QueryCache::ContentHash(kContinuousImage.data, kContinuousImage.total()*kContinuousImage.elemSize()),
+         static_cast<uint64_t>(kContinuousImage.rows),
+         static_cast<uint64_t>(kContinuousImage.cols),
+         static_cast<uint64_t>(kContinuousImage.type())};
+    const uint64_t kImageHash = igg::QueryCache::ContentHash(kImageKey, sizeof(kImageKey));
+    const auto kCacheEntry = query_cache_.Find(kImageHash, kIndexVersion);
+
+    std::vector<ScoredIndex<float>> results;
+    if (kCacheEntry && kCacheEntry->num_results >= NumResults)
+    {
+        const size_t kNumCached = std::min(NumResults, kCacheEntry->results.size());
+        results.assign(kCacheEntry->results.begin(), kCacheEntry->results.begin()+kNumCached);
+    }
+    else
+    {
+        std::vector<float> qhistogram(kNumClusters_);
+        if (kCacheEntry)
+        {
+            qhistogram = kCacheEntry->histogram.ToDense();
+        }
+        else
+        {
+            //Computer Features in Querried Image
+            cv::Mat features = igg::ComputeFeatures(QuerriedImage);
+            std::vector<std::vector<float>> qFeatures = igg::FromMat<float>(std::move(features));
+            //Compute histogram of the querried Image from the dictionary
+            qhistogram = ComputeHistogram(qFeatures, kNumClusters_);
+        }
+        // Partial selection, the remaining items are never ordered
+        results = GetSimilarityIndex()->TopK(qhistogram, NumResults);
+        query_cache_.Insert(kImageHash, kIndexVersion, {SparseHistogram<float>::FromDense(qhistogram), results, NumResults});
+    }
+
+    return ItemsOf(results);
+}
+
+std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchDescriptors(const cv::Mat& Descriptors, const size_t NumResults)
+{
+    LoadSearchData();
+    if (Descriptors.type() != CV_32FC1 || (Descriptors.rows > 0 && static_cast<size_t>(Descriptors.cols) != centroids_[0].size()))
+    {
+        throw std::invalid_argument("Descriptors do not match the cluster centroids.");
+    }
+
+    const std::vector<std::vector<float>> kFeatures = igg::FromMat<float>(Descriptors.clone());
+    return ItemsOf(GetSimilarityIndex()->TopK(ComputeHistogram(kFeatures, kNumClusters_), NumResults));
+}
+
+std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchFeaturesFile(const std::string& FeaturesPath, const size_t NumResults)
+{
+    return SearchDescriptors(igg::ReadMatFromBinary(FeaturesPath), NumResults);
+}
+
+std::vector<std::shared_ptr<const ImageItem>> bagofwords::SearchItem(const size_t ItemIndex, const size_t NumResults)
+{
+    LoadSearchData();
+    // Copied under load_mutex_, the histograms may be computed again meanwhile
+    std::vector<float> histogram;
+    {
+        std::lock_guard<std::mutex> lock(load_mutex_);
+        if (ItemIndex >= histogram_per_image_.size())
+        {
+            throw std::invalid_argument("No item with index "+std::to_string(ItemIndex)+".");
+        }
+        histogram = histogram_per_image_[ItemIndex];
+    }
+
+    return ItemsOf(GetSimilarityIndex()->TopK(histogram, NumResults));
+}
+
+std::vector<std::shared_ptr<const ImageItem>> bagofwords::ItemsOf(const std::vector<ScoredIndex<float>>& Results) const
+{
+    const auto kItems = dataset_->Items();
     std::vector<std::shared_ptr<const ImageItem>> items_ordered_by_similarity;
-    items_ordered_by_similarity.reserve(kNumImages);
+    items_ordered_by_similarity.reserve(Results.size());
 
-    for(const auto kIndex: indices) {
-      items_ordered_by_similarity.emplace_back(this->dataset_->Items()[kIndex]);
+    for (const auto& kResult : Results)
+    {
+        items_ordered_by_similarity.emplace_back(kItems[kResult.first]);
     }
 
     return items_ordered_by_similarity;
 }
 
+BudgetedSearchResult bagofwords::SearchImage(const cv::Mat& QuerriedImage, const size_t NumResults, const SearchBudget& Budget)
+{
+    const auto kStart = Clock::now();
+    const auto kDeadline = kStart+Budget.deadline;
+    const auto RemainingNs = [&kDeadline]()
+    {
+        return std::max(0.0, std::chrono::duration<double, std::nano>(kDeadline-Clock::now()).count());
+    };
+
+    LoadSearchData();
+    const auto kInvertedIndex = GetInvertedIndex();
+
+    // Search with a word index costs about as much as comparing to EfSearch() clusters
+    const double kPriorNsPerFeature = kPriorNsPerFeatureAndCluster*(word_index_ ? word_index_->EfSearch() : centroids_.size());
+    double ns_per_pixel, ns_per_feature, ns_per_posting;
+    {
+        std::lock_guard<std::mutex> lock(cost_mutex_);
+        ns_per_pixel = extraction_ns_per_pixel_ > 0.0 ? extraction_ns_per_pixel_ : kPriorExtractionNsPerPixel;
+        ns_per_feature = quantization_ns_per_feature_ > 0.0 ? quantization_ns_per_feature_ : kPriorNsPerFeature;
+        ns_per_posting = scoring_ns_per_posting_ > 0.0 ? scoring_ns_per_posting_ : kPriorScoringNsPerPosting;
+    }
+
+    BudgetedSearchResult result;
+
+    // Downscale the query image, if its features cannot be extracted in time
+    const int kLongSide = std::max(QuerriedImage.rows, QuerriedImage.cols);
+    double scale = 1.0;
+    if (Budget.max_image_side > 0 && kLongSide > Budget.max_image_side)
+    {
+        scale = static_cast<double>(Budget.max_image_side)/kLongSide;
+    }
+    const double kPredictedExtractionNs = QuerriedImage.total()*scale*scale*ns_per_pixel;
+    const double kAllowedExtractionNs = RemainingNs()*kExtractionShare;
+    if (kPredictedExtractionNs > kAllowedExtractionNs)
+    {
+        scale *= std::sqrt(kAllowedExtractionNs/kPredictedExtractionNs);
+    }
+    if (kLongSide > 0)
+    {
+        scale = std::min(1.0, std::max(scale, static_cast<double>(kMinImageSide)/kLongSide));
+    }
+
+    cv::Mat image = QuerriedImage;
+    if (scale < 1.0)
+    {
+        const cv::Size kSize(std::max(1, static_cast<int>(QuerriedImage.cols*scale)), std::max(1, static_cast<int>(QuerriedImage.rows*scale)));
+        cv::resize(QuerriedImage, image, kSize, 0, 0, cv::INTER_AREA);
+        result.downscaled = true;
+        result.degradations.emplace_back("Downscaled the query image from "+std::to_string(QuerriedImage.cols)+"x"+std::to_string(QuerriedImage.rows)+
+            " to "+std::to_string(kSize.width)+"x"+std::to_string(kSize.height)+".");
+    }
+
+    // Keep as many keypoints as can be assigned to words in time
+    int max_keypoints = Budget.max_keypoints;
+    {
+        const double kAllowedNs = std::max(0.0, RemainingNs()-image.total()*ns_per_pixel)*kQuantizationShare;
+        const int kAffordableKeypoints = static_cast<int>(std::min(kAllowedNs/ns_per_feature, 1e6));
+        if (max_keypoints == 0 || kAffordableKeypoints < max_keypoints)
+        {
+            max_keypoints = std::max(kMinKeypoints, kAffordableKeypoints);
+        }
+    }
+
+    const auto kExtractionStart = Clock::now();
+    std::vector<std::vector<float>> qFeatures = igg::FromMat<float>(igg::ComputeFeatures(image, max_keypoints));
+    const double kExtractionNs = std::chrono::duration<double, std::nano>(Clock::now()-kExtractionStart).count();
+    if (max_keypoints > 0 && static_cast<int>(qFeatures.size()) >= max_keypoints)
+    {
+        // The detector may keep a few more due to equal responses
+        qFeatures.resize(max_keypoints);
+        result.keypoints_capped = true;
+        result.degradations.emplace_back("Kept the "+std::to_string(max_keypoints)+" strongest keypoints.");
+    }
+
+    // Search the words with less effort, if there is a word index
+    const size_t kFullEffort = word_index_ ? word_index_->EfSearch() : 1;
+    size_t effort = kFullEffort;
+    const double kPredictedQuantizationNs = qFeatures.size()*ns_per_feature;
+    const double kAllowedQuantizationNs = RemainingNs()*kQuantizationShare;
+    if (word_index_ && kPredictedQuantizationNs > kAllowedQuantizationNs)
+    {
+        effort = std::max(static_cast<size_t>(1), static_cast<size_t>(kFullEffort*kAllowedQuantizationNs/kPredictedQuantizationNs));
+        if (effort < kFullEffort)
+        {
+            result.search_effort_reduced = true;
+            result.degradations.emplace_back("Reduced the word search effort from "+std::to_string(kFullEffort)+" to "+std::to_string(effort)+".");
+        }
+    }
+
+    const auto kQuantizationStart = Clock::now();
+    std::vector<float> qhistogram(centroids_.size(), 0.0f);
+    for (const auto& kFeature : qFeatures)
+    {
+        const size_t kCluster = word_index_ ? word_index_->NearestNeighbors(kFeature, 1, effort)[0] : NearestCluster(kFeature);
+        qhistogram[kCluster] += 1.0f;
+    }
+    if (!pruning_.IsEmpty())
+    {
+        pruning_.Apply(qhistogram);
+    }
+    const double kQuantizationNs = std::chrono::duration<double, std::nano>(Clock::now()-kQuantizationStart).count();
+
+    // Visit as many postings as can be scored in the remaining time
+    const auto kQuery = SparseHistogram<float>::FromDense(qhistogram);
+    const size_t kNumPostings = kInvertedIndex->NumPostings(kQuery);
+    const size_t kMaxPostings = std::min(kNumPostings, static_cast<size_t>(std::min(RemainingNs()/ns_per_posting, 1e15)));
+
+    const auto kScoringStart = Clock::now();
+    size_t num_visited = 0;
+    const auto kResults = kInvertedIndex->TopKTruncated(kQuery, NumResults, kMaxPostings, &num_visited);
+    const double kScoringNs = std::chrono::duration<double, std::nano>(Clock::now()-kScoringStart).count();
+    if (num_visited < kNumPostings)
+    {
+        result.postings_truncated = true;
+        result.degradations.emplace_back("Visited "+std::to_string(num_visited)+" of "+std::to_string(kNumPostings)+" postings.");
+    }
+
+    // Learn from this query for the next ones
+    {
+        std::lock_guard<std::mutex> lock(cost_mutex_);
+        if (image.total() > 0)
+        {
+            UpdateCostEstimate(extraction_ns_per_pixel_, kExtractionNs/image.total());
+        }
+        if (!qFeatures.empty())
+        {
+            UpdateCostEstimate(quantization_ns_per_feature_, kQuantizationNs/qFeatures.size()*kFullEffort/effort);
+        }
+        if (num_visited > 0)
+        {
+            UpdateCostEstimate(scoring_ns_per_posting_, kScoringNs/num_visited);
+        }
+    }
+
+    result.items = ItemsOf(kResults);
+    result.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now()-kStart);
+    return result;
+}
+
 std::vector<float> bagofwords::CompareHistogram(const std::vector<float>& qhistogram)
 {
-    int size = histogram_per_image_.size();
-    std::vector<float> similarity(size, 0.0f);
-    for (size_t i = 0; i < histogram_per_image_.size(); i++)
+    return GetSimilarityIndex()->Similarities(qhistogram);
+}
+
+std::shared_ptr<const igg::SimilarityIndex<float>> bagofwords::GetSimilarityIndex()
+{
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    if (!similarity_index_)
     {
-        float cos_distance = pow(L2Norm(histogram_per_image_[i], qhistogram),2) /
-                             (L2Norm(histogram_per_image_[i], histogram_per_image_[i]) *
-                              L2Norm(qhistogram, qhistogram));
-        similarity[i] = cos_distance;
+        similarity_index_ = std::make_shared<const igg::SimilarityIndex<float>>(histogram_per_image_);
     }
 
-    return similarity;
+    return similarity_index_;
 }
 
 float bagofwords::L2Norm(const std::vector<float>& h1, const std::vector<float>& h2)
@@ -143,6 +404,27 @@ void bagofwords::LoadCentroidsFromFile()
     centroids_ = dataset_->LoadCentroids();
     int kNumClusters_ = centroids_.size();
     std::cout << "* Number of clusters (= words): " << kNumClusters_ << "\n";
+
+    if (dataset_->HasWordIndex())
+    {
+        auto index = dataset_->LoadWordIndex();
+        if (index.Size() == centroids_.size())
+        {
+            std::cout << "* Use word index " << dataset_->WordIndexPath() << ".\n";
+            word_index_ = std::make_unique<const igg::HnswIndex<std::vector<float>>>(std::move(index));
+        }
+    }
+
+    pruning_ = igg::VocabularyPruning(centroids_.size());
+    if (dataset_->HasVocabularyPruning())
+    {
+        auto pruning = dataset_->LoadVocabularyPruning();
+        if (pruning.NumWords() == centroids_.size())
+        {
+            std::cout << "* Use vocabulary pruning " << dataset_->VocabularyPruningPath() << ".\n";
+            pruning_ = std::move(pruning);
+        }
+    }
 }
 
 void bagofwords::SaveHistogramImageDataset()
@@ -150,6 +432,9 @@ void bagofwords::SaveHistogramImageDataset()
     std::vector<float> histogram(kNumClusters_);
     std::vector<std::vector<std::shared_ptr<const igg::ImageItem>>> images_per_cluster(kNumClusters_);
     //std::vector<int>::iterator ip;
+    // Built aside, queries keep using the current histograms until the new ones are written
+    std::vector<std::vector<float>> histograms;
+    histograms.reserve(features_per_image_.size());
 
     for (size_t i = 0; i < features_per_image_.size(); i++)
     {
@@ -167,7 +452,7 @@ void bagofwords::SaveHistogramImageDataset()
                 images_per_cluster[k].emplace_back(dataset_->Items()[i]);
             }
         }
-        histogram_per_image_.emplace_back(histogram);
+        histograms.emplace_back(histogram);
     }
 
     std::vector<float> image_count_per_cluster;
@@ -185,28 +470,37 @@ void bagofwords::SaveHistogramImageDataset()
     //Re-Weight histograms and write them to file for each image
     for (const std::shared_ptr<const igg::ImageItem> &kItem : dataset_->Items())
     {
-        ReWeightHistogram(image_count_per_cluster, index);
+        ReWeightHistogram(image_count_per_cluster, histograms[index]);
 
         std::cout << " Write histogram to binary file.\n";
-        igg::WriteToBinary<float>(kItem->HistogramBinaryPath(), histogram_per_image_[index]);
+        igg::WriteHistogramToBinary<float>(kItem->HistogramBinaryPath(), histograms[index]);
 
         index++;
     }
+
+    // Histograms are re-computed, the similarity index and cached queries are out of date.
+    // Queries still running keep the indexes they copied.
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    histogram_per_image_ = std::move(histograms);
+    similarity_index_.reset();
+    inverted_index_.reset();
+    index_version_++;
 }
 
-void bagofwords::ReWeightHistogram(const std::vector<float>& image_count_per_cluster, int index)
+void bagofwords::ReWeightHistogram(const std::vector<float>& image_count_per_cluster, std::vector<float>& histogram)
 {
     // Total number of images for re-weighting
     const float kNumImages = static_cast<float>(dataset_->Items().size());
 
     std::cout << "  * Perfrom re-weighting.\n";
     // Number of features in this image for re-weighting
-    const float kNumFeatures = std::accumulate(histogram_per_image_[index].begin(), histogram_per_image_[index].end(), 0.0f);
+    const float kNumFeatures = std::accumulate(histogram.begin(), histogram.end(), 0.0f);
 
-    for (size_t cluster = 0; cluster < histogram_per_image_[index].size(); cluster++)
+    for (size_t cluster = 0; cluster < histogram.size(); cluster++)
     {
-        histogram_per_image_[index][cluster] =
-            histogram_per_image_[index][cluster] / kNumFeatures * std::log(kNumImages / image_count_per_cluster[cluster]);
+        // Words in no image, e.g. pruned stop words, are weighted zero
+        histogram[cluster] = image_count_per_cluster[cluster] > 0.0f ?
+            histogram[cluster] / kNumFeatures * std::log(kNumImages / image_count_per_cluster[cluster]) : 0.0f;
     }
 }
 
@@ -218,12 +512,22 @@ std::vector<float> bagofwords::ComputeHistogram(const std::vector<std::vector<fl
         int cluster = NearestCluster(feature_set[i]);
         hist[cluster] += 1.0;
     }
+    // Same pruning as the histograms of the dataset
+    if (!pruning_.IsEmpty())
+    {
+        pruning_.Apply(hist);
+    }
 
     return hist;
 }
 
 int bagofwords::NearestCluster(const std::vector<float>& image_feature)
 {
+    if (word_index_)
+    {
+        return word_index_->NearestNeighbor(image_feature);
+    }
+
     float min_dist = 0.0;
     int NearestClusterId = 0;
     for (size_t i = 0; i < centroids_.size(); i++)
@@ -335,6 +639,18 @@ void bagofwords::SaveCentroidsToFile()
 {
     igg::WriteCentroidsToBinary(dataset_->CentroidsPath(), centroids_);
     std::cout << "* Result written to " << dataset_->CentroidsPath() << ".\n";
+
+    // A word index and a pruning of the previous centroids are no longer valid
+    word_index_.reset();
+    if (dataset_->HasWordIndex())
+    {
+        boost::filesystem::remove(dataset_->WordIndexPath());
+    }
+    pruning_ = igg::VocabularyPruning(centroids_.size());
+    if (dataset_->HasVocabularyPruning())
+    {
+        boost::filesystem::remove(dataset_->VocabularyPruningPath());
+    }
 }
 
 } // namespace vers_2
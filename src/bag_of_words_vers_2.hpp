@@ -1,13 +1,19 @@
 #ifndef CPP_FINAL_PROJECT_BAG_OF_WORDS_VERS_2_HPP_
 #define CPP_FINAL_PROJECT_BAG_OF_WORDS_VERS_2_HPP_
 
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 
 #include "dataset/dataset.hpp"
+#include "histogram/similarity_index.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+#include "inverted_index/inverted_index.hpp"
+#include "query_engine/query_cache.hpp"
 
 
 namespace igg
@@ -15,6 +21,29 @@ namespace igg
 namespace vers_2
 {
 
+// Limits of a query which has to be answered within a deadline, see SearchImage()
+struct SearchBudget
+{
+    std::chrono::microseconds deadline{50000};
+    // Larger query images are always downscaled, 0 for no limit
+    int max_image_side = 0;
+    // Most keypoints of the query image, 0 for no limit
+    int max_keypoints = 0;
+};
+
+// Most similar items of a query with a deadline, and how the query was simplified to meet it
+struct BudgetedSearchResult
+{
+    std::vector<std::shared_ptr<const ImageItem>> items;
+    bool downscaled = false;
+    bool keypoints_capped = false;
+    bool search_effort_reduced = false;
+    bool postings_truncated = false;
+    // One description per degradation above, empty if the query was answered in full
+    std::vector<std::string> degradations;
+    std::chrono::microseconds elapsed{0};
+};
+
 class bagofwords
 {
 private:
@@ -22,19 +51,72 @@ private:
     std::vector<std::vector<std::vector<float>>> features_per_image_;
     std::vector<std::vector<float>> kFeatures_flatten_;
     std::vector<std::vector<float>> centroids_;
+    // Replaced under load_mutex_ together with the indexes below once computed again
     std::vector<std::vector<float>> histogram_per_image_;
+    // Optional search index over centroids_, only used if it was built beforehand
+    std::unique_ptr<const igg::HnswIndex<std::vector<float>>> word_index_;
+    // Stop words and burst cap recorded by BagOfWords::MakeHistograms() for the centroids,
+    // applied to the word counts of all histograms, none if it does not match
+    igg::VocabularyPruning pruning_;
+    // Normalized copy of histogram_per_image_, built on the first comparison. Each query
+    // copies the pointer under load_mutex_, so it keeps its snapshot if the histograms
+    // are computed again meanwhile.
+    std::shared_ptr<const igg::SimilarityIndex<float>> similarity_index_;
+    // Posting lists of histogram_per_image_, built on the first query with a deadline
+    std::shared_ptr<const igg::InvertedIndex> inverted_index_;
+    // Incremented whenever the histograms are computed again, outdates cached queries
+    uint64_t index_version_ = 0;
+    // Guards loading and replacing the members above, so queries may run concurrently
+    std::mutex load_mutex_;
 
     const int kNumIterations_;
     const double kEpsilon_;
     const int kNumClusters_;
     const bool kVerbose_;
 
+    // Histograms and results of repeated query images
+    igg::QueryCache query_cache_;
+
+    // Running estimates of the cost of the steps of a query with a deadline, in nanoseconds,
+    // zero until measured. Assigning a feature is estimated at the full search effort.
+    double extraction_ns_per_pixel_ = 0.0;
+    double quantization_ns_per_feature_ = 0.0;
+    double scoring_ns_per_posting_ = 0.0;
+    std::mutex cost_mutex_;
+
+    // Load centroids and histograms on the first query, returns the index version
+    uint64_t LoadSearchData();
+    std::shared_ptr<const igg::InvertedIndex> GetInvertedIndex();
+    std::vector<std::shared_ptr<const ImageItem>> ItemsOf(const std::vector<ScoredIndex<float>>& Results) const;
+
 public:
+    // Memory of the cache of repeated query images unless given
+    static const size_t kDefaultQueryCacheBytes = 64 << 20;
+
     bagofwords();
-    bagofwords(const int NumIterations, const double Epsilon, const int NumClusters, const bool Verbose);
+    // QueryCacheBytes is the memory of the cache of repeated query images, 0 to disable it
+    bagofwords(const int NumIterations, const double Epsilon, const int NumClusters, const bool Verbose,
+               const size_t QueryCacheBytes = kDefaultQueryCacheBytes);
+    // Same as above for the given dataset instead of Dataset::Default()
+    bagofwords(const std::shared_ptr<const igg::Dataset> Dataset, const int NumIterations, const double Epsilon,
+               const int NumClusters, const bool Verbose, const size_t QueryCacheBytes = kDefaultQueryCacheBytes);
 
-    // Get items ordered by similarity
-    std::vector<std::shared_ptr<const ImageItem>> SearchImage(const cv::Mat& QuerriedImage);
+    // Get the NumResults most similar items, most similar first
+    std::vector<std::shared_ptr<const ImageItem>> SearchImage(const cv::Mat& QuerriedImage, const size_t NumResults);
+    // Get the NumResults most similar items to an image given by its SIFT descriptors, one
+    // per row of type CV_32FC1, e.g. computed by another service. Skips decoding the image and
+    // computing features, throws std::invalid_argument if the descriptors do not match the words.
+    std::vector<std::shared_ptr<const ImageItem>> SearchDescriptors(const cv::Mat& Descriptors, const size_t NumResults);
+    // Same as above with the descriptors of a _features.binary file, see WriteMatToBinary()
+    std::vector<std::shared_ptr<const ImageItem>> SearchFeaturesFile(const std::string& FeaturesPath, const size_t NumResults);
+    // Get the NumResults most similar items to the item of the dataset with the given index,
+    // from its stored histogram, throws std::invalid_argument if there is no such item
+    std::vector<std::shared_ptr<const ImageItem>> SearchItem(const size_t ItemIndex, const size_t NumResults);
+    // Get the NumResults most similar items within Budget.deadline, if possible. Downscales
+    // the query image, keeps fewer keypoints, searches the words with less effort and
+    // visits fewer posting lists as far as needed, based on the time previous queries took.
+    // Similarities are computed with posting lists and approximate to 1%.
+    BudgetedSearchResult SearchImage(const cv::Mat& QuerriedImage, const size_t NumResults, const SearchBudget& Budget);
     void CreateDictionary(const int LoadFeatures, const std::string& kSelectedAlgorithm);
     void ExtractFeaturesImageDataset();
     void ComputeClusterCentroids(const std::string& KSelectedAlgorithm);
@@ -43,12 +125,15 @@ public:
     void LoadFeaturesFromFile();
     void SaveHistogramImageDataset();
     std::vector<float> ComputeHistogram(const std::vector<std::vector<float>>& feature_set, const int bins);
-    void ReWeightHistogram(const std::vector<float>& image_count_per_cluster, int index);
+    void ReWeightHistogram(const std::vector<float>& image_count_per_cluster, std::vector<float>& histogram);
     int NearestCluster(const std::vector<float>& image_feature);
     float KSqnorm(const std::vector<float>& centroid, const std::vector<float>& image_feature);
     void LoadCentroidsFromFile();
     float L2Norm(const std::vector<float>& h1, const std::vector<float>& h2);
     std::vector<float> CompareHistogram(const std::vector<float>& qhistogram);
+    std::shared_ptr<const igg::SimilarityIndex<float>> GetSimilarityIndex();
+    // Hits and misses of repeated query images in SearchImage()
+    const igg::QueryCache& GetQueryCache() const {return query_cache_;}
 };
 
 } // namespace vers_2
@@ -0,0 +1,210 @@
+
+#include "batch_search.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "features/features.hpp"
+
+
+namespace igg {
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(const Clock::time_point kStart) {
+  return std::chrono::duration<double>(Clock::now()-kStart).count();
+}
+
+// Quoted if it contains a separator, quote or line break
+std::string CsvField(const std::string& kValue) {
+  if (kValue.find_first_of(",\"\r\n")==std::string::npos) {return kValue;}
+  std::string field = "\"";
+  for (const auto kChar: kValue) {
+    if (kChar=='"') {field += '"';}
+    field += kChar;
+  }
+  return field+"\"";
+}
+
+std::string JsonString(const std::string& kValue) {
+  std::ostringstream string;
+  string << '"';
+  for (const auto kChar: kValue) {
+    switch (kChar) {
+      case '"': string << "\\\""; break;
+      case '\\': string << "\\\\"; break;
+      case '\n': string << "\\n"; break;
+      case '\r': string << "\\r"; break;
+      case '\t': string << "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(kChar)<0x20) {
+          string << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(kChar) << std::dec;
+        } else {
+          string << kChar;
+        }
+    }
+  }
+  string << '"';
+  return string.str();
+}
+
+bool IsImage(const fs::path& kPath) {
+  auto extension = kPath.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension==".png" || extension==".jpg" || extension==".jpeg";
+}
+
+// Features, histogram or error of one query of a chunk
+struct PreparedQuery {
+  SparseHistogram<float> histogram;
+  size_t num_features = 0;
+  std::string error;
+};
+
+} // namespace
+
+
+ResultFormat ResultFormatFromString(const std::string& kName) {
+  if (kName=="csv") {return ResultFormat::kCsv;}
+  if (kName=="jsonl") {return ResultFormat::kJsonLines;}
+  throw std::invalid_argument("Result format "+kName+" not recognized.");
+}
+
+
+std::vector<std::string> ListQueryImages(const std::string& kPath) {
+  std::vector<std::string> paths;
+  if (fs::is_directory(kPath)) {
+    for (const auto& kDirEntry: fs::recursive_directory_iterator(kPath)) {
+      if (!fs::is_directory(kDirEntry) && IsImage(kDirEntry.path())) {paths.push_back(kDirEntry.path().string());}
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  std::ifstream list(kPath);
+  if (!list) {throw std::runtime_error("Cannot read query list "+kPath+".");}
+  std::string line;
+  while (std::getline(list, line)) {
+    if (!line.empty() && line.back()=='\r') {line.pop_back();}
+    if (!line.empty()) {paths.push_back(line);}
+  }
+  return paths;
+}
+
+
+std::ostream& operator<<(std::ostream& stream, const BatchSearchStats& kStats) {
+  stream << "Searched " << kStats.num_queries << " queries (" << kStats.num_failed << " failed, "
+    << kStats.num_features << " features) in " << kStats.total_seconds << " s, "
+    << kStats.QueriesPerSecond() << " queries per second.\n";
+  stream << "Extraction " << kStats.extraction_seconds << " s, scoring " << kStats.scoring_seconds << " s.\n";
+  return stream;
+}
+
+
+BatchSearch::BatchSearch
+  (const std::shared_ptr<const QueryEngine> kEngine,
+   const size_t kNumResults,
+   const size_t kChunkSize,
+   const size_t kNumThreads):
+  kEngine_{kEngine}, kNumResults_{kNumResults}, kChunkSize_{kChunkSize},
+  kNumThreads_{std::max(kNumThreads, static_cast<size_t>(1))}
+{
+  if (!kEngine) {throw std::invalid_argument("Need a query engine.");}
+  if (kChunkSize==0) {throw std::invalid_argument("Chunk size has to be positive.");}
+}
+
+
+BatchSearchStats BatchSearch::Run
+  (const std::vector<std::string>& kQueryPaths,
+   std::ostream& output,
+   const ResultFormat kFormat) const
+{
+  const auto kStart = Clock::now();
+  BatchSearchStats stats;
+  if (kFormat==ResultFormat::kCsv) {output << "query,rank,index,similarity,image_path\n";}
+
+  for (size_t chunk_begin = 0; chunk_begin<kQueryPaths.size(); chunk_begin += this->kChunkSize_) {
+    const auto kChunkSize = std::min(this->kChunkSize_, kQueryPaths.size()-chunk_begin);
+
+    // Features and histograms in parallel, errors are kept per query
+    const auto kExtractionStart = Clock::now();
+    std::vector<PreparedQuery> queries(kChunkSize);
+    ParallelForBlocks(kChunkSize, this->kNumThreads_,
+      [&](const size_t, const size_t kBegin, const size_t kEnd) {
+        QueryEngine::Scratch scratch;
+        for (size_t index = kBegin; index<kEnd; index++) {
+          const auto& kPath = kQueryPaths[chunk_begin+index];
+          try {
+            const cv::Mat kImage = cv::imread(kPath, CV_LOAD_IMAGE_COLOR);
+            if (!kImage.data) {throw std::runtime_error("Cannot read image "+kPath+".");}
+            const auto kFeatures = FromMat<float>(ComputeFeatures(kImage));
+            queries[index].num_features = kFeatures.size();
+            queries[index].histogram = this->kEngine_->QueryHistogram(kFeatures, scratch);
+          } catch (const std::exception& kError) {
+            queries[index].error = kError.what();
+          }
+        }
+      });
+    stats.extraction_seconds += SecondsSince(kExtractionStart);
+
+    // All readable queries of the chunk at once
+    const auto kScoringStart = Clock::now();
+    std::vector<SparseHistogram<float>> histograms;
+    for (const auto& kQuery: queries) {
+      if (kQuery.error.empty()) {histograms.push_back(kQuery.histogram);}
+    }
+    const auto kResults = histograms.empty() ?
+      std::vector<std::vector<ScoredIndex<float>>>() :
+      this->kEngine_->MostSimilarItemsBatch(histograms, this->kNumResults_);
+    stats.scoring_seconds += SecondsSince(kScoringStart);
+
+    size_t result_index = 0;
+    for (size_t index = 0; index<kChunkSize; index++) {
+      const auto& kPath = kQueryPaths[chunk_begin+index];
+      const auto& kQuery = queries[index];
+      stats.num_queries++;
+      stats.num_features += kQuery.num_features;
+
+      if (!kQuery.error.empty()) {
+        stats.num_failed++;
+        std::cerr << "Query " << kPath << " failed: " << kQuery.error << "\n";
+        if (kFormat==ResultFormat::kJsonLines) {
+          output << "{\"query\": " << JsonString(kPath) << ", \"error\": " << JsonString(kQuery.error) << "}\n";
+        }
+        continue;
+      }
+
+      const auto& kQueryResults = kResults[result_index++];
+      if (kFormat==ResultFormat::kCsv) {
+        for (size_t rank = 0; rank<kQueryResults.size(); rank++) {
+          output << CsvField(kPath) << "," << rank+1 << "," << kQueryResults[rank].first << ","
+            << kQueryResults[rank].second << "," << CsvField(this->kEngine_->ImagePath(kQueryResults[rank].first)) << "\n";
+        }
+      } else {
+        output << "{\"query\": " << JsonString(kPath) << ", \"results\": [";
+        for (size_t rank = 0; rank<kQueryResults.size(); rank++) {
+          output << (rank>0 ? ", " : "") << "{\"rank\": " << rank+1 << ", \"index\": " << kQueryResults[rank].first
+            << ", \"similarity\": " << kQueryResults[rank].second
+            << ", \"image_path\": " << JsonString(this->kEngine_->ImagePath(kQueryResults[rank].first)) << "}";
+        }
+        output << "]}\n";
+      }
+    }
+    output.flush();
+  }
+
+  stats.total_seconds = SecondsSince(kStart);
+  return stats;
+}
+
+} // namespace igg
@@ -0,0 +1,111 @@
+#ifndef CPP_FINAL_PROJECT_BATCH_SEARCH_BATCH_SEARCH_HPP_
+#define CPP_FINAL_PROJECT_BATCH_SEARCH_BATCH_SEARCH_HPP_
+
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "query_engine/query_engine.hpp"
+#include "tools/parallel.hpp"
+
+
+namespace igg {
+
+/**
+ * Format of the results of a batch search.
+ *
+ * kCsv: One line per result, "query,rank,index,similarity,image_path", after a header line.
+ * kJsonLines: One JSON object per query, {"query": ..., "results": [{"rank": ..., "index": ...,
+ *   "similarity": ..., "image_path": ...}, ...]}, or {"query": ..., "error": ...} if it failed.
+ */
+enum class ResultFormat {kCsv, kJsonLines};
+
+/**
+ * Format by name, i.e. "csv" or "jsonl".
+ *
+ * Throws an instance of std::invalid_argument for any other name.
+ */
+ResultFormat ResultFormatFromString(const std::string& kName);
+
+/**
+ * Query images in the given list file (one path per line) or below the given
+ * directory (all .png, .jpg and .jpeg files, sorted).
+ *
+ * Throws an instance of std::runtime_error if the path can not be read.
+ */
+std::vector<std::string> ListQueryImages(const std::string& kPath);
+
+/**
+ * Counts and timings of a batch search.
+ */
+struct BatchSearchStats {
+  size_t num_queries = 0;
+  size_t num_failed = 0;
+  size_t num_features = 0;
+  // Reading images, computing features and histograms
+  double extraction_seconds = 0.0;
+  double scoring_seconds = 0.0;
+  double total_seconds = 0.0;
+
+  double QueriesPerSecond() const {return this->total_seconds>0.0 ? this->num_queries/this->total_seconds : 0.0;}
+};
+
+std::ostream& operator<<(std::ostream& stream, const BatchSearchStats& kStats);
+
+/**
+ * Searches the most similar images of many query images against one resident
+ * QueryEngine and streams the results.
+ *
+ * The queries are processed in chunks of kChunkSize: the features and histograms
+ * of a chunk are computed by kNumThreads threads, then the chunk is scored at once,
+ * see QueryEngine::MostSimilarItemsBatch(), and its results are written in the order
+ * of the queries. Only one chunk is kept in memory, so the number of queries is
+ * not limited.
+ *
+ * A query image that can not be read is counted as failed and reported on std::cerr
+ * (and in the output for kJsonLines), the others are processed regardless.
+ *
+ * Usage:
+ *
+ *   const BatchSearch kSearch(QueryEngine::Load(dataset), 10);
+ *   std::ofstream output("results.csv");
+ *   std::cout << kSearch.Run(ListQueryImages("queries.txt"), output, ResultFormat::kCsv);
+ */
+class BatchSearch {
+public:
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if kChunkSize is zero.
+   *
+   * @param kEngine The snapshot to query.
+   * @param kNumResults Number of results per query.
+   * @param kChunkSize Number of queries processed at once.
+   * @param kNumThreads Number of threads to compute features with.
+   */
+  BatchSearch
+    (const std::shared_ptr<const QueryEngine> kEngine,
+     const size_t kNumResults,
+     const size_t kChunkSize=256,
+     const size_t kNumThreads=DefaultNumThreads());
+
+  /**
+   * Search all queries and write their results to output.
+   */
+  BatchSearchStats Run
+    (const std::vector<std::string>& kQueryPaths,
+     std::ostream& output,
+     const ResultFormat kFormat) const;
+
+private:
+  const std::shared_ptr<const QueryEngine> kEngine_;
+  const size_t kNumResults_;
+  const size_t kChunkSize_;
+  const size_t kNumThreads_;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_BATCH_SEARCH_BATCH_SEARCH_HPP_
@@ -53,6 +53,19 @@ cv::Mat ReadMatFromBinary(const std::string& kPath)
 }
 
 
+bool IsSparseHistogramBinary(const std::string& kPath) {
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  size_t tag = 0;
+  file.read(reinterpret_cast<char*>(&tag), sizeof(size_t));
+  return file && tag==kSparseHistogramTag;
+}
+
+
 std::streamsize FileSize(const std::string& kPath) {
   // Reference: https://stackoverflow.com/questions/2409504/
   // using-c-filestreams-fstream-how-can-you-determine-the-size-of-a-file
@@ -10,6 +10,7 @@
 
 #include "clustering/feature_point.hpp"
 #include "histogram/histogram.hpp"
+#include "histogram/sparse_histogram.hpp"
 
 
 namespace igg {
@@ -94,6 +95,60 @@ bool WriteToBinary(const std::string& kPath, const std::vector<T>& kValues);
 template <class T>
 std::vector<T> ReadFromBinary(const std::string& kPath);
 
+/*
+ * Write a histogram to a binary file, choosing the smaller of two encodings:
+ * Dense like WriteToBinary(), or sparse like WriteSparseHistogramToBinary() if
+ * less than about half of the bins are non-zero.
+ *
+ * In case the given file already exists it is overwritten.
+ *
+ * @return True, if writing was successful.
+ */
+template <class T>
+bool WriteHistogramToBinary(const std::string& kPath, const Histogram<T>& kHistogram);
+
+/*
+ * Write only the non-zero bins of a histogram to a binary file.
+ *
+ * The file starts with kSparseHistogramTag in place of the number of values
+ * of a dense file, followed by the number of bins, the number of non-zero bins,
+ * the non-zero bins and their weights.
+ *
+ * In case the given file already exists it is overwritten.
+ *
+ * @return True, if writing was successful.
+ */
+template <class T>
+bool WriteSparseHistogramToBinary
+  (const std::string& kPath, const SparseHistogram<T>& kHistogram);
+
+/*
+ * Read a histogram written by WriteHistogramToBinary(), WriteSparseHistogramToBinary()
+ * or WriteToBinary(), whatever the encoding.
+ *
+ * Throws a std::runtime_error in case the file cannot be read.
+ */
+template <class T>
+Histogram<T> ReadHistogramFromBinary(const std::string& kPath);
+
+/*
+ * Read a histogram as sparse histogram, whatever the encoding. See ReadHistogramFromBinary().
+ *
+ * Throws a std::runtime_error in case the file cannot be read.
+ */
+template <class T>
+SparseHistogram<T> ReadSparseHistogramFromBinary(const std::string& kPath);
+
+// Header of sparse histogram files, no dense file has this many values
+const size_t kSparseHistogramTag = static_cast<size_t>(-1);
+
+/*
+ * Determine if a histogram file uses the sparse encoding.
+ *
+ * Throws a std::runtime_error in case the file cannot be read.
+ */
+bool IsSparseHistogramBinary(const std::string& kPath);
+
 /*
  * Determine the size of a certain file in bytes. This requires the
  * file to be readable.
@@ -89,7 +89,9 @@ bool WriteToBinary(const std::string& kPath, const std::vector<T>& kValues) {
     file.write(reinterpret_cast<char*>(&value), sizeof(T));
   }
 
-  return true;
+  // Closing flushes, so a full disk fails here at the latest
+  file.close();
+  return static_cast<bool>(file);
 }
 
 
@@ -117,5 +119,100 @@ std::vector<T> ReadFromBinary(const std::string& kPath) {
   return values;
 }
 
+
+template <class T>
+bool WriteHistogramToBinary(const std::string& kPath, const Histogram<T>& kHistogram) {
+  const auto kSparse = SparseHistogram<T>::FromDense(kHistogram);
+
+  // Compare payload sizes, headers are negligible
+  const auto kDenseSize = kHistogram.size()*sizeof(T);
+  const auto kSparseSize = kSparse.NumNonZeros()*
+    (sizeof(typename SparseHistogram<T>::BinType)+sizeof(T));
+
+  if (kSparseSize<kDenseSize) {return WriteSparseHistogramToBinary(kPath, kSparse);}
+  return WriteToBinary(kPath, kHistogram);
+}
+
+
+template <class T>
+bool WriteSparseHistogramToBinary
+  (const std::string& kPath, const SparseHistogram<T>& kHistogram)
+{
+  using BinType = typename SparseHistogram<T>::BinType;
+
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  // Write header information (tag, number of bins, number of non-zero bins)
+  size_t tag = kSparseHistogramTag;
+  size_t num_bins = kHistogram.NumBins();
+  size_t num_non_zeros = kHistogram.NumNonZeros();
+  file.write(reinterpret_cast<char*>(&tag), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_bins), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_non_zeros), sizeof(size_t));
+
+  // Write bins and weights
+  file.write(reinterpret_cast<const char*>(kHistogram.Bins().data()), num_non_zeros*sizeof(BinType));
+  file.write(reinterpret_cast<const char*>(kHistogram.Weights().data()), num_non_zeros*sizeof(T));
+
+  file.close();
+  return static_cast<bool>(file);
+}
+
+
+template <class T>
+Histogram<T> ReadHistogramFromBinary(const std::string& kPath) {
+  if (!IsSparseHistogramBinary(kPath)) {return ReadFromBinary<T>(kPath);}
+  return ReadSparseHistogramFromBinary<T>(kPath).ToDense();
+}
+
+
+template <class T>
+SparseHistogram<T> ReadSparseHistogramFromBinary(const std::string& kPath) {
+  using BinType = typename SparseHistogram<T>::BinType;
+
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  // Read header information
+  size_t tag_or_number_of_values = 0;
+  file.read(reinterpret_cast<char*>(&tag_or_number_of_values), sizeof(size_t));
+
+  if (tag_or_number_of_values!=kSparseHistogramTag) {
+    // Dense file
+    Histogram<T> histogram(tag_or_number_of_values);
+    file.read(reinterpret_cast<char*>(histogram.data()), histogram.size()*sizeof(T));
+    if (!file) {throw std::runtime_error("Cannot read histogram from file "+kPath+".");}
+    return SparseHistogram<T>::FromDense(histogram);
+  }
+
+  size_t num_bins = 0;
+  size_t num_non_zeros = 0;
+  file.read(reinterpret_cast<char*>(&num_bins), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&num_non_zeros), sizeof(size_t));
+  if (!file || num_non_zeros>num_bins) {
+    throw std::runtime_error("Cannot read histogram from file "+kPath+".");
+  }
+
+  std::vector<BinType> bins(num_non_zeros);
+  std::vector<T> weights(num_non_zeros);
+  file.read(reinterpret_cast<char*>(bins.data()), num_non_zeros*sizeof(BinType));
+  file.read(reinterpret_cast<char*>(weights.data()), num_non_zeros*sizeof(T));
+  if (!file) {throw std::runtime_error("Cannot read histogram from file "+kPath+".");}
+
+  try {
+    return SparseHistogram<T>(num_bins, std::move(bins), std::move(weights));
+  } catch (const std::invalid_argument&) {
+    throw std::runtime_error("Invalid sparse histogram in file "+kPath+".");
+  }
+}
+
 } // namespace igg
 
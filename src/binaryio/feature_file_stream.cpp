@@ -0,0 +1,119 @@
+#include <fstream>
+#include <stdexcept>
+
+#include "feature_file_stream.hpp"
+#include "binaryio.hpp"
+
+
+namespace igg {
+
+namespace { // Put inside nameless namespace to prevent access from outside this file
+
+// Number of rows as stored in the header written by WriteMatToBinary
+size_t ReadNumRows(const std::string& kPath) {
+  std::ifstream file(kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  int rows = 0;
+  int cols = 0;
+  int type = 0;
+  file.read(reinterpret_cast<char*>(&rows), sizeof(int));
+  file.read(reinterpret_cast<char*>(&cols), sizeof(int));
+  file.read(reinterpret_cast<char*>(&type), sizeof(int));
+  if (!file || rows<0) {
+    throw std::runtime_error("Cannot read header of file "+kPath+".");
+  }
+  if (rows>0 && type!=CV_32F) {
+    throw std::runtime_error("Expected features of type float in file "+kPath+".");
+  }
+
+  return static_cast<size_t>(rows);
+}
+
+// Read the files kFirstPathIndex (inclusive) to kLastPathIndex (exclusive) into one chunk
+std::vector<FeaturePoint<float>> ReadChunk
+  (const std::vector<std::string>& kPaths,
+   const size_t kFirstPathIndex,
+   const size_t kLastPathIndex)
+{
+  std::vector<FeaturePoint<float>> chunk;
+  for (size_t path_index = kFirstPathIndex; path_index<kLastPathIndex; path_index++) {
+    auto features = FromMat<float>(ReadMatFromBinary(kPaths[path_index]));
+    chunk.insert
+      (chunk.end(),
+       std::make_move_iterator(features.begin()),
+       std::make_move_iterator(features.end()));
+  }
+  return chunk;
+}
+
+} // nameless namespace
+
+
+FeatureFileStream::FeatureFileStream
+  (const std::vector<std::string>& kPaths, const size_t kChunkSize):
+  kPaths_{kPaths},
+  kChunkSize_{kChunkSize},
+  size_{0},
+  next_path_index_{0}
+{
+  this->num_rows_.reserve(this->kPaths_.size());
+  for (const auto& kPath: this->kPaths_) {
+    this->num_rows_.emplace_back(ReadNumRows(kPath));
+    this->size_ += this->num_rows_.back();
+  }
+}
+
+
+FeatureFileStream::~FeatureFileStream() {
+  // Do not leave a read in progress behind
+  if (this->next_chunk_.valid()) {this->next_chunk_.wait();}
+}
+
+
+void FeatureFileStream::Rewind() {
+  if (this->next_chunk_.valid()) {this->next_chunk_.wait();}
+  this->next_chunk_ = {};
+  this->current_chunk_.clear();
+  this->next_path_index_ = 0;
+  this->ReadAhead();
+}
+
+
+std::vector<FeaturePoint<float> const *> FeatureFileStream::NextChunk() {
+  if (!this->next_chunk_.valid()) {
+    // End of stream or Rewind() was not called yet
+    if (this->next_path_index_==0) {this->ReadAhead();}
+    if (!this->next_chunk_.valid()) {
+      this->current_chunk_.clear();
+      return {};
+    }
+  }
+
+  this->current_chunk_ = this->next_chunk_.get();
+  this->ReadAhead();
+
+  return GetPointers(this->current_chunk_);
+}
+
+
+void FeatureFileStream::ReadAhead() {
+  const auto kNumPaths = this->kPaths_.size();
+  if (this->next_path_index_>=kNumPaths) {return;}
+
+  // Collect whole files until the chunk is large enough
+  size_t last_path_index = this->next_path_index_;
+  size_t num_features = 0;
+  while (last_path_index<kNumPaths && (num_features<this->kChunkSize_ || num_features==0)) {
+    num_features += this->num_rows_[last_path_index];
+    last_path_index++;
+  }
+
+  this->next_chunk_ = std::async
+    (std::launch::async, ReadChunk, std::cref(this->kPaths_), this->next_path_index_, last_path_index);
+  this->next_path_index_ = last_path_index;
+}
+
+} // namespace igg
@@ -0,0 +1,69 @@
+#ifndef CPP_FINAL_PROJECT_BINARYIO_FEATURE_FILE_STREAM_HPP_
+#define CPP_FINAL_PROJECT_BINARYIO_FEATURE_FILE_STREAM_HPP_
+
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "clustering/point_stream.hpp"
+
+
+namespace igg {
+
+/**
+ * Streams the features of several binary files as written by WriteMatToBinary
+ * (one feature per row), e.g. the extracted features of all images of a dataset.
+ *
+ * Files are read sequentially and grouped into chunks of at least kChunkSize
+ * features, only a single file larger than that forms a chunk by itself. While a
+ * chunk is processed, the next one is read in the background.
+ *
+ * Memory usage is therefore about two chunks, independent of the number of files.
+ */
+class FeatureFileStream: public PointStream<float> {
+public:
+  /**
+   * Constructor. Reads the headers of all files to determine the number of features.
+   *
+   * Throws a std::runtime_error in case a file cannot be read or does not contain
+   * features of type float.
+   *
+   * @param kPaths The feature files, features are provided in this order.
+   * @param kChunkSize Minimum number of features per chunk. A good value may be 100000.
+   */
+  FeatureFileStream(const std::vector<std::string>& kPaths, const size_t kChunkSize);
+
+  ~FeatureFileStream() override;
+
+  size_t Size() const override {return this->size_;}
+
+  /**
+   * Number of features in each file, in the order of the files.
+   */
+  const std::vector<size_t>& NumFeaturesPerFile() const {return this->num_rows_;}
+
+  void Rewind() override;
+
+  /**
+   * Throws a std::runtime_error in case a file cannot be read.
+   */
+  std::vector<FeaturePoint<float> const *> NextChunk() override;
+
+private:
+  const std::vector<std::string> kPaths_;
+  const size_t kChunkSize_;
+  std::vector<size_t> num_rows_; // Number of features in each file
+  size_t size_;
+
+  // Index of the first file of the chunk read next
+  size_t next_path_index_;
+  std::vector<FeaturePoint<float>> current_chunk_;
+  std::future<std::vector<FeaturePoint<float>>> next_chunk_;
+
+  void ReadAhead();
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_BINARYIO_FEATURE_FILE_STREAM_HPP_
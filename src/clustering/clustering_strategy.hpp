@@ -3,6 +3,7 @@
 
 
 #include "feature_point.hpp"
+#include "point_stream.hpp"
 
 
 namespace igg {
@@ -16,9 +17,31 @@ template <class T>
 class ClusteringStrategy {
 
 public:
+  virtual ~ClusteringStrategy() = default;
+
   virtual std::vector<FeaturePoint<T>> ClusterCentroids
     (const std::vector<FeaturePoint<T>>& kPointSet) const = 0;
 
+  /**
+   * Cluster points provided by a stream.
+   *
+   * By default all points are collected in memory and passed to ClusterCentroids.
+   * Strategies which can work on chunks of points override this.
+   */
+  virtual std::vector<FeaturePoint<T>> ClusterCentroidsFromStream
+    (PointStream<T>& stream) const
+  {
+    std::vector<FeaturePoint<T>> point_set;
+    point_set.reserve(stream.Size());
+
+    stream.Rewind();
+    for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+      for (const auto kPoint: chunk) {point_set.emplace_back(*kPoint);}
+    }
+
+    return this->ClusterCentroids(point_set);
+  }
+
 };
 
 } // namespace igg
@@ -5,6 +5,7 @@
 #include <random>
 
 #include "clustering_strategy.hpp"
+#include "seeding.hpp"
 
 
 namespace igg {
@@ -28,13 +29,15 @@ public:
    * provided point set. Note that also multiple sequential calls of ClusterCentroids
    * will always use the same seed.
    * @param kVerbose If true, print some output to the terminal.
+   * @param kSeeding Method to select the initial centroids.
    */
   ClusteringStrategyKmeans
     (const size_t kNumClusters,
      const int kNumIterations,
      const T kEpsilon,
      const int kSeed,
-     const bool kVerbose);
+     const bool kVerbose,
+     const SeedingMethod kSeeding = SeedingMethod::kRandom);
 
   /**
    * Perform the actual clustering.
@@ -57,13 +60,11 @@ private:
   const T kEpsilon_;
   const int kSeed_;
   const bool kVerbose_;
+  const SeedingMethod kSeeding_;
 
   std::vector<FeaturePoint<T>> InitCentroids
     (const std::vector<FeaturePoint<T>>& kPointSet) const;
 
-  std::vector<FeaturePoint<T>> SubsamplePointSet
-    (const std::vector<FeaturePoint<T>>& kPointSet, const size_t kSubSampleSize) const;
-
   // For debugging only
   cv::Mat MakePlot
     (const std::vector<std::vector<FeaturePoint<T> const *>>& kClusters,
@@ -3,7 +3,6 @@
 #include <cmath>
 #include <algorithm>
 
-#include "tools/sampling.hpp"
 #include "tools/linalg.hpp"
 
 namespace igg {
@@ -14,12 +13,14 @@ ClusteringStrategyKmeans<T>::ClusteringStrategyKmeans
    const int kNumIterations,
    const T kEpsilon,
    const int kSeed,
-   const bool kVerbose):
+   const bool kVerbose,
+   const SeedingMethod kSeeding):
   kNumClusters_{kNumClusters},
   kNumIterations_{kNumIterations},
   kEpsilon_{kEpsilon},
   kSeed_{kSeed},
-  kVerbose_{kVerbose}
+  kVerbose_{kVerbose},
+  kSeeding_{kSeeding}
 {}
 
 
@@ -118,35 +119,23 @@ std::vector<FeaturePoint<T>> ClusteringStrategyKmeans<T>::ClusterCentroids
 
 
 template <class T>
-std::vector<FeaturePoint<T>> ClusteringStrategyKmeans<T>::SubsamplePointSet
-  (const std::vector<FeaturePoint<T>>& kPointSet, const size_t kSubsampleSize) const
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeans<T>::InitCentroids
+  (const std::vector<FeaturePoint<T>> &kPointSet) const
 {
-  const size_t kNumPoints = kPointSet.size();
-
   // Seed random number generator
   std::mt19937 engine(this->kSeed_);
 
-  // Sample kNumClusters_ different indices
-  const auto  kIndices = SampleIndicesWithoutReplacement<size_t>
-    (this->kNumClusters_, kNumPoints, engine);
-
-  // Collect points
-  std::vector<FeaturePoint<T>> subsample;
-  subsample.reserve(kSubsampleSize);
+  // Select kNumClusters_ different points
+  const auto kIndices = SampleCentroidIndices
+    (kPointSet, this->kNumClusters_, this->kSeeding_, engine);
 
+  std::vector<FeaturePoint<T>> centroids;
+  centroids.reserve(this->kNumClusters_);
   for (const auto kIndex: kIndices) {
-    subsample.emplace_back(kPointSet[kIndex]);
+    centroids.emplace_back(kPointSet[kIndex]);
   }
 
-  return subsample;
-}
-
-
-template <class T>
-std::vector<FeaturePoint<T>> ClusteringStrategyKmeans<T>::InitCentroids
-  (const std::vector<FeaturePoint<T>> &kPointSet) const
-{
-  return this->SubsamplePointSet(kPointSet, this->kNumClusters_);
+  return centroids;
 }
 
 
@@ -3,6 +3,7 @@
 
 
 #include "clustering_strategy.hpp"
+#include "seeding.hpp"
 
 
 namespace igg {
@@ -26,13 +27,17 @@ public:
    * @param kEpsilon Early stopping if all centroid updates are smaller than this value.
    * @param kAttempt Repeat multiple times with different initializations.
    * @param kVerbose If true, print some output to the terminal.
+   * @param kSeeding Method to select the initial centroids. Random and k-means++ are
+   * handled by OpenCV, k-means|| is applied before and passed as initial labels
+   * (first attempt only).
   */
   ClusteringStrategyKmeansOpenCV
     (const size_t kNumClusters,
      const int kNumIterations,
      const T kEpsilon,
      const int kAttempts,
-     const bool kVerbose);
+     const bool kVerbose,
+     const SeedingMethod kSeeding = SeedingMethod::kKmeansPlusPlus);
 
   /**
    * Perform the actual clustering.
@@ -56,6 +61,7 @@ private:
   const T kEpsilon_;
   const int kAttempts_;
   const bool kVerbose_;
+  const SeedingMethod kSeeding_;
 
 };
 
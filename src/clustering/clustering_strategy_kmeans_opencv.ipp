@@ -8,12 +8,14 @@ ClusteringStrategyKmeansOpenCV<T>::ClusteringStrategyKmeansOpenCV
    const int kNumIterations,
    const T kEpsilon,
    const int kAttempts,
-   const bool kVerbose):
+   const bool kVerbose,
+   const SeedingMethod kSeeding):
   kNumClusters_{kNumClusters},
   kNumIterations_{kNumIterations},
   kEpsilon_{kEpsilon},
   kAttempts_{kAttempts},
-  kVerbose_{kVerbose}
+  kVerbose_{kVerbose},
+  kSeeding_{kSeeding}
 {}
 
 
@@ -38,11 +40,30 @@ std::vector<FeaturePoint<T>> ClusteringStrategyKmeansOpenCV<T>::ClusterCentroids
   cv::Mat centroids_mat;
   cv::Mat labels_mat; // OpenCV wants to return labels as well
 
+  int flags = cv::KMEANS_PP_CENTERS;
+  if (this->kSeeding_==SeedingMethod::kRandom) {
+    flags = cv::KMEANS_RANDOM_CENTERS;
+  } else if (this->kSeeding_==SeedingMethod::kKmeansParallel) {
+    // OpenCV only accepts initial labels, so assign each point to its nearest seed
+    std::random_device random_device;
+    std::mt19937 engine(random_device());
+    std::vector<FeaturePoint<T>> seeds;
+    seeds.reserve(this->kNumClusters_);
+    for (const auto kIndex: SampleCentroidIndicesKmeansParallel(kPointSet, this->kNumClusters_, engine))
+      {seeds.emplace_back(kPointSet[kIndex]);}
+
+    labels_mat.create(static_cast<int>(kNumPoints), 1, CV_32S);
+    for (size_t index = 0; index<kNumPoints; index++) {
+      labels_mat.at<int>(static_cast<int>(index)) = static_cast<int>(NearestNeighbor(kPointSet[index], seeds));
+    }
+    flags = cv::KMEANS_USE_INITIAL_LABELS|cv::KMEANS_PP_CENTERS;
+  }
+
   cv::kmeans
     (kPointSetMat, this->kNumClusters_, labels_mat,
      cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS,
        this->kNumIterations_, static_cast<double>(this->kEpsilon_)),
-     this->kAttempts_, cv::KMEANS_PP_CENTERS, centroids_mat);
+     this->kAttempts_, flags, centroids_mat);
 
   return FromMat<T>(std::move(centroids_mat));
 }
@@ -0,0 +1,71 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_STREAMING_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_STREAMING_HPP_
+
+
+#include <random>
+
+#include "clustering_strategy.hpp"
+
+
+namespace igg {
+
+/**
+ * K-Means working on a stream of points, so only the centroids and one
+ * accumulator per cluster are kept in memory. Each iteration is a single pass
+ * over the stream, e.g. over the feature files of a dataset.
+ *
+ * This is an exact implementation of the same algorithm as ClusteringStrategyKmeans
+ * (random initialization), given the same seed and the points in the same order the
+ * resulting centroids are identical.
+ */
+template <class T>
+class ClusteringStrategyKmeansStreaming: public ClusteringStrategy<T> {
+
+public:
+  /**
+   * Constructor.
+   *
+   * @param kNumClusters Number of clusters.
+   * @param kNumIterations Maximum number of iterations.
+   * @param kEpsilon Early stopping if all centroid updates are smaller than this value.
+   * @param kSeed For initialization of centroids, which are randomly selected from the
+   * provided points.
+   * @param kVerbose If true, print some output to the terminal.
+   */
+  ClusteringStrategyKmeansStreaming
+    (const size_t kNumClusters,
+     const int kNumIterations,
+     const T kEpsilon,
+     const int kSeed,
+     const bool kVerbose);
+
+  /**
+   * Cluster points already in memory, by streaming over them.
+   */
+  std::vector<FeaturePoint<T>> ClusterCentroids
+    (const std::vector<FeaturePoint<T>>& kPointSet) const override;
+
+  /**
+   * Perform the actual clustering.
+   *
+   * Throws an instance of std::invalid_argument if the stream is empty or the
+   * number of clusters is larger than the number of points.
+   */
+  std::vector<FeaturePoint<T>> ClusterCentroidsFromStream
+    (PointStream<T>& stream) const override;
+
+private:
+  const size_t kNumClusters_;
+  const int kNumIterations_;
+  const T kEpsilon_;
+  const int kSeed_;
+  const bool kVerbose_;
+
+  std::vector<FeaturePoint<T>> InitCentroids(PointStream<T>& stream) const;
+};
+
+} // namespace igg
+
+#include "clustering_strategy_kmeans_streaming.ipp"
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_STREAMING_HPP_
@@ -0,0 +1,156 @@
+
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "tools/sampling.hpp"
+#include "tools/linalg.hpp"
+
+namespace igg {
+
+template <class T>
+ClusteringStrategyKmeansStreaming<T>::ClusteringStrategyKmeansStreaming
+  (const size_t kNumClusters,
+   const int kNumIterations,
+   const T kEpsilon,
+   const int kSeed,
+   const bool kVerbose):
+  kNumClusters_{kNumClusters},
+  kNumIterations_{kNumIterations},
+  kEpsilon_{kEpsilon},
+  kSeed_{kSeed},
+  kVerbose_{kVerbose}
+{}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansStreaming<T>::ClusterCentroids
+  (const std::vector<FeaturePoint<T>>& kPointSet) const
+{
+  const size_t kChunkSize = 100000;
+  InMemoryPointStream<T> stream(kPointSet, kChunkSize);
+  return this->ClusterCentroidsFromStream(stream);
+}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansStreaming<T>::ClusterCentroidsFromStream
+  (PointStream<T>& stream) const
+{
+  const auto kNumPoints = stream.Size();
+  if (kNumPoints==0)
+    {throw std::invalid_argument("Empty set of points.");}
+
+  if (this->kVerbose_) {std::cout << "Number of points to cluster: " << kNumPoints << ".\n";}
+
+  if (kNumPoints<this->kNumClusters_) {
+    throw std::invalid_argument
+      ("Number of clusters is larger than number of points.");
+  }
+
+  auto centroids = this->InitCentroids(stream);
+  const auto kNumFeatures = centroids[0].size();
+
+  // Sum and number of the points assigned to each cluster in the current pass
+  std::vector<FeaturePoint<T>> sums(this->kNumClusters_, FeaturePoint<T>(kNumFeatures));
+  std::vector<size_t> counts(this->kNumClusters_);
+
+  // Distance between centroids and updated centroids for early termination
+  std::vector<T> deltas(this->kNumClusters_);
+
+  T max_delta = std::numeric_limits<T>::max();
+  int iteration = 0;
+
+  while (true) {
+    if (this->kVerbose_) {std::cout << "* Start iteration " << iteration << ".\n";}
+
+    // Unlike ClusteringStrategyKmeans, check before the assignment, since its result
+    // would not be used and it is a full pass over the data
+    if (max_delta < this->kEpsilon_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Max update smaller than epsilon (" << this->kEpsilon_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (iteration >= this->kNumIterations_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Reached maximum number of iterations (" << this->kNumIterations_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (this->kVerbose_) {std::cout << "  * Assign data points to nearest cluster.\n";}
+    for (auto& sum: sums) {std::fill(sum.begin(), sum.end(), static_cast<T>(0));}
+    std::fill(counts.begin(), counts.end(), 0);
+
+    // Points are accumulated in stream order, which is the order Centroid() sums them
+    // up in the in-memory implementation, so the floating point results are identical
+    stream.Rewind();
+    for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+      for (const auto kPoint: chunk) {
+        const auto kNearestClusterIndex = NearestNeighbor(*kPoint, centroids);
+        auto& sum = sums[kNearestClusterIndex];
+        for (size_t index = 0; index<kNumFeatures; index++) {sum[index] += (*kPoint)[index];}
+        counts[kNearestClusterIndex]++;
+      }
+    }
+
+    if (this->kVerbose_) {std::cout << "  * Update centroids.\n";}
+    for (size_t cluster_index = 0; cluster_index<this->kNumClusters_; cluster_index++) {
+      if (counts[cluster_index]==0) {
+        // No update is cluster is empty
+        deltas[cluster_index] = static_cast<T>(0);
+        continue;
+      }
+
+      auto& sum = sums[cluster_index];
+      for (auto& value: sum) {value = value/counts[cluster_index];}
+
+      deltas[cluster_index] = std::sqrt(SquaredL2Norm<FeaturePoint<T>>
+        (Difference<FeaturePoint<T>>(sum, centroids[cluster_index])));
+      centroids[cluster_index] = sum;
+    }
+
+    max_delta = *std::max_element(deltas.begin(), deltas.end());
+    if (this->kVerbose_) {std::cout << "  * Max update: " << max_delta << ".\n";}
+
+    iteration++;
+  }
+
+  return centroids;
+}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansStreaming<T>::InitCentroids
+  (PointStream<T>& stream) const
+{
+  // Seed random number generator
+  std::mt19937 engine(this->kSeed_);
+
+  // Sample kNumClusters_ different indices, same as ClusteringStrategyKmeans
+  const auto kIndices = SampleIndicesWithoutReplacement<size_t>
+    (this->kNumClusters_, stream.Size(), engine);
+
+  // Position of each sampled index in the result
+  std::unordered_map<size_t, size_t> positions;
+  for (size_t position = 0; position<kIndices.size(); position++)
+    {positions[kIndices[position]] = position;}
+
+  // Collect points in one pass
+  std::vector<FeaturePoint<T>> centroids(this->kNumClusters_);
+  size_t index = 0;
+  stream.Rewind();
+  for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+    for (const auto kPoint: chunk) {
+      const auto kPosition = positions.find(index);
+      if (kPosition!=positions.end()) {centroids[kPosition->second] = *kPoint;}
+      index++;
+    }
+  }
+
+  return centroids;
+}
+
+} // namespace igg
@@ -3,6 +3,7 @@
 
 
 #include "clustering_strategy.hpp"
+#include "seeding.hpp"
 
 
 /**
@@ -17,7 +18,8 @@ public:
   ClusteringStrategyKmeansVers2
     (const size_t kNumClusters,
      const int kNumIterations,
-     const bool kVerbose);
+     const bool kVerbose,
+     const SeedingMethod kSeeding = SeedingMethod::kKmeansPlusPlus);
 
   std::vector<FeaturePoint<T>> ClusterCentroids
     (const std::vector<FeaturePoint<T>>& kPointSet) const override;
@@ -26,6 +28,7 @@ private:
   const size_t kNumClusters_;
   const int kNumIterations_;
   const bool kVerbose_;
+  const SeedingMethod kSeeding_;
 
 };
 
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <random>
 
 //#include "tools/sampling.hpp"
 //#include "tools/terminalout.hpp"
@@ -15,10 +16,12 @@ template <class T>
 ClusteringStrategyKmeansVers2<T>::ClusteringStrategyKmeansVers2
   (const size_t kNumClusters,
    const int kNumIterations,
-   const bool kVerbose):
+   const bool kVerbose,
+   const SeedingMethod kSeeding):
   kNumClusters_{kNumClusters},
   kNumIterations_{kNumIterations},
-  kVerbose_{kVerbose}
+  kVerbose_{kVerbose},
+  kSeeding_{kSeeding}
 {}
 
 
@@ -48,6 +51,12 @@ std::vector<FeaturePoint<T>> ClusteringStrategyKmeansVers2<T>::ClusterCentroids
     converted_point_set.emplace_back(converted_point);
   }
 
+  // Select initial centroids, not seeded as the wrapped implementation never was
+  std::random_device random_device;
+  std::mt19937 engine(random_device());
+  const auto kInitialIndices = SampleCentroidIndices
+    (kPointSet, this->kNumClusters_, this->kSeeding_, engine);
+
   // Run clustering
   if (!this->kVerbose_) {
     // Disable terminal output
@@ -56,7 +65,7 @@ std::vector<FeaturePoint<T>> ClusteringStrategyKmeansVers2<T>::ClusterCentroids
     std::cout.setstate(std::ios_base::failbit);
   }
 
-  kmeans.RunKMeans(converted_point_set);
+  kmeans.RunKMeans(converted_point_set, kInitialIndices);
 
   if (!this->kVerbose_) {
     // Enable output again
@@ -0,0 +1,70 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_WITH_HNSW_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_WITH_HNSW_HPP_
+
+
+#include <random>
+
+#include "clustering_strategy.hpp"
+#include "seeding.hpp"
+
+
+namespace igg {
+
+/**
+ * K-Means using a Hierarchical Navigable Small World graph over the centroids
+ * to assign points to their (approximately) nearest cluster.
+ *
+ * The graph is rebuilt in each iteration. This pays off for a large number of
+ * clusters, where the brute force assignment dominates the runtime.
+ */
+template <class T>
+class ClusteringStrategyKmeansWithHnsw: public ClusteringStrategy<T> {
+
+public:
+  /**
+   * Constructor.
+   *
+   * @param kNumClusters Number of clusters.
+   * @param kNumIterations Maximum number of iterations.
+   * @param kEpsilon Early stopping if all centroid updates are smaller than this value.
+   * @param kMaxConnections Graph parameter M, see HnswIndex.
+   * @param kEfConstruction Graph parameter efConstruction, see HnswIndex.
+   * @param kEfSearch Graph parameter efSearch, see HnswIndex.
+   * @param kSeed For initialization of centroids and the graph.
+   * @param kVerbose If true, print some output to the terminal.
+   * @param kSeeding Method to select the initial centroids.
+   */
+  ClusteringStrategyKmeansWithHnsw
+    (const size_t kNumClusters,
+     const int kNumIterations,
+     const T kEpsilon,
+     const size_t kMaxConnections,
+     const size_t kEfConstruction,
+     const size_t kEfSearch,
+     const int kSeed,
+     const bool kVerbose,
+     const SeedingMethod kSeeding = SeedingMethod::kRandom);
+
+  std::vector<FeaturePoint<T>> ClusterCentroids
+    (const std::vector<FeaturePoint<T>>& kPointSet) const override;
+
+private:
+  const size_t kNumClusters_;
+  const int kNumIterations_;
+  const T kEpsilon_;
+  const size_t kMaxConnections_;
+  const size_t kEfConstruction_;
+  const size_t kEfSearch_;
+  const int kSeed_;
+  const bool kVerbose_;
+  const SeedingMethod kSeeding_;
+
+  std::vector<FeaturePoint<T>> InitCentroids
+    (const std::vector<FeaturePoint<T>>& kPointSet) const;
+};
+
+} // namespace igg
+
+#include "clustering_strategy_kmeans_with_hnsw.ipp"
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_CLUSTERING_STRATEGY_KMEANS_WITH_HNSW_HPP_
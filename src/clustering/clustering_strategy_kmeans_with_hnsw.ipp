@@ -0,0 +1,145 @@
+
+
+#include <cmath>
+#include <algorithm>
+
+#include "tools/linalg.hpp"
+
+#include "hnsw_index/hnsw_index.hpp"
+
+namespace igg {
+
+template <class T>
+ClusteringStrategyKmeansWithHnsw<T>::ClusteringStrategyKmeansWithHnsw
+  (const size_t kNumClusters,
+   const int kNumIterations,
+   const T kEpsilon,
+   const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const size_t kEfSearch,
+   const int kSeed,
+   const bool kVerbose,
+   const SeedingMethod kSeeding):
+  kNumClusters_{kNumClusters},
+  kNumIterations_{kNumIterations},
+  kEpsilon_{kEpsilon},
+  kMaxConnections_{kMaxConnections},
+  kEfConstruction_{kEfConstruction},
+  kEfSearch_{kEfSearch},
+  kSeed_{kSeed},
+  kVerbose_{kVerbose},
+  kSeeding_{kSeeding}
+{}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithHnsw<T>::ClusterCentroids
+  (const std::vector<FeaturePoint<T>>& kPointSet) const
+{
+  if (kPointSet.empty())
+    {throw std::invalid_argument("Empty set of points.");}
+
+  const auto kNumPoints = kPointSet.size();
+  if (this->kVerbose_) {std::cout << "Number of points to cluster: " << kNumPoints << ".\n";}
+
+  if (kNumPoints<this->kNumClusters_) {
+    throw std::invalid_argument
+      ("Number of clusters is larger than number of points.");
+  }
+
+  const auto kNumFeatures = kPointSet[0].size();
+  auto centroids = this->InitCentroids(kPointSet);
+
+  // Store updated centroids
+  std::vector<FeaturePoint<T>> updated_centroids
+    (this->kNumClusters_, FeaturePoint<T>(kNumFeatures));
+
+  // Distance between centroids and updated centroids for early termination
+  std::vector<T> deltas(this->kNumClusters_);
+
+  // Initialize kNumClusters_ empty clusters (vector of pointers to const objects)
+  std::vector<std::vector<FeaturePoint<T> const *>> clusters (this->kNumClusters_);
+
+  // Reserve some memory for each cluster
+  const auto kApproximateNumPointsPerCluster = kNumPoints/this->kNumClusters_;
+  for (auto& cluster: clusters)
+    {cluster.reserve(kApproximateNumPointsPerCluster);}
+
+  T max_delta = std::numeric_limits<T>::max();
+  int iteration = 0;
+
+  while (true) {
+    if (this->kVerbose_) {std::cout << "* Start iteration " << iteration << ".\n";}
+
+    // Reset clusters
+    for (auto& cluster: clusters)
+      {cluster.clear();}
+
+    // Build index, point indices in the graph equal cluster indices
+    if (this->kVerbose_) {std::cout << "  * Build index over centroids.\n";}
+    const HnswIndex<FeaturePoint<T>> kIndex
+      (centroids, this->kMaxConnections_, this->kEfConstruction_, this->kEfSearch_, this->kSeed_);
+
+    if (this->kVerbose_) {std::cout << "  * Assign data points to nearest cluster.\n";}
+    for (const auto& kPoint: kPointSet) {
+      clusters[kIndex.NearestNeighbor(kPoint)].emplace_back(&kPoint);
+    }
+
+    if (max_delta < this->kEpsilon_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Max update smaller than epsilon (" << this->kEpsilon_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (iteration >= this->kNumIterations_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Reached maximum number of iterations (" << this->kNumIterations_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (this->kVerbose_) {std::cout << "  * Update centroids.\n";}
+    for (size_t cluster_index = 0; cluster_index<this->kNumClusters_; cluster_index++) {
+      if (clusters[cluster_index].size()>0) {
+        updated_centroids[cluster_index] = Centroid<FeaturePoint<T>>(clusters[cluster_index]);
+      } else {
+        // No update is cluster is empty
+        updated_centroids[cluster_index] = centroids[cluster_index];
+      }
+      deltas[cluster_index] = std::sqrt(SquaredL2Norm<FeaturePoint<T>>
+        (Difference<FeaturePoint<T>>(updated_centroids[cluster_index], centroids[cluster_index])));
+    }
+
+    // Use updated centroids for next iteration
+    centroids = updated_centroids;
+
+    max_delta = *std::max_element(deltas.begin(), deltas.end());
+    if (this->kVerbose_) {std::cout << "  * Max update: " << max_delta << ".\n";}
+
+    iteration++;
+  }
+
+  return centroids;
+}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithHnsw<T>::InitCentroids
+  (const std::vector<FeaturePoint<T>> &kPointSet) const
+{
+  // Seed random number generator
+  std::mt19937 engine(this->kSeed_);
+
+  // Select kNumClusters_ different points
+  const auto kIndices = SampleCentroidIndices
+    (kPointSet, this->kNumClusters_, this->kSeeding_, engine);
+
+  std::vector<FeaturePoint<T>> centroids;
+  centroids.reserve(this->kNumClusters_);
+  for (const auto kIndex: kIndices) {
+    centroids.emplace_back(kPointSet[kIndex]);
+  }
+
+  return centroids;
+}
+
+} // namespace igg
@@ -6,6 +6,7 @@
 #include <random>
 
 #include "clustering_strategy.hpp"
+#include "seeding.hpp"
 
 
 namespace igg {
@@ -25,7 +26,8 @@ public:
      const size_t kSearchLimit,
      const size_t kNumSplitDimensions,
      const int kSeed,
-     const bool kVerbose);
+     const bool kVerbose,
+     const SeedingMethod kSeeding = SeedingMethod::kRandom);
 
   std::vector<FeaturePoint<T>> ClusterCentroids
     (const std::vector<FeaturePoint<T>>& kPointSet) const override;
@@ -39,12 +41,10 @@ private:
   const size_t kNumSplitDimensions_;
   const int kSeed_;
   const bool kVerbose_;
+  const SeedingMethod kSeeding_;
 
   std::vector<FeaturePoint<T>> InitCentroids
     (const std::vector<FeaturePoint<T>>& kPointSet) const;
-
-  std::vector<FeaturePoint<T>> SubsamplePointSet
-    (const std::vector<FeaturePoint<T>>& kPointSet, const size_t kSubSampleSize) const;
 };
 
 } // namespace igg
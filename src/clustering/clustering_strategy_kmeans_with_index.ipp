@@ -3,7 +3,6 @@
 #include <cmath>
 #include <algorithm>
 
-#include "tools/sampling.hpp"
 #include "tools/linalg.hpp"
 
 #include "kmeans_with_index/index.hpp"
@@ -19,7 +18,8 @@ ClusteringStrategyKmeansWithIndex<T>::ClusteringStrategyKmeansWithIndex
    const size_t kSearchLimit,
    const size_t kNumSplitDimensions,
    const int kSeed,
-   const bool kVerbose):
+   const bool kVerbose,
+   const SeedingMethod kSeeding):
   kNumClusters_{kNumClusters},
   kNumIterations_{kNumIterations},
   kEpsilon_{kEpsilon},
@@ -27,7 +27,8 @@ ClusteringStrategyKmeansWithIndex<T>::ClusteringStrategyKmeansWithIndex
   kSearchLimit_{kSearchLimit},
   kNumSplitDimensions_{kNumSplitDimensions},
   kSeed_{kSeed},
-  kVerbose_{kVerbose}
+  kVerbose_{kVerbose},
+  kSeeding_{kSeeding}
 {}
 
 
@@ -138,35 +139,23 @@ std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithIndex<T>::ClusterCentro
 
 
 template <class T>
-std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithIndex<T>::SubsamplePointSet
-  (const std::vector<FeaturePoint<T>>& kPointSet, const size_t kSubsampleSize) const
+std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithIndex<T>::InitCentroids
+  (const std::vector<FeaturePoint<T>> &kPointSet) const
 {
-  const size_t kNumPoints = kPointSet.size();
-
   // Seed random number generator
   std::mt19937 engine(this->kSeed_);
 
-  // Sample kNumClusters_ different indices
-  const auto  kIndices = SampleIndicesWithoutReplacement<size_t>
-    (this->kNumClusters_, kNumPoints, engine);
-
-  // Collect points
-  std::vector<FeaturePoint<T>> subsample;
-  subsample.reserve(kSubsampleSize);
+  // Select kNumClusters_ different points
+  const auto kIndices = SampleCentroidIndices
+    (kPointSet, this->kNumClusters_, this->kSeeding_, engine);
 
+  std::vector<FeaturePoint<T>> centroids;
+  centroids.reserve(this->kNumClusters_);
   for (const auto kIndex: kIndices) {
-    subsample.emplace_back(kPointSet[kIndex]);
+    centroids.emplace_back(kPointSet[kIndex]);
   }
 
-  return subsample;
-}
-
-
-template <class T>
-std::vector<FeaturePoint<T>> ClusteringStrategyKmeansWithIndex<T>::InitCentroids
-  (const std::vector<FeaturePoint<T>> &kPointSet) const
-{
-  return this->SubsamplePointSet(kPointSet, this->kNumClusters_);
+  return centroids;
 }
 
 } // namespace igg
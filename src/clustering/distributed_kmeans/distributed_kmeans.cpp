@@ -0,0 +1,466 @@
+#include "distributed_kmeans.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "tools/linalg.hpp"
+#include "tools/sampling.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// What a message from the coordinator asks a worker for
+enum class KmeansRequest: uint8_t {
+  kSize, // Number of points and dimensions
+  kFetch, // Points by their index within the shard
+  kAssign, // Partial sums and counts of the clusters for the given centroids
+  kFinish // No more requests
+};
+
+const char kCheckpointMagic[] = "KMEANSC2";
+
+// Appends plain values to a message
+class MessageWriter {
+public:
+  template <class T>
+  void Write(const T kValue) {
+    this->message_.append(reinterpret_cast<const char*>(&kValue), sizeof(T));
+  }
+
+  template <class T>
+  void WriteValues(const T* kValues, const size_t kSize) {
+    this->message_.append(reinterpret_cast<const char*>(kValues), sizeof(T)*kSize);
+  }
+
+  const std::string& Message() const {return this->message_;}
+
+private:
+  std::string message_;
+};
+
+// Reads what MessageWriter appended, never beyond the end of the message
+class MessageReader {
+public:
+  explicit MessageReader(const std::string& kMessage): kMessage_(kMessage) {}
+
+  template <class T>
+  T Read() {
+    T value;
+    this->ReadValues(&value, 1);
+    return value;
+  }
+
+  template <class T>
+  void ReadValues(T* values, const size_t kSize) {
+    if (kSize>this->Remaining()/sizeof(T)) {throw std::runtime_error("Message ends unexpectedly.");}
+    std::memcpy(values, this->kMessage_.data()+this->position_, sizeof(T)*kSize);
+    this->position_ += sizeof(T)*kSize;
+  }
+
+  size_t Remaining() const {return this->kMessage_.size()-this->position_;}
+
+private:
+  const std::string& kMessage_;
+  size_t position_ = 0;
+};
+
+void SendToAll(const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers, const std::string& kMessage) {
+  for (size_t worker = 0; worker<kWorkers.size(); worker++) {
+    if (!kWorkers[worker]->Send(kMessage)) {
+      throw std::runtime_error("Connection to K-means worker "+std::to_string(worker)+" failed.");
+    }
+  }
+}
+
+std::string ReceiveFrom(const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers, const size_t kWorker) {
+  std::string message;
+  if (!kWorkers[kWorker]->Receive(message)) {
+    throw std::runtime_error("Connection to K-means worker "+std::to_string(kWorker)+" failed.");
+  }
+  return message;
+}
+
+} // namespace
+
+
+KmeansWorker::KmeansWorker(PointStream<float>& shard): shard_(shard) {}
+
+
+bool KmeansWorker::Serve(KmeansChannel& channel) const {
+  std::string request;
+  while (channel.Receive(request)) {
+    MessageReader reader(request);
+    MessageWriter response;
+
+    switch (static_cast<KmeansRequest>(reader.Read<uint8_t>())) {
+      case KmeansRequest::kSize: {
+        this->shard_.Rewind();
+        const auto kChunk = this->shard_.NextChunk();
+        response.Write(static_cast<uint64_t>(this->shard_.Size()));
+        response.Write(static_cast<uint64_t>(kChunk.empty() ? 0 : kChunk[0]->size()));
+        break;
+      }
+
+      case KmeansRequest::kFetch: {
+        std::vector<uint64_t> indices(reader.Read<uint64_t>());
+        reader.ReadValues(indices.data(), indices.size());
+
+        // Position of each index in the response
+        std::unordered_map<uint64_t, size_t> positions;
+        for (size_t position = 0; position<indices.size(); position++) {
+          if (indices[position]>=this->shard_.Size()) {throw std::runtime_error("Point index out of range.");}
+          positions[indices[position]] = position;
+        }
+
+        std::vector<FeaturePoint<float>> points(indices.size());
+        uint64_t index = 0;
+        this->shard_.Rewind();
+        for (auto chunk = this->shard_.NextChunk(); !chunk.empty(); chunk = this->shard_.NextChunk()) {
+          for (const auto kPoint: chunk) {
+            const auto kPosition = positions.find(index++);
+            if (kPosition!=positions.end()) {points[kPosition->second] = *kPoint;}
+          }
+        }
+
+        const uint64_t kNumDimensions = points.empty() ? 0 : points[0].size();
+        response.Write(static_cast<uint64_t>(points.size()));
+        response.Write(kNumDimensions);
+        for (const auto& kPoint: points) {response.WriteValues(kPoint.data(), kNumDimensions);}
+        break;
+      }
+
+      case KmeansRequest::kAssign: {
+        const auto kIteration = reader.Read<int32_t>();
+        const auto kNumClusters = reader.Read<uint64_t>();
+        const auto kNumDimensions = reader.Read<uint64_t>();
+        if (kNumClusters==0 || kNumDimensions*kNumClusters*sizeof(float)!=reader.Remaining()) {
+          throw std::runtime_error("Size of centroids does not match message.");
+        }
+        std::vector<FeaturePoint<float>> centroids(kNumClusters, FeaturePoint<float>(kNumDimensions));
+        for (auto& centroid: centroids) {reader.ReadValues(centroid.data(), kNumDimensions);}
+
+        // Same assignment as ClusteringStrategyKmeansStreaming, sums in double precision
+        std::vector<uint64_t> counts(kNumClusters, 0);
+        std::vector<double> sums(kNumClusters*kNumDimensions, 0.0);
+        this->shard_.Rewind();
+        for (auto chunk = this->shard_.NextChunk(); !chunk.empty(); chunk = this->shard_.NextChunk()) {
+          for (const auto kPoint: chunk) {
+            if (kPoint->size()!=kNumDimensions) {throw std::runtime_error("Points and centroids differ in dimension.");}
+            const auto kNearestClusterIndex = NearestNeighbor(*kPoint, centroids);
+            auto* sum = &sums[kNearestClusterIndex*kNumDimensions];
+            for (size_t index = 0; index<kNumDimensions; index++) {sum[index] += (*kPoint)[index];}
+            counts[kNearestClusterIndex]++;
+          }
+        }
+
+        response.Write(kIteration);
+        response.WriteValues(counts.data(), counts.size());
+        response.WriteValues(sums.data(), sums.size());
+        break;
+      }
+
+      case KmeansRequest::kFinish:
+        return true;
+
+      default:
+        throw std::runtime_error("Unknown K-means request.");
+    }
+
+    if (!channel.Send(response.Message())) {return false;}
+  }
+  return false;
+}
+
+
+DistributedKmeans::DistributedKmeans
+  (const size_t kNumClusters,
+   const int kNumIterations,
+   const float kEpsilon,
+   const int kSeed,
+   const bool kVerbose,
+   const std::string& kCheckpointPath):
+  kNumClusters_{kNumClusters},
+  kNumIterations_{kNumIterations},
+  kEpsilon_{kEpsilon},
+  kSeed_{kSeed},
+  kVerbose_{kVerbose},
+  kCheckpointPath_{kCheckpointPath}
+{}
+
+
+std::vector<FeaturePoint<float>> DistributedKmeans::ClusterCentroids
+  (const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers) const
+{
+  if (kWorkers.empty()) {throw std::invalid_argument("Need at least one K-means worker.");}
+
+  // Size of the shard of each worker
+  MessageWriter size_request;
+  size_request.Write(static_cast<uint8_t>(KmeansRequest::kSize));
+  SendToAll(kWorkers, size_request.Message());
+  std::vector<size_t> num_points_per_worker;
+  size_t num_dimensions = 0;
+  for (size_t worker = 0; worker<kWorkers.size(); worker++) {
+    const auto kResponse = ReceiveFrom(kWorkers, worker);
+    MessageReader reader(kResponse);
+    num_points_per_worker.emplace_back(reader.Read<uint64_t>());
+    const auto kNumDimensions = reader.Read<uint64_t>();
+    if (num_points_per_worker.back()==0) {continue;}
+    if (num_dimensions>0 && kNumDimensions!=num_dimensions) {
+      throw std::runtime_error("Points of K-means worker "+std::to_string(worker)+" differ in dimension.");
+    }
+    num_dimensions = kNumDimensions;
+  }
+
+  const auto kNumPoints = std::accumulate(num_points_per_worker.begin(), num_points_per_worker.end(), size_t(0));
+  if (kNumPoints==0)
+    {throw std::invalid_argument("Empty set of points.");}
+
+  if (this->kVerbose_) {
+    std::cout << "Number of points to cluster: " << kNumPoints << " on " << kWorkers.size() << " workers.\n";
+  }
+
+  if (kNumPoints<this->kNumClusters_) {
+    throw std::invalid_argument
+      ("Number of clusters is larger than number of points.");
+  }
+
+  std::vector<FeaturePoint<float>> centroids;
+  float max_delta = std::numeric_limits<float>::max();
+  int iteration = 0;
+  if (this->ReadCheckpoint(num_points_per_worker, iteration, max_delta, centroids)) {
+    if (this->kVerbose_) {std::cout << "* Continue after iteration " << iteration-1 << " from checkpoint.\n";}
+  } else {
+    centroids = this->InitCentroids(kWorkers, num_points_per_worker);
+  }
+  if (centroids[0].size()!=num_dimensions) {
+    throw std::runtime_error("Centroids of the checkpoint and points differ in dimension.");
+  }
+
+  while (true) {
+    if (this->kVerbose_) {std::cout << "* Start iteration " << iteration << ".\n";}
+
+    if (max_delta < this->kEpsilon_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Max update smaller than epsilon (" << this->kEpsilon_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (iteration >= this->kNumIterations_) {
+      if (this->kVerbose_)
+        {std::cout << "  * Reached maximum number of iterations (" << this->kNumIterations_ << "). Terminate.\n";}
+      break;
+    }
+
+    if (this->kVerbose_) {std::cout << "  * Assign data points to nearest cluster on all workers.\n";}
+    MessageWriter assign_request;
+    assign_request.Write(static_cast<uint8_t>(KmeansRequest::kAssign));
+    assign_request.Write(static_cast<int32_t>(iteration));
+    assign_request.Write(static_cast<uint64_t>(this->kNumClusters_));
+    assign_request.Write(static_cast<uint64_t>(num_dimensions));
+    for (const auto& kCentroid: centroids) {assign_request.WriteValues(kCentroid.data(), num_dimensions);}
+    SendToAll(kWorkers, assign_request.Message());
+
+    // Reduce in the order of the workers, independent of which one answers first
+    std::vector<uint64_t> counts(this->kNumClusters_, 0);
+    std::vector<double> sums(this->kNumClusters_*num_dimensions, 0.0);
+    std::vector<uint64_t> worker_counts(this->kNumClusters_);
+    std::vector<double> worker_sums(sums.size());
+    for (size_t worker = 0; worker<kWorkers.size(); worker++) {
+      const auto kResponse = ReceiveFrom(kWorkers, worker);
+      MessageReader reader(kResponse);
+      if (reader.Read<int32_t>()!=iteration) {
+        throw std::runtime_error("K-means worker "+std::to_string(worker)+" answered another iteration.");
+      }
+      reader.ReadValues(worker_counts.data(), worker_counts.size());
+      reader.ReadValues(worker_sums.data(), worker_sums.size());
+      for (size_t index = 0; index<counts.size(); index++) {counts[index] += worker_counts[index];}
+      for (size_t index = 0; index<sums.size(); index++) {sums[index] += worker_sums[index];}
+    }
+
+    if (this->kVerbose_) {std::cout << "  * Update centroids.\n";}
+    std::vector<float> deltas(this->kNumClusters_, 0.0f);
+    for (size_t cluster_index = 0; cluster_index<this->kNumClusters_; cluster_index++) {
+      // No update is cluster is empty
+      if (counts[cluster_index]==0) {continue;}
+
+      FeaturePoint<float> centroid(num_dimensions);
+      for (size_t index = 0; index<num_dimensions; index++) {
+        centroid[index] = static_cast<float>(sums[cluster_index*num_dimensions+index]/counts[cluster_index]);
+      }
+      deltas[cluster_index] = std::sqrt(SquaredL2Norm<FeaturePoint<float>>
+        (Difference<FeaturePoint<float>>(centroid, centroids[cluster_index])));
+      centroids[cluster_index] = std::move(centroid);
+    }
+
+    max_delta = *std::max_element(deltas.begin(), deltas.end());
+    if (this->kVerbose_) {std::cout << "  * Max update: " << max_delta << ".\n";}
+
+    iteration++;
+    this->WriteCheckpoint(num_points_per_worker, iteration, max_delta, centroids);
+  }
+
+  MessageWriter finish_request;
+  finish_request.Write(static_cast<uint8_t>(KmeansRequest::kFinish));
+  SendToAll(kWorkers, finish_request.Message());
+
+  // A later run with the same checkpoint path starts over
+  if (!this->kCheckpointPath_.empty()) {std::remove(this->kCheckpointPath_.c_str());}
+
+  return centroids;
+}
+
+
+std::vector<FeaturePoint<float>> DistributedKmeans::InitCentroids
+  (const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers,
+   const std::vector<size_t>& kNumPointsPerWorker) const
+{
+  // Seed random number generator
+  std::mt19937 engine(this->kSeed_);
+
+  // Sample kNumClusters_ different indices of all points, same as ClusteringStrategyKmeansStreaming
+  const auto kNumPoints = std::accumulate(kNumPointsPerWorker.begin(), kNumPointsPerWorker.end(), size_t(0));
+  const auto kIndices = SampleIndicesWithoutReplacement<size_t>(this->kNumClusters_, kNumPoints, engine);
+
+  // Index within the shard and position in the result of each sampled point, by worker
+  std::vector<std::vector<uint64_t>> shard_indices(kWorkers.size());
+  std::vector<std::vector<size_t>> positions(kWorkers.size());
+  for (size_t position = 0; position<kIndices.size(); position++) {
+    auto index = kIndices[position];
+    size_t worker = 0;
+    while (index>=kNumPointsPerWorker[worker]) {index -= kNumPointsPerWorker[worker++];}
+    shard_indices[worker].emplace_back(index);
+    positions[worker].emplace_back(position);
+  }
+
+  for (size_t worker = 0; worker<kWorkers.size(); worker++) {
+    MessageWriter fetch_request;
+    fetch_request.Write(static_cast<uint8_t>(KmeansRequest::kFetch));
+    fetch_request.Write(static_cast<uint64_t>(shard_indices[worker].size()));
+    fetch_request.WriteValues(shard_indices[worker].data(), shard_indices[worker].size());
+    if (!kWorkers[worker]->Send(fetch_request.Message())) {
+      throw std::runtime_error("Connection to K-means worker "+std::to_string(worker)+" failed.");
+    }
+  }
+
+  std::vector<FeaturePoint<float>> centroids(this->kNumClusters_);
+  for (size_t worker = 0; worker<kWorkers.size(); worker++) {
+    const auto kResponse = ReceiveFrom(kWorkers, worker);
+    MessageReader reader(kResponse);
+    const auto kNumFetched = reader.Read<uint64_t>();
+    const auto kNumDimensions = reader.Read<uint64_t>();
+    if (kNumFetched!=positions[worker].size()) {
+      throw std::runtime_error("K-means worker "+std::to_string(worker)+" returned other points.");
+    }
+    for (const auto kPosition: positions[worker]) {
+      centroids[kPosition].resize(kNumDimensions);
+      reader.ReadValues(centroids[kPosition].data(), kNumDimensions);
+    }
+  }
+
+  return centroids;
+}
+
+
+bool DistributedKmeans::ReadCheckpoint
+  (const std::vector<size_t>& kNumPointsPerWorker,
+   int& iteration, float& max_delta, std::vector<FeaturePoint<float>>& centroids) const
+{
+  if (this->kCheckpointPath_.empty()) {return false;}
+  std::ifstream file(this->kCheckpointPath_, std::ios::binary);
+  if (!file) {return false;}
+
+  char magic[sizeof(kCheckpointMagic)] = {0};
+  uint64_t num_clusters = 0;
+  uint64_t num_dimensions = 0;
+  int32_t seed = 0;
+  uint64_t num_workers = 0;
+  int32_t checkpoint_iteration = 0;
+  file.read(magic, sizeof(kCheckpointMagic)-1);
+  file.read(reinterpret_cast<char*>(&num_clusters), sizeof(num_clusters));
+  file.read(reinterpret_cast<char*>(&num_dimensions), sizeof(num_dimensions));
+  file.read(reinterpret_cast<char*>(&seed), sizeof(seed));
+  file.read(reinterpret_cast<char*>(&num_workers), sizeof(num_workers));
+  std::vector<size_t> num_points_per_worker;
+  for (uint64_t worker = 0; file && worker<num_workers; worker++) {
+    uint64_t num_points = 0;
+    file.read(reinterpret_cast<char*>(&num_points), sizeof(num_points));
+    num_points_per_worker.emplace_back(num_points);
+  }
+  file.read(reinterpret_cast<char*>(&checkpoint_iteration), sizeof(checkpoint_iteration));
+  file.read(reinterpret_cast<char*>(&max_delta), sizeof(max_delta));
+  if (!file || std::strcmp(magic, kCheckpointMagic)!=0) {
+    throw std::runtime_error("Cannot read K-means checkpoint "+this->kCheckpointPath_+".");
+  }
+  if (num_clusters!=this->kNumClusters_) {
+    throw std::runtime_error
+      ("K-means checkpoint "+this->kCheckpointPath_+" has "+std::to_string(num_clusters)+
+       " clusters, not "+std::to_string(this->kNumClusters_)+".");
+  }
+  if (seed!=this->kSeed_) {
+    throw std::runtime_error
+      ("K-means checkpoint "+this->kCheckpointPath_+" has seed "+std::to_string(seed)+
+       ", not "+std::to_string(this->kSeed_)+".");
+  }
+  // Same centroids only if the workers own the same shards in the same order
+  if (num_points_per_worker!=kNumPointsPerWorker) {
+    throw std::runtime_error
+      ("K-means checkpoint "+this->kCheckpointPath_+" was written for other shards of the points.");
+  }
+
+  centroids.assign(num_clusters, FeaturePoint<float>(num_dimensions));
+  for (auto& centroid: centroids) {
+    file.read(reinterpret_cast<char*>(centroid.data()), sizeof(float)*num_dimensions);
+  }
+  if (!file) {throw std::runtime_error("Cannot read K-means checkpoint "+this->kCheckpointPath_+".");}
+  iteration = checkpoint_iteration;
+  return true;
+}
+
+
+void DistributedKmeans::WriteCheckpoint
+  (const std::vector<size_t>& kNumPointsPerWorker,
+   const int kIteration, const float kMaxDelta, const std::vector<FeaturePoint<float>>& kCentroids) const
+{
+  if (this->kCheckpointPath_.empty()) {return;}
+
+  // Renamed once complete, so a failure while writing keeps the previous checkpoint
+  const auto kTemporaryPath = this->kCheckpointPath_+".tmp";
+  {
+    std::ofstream file(kTemporaryPath, std::ios::binary);
+    const uint64_t kNumClusters = kCentroids.size();
+    const uint64_t kNumDimensions = kCentroids[0].size();
+    const int32_t kSeed = this->kSeed_;
+    const uint64_t kNumWorkers = kNumPointsPerWorker.size();
+    const std::vector<uint64_t> kNumPoints(kNumPointsPerWorker.begin(), kNumPointsPerWorker.end());
+    const int32_t kCheckpointIteration = kIteration;
+    file.write(kCheckpointMagic, sizeof(kCheckpointMagic)-1);
+    file.write(reinterpret_cast<const char*>(&kNumClusters), sizeof(kNumClusters));
+    file.write(reinterpret_cast<const char*>(&kNumDimensions), sizeof(kNumDimensions));
+    file.write(reinterpret_cast<const char*>(&kSeed), sizeof(kSeed));
+    file.write(reinterpret_cast<const char*>(&kNumWorkers), sizeof(kNumWorkers));
+    file.write(reinterpret_cast<const char*>(kNumPoints.data()), sizeof(uint64_t)*kNumPoints.size());
+    file.write(reinterpret_cast<const char*>(&kCheckpointIteration), sizeof(kCheckpointIteration));
+    file.write(reinterpret_cast<const char*>(&kMaxDelta), sizeof(kMaxDelta));
+    for (const auto& kCentroid: kCentroids) {
+      file.write(reinterpret_cast<const char*>(kCentroid.data()), sizeof(float)*kNumDimensions);
+    }
+    if (!file) {throw std::runtime_error("Cannot write K-means checkpoint "+kTemporaryPath+".");}
+  }
+  if (std::rename(kTemporaryPath.c_str(), this->kCheckpointPath_.c_str())!=0) {
+    throw std::runtime_error("Cannot write K-means checkpoint "+this->kCheckpointPath_+".");
+  }
+}
+
+} // namespace igg
@@ -0,0 +1,132 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_DISTRIBUTED_KMEANS_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_DISTRIBUTED_KMEANS_HPP_
+
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clustering/feature_point.hpp"
+#include "clustering/point_stream.hpp"
+#include "kmeans_channel.hpp"
+
+
+namespace igg {
+
+/**
+ * Worker of DistributedKmeans, owning a shard of the points, e.g. the features of some
+ * of the images of a dataset. For each iteration, it assigns its points to the centroids
+ * sent by the coordinator and returns the sum and number of points of each cluster.
+ *
+ * A worker keeps no state between requests, so a worker which failed can simply be
+ * started again and the coordinator restarted from its last checkpoint.
+ */
+class KmeansWorker {
+public:
+  /**
+   * Constructor. Refers to the stream, which must outlive the worker.
+   */
+  explicit KmeansWorker(PointStream<float>& shard);
+
+  /**
+   * Answer the requests of a coordinator until it is done or the connection is closed.
+   *
+   * Throws an instance of std::runtime_error if a request is malformed.
+   *
+   * @return True if the coordinator finished, false if the connection was closed.
+   */
+  bool Serve(KmeansChannel& channel) const;
+
+private:
+  PointStream<float>& shard_;
+};
+
+
+/**
+ * Coordinator of K-means over points distributed among several worker processes (map
+ * reduce). Each iteration, the centroids are sent to all workers, which assign their
+ * points in parallel and return partial sums and counts per cluster. These are reduced
+ * in the order of the workers, so the result does not depend on which worker answers
+ * first, and is the same for each run given the same shards.
+ *
+ * This is the algorithm of ClusteringStrategyKmeansStreaming (random initialization).
+ * The initial centroids are the same, given the same seed and the shards in the order
+ * of the point set. Partial sums are accumulated in double precision, so the centroids
+ * match up to rounding.
+ *
+ * With a checkpoint path, the centroids are written after each completed iteration. A
+ * coordinator restarted with the same checkpoint (e.g. after a worker or the coordinator
+ * itself failed) continues with the next iteration, and ends with the same centroids as
+ * a run without failures. The checkpoint records the seed and the number of points of
+ * each worker, and is not used for another seed or other shards. It is removed once the
+ * clustering completes.
+ *
+ * Usage:
+ *
+ *   // Each worker process
+ *   KmeansChannelListener listener("/tmp/kmeans_worker_0.sock");
+ *   KmeansWorker(shard_stream).Serve(*listener.Accept());
+ *
+ *   // Coordinator
+ *   std::vector<std::unique_ptr<KmeansChannel>> workers;
+ *   workers.emplace_back(FileDescriptorChannel::Connect("/tmp/kmeans_worker_0.sock"));
+ *   const DistributedKmeans kKmeans(100, 25, 1e-3f, 0, true, "/tmp/kmeans.checkpoint");
+ *   const auto kCentroids = kKmeans.ClusterCentroids(workers);
+ */
+class DistributedKmeans {
+public:
+  /**
+   * Constructor.
+   *
+   * @param kNumClusters Number of clusters.
+   * @param kNumIterations Maximum number of iterations.
+   * @param kEpsilon Early stopping if all centroid updates are smaller than this value.
+   * @param kSeed For initialization of centroids, which are randomly selected from the
+   * points of all workers.
+   * @param kVerbose If true, print some output to the terminal.
+   * @param kCheckpointPath File to continue from and to write the state to after each
+   * iteration, empty for none.
+   */
+  DistributedKmeans
+    (const size_t kNumClusters,
+     const int kNumIterations,
+     const float kEpsilon,
+     const int kSeed,
+     const bool kVerbose,
+     const std::string& kCheckpointPath = "");
+
+  /**
+   * Perform the clustering, and let the workers finish.
+   *
+   * Throws an instance of std::invalid_argument if there are no workers or points, or
+   * fewer points than clusters, and of std::runtime_error if a worker fails or the
+   * checkpoint does not match.
+   */
+  std::vector<FeaturePoint<float>> ClusterCentroids
+    (const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers) const;
+
+private:
+  const size_t kNumClusters_;
+  const int kNumIterations_;
+  const float kEpsilon_;
+  const int kSeed_;
+  const bool kVerbose_;
+  const std::string kCheckpointPath_;
+
+  // Same points as ClusteringStrategyKmeansStreaming selects
+  std::vector<FeaturePoint<float>> InitCentroids
+    (const std::vector<std::unique_ptr<KmeansChannel>>& kWorkers,
+     const std::vector<size_t>& kNumPointsPerWorker) const;
+
+  // False if there is no checkpoint, throws if it was written for another seed or other shards
+  bool ReadCheckpoint
+    (const std::vector<size_t>& kNumPointsPerWorker,
+     int& iteration, float& max_delta, std::vector<FeaturePoint<float>>& centroids) const;
+  void WriteCheckpoint
+    (const std::vector<size_t>& kNumPointsPerWorker,
+     const int kIteration, const float kMaxDelta, const std::vector<FeaturePoint<float>>& kCentroids) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_DISTRIBUTED_KMEANS_HPP_
@@ -0,0 +1,176 @@
+#include "kmeans_channel.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace igg {
+
+namespace {
+
+// Largest message accepted, e.g. the partial sums of 100k clusters of 128 dimensions
+const uint32_t kMaxMessageSize = 1024u*1024u*1024u;
+
+sockaddr_un MakeSocketAddress(const std::string& kSocketPath) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (kSocketPath.empty() || kSocketPath.size()>=sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path "+kSocketPath+" is empty or too long.");
+  }
+  std::strncpy(address.sun_path, kSocketPath.c_str(), sizeof(address.sun_path)-1);
+  return address;
+}
+
+// Write to a pipe without SIGPIPE if the other end is closed: the signal is blocked for
+// this thread meanwhile, and discarded if this write raised it
+ssize_t WriteWithoutSigpipe(const int kDescriptor, const char* bytes, const size_t kSize) {
+  sigset_t sigpipe_set;
+  sigemptyset(&sigpipe_set);
+  sigaddset(&sigpipe_set, SIGPIPE);
+  sigset_t pending_set;
+  sigpending(&pending_set);
+  const bool kWasPending = sigismember(&pending_set, SIGPIPE)==1;
+  sigset_t previous_set;
+  pthread_sigmask(SIG_BLOCK, &sigpipe_set, &previous_set);
+
+  const auto kWritten = ::write(kDescriptor, bytes, kSize);
+  const auto kError = errno;
+  if (kWritten<0 && kError==EPIPE && !kWasPending) {
+    const timespec kNoWait{0, 0};
+    while (sigtimedwait(&sigpipe_set, nullptr, &kNoWait)<0 && errno==EINTR) {}
+  }
+
+  pthread_sigmask(SIG_SETMASK, &previous_set, nullptr);
+  errno = kError;
+  return kWritten;
+}
+
+bool WriteAll(const int kDescriptor, const char* bytes, size_t size) {
+  while (size>0) {
+    // No SIGPIPE if the other side closed the connection
+    auto written = ::send(kDescriptor, bytes, size, MSG_NOSIGNAL);
+    if (written<0 && errno==ENOTSOCK) {written = WriteWithoutSigpipe(kDescriptor, bytes, size);}
+    if (written<0 && errno==EINTR) {continue;}
+    if (written<=0) {return false;}
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool ReadAll(const int kDescriptor, char* bytes, size_t size) {
+  while (size>0) {
+    const auto kRead = ::read(kDescriptor, bytes, size);
+    if (kRead<0 && errno==EINTR) {continue;}
+    if (kRead<=0) {return false;}
+    bytes += kRead;
+    size -= kRead;
+  }
+  return true;
+}
+
+} // namespace
+
+
+FileDescriptorChannel::FileDescriptorChannel(const int kReadDescriptor, const int kWriteDescriptor):
+  kReadDescriptor_{kReadDescriptor}, kWriteDescriptor_{kWriteDescriptor} {}
+
+
+FileDescriptorChannel::~FileDescriptorChannel() {
+  ::close(this->kReadDescriptor_);
+  if (this->kWriteDescriptor_!=this->kReadDescriptor_) {::close(this->kWriteDescriptor_);}
+}
+
+
+bool FileDescriptorChannel::Send(const std::string& kMessage) {
+  if (kMessage.size()>kMaxMessageSize) {return false;}
+  const uint32_t kSize = kMessage.size();
+  return WriteAll(this->kWriteDescriptor_, reinterpret_cast<const char*>(&kSize), sizeof(uint32_t)) &&
+    WriteAll(this->kWriteDescriptor_, kMessage.data(), kMessage.size());
+}
+
+
+bool FileDescriptorChannel::Receive(std::string& message) {
+  uint32_t size = 0;
+  if (!ReadAll(this->kReadDescriptor_, reinterpret_cast<char*>(&size), sizeof(uint32_t)) ||
+      size>kMaxMessageSize) {
+    return false;
+  }
+  message.resize(size);
+  return size==0 || ReadAll(this->kReadDescriptor_, &message[0], size);
+}
+
+
+std::pair<std::unique_ptr<KmeansChannel>, std::unique_ptr<KmeansChannel>> FileDescriptorChannel::MakePipePair() {
+  int to_second[2];
+  int to_first[2];
+  if (::pipe(to_second)<0) {throw std::runtime_error("Cannot create pipe.");}
+  if (::pipe(to_first)<0) {
+    ::close(to_second[0]);
+    ::close(to_second[1]);
+    throw std::runtime_error("Cannot create pipe.");
+  }
+  return {std::make_unique<FileDescriptorChannel>(to_first[0], to_second[1]),
+          std::make_unique<FileDescriptorChannel>(to_second[0], to_first[1])};
+}
+
+
+std::unique_ptr<KmeansChannel> FileDescriptorChannel::Connect(const std::string& kSocketPath) {
+  const auto kAddress = MakeSocketAddress(kSocketPath);
+  const auto kSocket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (kSocket<0) {throw std::runtime_error("Cannot create socket.");}
+  if (::connect(kSocket, reinterpret_cast<const sockaddr*>(&kAddress), sizeof(kAddress))<0) {
+    ::close(kSocket);
+    throw std::runtime_error("Cannot connect to "+kSocketPath+": "+std::strerror(errno)+".");
+  }
+  return std::make_unique<FileDescriptorChannel>(kSocket, kSocket);
+}
+
+
+KmeansChannelListener::KmeansChannelListener(const std::string& kSocketPath): kSocketPath_{kSocketPath} {
+  const auto kAddress = MakeSocketAddress(kSocketPath);
+
+  // Replace a socket left over by a previous worker, but nothing else
+  struct stat status;
+  if (::lstat(kSocketPath.c_str(), &status)==0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      throw std::runtime_error("Cannot create socket "+kSocketPath+", the file exists.");
+    }
+    ::unlink(kSocketPath.c_str());
+  }
+
+  this->socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (this->socket_<0) {throw std::runtime_error("Cannot create socket.");}
+  if (::bind(this->socket_, reinterpret_cast<const sockaddr*>(&kAddress), sizeof(kAddress))<0 ||
+      ::listen(this->socket_, SOMAXCONN)<0) {
+    ::close(this->socket_);
+    throw std::runtime_error("Cannot listen on socket "+kSocketPath+": "+std::strerror(errno)+".");
+  }
+}
+
+
+KmeansChannelListener::~KmeansChannelListener() {
+  ::close(this->socket_);
+  ::unlink(this->kSocketPath_.c_str());
+}
+
+
+std::unique_ptr<KmeansChannel> KmeansChannelListener::Accept() const {
+  while (true) {
+    const auto kConnection = ::accept(this->socket_, nullptr, nullptr);
+    if (kConnection>=0) {return std::make_unique<FileDescriptorChannel>(kConnection, kConnection);}
+    if (errno!=EINTR) {throw std::runtime_error("Cannot accept connection: "+std::string(std::strerror(errno))+".");}
+  }
+}
+
+} // namespace igg
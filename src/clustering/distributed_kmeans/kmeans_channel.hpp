@@ -0,0 +1,107 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_KMEANS_CHANNEL_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_KMEANS_CHANNEL_HPP_
+
+
+#include <memory>
+#include <string>
+#include <utility>
+
+
+namespace igg {
+
+/**
+ * Connection between the coordinator of DistributedKmeans and one of its workers,
+ * exchanging whole messages. Implement it to use another transport, e.g. TCP or a
+ * message queue.
+ */
+class KmeansChannel {
+public:
+  virtual ~KmeansChannel() = default;
+
+  /**
+   * @return True on success, false if the connection was closed or failed.
+   */
+  virtual bool Send(const std::string& kMessage) = 0;
+
+  /**
+   * @return True on success, false if the connection was closed or failed.
+   */
+  virtual bool Receive(std::string& message) = 0;
+};
+
+
+/**
+ * Channel over file descriptors, e.g. a local (Unix domain) socket or a pair of pipes.
+ * Messages are sent as frames of a 32 bit size followed by that many bytes.
+ */
+class FileDescriptorChannel: public KmeansChannel {
+public:
+  /**
+   * Constructor. Takes ownership of the descriptors, which may be the same.
+   */
+  FileDescriptorChannel(const int kReadDescriptor, const int kWriteDescriptor);
+
+  ~FileDescriptorChannel() override;
+
+  FileDescriptorChannel(const FileDescriptorChannel&) = delete;
+  FileDescriptorChannel& operator=(const FileDescriptorChannel&) = delete;
+
+  bool Send(const std::string& kMessage) override;
+  bool Receive(std::string& message) override;
+
+  /**
+   * Two ends connected by pipes, e.g. for a worker in another thread or a forked process.
+   * Sending fails without SIGPIPE if the other end is closed, as for sockets.
+   *
+   * Throws an instance of std::runtime_error if the pipes cannot be created.
+   */
+  static std::pair<std::unique_ptr<KmeansChannel>, std::unique_ptr<KmeansChannel>> MakePipePair();
+
+  /**
+   * Connect to a worker listening on a local socket, see KmeansChannelListener.
+   *
+   * Throws an instance of std::runtime_error if the worker cannot be reached.
+   */
+  static std::unique_ptr<KmeansChannel> Connect(const std::string& kSocketPath);
+
+private:
+  const int kReadDescriptor_;
+  const int kWriteDescriptor_;
+};
+
+
+/**
+ * Local socket a worker waits on for its coordinator.
+ */
+class KmeansChannelListener {
+public:
+  /**
+   * Constructor. Listens on the socket, a socket left over at the path is replaced.
+   *
+   * Throws an instance of std::runtime_error if the socket cannot be created.
+   */
+  explicit KmeansChannelListener(const std::string& kSocketPath);
+
+  /**
+   * Closes and removes the socket.
+   */
+  ~KmeansChannelListener();
+
+  KmeansChannelListener(const KmeansChannelListener&) = delete;
+  KmeansChannelListener& operator=(const KmeansChannelListener&) = delete;
+
+  /**
+   * Wait for the next coordinator to connect.
+   *
+   * Throws an instance of std::runtime_error if accepting fails.
+   */
+  std::unique_ptr<KmeansChannel> Accept() const;
+
+private:
+  const std::string kSocketPath_;
+  int socket_ = -1;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_DISTRIBUTED_KMEANS_KMEANS_CHANNEL_HPP_
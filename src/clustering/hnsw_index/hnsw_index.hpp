@@ -0,0 +1,215 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_HNSW_INDEX_HNSW_INDEX_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_HNSW_INDEX_HNSW_INDEX_HPP_
+
+
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include <string>
+#include <random>
+
+
+namespace igg {
+
+/**
+ * How HnswIndex measures and stores its points. This is for dense vectors such as
+ * FeaturePoint<float>, specialize it for other point types, e.g. SparseHistogram<T>
+ * in sparse_histogram.hpp.
+ */
+template <class PointType>
+struct HnswPointTraits {
+  using ScalarType = typename PointType::value_type;
+
+  // All points of an index have the same number of dimensions
+  static size_t Dimension(const PointType& kPoint) {return kPoint.size();}
+
+  static ScalarType SquaredDistance(const PointType& kPoint1, const PointType& kPoint2);
+
+  static void Write(std::ostream& file, const PointType& kPoint);
+  static PointType Read(std::istream& file, const size_t kDimension);
+};
+
+
+/**
+ * Spatial index for approximate nearest neighbor search based on a
+ * Hierarchical Navigable Small World graph.
+ *
+ * Each point is inserted into a randomly chosen number of layers. Upper layers
+ * are sparse and are used to quickly find a good entry point for the dense
+ * bottom layer, where the actual search takes place. Query cost grows roughly
+ * logarithmically with the number of points.
+ *
+ * Reference: Malkov, Yashunin: Efficient and robust approximate nearest neighbor
+ * search using Hierarchical Navigable Small World graphs, 2016,
+ * https://arxiv.org/abs/1603.09320
+ *
+ * Usage:
+ *
+ *   HnswIndex<FeaturePoint<float>> index(kCentroids, 16, 200, 50, 0);
+ *   const auto kNearestIndex = index.NearestNeighbor(kQueryPoint);
+ */
+template <class PointType>
+class HnswIndex {
+public:
+  using ScalarType = typename HnswPointTraits<PointType>::ScalarType;
+
+  /**
+   * Constructor. Builds the index over a copy of the given points.
+   *
+   * @param kPointSet Points to index. All are expected to have the same number of dimensions.
+   * @param kMaxConnections Number of neighbors each point is connected to on the upper layers
+   * (twice as many on the bottom layer). Usually referred to as M. A good value may be 16.
+   * @param kEfConstruction Size of the candidate list used while building the graph.
+   * Larger values give a better graph at the cost of build time. A good value may be 200.
+   * @param kEfSearch Size of the candidate list used for queries. Larger values increase
+   * recall at the cost of query time. A good value may be 50.
+   * @param kSeed For the random selection of layers.
+   */
+  HnswIndex
+    (const std::vector<PointType>& kPointSet,
+     const size_t kMaxConnections,
+     const size_t kEfConstruction,
+     const size_t kEfSearch,
+     const int kSeed);
+
+  /**
+   * Add a single point to the index.
+   *
+   * @return The index of the inserted point.
+   */
+  size_t Insert(const PointType& kPoint);
+
+  /**
+   * Get the index of the (approximately) nearest point, where the distance measure
+   * is the L2 norm. Equivalent to NearestNeighbor in feature_point.hpp.
+   *
+   * Throws an instance of std::runtime_error if the index is empty.
+   */
+  size_t NearestNeighbor(const PointType& kQueryPoint) const;
+
+  /**
+   * Get the indices of the (approximately) kNumNeighbors nearest points, nearest first.
+   *
+   * At least kNumNeighbors candidates are considered, even if the configured
+   * search effort is smaller.
+   */
+  std::vector<size_t> NearestNeighbors
+    (const PointType& kQueryPoint, const size_t kNumNeighbors) const;
+
+  /**
+   * Same as above, but with the given size of the candidate list instead of EfSearch(),
+   * so concurrent queries on a shared index can trade recall against query time.
+   */
+  std::vector<size_t> NearestNeighbors
+    (const PointType& kQueryPoint, const size_t kNumNeighbors, const size_t kEfSearch) const;
+
+  /**
+   * Number of points in the index.
+   */
+  size_t Size() const {return this->points_.size();}
+
+  /**
+   * The indexed point with the given index.
+   */
+  const PointType& Point(const size_t kIndex) const {return this->points_[kIndex];}
+
+  size_t MaxConnections() const {return this->kMaxConnections_;}
+  size_t EfConstruction() const {return this->kEfConstruction_;}
+
+  /**
+   * Size of the candidate list used for queries.
+   */
+  size_t EfSearch() const {return this->ef_search_;}
+
+  /**
+   * Trade recall against query time without rebuilding the index.
+   */
+  void SetEfSearch(const size_t kEfSearch) {this->ef_search_ = kEfSearch;}
+
+  /**
+   * Write the index to a binary file.
+   *
+   * In case the given file already exists it is overwritten.
+   *
+   * @return True, if writing was successful.
+   */
+  bool WriteToBinary(const std::string& kPath) const;
+
+  /**
+   * Read an index from a binary file as written by WriteToBinary.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  static HnswIndex<PointType> ReadFromBinary(const std::string& kPath);
+
+private:
+  // Pairs of distance and point index
+  using Candidate = std::pair<ScalarType, size_t>;
+
+  // Points visited by a search, marked with the epoch of the search instead of cleared
+  // for each search. The buffer grows to the size of the largest index searched.
+  struct VisitedEpochs {
+    std::vector<uint32_t> epochs;
+    uint32_t epoch = 0;
+
+    void Start(const size_t kNumPoints) {
+      if (this->epochs.size()<kNumPoints) {this->epochs.resize(kNumPoints, 0);}
+      if (++this->epoch==0) {
+        std::fill(this->epochs.begin(), this->epochs.end(), 0);
+        this->epoch = 1;
+      }
+    }
+
+    // False if the point was visited before
+    bool Visit(const size_t kIndex) {
+      if (this->epochs[kIndex]==this->epoch) {return false;}
+      this->epochs[kIndex] = this->epoch;
+      return true;
+    }
+  };
+
+  size_t kMaxConnections_;
+  size_t kEfConstruction_;
+  size_t ef_search_;
+  double kLevelMultiplier_;
+  std::mt19937 engine_;
+
+  std::vector<PointType> points_;
+  // For each point and each layer the point is part of, the indices of its neighbors
+  std::vector<std::vector<std::vector<size_t>>> neighbors_;
+  size_t entry_point_;
+  int max_level_;
+
+  HnswIndex
+    (const size_t kMaxConnections,
+     const size_t kEfConstruction,
+     const size_t kEfSearch,
+     const int kSeed);
+
+  int SampleLevel();
+
+  size_t GreedySearchUpperLayers
+    (const PointType& kQueryPoint, const int kTargetLevel) const;
+
+  std::vector<Candidate> SearchLayer
+    (const PointType& kQueryPoint,
+     const size_t kEntryPoint,
+     const size_t kEf,
+     const int kLevel) const;
+
+  std::vector<size_t> SelectNeighbors
+    (std::vector<Candidate> candidates, const size_t kNumNeighbors) const;
+
+  size_t MaxConnectionsOnLevel(const int kLevel) const;
+
+  static ScalarType SquaredDistance
+    (const PointType& kPoint1, const PointType& kPoint2)
+    {return HnswPointTraits<PointType>::SquaredDistance(kPoint1, kPoint2);}
+};
+
+} // namespace igg
+
+#include "hnsw_index.ipp"
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_HNSW_INDEX_HNSW_INDEX_HPP_
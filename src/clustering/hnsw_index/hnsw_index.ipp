@@ -0,0 +1,414 @@
+
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "tools/linalg.hpp"
+
+
+namespace igg {
+
+template <class PointType>
+HnswIndex<PointType>::HnswIndex
+  (const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const size_t kEfSearch,
+   const int kSeed):
+  kMaxConnections_{kMaxConnections},
+  kEfConstruction_{kEfConstruction},
+  ef_search_{kEfSearch},
+  kLevelMultiplier_{1.0/std::log(static_cast<double>(std::max<size_t>(kMaxConnections, 2)))},
+  engine_(kSeed),
+  entry_point_{0},
+  max_level_{-1}
+{
+  if (kMaxConnections<2)
+    {throw std::invalid_argument("Number of connections must be at least 2.");}
+}
+
+
+template <class PointType>
+HnswIndex<PointType>::HnswIndex
+  (const std::vector<PointType>& kPointSet,
+   const size_t kMaxConnections,
+   const size_t kEfConstruction,
+   const size_t kEfSearch,
+   const int kSeed):
+  HnswIndex(kMaxConnections, kEfConstruction, kEfSearch, kSeed)
+{
+  this->points_.reserve(kPointSet.size());
+  this->neighbors_.reserve(kPointSet.size());
+  for (const auto& kPoint: kPointSet) {
+    this->Insert(kPoint);
+  }
+}
+
+
+template <class PointType>
+size_t HnswIndex<PointType>::Insert(const PointType& kPoint)
+{
+  if (!this->points_.empty() &&
+      HnswPointTraits<PointType>::Dimension(kPoint)!=HnswPointTraits<PointType>::Dimension(this->points_[0]))
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  const size_t kNewIndex = this->points_.size();
+  const int kLevel = this->SampleLevel();
+
+  this->points_.emplace_back(kPoint);
+  this->neighbors_.emplace_back(kLevel+1);
+
+  if (kNewIndex==0) {
+    // First point, nothing to connect to
+    this->entry_point_ = kNewIndex;
+    this->max_level_ = kLevel;
+    return kNewIndex;
+  }
+
+  // Descend through the layers above the new point's top layer
+  size_t entry_point = this->GreedySearchUpperLayers(kPoint, kLevel);
+
+  // Connect the point on each of its layers, starting from the top
+  for (int level = std::min(kLevel, this->max_level_); level>=0; level--) {
+    const auto kCandidates = this->SearchLayer(kPoint, entry_point, this->kEfConstruction_, level);
+    const auto kSelected = this->SelectNeighbors(kCandidates, this->kMaxConnections_);
+    this->neighbors_[kNewIndex][level] = kSelected;
+
+    // Add reverse connections, prune lists which became too long
+    const auto kMaxConnectionsOnLevel = this->MaxConnectionsOnLevel(level);
+    for (const auto kNeighbor: kSelected) {
+      auto& neighbor_list = this->neighbors_[kNeighbor][level];
+      neighbor_list.emplace_back(kNewIndex);
+      if (neighbor_list.size()>kMaxConnectionsOnLevel) {
+        std::vector<Candidate> neighbor_candidates;
+        neighbor_candidates.reserve(neighbor_list.size());
+        for (const auto kIndex: neighbor_list) {
+          neighbor_candidates.emplace_back
+            (SquaredDistance(this->points_[kNeighbor], this->points_[kIndex]), kIndex);
+        }
+        neighbor_list = this->SelectNeighbors(neighbor_candidates, kMaxConnectionsOnLevel);
+      }
+    }
+
+    // Closest candidate is the entry point for the next layer
+    entry_point = kCandidates.front().second;
+  }
+
+  if (kLevel>this->max_level_) {
+    this->max_level_ = kLevel;
+    this->entry_point_ = kNewIndex;
+  }
+
+  return kNewIndex;
+}
+
+
+template <class PointType>
+size_t HnswIndex<PointType>::NearestNeighbor(const PointType& kQueryPoint) const
+{
+  return this->NearestNeighbors(kQueryPoint, 1)[0];
+}
+
+
+template <class PointType>
+std::vector<size_t> HnswIndex<PointType>::NearestNeighbors
+  (const PointType& kQueryPoint, const size_t kNumNeighbors) const
+{
+  return this->NearestNeighbors(kQueryPoint, kNumNeighbors, this->ef_search_);
+}
+
+
+template <class PointType>
+std::vector<size_t> HnswIndex<PointType>::NearestNeighbors
+  (const PointType& kQueryPoint, const size_t kNumNeighbors, const size_t kEfSearch) const
+{
+  if (this->points_.empty())
+    {throw std::runtime_error("Tried to search empty index.");}
+
+  const auto kEntryPoint = this->GreedySearchUpperLayers(kQueryPoint, 0);
+  const auto kCandidates = this->SearchLayer
+    (kQueryPoint, kEntryPoint, std::max(kEfSearch, kNumNeighbors), 0);
+
+  const auto kNumResults = std::min(kNumNeighbors, kCandidates.size());
+  std::vector<size_t> nearest_neighbors;
+  nearest_neighbors.reserve(kNumResults);
+  for (size_t index = 0; index<kNumResults; index++) {
+    nearest_neighbors.emplace_back(kCandidates[index].second);
+  }
+
+  return nearest_neighbors;
+}
+
+
+template <class PointType>
+int HnswIndex<PointType>::SampleLevel()
+{
+  // Exponentially decaying probability of reaching a higher layer
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double kSample = std::max(uniform(this->engine_), std::numeric_limits<double>::min());
+  return static_cast<int>(std::floor(-std::log(kSample)*this->kLevelMultiplier_));
+}
+
+
+template <class PointType>
+size_t HnswIndex<PointType>::GreedySearchUpperLayers
+  (const PointType& kQueryPoint, const int kTargetLevel) const
+{
+  size_t current = this->entry_point_;
+  ScalarType current_distance = SquaredDistance(kQueryPoint, this->points_[current]);
+
+  for (int level = this->max_level_; level>kTargetLevel; level--) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (const auto kNeighbor: this->neighbors_[current][level]) {
+        const auto kDistance = SquaredDistance(kQueryPoint, this->points_[kNeighbor]);
+        if (kDistance<current_distance) {
+          current_distance = kDistance;
+          current = kNeighbor;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  return current;
+}
+
+
+template <class PointType>
+std::vector<typename HnswIndex<PointType>::Candidate> HnswIndex<PointType>::SearchLayer
+  (const PointType& kQueryPoint,
+   const size_t kEntryPoint,
+   const size_t kEf,
+   const int kLevel) const
+{
+  // Reused by all searches of this thread, a point is visited if marked with the current epoch
+  thread_local VisitedEpochs visited;
+  visited.Start(this->points_.size());
+  visited.Visit(kEntryPoint);
+
+  // Points still to expand, closest on top
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+  // Best points found so far, farthest on top
+  std::priority_queue<Candidate> results;
+
+  const auto kEntryDistance = SquaredDistance(kQueryPoint, this->points_[kEntryPoint]);
+  candidates.emplace(kEntryDistance, kEntryPoint);
+  results.emplace(kEntryDistance, kEntryPoint);
+
+  while (!candidates.empty()) {
+    const auto kCandidate = candidates.top();
+    if (kCandidate.first>results.top().first && results.size()>=kEf)
+      {break;} // All remaining candidates are farther than the worst result
+    candidates.pop();
+
+    for (const auto kNeighbor: this->neighbors_[kCandidate.second][kLevel]) {
+      if (!visited.Visit(kNeighbor))
+        {continue;}
+
+      const auto kDistance = SquaredDistance(kQueryPoint, this->points_[kNeighbor]);
+      if (results.size()<kEf || kDistance<results.top().first) {
+        candidates.emplace(kDistance, kNeighbor);
+        results.emplace(kDistance, kNeighbor);
+        if (results.size()>kEf)
+          {results.pop();}
+      }
+    }
+  }
+
+  // Return in ascending order of distance
+  std::vector<Candidate> sorted_results(results.size());
+  for (auto it = sorted_results.rbegin(); it!=sorted_results.rend(); it++) {
+    *it = results.top();
+    results.pop();
+  }
+
+  return sorted_results;
+}
+
+
+template <class PointType>
+std::vector<size_t> HnswIndex<PointType>::SelectNeighbors
+  (std::vector<Candidate> candidates, const size_t kNumNeighbors) const
+{
+  std::sort(candidates.begin(), candidates.end());
+
+  // Heuristic from the reference: prefer candidates that are closer to the query than
+  // to any neighbor selected so far, this keeps connections between distant regions
+  std::vector<size_t> selected;
+  std::vector<size_t> discarded;
+  selected.reserve(kNumNeighbors);
+
+  for (const auto& kCandidate: candidates) {
+    if (selected.size()>=kNumNeighbors)
+      {break;}
+
+    bool keep = true;
+    for (const auto kSelected: selected) {
+      if (SquaredDistance(this->points_[kCandidate.second], this->points_[kSelected])<kCandidate.first) {
+        keep = false;
+        break;
+      }
+    }
+
+    if (keep) {selected.emplace_back(kCandidate.second);}
+    else {discarded.emplace_back(kCandidate.second);}
+  }
+
+  // Fill up with the closest discarded candidates to keep the graph well connected
+  for (size_t index = 0; index<discarded.size() && selected.size()<kNumNeighbors; index++) {
+    selected.emplace_back(discarded[index]);
+  }
+
+  return selected;
+}
+
+
+template <class PointType>
+size_t HnswIndex<PointType>::MaxConnectionsOnLevel(const int kLevel) const
+{
+  // The bottom layer is denser, as recommended in the reference
+  return kLevel==0 ? 2*this->kMaxConnections_ : this->kMaxConnections_;
+}
+
+
+template <class PointType>
+typename HnswPointTraits<PointType>::ScalarType HnswPointTraits<PointType>::SquaredDistance
+  (const PointType& kPoint1, const PointType& kPoint2)
+{
+  return SquaredL2Distance<PointType>(kPoint1, kPoint2);
+}
+
+
+template <class PointType>
+void HnswPointTraits<PointType>::Write(std::ostream& file, const PointType& kPoint)
+{
+  file.write(reinterpret_cast<const char*>(kPoint.data()), sizeof(ScalarType)*kPoint.size());
+}
+
+
+template <class PointType>
+PointType HnswPointTraits<PointType>::Read(std::istream& file, const size_t kDimension)
+{
+  PointType point(kDimension);
+  file.read(reinterpret_cast<char*>(point.data()), sizeof(ScalarType)*kDimension);
+  return point;
+}
+
+
+template <class PointType>
+bool HnswIndex<PointType>::WriteToBinary(const std::string& kPath) const
+{
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  size_t num_points = this->points_.size();
+  size_t num_features = num_points>0 ? HnswPointTraits<PointType>::Dimension(this->points_[0]) : 0;
+  size_t max_connections = this->kMaxConnections_;
+  size_t ef_construction = this->kEfConstruction_;
+  size_t ef_search = this->ef_search_;
+  size_t entry_point = this->entry_point_;
+  int max_level = this->max_level_;
+
+  // Write header information
+  file.write(reinterpret_cast<char*>(&num_points), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_features), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&max_connections), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&ef_construction), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&ef_search), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&entry_point), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&max_level), sizeof(int));
+
+  // Write points
+  for (const auto& kPoint: this->points_) {
+    HnswPointTraits<PointType>::Write(file, kPoint);
+  }
+
+  // Write graph (number of layers, then number of neighbors and neighbors for each layer)
+  for (const auto& kLayers: this->neighbors_) {
+    size_t num_layers = kLayers.size();
+    file.write(reinterpret_cast<char*>(&num_layers), sizeof(size_t));
+    for (const auto& kNeighbors: kLayers) {
+      size_t num_neighbors = kNeighbors.size();
+      file.write(reinterpret_cast<char*>(&num_neighbors), sizeof(size_t));
+      file.write(reinterpret_cast<const char*>(kNeighbors.data()), sizeof(size_t)*num_neighbors);
+    }
+  }
+
+  return true;
+}
+
+
+template <class PointType>
+HnswIndex<PointType> HnswIndex<PointType>::ReadFromBinary(const std::string& kPath)
+{
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  // Read header information
+  size_t num_points = 0;
+  size_t num_features = 0;
+  size_t max_connections = 0;
+  size_t ef_construction = 0;
+  size_t ef_search = 0;
+  size_t entry_point = 0;
+  int max_level = -1;
+  file.read(reinterpret_cast<char*>(&num_points), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&num_features), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&max_connections), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&ef_construction), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&ef_search), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&entry_point), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&max_level), sizeof(int));
+  if (!file) {
+    throw std::runtime_error("Cannot read header of file "+kPath+".");
+  }
+
+  // Seed is only used for further insertions, derive it from the current size
+  HnswIndex<PointType> index
+    (max_connections, ef_construction, ef_search, static_cast<int>(num_points));
+  index.entry_point_ = entry_point;
+  index.max_level_ = max_level;
+
+  // Read points
+  index.points_.reserve(num_points);
+  for (size_t point_index = 0; point_index<num_points; point_index++) {
+    index.points_.emplace_back(HnswPointTraits<PointType>::Read(file, num_features));
+  }
+
+  // Read graph
+  index.neighbors_.reserve(num_points);
+  for (size_t point_index = 0; point_index<num_points; point_index++) {
+    size_t num_layers = 0;
+    file.read(reinterpret_cast<char*>(&num_layers), sizeof(size_t));
+    std::vector<std::vector<size_t>> layers(num_layers);
+    for (auto& neighbors: layers) {
+      size_t num_neighbors = 0;
+      file.read(reinterpret_cast<char*>(&num_neighbors), sizeof(size_t));
+      neighbors.resize(num_neighbors);
+      file.read(reinterpret_cast<char*>(neighbors.data()), sizeof(size_t)*num_neighbors);
+    }
+    index.neighbors_.emplace_back(std::move(layers));
+  }
+
+  if (!file) {
+    throw std::runtime_error("File "+kPath+" ended unexpectedly.");
+  }
+
+  return index;
+}
+
+} // namespace igg
@@ -35,7 +35,7 @@ public:
 
     void SetCentroidValue(const int &index, const T &value);
     int CentroidDimension();
-    FeaturePoint<T> GetCentroid();
+    const FeaturePoint<T> &GetCentroid() const;
     void SetCentroid(FeaturePoint<T> centroid)
     {
         centroid_ = centroid;
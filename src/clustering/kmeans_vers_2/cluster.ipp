@@ -35,7 +35,7 @@ bool Cluster<T>::DeletePoint(const int &pointId)
 }
 
 template <class T>
-FeaturePoint<T> Cluster<T>::GetCentroid()
+const FeaturePoint<T> &Cluster<T>::GetCentroid() const
 {
     return centroid_;
 }
@@ -19,6 +19,8 @@ private:
     std::vector<T> data_;
 
 public:
+    using value_type = T;
+
     FeaturePoint() = default;
     // Keyword explicit forbids implicit conversion (e.g. FeaturePoint point = 1 is not allowed)
     explicit FeaturePoint(const int &id) : pointId_{id} {}
@@ -49,6 +51,17 @@ public:
         return data_[index];
     }
 
+    // Vector-like access, allows usage with the generic functions in tools/linalg.hpp
+    size_t size() const
+    {
+        return data_.size();
+    }
+
+    const T &operator[](const size_t index) const
+    {
+        return data_[index];
+    }
+
     void AppendValue(const T &value)
     {
         data_.emplace_back(value);
@@ -2,8 +2,9 @@
 #define CPP_FINAL_PROJECT_CLUSTERING_KMEANS_VERS_2_KMEANS_HPP_
 
 
+#include <vector>
+
 #include "cluster.hpp"
-#include <eigen3/Eigen/Dense>
 
 #include "feature_point.hpp"
 
@@ -23,12 +24,18 @@ private:
 
     std::vector<Cluster<T>> clusters_;
 
-    // Matrix of bools to store and lookup cluster assignments
-    // One row for each cluster, one column for each data point
-    // [i, j]==true <=> point j is assigned to cluster i
-    // Note that it is in principle possible to assign a point to multiple clusters,
-    // therefore we need to maintain this matrix properly
-    Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic> responsibility_; // Use Eigen::Dynamic as size is not known at compile time
+    static constexpr int kUnassigned = -1;
+
+    // Cluster id of each data point, kUnassigned before the first iteration
+    std::vector<int> labels_;
+
+    // Sum and number of the points assigned to each cluster
+    // Only updated for points which change their assignment, so an iteration does not
+    // need to visit all points again to update the centroids
+    std::vector<std::vector<double>> sums_;
+    std::vector<size_t> counts_;
+
+    void UpdateSum(const FeaturePoint<T> &point, const int cluster_id, const double sign);
 
 public:
     KMeans() = default;
@@ -36,14 +43,17 @@ public:
     ~KMeans() = default;
 
     void RunKMeans(const std::vector<FeaturePoint<T>> &point_set);
+    // Run with the given points as initial centroids, e.g. selected by a function in clustering/seeding.hpp
+    // If no indices are given, K-Means++ is used
+    void RunKMeans(const std::vector<FeaturePoint<T>> &point_set, const std::vector<size_t> &initial_indices);
     int NearestCluster(const FeaturePoint<T> &point, float &min_dist);
     float KNorm(const FeaturePoint<T> &centroid, const FeaturePoint<T> &point);
     void InitCluster(const std::vector<FeaturePoint<T>> &point_set);
-    void ReComputeCentroid(const std::vector<FeaturePoint<T>> &point_set);
+    void InitCluster(const std::vector<FeaturePoint<T>> &point_set, const std::vector<size_t> &initial_indices);
+    void ReComputeCentroid(const std::vector<bool> &changed_clusters);
     void PrintClusterPointIds();
     void PrintClusterCentroid();
     std::vector<std::vector<T>> GetCentroids();
-    void PrintResponsibilityMatrix();
 };
 
 } // namespave vers_2
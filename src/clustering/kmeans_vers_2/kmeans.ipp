@@ -2,10 +2,10 @@
 
 #include <cmath>
 #include <algorithm>
-#include <eigen3/Eigen/Dense>
 #include <random>
 
 #include "tools/terminalout.hpp"
+#include "clustering/seeding.hpp"
 
 
 namespace igg
@@ -13,11 +13,14 @@ namespace igg
 namespace vers_2
 {
 
+template <class T>
+constexpr int KMeans<T>::kUnassigned;
+
 template <class T>
 KMeans<T>::KMeans(const size_t K, const int iterations, const size_t total_points) : K_{K}, iters_{iterations}, total_points_{total_points}
 {
     clusters_.reserve(K_);
-    responsibility_.setConstant(K_, total_points_, false); // Initially, no point is assigned to any cluster
+    labels_.assign(total_points_, kUnassigned); // Initially, no point is assigned to any cluster
 }
 
 template <class T>
@@ -42,6 +45,13 @@ int KMeans<T>::NearestCluster(const FeaturePoint<T> &point, float& min_dist)
 
 template <class T>
 void KMeans<T>::RunKMeans(const std::vector<FeaturePoint<T>> &point_set)
+{
+    // Initial centroids are selected using K-Means++
+    RunKMeans(point_set, {});
+}
+
+template <class T>
+void KMeans<T>::RunKMeans(const std::vector<FeaturePoint<T>> &point_set, const std::vector<size_t> &initial_indices)
 {
     std::cout << "Point set size: " << point_set.size() << std::endl;
     std::cout << "K: " << K_ << std::endl;
@@ -54,66 +64,63 @@ void KMeans<T>::RunKMeans(const std::vector<FeaturePoint<T>> &point_set)
     total_points_ = point_set.size();
 
     // Initializing clusters
-    InitCluster(point_set);
+    InitCluster(point_set, initial_indices);
     // PrintClusterCentroid();
     std::cout << "Clusters initialized: " << clusters_.size() << std::endl;
 
     std::cout << "Running K-Means clustering" << std::endl;
 
+    // Initially, no point is assigned to any cluster
+    const size_t dimensions = point_set[0].size();
+    labels_.assign(total_points_, kUnassigned);
+    sums_.assign(K_, std::vector<double>(dimensions, 0.0));
+    counts_.assign(K_, 0);
+    std::vector<bool> changed_clusters(K_, false);
+
     int iter = 0;
 
     while (true)
     {
         std::cout << "Start iteration: " << iter << "\n";
 
-        bool done = true; // Set to false as soon as we update some cluster assignments
+        size_t changed_points = 0; // Number of points with updated cluster assignment
 
         for (size_t i = 0; i < total_points_; i++)
         {
             // Find cluster with nearest centroid
             float min = 0.0;
             // Function will also requires to return minimum distance by reference, but it is not used here
-            int neareast_cluster_id = NearestCluster(point_set[i], min);
+            const int nearest_cluster_id = NearestCluster(point_set[i], min);
+            const int current_cluster_id = labels_[i];
 
-            // Check integrity of resposibility matrix
-            int count = responsibility_.col(i).count();
-            if (count > 1)
+            if (nearest_cluster_id == current_cluster_id)
             {
-                throw std::runtime_error("Something's wrong, count should be 0 or 1. Each point should belong to only one cluster.");
+                // No need to update cluster, current assignment equals new assigment
+                continue;
             }
 
-            if (count == 1)
+            // Move the point from its current cluster (if any) to the nearest one
+            if (current_cluster_id != kUnassigned)
             {
-                // Get the current cluster id of this point
-                // It is the ith column's maximum's index
-                Eigen::Matrix<bool, Eigen::Dynamic, Eigen::Dynamic>::Index max_row; // Set in following line
-                responsibility_.col(i).maxCoeff(&max_row);
-
-                int current_cluster_id = max_row;
-                if (neareast_cluster_id != current_cluster_id)
-                {
-                    responsibility_(current_cluster_id, i) = false; // Unset current cluster assigment
-                    responsibility_(neareast_cluster_id, i) = true; // Set new cluster assigment
-                    done = false; // Something was updated, we need to continue to iterate
-                }
-                else
-                {
-                    // No need to update cluster, current assignment equals new assigment
-                    continue;
-                }
-            }
-            else
-            {
-                // This point has no current assignment, it is assigned to a cluster for the first time
-                responsibility_(neareast_cluster_id, i) = true;
-                done = false; // Something was updated, we need to continue to iterate
+                UpdateSum(point_set[i], current_cluster_id, -1.0);
+                changed_clusters[current_cluster_id] = true;
             }
+            UpdateSum(point_set[i], nearest_cluster_id, 1.0);
+            changed_clusters[nearest_cluster_id] = true;
+
+            labels_[i] = nearest_cluster_id;
+            changed_points++;
         }
 
+        std::cout << "Points with updated assignment: " << changed_points << "\n";
+
+        const bool done = (changed_points == 0);
+
         // Recompute centroids
         if (!done)
         {
-            ReComputeCentroid(point_set);
+            ReComputeCentroid(changed_clusters);
+            std::fill(changed_clusters.begin(), changed_clusters.end(), false);
         }
 
         if (done || iter >= iters_)
@@ -127,95 +134,79 @@ void KMeans<T>::RunKMeans(const std::vector<FeaturePoint<T>> &point_set)
 }
 
 template <class T>
-void KMeans<T>::InitCluster(const std::vector<FeaturePoint<T>> &point_set)
+void KMeans<T>::UpdateSum(const FeaturePoint<T> &point, const int cluster_id, const double sign)
 {
-    // Randomly choose centroid for all clusters for first iteration using K-Means++ initialization
-    // References:
-    // https://stackoverflow.com/questions/5466323/how-exactly-does-k-means-work
-    // https://www.fluentcpp.com/2019/05/24/how-to-fill-a-cpp-collection-with-random-values
+    std::vector<double> &sum = sums_[cluster_id];
+    const size_t dimensions = sum.size();
+    for (size_t j = 0; j < dimensions; j++)
+    {
+        sum[j] += sign * static_cast<double>(point[j]);
+    }
 
+    if (sign > 0.0)
+    {
+        counts_[cluster_id]++;
+    }
+    else
+    {
+        counts_[cluster_id]--;
+    }
+}
 
-    // For the first cluster, all points have equal probability to be drawn as the centroid
-    // For this we need to sample integers from a uniform distribution
+template <class T>
+void KMeans<T>::InitCluster(const std::vector<FeaturePoint<T>> &point_set)
+{
+    // Randomly choose centroid for all clusters for first iteration using K-Means++ initialization
+    // The distance of each point to its nearest centroid is updated incrementally, see clustering/seeding.hpp
     std::random_device random_device;  // Will be used to obtain a seed for the random number engine
     std::mt19937 random_generator(random_device()); // Standard mersenne_twister_engine seeded with random_device()
-    std::uniform_int_distribution<int> uniform_int_distribution(0, total_points_ - 1);
-
-    int point_index = uniform_int_distribution(random_generator); // A random integer between 0 (inclusive) and total_points_ (exclusive)
-    Cluster<float> cluster(0, point_set[point_index]);
-    clusters_.emplace_back(cluster);
 
-    // Sample remaining centroids, points have probability inverse to the minimum distance to the already existing clusters
-    // For this we need to sample floats from a uniform distribution
-    std::uniform_real_distribution<float> uniform_float_distribution(0.0, 1.0);
+    InitCluster(point_set, SampleCentroidIndicesKmeansPlusPlus(point_set, K_, random_generator));
+}
 
-    size_t k = 1; // Cluster index, starting with 1 as first centroid has been sampled already
-    while (k < K_)
+template <class T>
+void KMeans<T>::InitCluster(const std::vector<FeaturePoint<T>> &point_set, const std::vector<size_t> &initial_indices)
+{
+    if (initial_indices.empty())
     {
-        // For each point, get the minimum distance to already initialized clusters
-        std::vector<float> min_dist;
-        float sum = 0.0f;
-        float min = 0.0f;
-        for (size_t i = 0; i < total_points_; i++)
-        {
-            NearestCluster(point_set[i], min);
-            sum += min;
-            min_dist.emplace_back(min);
-        }
-
-        // From this, compute a cumulative probability for each point
-        std::vector<float> cumulative_probs;
-        float cum_sum = 0.0f;
-        for (size_t i = 0; i < min_dist.size(); i++)
-        {
-            min_dist[i] = min_dist[i] / sum;
-            cum_sum += min_dist[i];
-            cumulative_probs.push_back(cum_sum);
-        }
-
-        // Sample a float between 0 and 1
-        float probability = uniform_float_distribution(random_generator);
+        InitCluster(point_set);
+        return;
+    }
 
-        for (size_t i = 0; i < cumulative_probs.size(); i++)
-        {
-            if (probability < cumulative_probs[i])
-            {
-                // Accept this point as a cluster centroid
-                Cluster<float> cluster(k, point_set[i]);
-                clusters_.emplace_back(cluster);
-                k++;
-                break;
-            }
-        }
+    if (initial_indices.size() != K_)
+    {
+        throw std::runtime_error("Error: Number of initial centroids does not match number of clusters.");
+    }
 
+    clusters_.clear();
+    for (size_t k = 0; k < K_; k++)
+    {
+        Cluster<T> cluster(k, point_set[initial_indices[k]]);
+        clusters_.emplace_back(cluster);
     }
 }
 
 template <class T>
-void KMeans<T>::ReComputeCentroid(const std::vector<FeaturePoint<T>> &point_set)
+void KMeans<T>::ReComputeCentroid(const std::vector<bool> &changed_clusters)
 {
+    // Only clusters whose assignments changed need a new centroid, the sums are up to date
     for (size_t i = 0; i < K_; i++)
     {
-
-        int total_points_cluster = responsibility_.row(i).count();
-        std::cout << "Total points in cluster " << i << ": " << total_points_cluster << std::endl;
-        std::vector<float> vsum(point_set[0].GetDimensions(), 0.0f);
-        for (int j = 0; j < responsibility_.cols(); j++)
+        if (!changed_clusters[i] || counts_[i] == 0)
         {
+            // Keep centroid of empty clusters
+            continue;
+        }
 
-            if (responsibility_(i, j) == true)
-            {
-                std::vector<T> data = point_set[j].GetData();
-                // typename std::vector<T>::iterator it = point_set[j].begin();
-                //Reference: https://stackoverflow.com/questions/28607912/sum-values-of-2-vectors/28607985
-                std::transform(vsum.begin(), vsum.end(), data.begin(), vsum.begin(), std::plus<float>());
-            }
+        const double scale = 1.0 / static_cast<double>(counts_[i]);
+        std::vector<T> mean(sums_[i].size());
+        for (size_t j = 0; j < mean.size(); j++)
+        {
+            mean[j] = static_cast<T>(sums_[i][j] * scale);
         }
-        //Reference: https://stackoverflow.com/questions/41030911/how-to-multiply-a-vector-and-scalar-in-c
-        std::transform(vsum.begin(), vsum.end(), vsum.begin(),
-                       [total_points_cluster](T i) { return static_cast<float>(i) * 1 / total_points_cluster; });
+
         FeaturePoint<T> point(1);
-        point.SetVector(vsum);
+        point.SetVector(mean);
 
         clusters_[i].SetCentroid(point);
     }
@@ -229,7 +220,8 @@ float KMeans<T>::KNorm(const FeaturePoint<T> &centroid, const FeaturePoint<T> &p
     {
         for (int i = 0; i < centroid.GetDimensions(); i++)
         {
-            sum += pow((centroid.At(i) - point.At(i)), 2);
+            const float difference = centroid.At(i) - point.At(i);
+            sum += difference * difference;
         }
     }
     else
@@ -262,9 +254,9 @@ void KMeans<T>::PrintClusterPointIds()
     for (int i = 0; i < K_; i++)
     {
         std::cout << "Points in cluster: " << i << " : ";
-        for (int j = 0; j < responsibility_.cols(); j++)
+        for (size_t j = 0; j < labels_.size(); j++)
         {
-            if (responsibility_(i, j) == true)
+            if (labels_[j] == static_cast<int>(i))
             {
                 std::cout << "\t " << j;
             }
@@ -292,11 +284,5 @@ std::vector<std::vector<T>> KMeans<T>::GetCentroids()
     return centroids;
 }
 
-template <class T>
-void KMeans<T>::PrintResponsibilityMatrix()
-{
-    std::cout<<"Responsibility Matrix: \n"<<responsibility_<<std::endl;
-}
-
 } // namespace vers_2
 } // namespace igg
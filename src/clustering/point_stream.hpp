@@ -0,0 +1,84 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_POINT_STREAM_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_POINT_STREAM_HPP_
+
+
+#include <algorithm>
+#include <vector>
+
+#include "feature_point.hpp"
+
+
+namespace igg {
+
+/**
+ * Sequential access to a point set in chunks, so algorithms which only need a
+ * few passes over the data do not require all points in memory at once.
+ *
+ * Usage:
+ *
+ *   stream.Rewind();
+ *   for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+ *     for (const auto kPoint: chunk) {...}
+ *   }
+ */
+template <class T>
+class PointStream {
+public:
+  virtual ~PointStream() = default;
+
+  /**
+   * Total number of points.
+   */
+  virtual size_t Size() const = 0;
+
+  /**
+   * Start again from the first point.
+   */
+  virtual void Rewind() = 0;
+
+  /**
+   * Get the next points in the order of the point set. The pointers stay valid
+   * until the next call of NextChunk() or Rewind().
+   *
+   * @return Pointers to the points, empty if all points have been visited.
+   */
+  virtual std::vector<FeaturePoint<T> const *> NextChunk() = 0;
+};
+
+
+/**
+ * Stream over a point set which is already in memory, mostly for testing.
+ * Refers to the given point set, which must outlive the stream.
+ */
+template <class T>
+class InMemoryPointStream: public PointStream<T> {
+public:
+  InMemoryPointStream
+    (const std::vector<FeaturePoint<T>>& kPointSet, const size_t kChunkSize):
+    kPointSet_{kPointSet},
+    kChunkSize_{std::max(kChunkSize, static_cast<size_t>(1))},
+    position_{0}
+  {}
+
+  size_t Size() const override {return this->kPointSet_.size();}
+
+  void Rewind() override {this->position_ = 0;}
+
+  std::vector<FeaturePoint<T> const *> NextChunk() override {
+    const auto kEnd = std::min(this->position_+this->kChunkSize_, this->kPointSet_.size());
+    std::vector<FeaturePoint<T> const *> chunk;
+    chunk.reserve(kEnd-std::min(this->position_, kEnd));
+    for (; this->position_<kEnd; this->position_++)
+      {chunk.emplace_back(&this->kPointSet_[this->position_]);}
+    return chunk;
+  }
+
+private:
+  const std::vector<FeaturePoint<T>>& kPointSet_;
+  const size_t kChunkSize_;
+  size_t position_;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_POINT_STREAM_HPP_
@@ -0,0 +1,91 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_SEEDING_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_SEEDING_HPP_
+
+/**
+ * @file seeding.hpp
+ *
+ * Selection of initial centroids for the K-means variants.
+ *
+ * All functions return indices into the given point set, so they can be used
+ * with any point type providing size() and operator[], e.g. FeaturePoint.
+ */
+
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace igg {
+
+enum class SeedingMethod {
+  kRandom, // Uniformly sampled points
+  kKmeansPlusPlus, // Arthur, Vassilvitskii: k-means++: The Advantages of Careful Seeding, 2007
+  kKmeansParallel // Bahmani et al.: Scalable K-Means++, 2012 (k-means||)
+};
+
+/**
+ * Parse a seeding method from its name as used on the command line,
+ * i.e. "random", "kmeans++" or "kmeans||".
+ *
+ * Throws an instance of std::invalid_argument if the name is not recognized.
+ */
+SeedingMethod SeedingMethodFromString(const std::string& kName);
+
+/**
+ * Select kNumClusters different points as initial centroids using the given method.
+ *
+ * Throws an instance of std::invalid_argument if the point set contains less
+ * than kNumClusters points.
+ *
+ * @return Indices of the selected points.
+ */
+template <class PointType>
+std::vector<size_t> SampleCentroidIndices
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   const SeedingMethod kMethod,
+   std::mt19937& engine);
+
+/**
+ * k-means++ seeding.
+ *
+ * Keeps the squared distance of each point to its nearest centroid selected so far
+ * and only compares against the newest centroid in each step, so the total cost is
+ * O(N*K) distance computations. The next centroid is drawn by binary search on
+ * the cumulative distances.
+ *
+ * @param kWeights Optional weight for each point, multiplied with the distances.
+ * If empty, all points have unit weight.
+ */
+template <class PointType>
+std::vector<size_t> SampleCentroidIndicesKmeansPlusPlus
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   std::mt19937& engine,
+   const std::vector<double>& kWeights = {});
+
+/**
+ * k-means|| seeding.
+ *
+ * Instead of one point per pass over the data, each round samples about
+ * kOversamplingFactor*kNumClusters candidates independently. The candidates are
+ * weighted by the number of points closest to them and reduced to kNumClusters
+ * centroids by weighted k-means++. Requires only kNumRounds passes over the data,
+ * which matters for large K.
+ *
+ * @param kOversamplingFactor Expected number of candidates per round relative to kNumClusters.
+ * @param kNumRounds Number of sampling rounds. A good value may be 5.
+ */
+template <class PointType>
+std::vector<size_t> SampleCentroidIndicesKmeansParallel
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   std::mt19937& engine,
+   const double kOversamplingFactor = 2.0,
+   const size_t kNumRounds = 5);
+
+} // namespace igg
+
+#include "seeding.ipp"
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_SEEDING_HPP_
@@ -0,0 +1,236 @@
+
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "tools/sampling.hpp"
+#include "tools/linalg.hpp"
+
+
+namespace igg {
+
+namespace internal {
+
+// Draw an index with probability proportional to its increment in the (non-decreasing)
+// cumulative sums. Returns kCumulative.size() if the total mass is zero.
+inline size_t SampleFromCumulative
+  (const std::vector<double>& kCumulative, std::mt19937& engine)
+{
+  const auto kSize = kCumulative.size();
+  if (kSize==0 || !(kCumulative.back()>0.0)) {return kSize;}
+
+  std::uniform_real_distribution<double> uniform(0.0, kCumulative.back());
+  const auto kIndex = static_cast<size_t>(std::upper_bound
+    (kCumulative.begin(), kCumulative.end(), uniform(engine))-kCumulative.begin());
+
+  return std::min(kIndex, kSize-1);
+}
+
+// Uniformly draw an index that is not selected yet,
+// used if all remaining points coincide with a centroid
+inline size_t SampleUnselected
+  (const std::vector<bool>& kIsSelected, std::mt19937& engine)
+{
+  std::vector<size_t> unselected;
+  for (size_t index = 0; index<kIsSelected.size(); index++) {
+    if (!kIsSelected[index]) {unselected.emplace_back(index);}
+  }
+
+  std::uniform_int_distribution<size_t> uniform(0, unselected.size()-1);
+  return unselected[uniform(engine)];
+}
+
+// Lower the distance of each point to its nearest centroid given a new centroid
+template <class PointType>
+void UpdateMinDistances
+  (const std::vector<PointType>& kPointSet,
+   const PointType& kNewCentroid,
+   std::vector<double>& min_distances)
+{
+  const auto kNumPoints = kPointSet.size();
+  for (size_t index = 0; index<kNumPoints; index++) {
+    const auto kDistance = static_cast<double>
+      (SquaredL2Distance<PointType>(kPointSet[index], kNewCentroid));
+    if (kDistance<min_distances[index]) {min_distances[index] = kDistance;}
+  }
+}
+
+} // namespace internal
+
+
+inline SeedingMethod SeedingMethodFromString(const std::string& kName) {
+  if (kName=="random") {return SeedingMethod::kRandom;}
+  if (kName=="kmeans++") {return SeedingMethod::kKmeansPlusPlus;}
+  if (kName=="kmeans||") {return SeedingMethod::kKmeansParallel;}
+  throw std::invalid_argument("Seeding method "+kName+" not recognized.");
+}
+
+
+template <class PointType>
+std::vector<size_t> SampleCentroidIndices
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   const SeedingMethod kMethod,
+   std::mt19937& engine)
+{
+  switch (kMethod) {
+    case SeedingMethod::kKmeansPlusPlus:
+      return SampleCentroidIndicesKmeansPlusPlus(kPointSet, kNumClusters, engine);
+    case SeedingMethod::kKmeansParallel:
+      return SampleCentroidIndicesKmeansParallel(kPointSet, kNumClusters, engine);
+    case SeedingMethod::kRandom:
+    default:
+      return SampleIndicesWithoutReplacement<size_t>(kNumClusters, kPointSet.size(), engine);
+  }
+}
+
+
+template <class PointType>
+std::vector<size_t> SampleCentroidIndicesKmeansPlusPlus
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   std::mt19937& engine,
+   const std::vector<double>& kWeights)
+{
+  const auto kNumPoints = kPointSet.size();
+  if (kNumClusters>kNumPoints) {
+    throw std::invalid_argument
+      ("Number of clusters is larger than number of points.");
+  }
+  if (!kWeights.empty() && kWeights.size()!=kNumPoints) {
+    throw std::invalid_argument("Number of weights does not match number of points.");
+  }
+
+  std::vector<size_t> indices;
+  indices.reserve(kNumClusters);
+  if (kNumClusters==0) {return indices;}
+
+  const bool kIsWeighted = !kWeights.empty();
+  std::vector<bool> is_selected(kNumPoints, false);
+  std::vector<double> cumulative(kNumPoints);
+
+  // First centroid with probability proportional to the weight
+  if (kIsWeighted) {
+    std::partial_sum(kWeights.begin(), kWeights.end(), cumulative.begin());
+    indices.emplace_back(internal::SampleFromCumulative(cumulative, engine));
+    if (indices.back()==kNumPoints) {indices.back() = internal::SampleUnselected(is_selected, engine);}
+  } else {
+    std::uniform_int_distribution<size_t> uniform(0, kNumPoints-1);
+    indices.emplace_back(uniform(engine));
+  }
+  is_selected[indices.back()] = true;
+
+  std::vector<double> min_distances(kNumPoints, std::numeric_limits<double>::max());
+
+  while (indices.size()<kNumClusters) {
+    // Only the newest centroid can lower the distances
+    internal::UpdateMinDistances(kPointSet, kPointSet[indices.back()], min_distances);
+
+    double sum = 0.0;
+    for (size_t index = 0; index<kNumPoints; index++) {
+      sum += kIsWeighted ? kWeights[index]*min_distances[index] : min_distances[index];
+      cumulative[index] = sum;
+    }
+
+    auto next_index = internal::SampleFromCumulative(cumulative, engine);
+    if (next_index==kNumPoints) {next_index = internal::SampleUnselected(is_selected, engine);}
+
+    indices.emplace_back(next_index);
+    is_selected[next_index] = true;
+  }
+
+  return indices;
+}
+
+
+template <class PointType>
+std::vector<size_t> SampleCentroidIndicesKmeansParallel
+  (const std::vector<PointType>& kPointSet,
+   const size_t kNumClusters,
+   std::mt19937& engine,
+   const double kOversamplingFactor,
+   const size_t kNumRounds)
+{
+  const auto kNumPoints = kPointSet.size();
+  if (kNumClusters>kNumPoints) {
+    throw std::invalid_argument
+      ("Number of clusters is larger than number of points.");
+  }
+  if (kNumClusters==0) {return {};}
+
+  // First candidate uniformly
+  std::uniform_int_distribution<size_t> uniform_index(0, kNumPoints-1);
+  std::vector<size_t> candidates {uniform_index(engine)};
+  std::vector<bool> is_candidate(kNumPoints, false);
+  is_candidate[candidates.back()] = true;
+
+  // Distance to and position of the nearest candidate for each point
+  std::vector<double> min_distances(kNumPoints, std::numeric_limits<double>::max());
+  std::vector<size_t> nearest_candidates(kNumPoints, 0);
+  internal::UpdateMinDistances(kPointSet, kPointSet[candidates.back()], min_distances);
+  double cost = std::accumulate(min_distances.begin(), min_distances.end(), 0.0);
+
+  const double kExpectedPerRound = kOversamplingFactor*static_cast<double>(kNumClusters);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  for (size_t round = 0; round<kNumRounds && cost>0.0; round++) {
+    // Sample each point independently, proportional to its distance
+    const auto kFirstNew = candidates.size();
+    for (size_t index = 0; index<kNumPoints; index++) {
+      if (!is_candidate[index] && uniform(engine)<kExpectedPerRound*min_distances[index]/cost) {
+        candidates.emplace_back(index);
+        is_candidate[index] = true;
+      }
+    }
+
+    // Update distances against the new candidates only
+    for (size_t index = 0; index<kNumPoints; index++) {
+      for (size_t position = kFirstNew; position<candidates.size(); position++) {
+        const auto kDistance = static_cast<double>
+          (SquaredL2Distance<PointType>(kPointSet[index], kPointSet[candidates[position]]));
+        if (kDistance<min_distances[index]) {
+          min_distances[index] = kDistance;
+          nearest_candidates[index] = position;
+        }
+      }
+    }
+    cost = std::accumulate(min_distances.begin(), min_distances.end(), 0.0);
+  }
+
+  if (candidates.size()<=kNumClusters) {
+    // Too few candidates, continue with plain k-means++ steps
+    std::vector<double> cumulative(kNumPoints);
+    while (candidates.size()<kNumClusters) {
+      std::partial_sum(min_distances.begin(), min_distances.end(), cumulative.begin());
+      auto next_index = internal::SampleFromCumulative(cumulative, engine);
+      if (next_index==kNumPoints) {next_index = internal::SampleUnselected(is_candidate, engine);}
+
+      candidates.emplace_back(next_index);
+      is_candidate[next_index] = true;
+      internal::UpdateMinDistances(kPointSet, kPointSet[next_index], min_distances);
+    }
+    return candidates;
+  }
+
+  // Weight candidates by the number of points they are closest to
+  std::vector<double> weights(candidates.size(), 0.0);
+  for (const auto kPosition: nearest_candidates) {weights[kPosition] += 1.0;}
+
+  std::vector<PointType> candidate_points;
+  candidate_points.reserve(candidates.size());
+  for (const auto kIndex: candidates) {candidate_points.emplace_back(kPointSet[kIndex]);}
+
+  // Reduce to kNumClusters centroids
+  const auto kPositions = SampleCentroidIndicesKmeansPlusPlus
+    (candidate_points, kNumClusters, engine, weights);
+
+  std::vector<size_t> indices;
+  indices.reserve(kNumClusters);
+  for (const auto kPosition: kPositions) {indices.emplace_back(candidates[kPosition]);}
+
+  return indices;
+}
+
+} // namespace igg
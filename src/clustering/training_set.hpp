@@ -0,0 +1,55 @@
+#ifndef CPP_FINAL_PROJECT_CLUSTERING_TRAINING_SET_HPP_
+#define CPP_FINAL_PROJECT_CLUSTERING_TRAINING_SET_HPP_
+
+/**
+ * @file training_set.hpp
+ *
+ * Subsampling of a point stream to a training set of fixed size, as the quality
+ * of the visual vocabulary saturates well before all descriptors are used.
+ */
+
+#include <random>
+#include <vector>
+
+#include "point_stream.hpp"
+
+
+namespace igg {
+
+/**
+ * Uniformly sample points from a stream in a single pass (reservoir sampling).
+ *
+ * @param kSampleSize Number of points to sample. If the stream contains fewer
+ * points, all of them are returned.
+ *
+ * @return The sampled points, in no particular order.
+ */
+template <class T>
+std::vector<FeaturePoint<T>> SampleTrainingSet
+  (PointStream<T>& stream, const size_t kSampleSize, std::mt19937& engine);
+
+/**
+ * Sample points from a stream consisting of consecutive strata (e.g. the
+ * features of each image), taking about the same number of points from each
+ * stratum, so strata with many points do not dominate. See StratifiedSampleSizes.
+ *
+ * Throws an instance of std::invalid_argument if the stratum sizes do not add up
+ * to the size of the stream.
+ *
+ * @param kStratumSizes Number of points in each stratum, in stream order.
+ * @param kSampleSize Number of points to sample.
+ *
+ * @return The sampled points, in stream order.
+ */
+template <class T>
+std::vector<FeaturePoint<T>> SampleTrainingSetStratified
+  (PointStream<T>& stream,
+   const std::vector<size_t>& kStratumSizes,
+   const size_t kSampleSize,
+   std::mt19937& engine);
+
+} // namespace igg
+
+#include "training_set.ipp"
+
+#endif // CPP_FINAL_PROJECT_CLUSTERING_TRAINING_SET_HPP_
@@ -0,0 +1,73 @@
+
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "tools/sampling.hpp"
+
+
+namespace igg {
+
+template <class T>
+std::vector<FeaturePoint<T>> SampleTrainingSet
+  (PointStream<T>& stream, const size_t kSampleSize, std::mt19937& engine)
+{
+  ReservoirSampler<FeaturePoint<T>> sampler(kSampleSize, engine);
+
+  stream.Rewind();
+  for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+    for (const auto kPoint: chunk) {sampler.Add(*kPoint);}
+  }
+
+  return sampler.Sample();
+}
+
+
+template <class T>
+std::vector<FeaturePoint<T>> SampleTrainingSetStratified
+  (PointStream<T>& stream,
+   const std::vector<size_t>& kStratumSizes,
+   const size_t kSampleSize,
+   std::mt19937& engine)
+{
+  if (std::accumulate(kStratumSizes.begin(), kStratumSizes.end(), static_cast<size_t>(0))!=stream.Size()) {
+    throw std::invalid_argument("Stratum sizes do not match number of points.");
+  }
+
+  // Select indices within each stratum and convert them to positions in the stream
+  const auto kSampleSizes = StratifiedSampleSizes(kStratumSizes, kSampleSize);
+  std::vector<size_t> selected;
+  selected.reserve(std::accumulate(kSampleSizes.begin(), kSampleSizes.end(), static_cast<size_t>(0)));
+
+  size_t offset = 0;
+  for (size_t stratum_index = 0; stratum_index<kStratumSizes.size(); stratum_index++) {
+    const auto kFirst = selected.size();
+    for (const auto kIndex: SampleIndicesWithoutReplacement<size_t>
+           (kSampleSizes[stratum_index], kStratumSizes[stratum_index], engine))
+      {selected.emplace_back(offset+kIndex);}
+    std::sort(selected.begin()+kFirst, selected.end());
+    offset += kStratumSizes[stratum_index];
+  }
+
+  // Collect points in one pass
+  std::vector<FeaturePoint<T>> training_set;
+  training_set.reserve(selected.size());
+
+  size_t position = 0;
+  auto next_selected = selected.begin();
+  stream.Rewind();
+  for (auto chunk = stream.NextChunk(); !chunk.empty() && next_selected!=selected.end(); chunk = stream.NextChunk()) {
+    for (const auto kPoint: chunk) {
+      if (next_selected!=selected.end() && *next_selected==position) {
+        training_set.emplace_back(*kPoint);
+        next_selected++;
+      }
+      position++;
+    }
+  }
+
+  return training_set;
+}
+
+} // namespace igg
@@ -6,6 +6,8 @@
 #include "clustering/clustering_strategy_kmeans_vers_2.hpp"
 #include "clustering/clustering_strategy_kmeans_opencv.hpp"
 #include "clustering/clustering_strategy_kmeans_with_index.hpp"
+#include "clustering/clustering_strategy_kmeans_with_hnsw.hpp"
+#include "clustering/clustering_strategy_kmeans_streaming.hpp"
 
 
 int main (int argc, char** argv) {
@@ -15,11 +17,19 @@ int main (int argc, char** argv) {
   po::options_description options_description("Options");
   options_description.add_options()
     ("help,h", "Show help.")
-    ("variant,v", po::value<std::string>()->default_value("kmeans"), "Variant of K-means to use. Options: kmeans, kmeans_vers_2, kmeans_opencv, kmeans_with_index.")
+    ("variant,v", po::value<std::string>()->default_value("kmeans"), "Variant of K-means to use. Options: kmeans, kmeans_vers_2, kmeans_opencv, kmeans_with_index, kmeans_with_hnsw, kmeans_streaming, kmeans_distributed.")
     ("num-clusters,k", po::value<size_t>()->default_value(100), "Number of clusters.")
     ("iterations,i", po::value<int>()->default_value(25), "Maximum number of iterations.")
     ("epsilon,e", po::value<float>()->default_value(1e-3f), "Stop if centroid updates are smaller than this value. Not supported by all variants.")
-    ("seed,s", po::value<int>()->default_value(0), "Seed for initialization of centroids. Not supported by all variants.");
+    ("seed,s", po::value<int>()->default_value(0), "Seed for initialization of centroids. Not supported by all variants.")
+    ("init,", po::value<std::string>(), "Method to select initial centroids. Options: random, kmeans++, kmeans||. Defaults to random for kmeans, kmeans_with_index and kmeans_with_hnsw, to kmeans++ otherwise.")
+    ("max-training-descriptors,", po::value<size_t>()->default_value(0), "Cluster a random sample of this many features instead of all. 0 to use all features.")
+    ("stratified,", "Sample about the same number of features from each image. Only used with --max-training-descriptors.")
+    ("hnsw-m,", po::value<size_t>()->default_value(16), "Number of connections per graph node. Only used by kmeans_with_hnsw.")
+    ("hnsw-ef-construction,", po::value<size_t>()->default_value(200), "Candidate list size while building the graph. Only used by kmeans_with_hnsw.")
+    ("hnsw-ef-search,", po::value<size_t>()->default_value(50), "Candidate list size while searching the graph. Only used by kmeans_with_hnsw.")
+    ("worker,", po::value<std::vector<std::string>>(), "Socket of a kmeans_worker, repeat for each worker in the order of their shards. Only used by kmeans_distributed.")
+    ("checkpoint,", po::value<std::string>()->default_value(""), "File to store the state after each iteration and to continue from. Only used by kmeans_distributed.");
   // Note on the syntax: (...) is an operator on the object returned by add_options(), which returns a reference to the very same object
   // Reference: https://stackoverflow.com/questions/10486588/boost-program-options-add-options-syntax
 
@@ -55,6 +65,22 @@ int main (int argc, char** argv) {
     return 1;
   }
   const auto kSeed = variables_map["seed"].as<int>();
+  const auto kMaxTrainingDescriptors = variables_map["max-training-descriptors"].as<size_t>();
+  const bool kStratified = variables_map.count("stratified")>0;
+
+  // Use the default of the variant if no seeding method is given
+  const bool kHasInit = variables_map.count("init")>0;
+  igg::SeedingMethod seeding = igg::SeedingMethod::kRandom;
+  if (kHasInit) {
+    try {
+      seeding = igg::SeedingMethodFromString(variables_map["init"].as<std::string>());
+    } catch (const std::invalid_argument& kError) {
+      std::cerr << kError.what() << "\n";
+      return 1;
+    }
+  }
+  const auto SeedingOr = [kHasInit, seeding](const igg::SeedingMethod kDefault)
+    {return kHasInit ? seeding : kDefault;};
 
   std::cout << "Clustering parameters:\n";
   std::cout << "* K-means variant: " << kVariant << "\n";
@@ -62,6 +88,11 @@ int main (int argc, char** argv) {
   std::cout << "* Iterations: " << kIterations << "\n";
   std::cout << "* Epsilon: " << kEpsilon << "\n";
   std::cout << "* Seed: " << kSeed << "\n";
+  if (kMaxTrainingDescriptors>0) {
+    std::cout << "* Max. training descriptors: " << kMaxTrainingDescriptors <<
+      (kStratified ? " (stratified)" : "") << "\n";
+  }
+  if (kHasInit) {std::cout << "* Initialization: " << variables_map["init"].as<std::string>() << "\n";}
 
   const auto kDataset = igg::Dataset::Default();
   if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
@@ -72,26 +103,69 @@ int main (int argc, char** argv) {
     if (kVariant=="kmeans") {
       std::cout << "Using own implementation of K-Means.\n";
       const igg::ClusteringStrategyKmeans<float> kStrategy
-        (kNumClusters, kIterations, kEpsilon, kSeed, true); // True to allow terminal output
-      kBagOfWords.ComputeClusterCentroids(kStrategy);
+        (kNumClusters, kIterations, kEpsilon, kSeed, true, // True to allow terminal output
+         SeedingOr(igg::SeedingMethod::kRandom));
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
     } else if (kVariant=="kmeans_vers_2") {
       std::cout << "Using own implementation of K-Means (second alternative).\n";
       const igg::ClusteringStrategyKmeansVers2<float> kStrategy
-        (kNumClusters, kIterations, true); // True to allow terminal output
-      kBagOfWords.ComputeClusterCentroids(kStrategy);
+        (kNumClusters, kIterations, true, // True to allow terminal output
+         SeedingOr(igg::SeedingMethod::kKmeansPlusPlus));
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
     } else if (kVariant=="kmeans_opencv") {
       std::cout << "Using OpenCV implementation of K-means.\n";
       const int kAttempts = 1;
       const igg::ClusteringStrategyKmeansOpenCV<float> kStrategy
-        (kNumClusters, kIterations, kEpsilon, kAttempts, true); // True to allow terminal output
-      kBagOfWords.ComputeClusterCentroids(kStrategy);
+        (kNumClusters, kIterations, kEpsilon, kAttempts, true, // True to allow terminal output
+         SeedingOr(igg::SeedingMethod::kKmeansPlusPlus));
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
     } else if (kVariant=="kmeans_with_index") {
       const size_t kNumTrees = 10;
       const size_t kSearchLimit = 100;
       const size_t kNumSplitDimensions = 5;
       const igg::ClusteringStrategyKmeansWithIndex<float> kStrategy
-        (kNumClusters, kIterations, kEpsilon, kNumTrees, kSearchLimit, kNumSplitDimensions, kSeed, true);
-      kBagOfWords.ComputeClusterCentroids(kStrategy);
+        (kNumClusters, kIterations, kEpsilon, kNumTrees, kSearchLimit, kNumSplitDimensions, kSeed, true,
+         SeedingOr(igg::SeedingMethod::kRandom));
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
+    } else if (kVariant=="kmeans_with_hnsw") {
+      const auto kMaxConnections = variables_map["hnsw-m"].as<size_t>();
+      const auto kEfConstruction = variables_map["hnsw-ef-construction"].as<size_t>();
+      const auto kEfSearch = variables_map["hnsw-ef-search"].as<size_t>();
+      const igg::ClusteringStrategyKmeansWithHnsw<float> kStrategy
+        (kNumClusters, kIterations, kEpsilon, kMaxConnections, kEfConstruction, kEfSearch, kSeed, true,
+         SeedingOr(igg::SeedingMethod::kRandom));
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
+    } else if (kVariant=="kmeans_streaming") {
+      std::cout << "Using own implementation of K-Means, streaming features from disk.\n";
+      if (kHasInit && seeding!=igg::SeedingMethod::kRandom) {
+        std::cerr << "Variant kmeans_streaming only supports random initialization.\n";
+        return 1;
+      }
+      const igg::ClusteringStrategyKmeansStreaming<float> kStrategy
+        (kNumClusters, kIterations, kEpsilon, kSeed, true); // True to allow terminal output
+      kBagOfWords.ComputeClusterCentroids(kStrategy, kMaxTrainingDescriptors, kStratified, kSeed);
+    } else if (kVariant=="kmeans_distributed") {
+      std::cout << "Using own implementation of K-Means, distributed among worker processes.\n";
+      if (kHasInit && seeding!=igg::SeedingMethod::kRandom) {
+        std::cerr << "Variant kmeans_distributed only supports random initialization.\n";
+        return 1;
+      }
+      if (kMaxTrainingDescriptors>0) {
+        std::cerr << "Variant kmeans_distributed always clusters all features.\n";
+        return 1;
+      }
+      if (!variables_map.count("worker")) {
+        std::cerr << "Variant kmeans_distributed needs at least one --worker.\n";
+        return 1;
+      }
+      std::vector<std::unique_ptr<igg::KmeansChannel>> workers;
+      for (const auto& kSocketPath: variables_map["worker"].as<std::vector<std::string>>()) {
+        workers.emplace_back(igg::FileDescriptorChannel::Connect(kSocketPath));
+      }
+      const igg::DistributedKmeans kKmeans
+        (kNumClusters, kIterations, kEpsilon, kSeed, true, // True to allow terminal output
+         variables_map["checkpoint"].as<std::string>());
+      kBagOfWords.ComputeClusterCentroids(kKmeans, workers);
     } else {
       std::cerr << "Variant " << kVariant << " not recognized.\n";
       return -1;
@@ -15,7 +15,15 @@ Dataset::Dataset(const std::string kDir):
   kImagesDir_{fs::path(kDir)/"images/"},
   kResultsDir_{fs::path(kDir)/"results/"},
   kCentroidsPath_(fs::path(kDir)/"results"/"centroids.binary"),
+  kWordIndexPath_(fs::path(kDir)/"results"/"centroids_hnsw.binary"),
+  kInvertedIndexPath_(fs::path(kDir)/"results"/"inverted_index.binary"),
   kHistogramWeightsPath_(fs::path(kDir)/"results"/"histogram_weights.binary"),
+  kVocabularyPruningPath_(fs::path(kDir)/"results"/"vocabulary_pruning.binary"),
+  kProductQuantizationPath_(fs::path(kDir)/"results"/"product_quantization.binary"),
+  kVladEncoderPath_(fs::path(kDir)/"results"/"vlad_encoder.binary"),
+  kVladVectorsPath_(fs::path(kDir)/"results"/"vlad_vectors.binary"),
+  kHistogramIndexPath_(fs::path(kDir)/"results"/"histograms_hnsw.binary"),
+  kVladIndexPath_(fs::path(kDir)/"results"/"vlad_vectors_hnsw.binary"),
   kWebDir_{fs::path(kDir)/"web/"}
 {
   if (!fs::exists(fs::path(kDir))) {
@@ -113,9 +121,50 @@ std::vector<FeaturePoint<float>> Dataset::LoadCentroids() const {
 }
 
 
+HnswIndex<FeaturePoint<float>> Dataset::LoadWordIndex() const {
+  return HnswIndex<FeaturePoint<float>>::ReadFromBinary(this->kWordIndexPath_.string());
+}
+
+
+InvertedIndex Dataset::LoadInvertedIndex() const {
+  return InvertedIndex::ReadFromBinary(this->kInvertedIndexPath_.string());
+}
+
+
 std::vector<float> Dataset::LoadHistogramWeights() const {
   return ReadFromBinary<float>(this->kHistogramWeightsPath_.string());
 }
 
+
+VocabularyPruning Dataset::LoadVocabularyPruning() const {
+  return VocabularyPruning::ReadFromBinary(this->kVocabularyPruningPath_.string());
+}
+
+
+ProductQuantizedIndex Dataset::LoadProductQuantization() const {
+  return ProductQuantizedIndex::ReadFromBinary(this->kProductQuantizationPath_.string());
+}
+
+
+VladEncoder Dataset::LoadVladEncoder() const {
+  return VladEncoder::ReadFromBinary(this->kVladEncoderPath_.string());
+}
+
+
+std::vector<std::vector<float>> Dataset::LoadVladVectors() const {
+  // Same layout as the centroids
+  return ReadCentroidsFromBinary<float>(this->kVladVectorsPath_.string());
+}
+
+
+HnswIndex<SparseHistogram<float>> Dataset::LoadHistogramIndex() const {
+  return HnswIndex<SparseHistogram<float>>::ReadFromBinary(this->kHistogramIndexPath_.string());
+}
+
+
+HnswIndex<std::vector<float>> Dataset::LoadVladIndex() const {
+  return HnswIndex<std::vector<float>>::ReadFromBinary(this->kVladIndexPath_.string());
+}
+
 } // namespace igg
 
@@ -7,6 +7,12 @@
 #include <boost/filesystem.hpp>
 
 #include "image_item.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "histogram/sparse_histogram.hpp"
+#include "inverted_index/inverted_index.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+#include "product_quantization/product_quantized_index.hpp"
+#include "vlad/vlad_encoder.hpp"
 
 
 namespace igg {
@@ -37,7 +43,16 @@ namespace fs = boost::filesystem;
  *       |
  *       |_ results/
  *       |    |_ centroids.binary
+ *       |    |_ centroids_hnsw.binary (optional)
  *       |    |_ histogram_weights.binary
+ *       |    |_ histograms_hnsw.binary (optional)
+ *       |    |_ histograms_hnsw.binary.items (optional)
+ *       |    |_ product_quantization.binary (optional)
+ *       |    |_ vlad_encoder.binary (optional)
+ *       |    |_ vlad_vectors.binary (optional)
+ *       |    |_ vlad_vectors_hnsw.binary (optional)
+ *       |    |_ vlad_vectors_hnsw.binary.items (optional)
+ *       |    |_ vocabulary_pruning.binary
  *       |    |_ <one binary file with extracted features for each image>
  *       |
  *       |_ web/
@@ -114,6 +129,45 @@ public:
    */
   std::vector<FeaturePoint<float>> LoadCentroids() const;
 
+  /**
+   * Path to the file where a search index over the cluster centroids (the visual words)
+   * is stored. It speeds up assigning features to words for large vocabularies.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string WordIndexPath() const {return this->kWordIndexPath_.string();}
+
+  /**
+   * Check if a binary file with a search index over the cluster centroids exists.
+   */
+  bool HasWordIndex() const {return FileExists(this->kWordIndexPath_.string());}
+
+  /**
+   * Loads the search index over the cluster centroids from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  HnswIndex<FeaturePoint<float>> LoadWordIndex() const;
+
+  /**
+   * Path to the file where the inverted index (images per visual word) is stored.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string InvertedIndexPath() const {return this->kInvertedIndexPath_.string();}
+
+  /**
+   * Check if a binary file with an inverted index exists.
+   */
+  bool HasInvertedIndex() const {return FileExists(this->kInvertedIndexPath_.string());}
+
+  /**
+   * Loads the inverted index from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  InvertedIndex LoadInvertedIndex() const;
+
   /**
    * Path where histogram weights for the overall dataset are stored.
    *
@@ -133,6 +187,120 @@ public:
    */
   std::vector<float> LoadHistogramWeights() const;
 
+  /**
+   * Path where the stop words and the word count limit used for the histograms are stored.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string VocabularyPruningPath() const {return this->kVocabularyPruningPath_.string();}
+
+  /**
+   * Check if a binary file with a vocabulary pruning exists.
+   */
+  bool HasVocabularyPruning() const {return FileExists(this->kVocabularyPruningPath_.string());}
+
+  /**
+   * Loads the vocabulary pruning from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  VocabularyPruning LoadVocabularyPruning() const;
+
+  /**
+   * Path to the file where the compact codes of the image histograms and the product
+   * quantizer are stored.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string ProductQuantizationPath() const {return this->kProductQuantizationPath_.string();}
+
+  /**
+   * Check if a binary file with product quantization codes exists.
+   */
+  bool HasProductQuantization() const {return FileExists(this->kProductQuantizationPath_.string());}
+
+  /**
+   * Loads the product quantization codes from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  ProductQuantizedIndex LoadProductQuantization() const;
+
+  /**
+   * Path to the file where the VLAD vocabulary and projection are stored.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string VladEncoderPath() const {return this->kVladEncoderPath_.string();}
+
+  /**
+   * Path to the file where the VLAD vectors of all images are stored, one row per
+   * image in the order of Items().
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string VladVectorsPath() const {return this->kVladVectorsPath_.string();}
+
+  /**
+   * Check if binary files with the VLAD encoder and vectors exist.
+   */
+  bool HasVladVectors() const
+    {return FileExists(this->kVladEncoderPath_.string()) && FileExists(this->kVladVectorsPath_.string());}
+
+  /**
+   * Loads the VLAD encoder from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  VladEncoder LoadVladEncoder() const;
+
+  /**
+   * Loads the VLAD vectors from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  std::vector<std::vector<float>> LoadVladVectors() const;
+
+  /**
+   * Path to the file where the search index over the normalized histograms of all
+   * images is stored, see HnswIndex. The histograms are kept sparse.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string HistogramIndexPath() const {return this->kHistogramIndexPath_.string();}
+
+  /**
+   * Check if a binary file with the search index over the histograms exists.
+   */
+  bool HasHistogramIndex() const {return FileExists(this->kHistogramIndexPath_.string());}
+
+  /**
+   * Loads the search index over the histograms from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  HnswIndex<SparseHistogram<float>> LoadHistogramIndex() const;
+
+  /**
+   * Path to the file where the search index over the VLAD vectors of all images is
+   * stored, see HnswIndex.
+   *
+   * Note that this file does not necessarily exist yet.
+   */
+  std::string VladIndexPath() const {return this->kVladIndexPath_.string();}
+
+  /**
+   * Check if a binary file with the search index over the VLAD vectors exists.
+   */
+  bool HasVladIndex() const {return FileExists(this->kVladIndexPath_.string());}
+
+  /**
+   * Loads the search index over the VLAD vectors from the binary file.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  HnswIndex<std::vector<float>> LoadVladIndex() const;
+
 
   /**
    * Provide a pointer to the defined default dataset.
@@ -149,7 +317,15 @@ private:
   const fs::path kImagesDir_;
   const fs::path kResultsDir_;
   const fs::path kCentroidsPath_;
+  const fs::path kWordIndexPath_;
+  const fs::path kInvertedIndexPath_;
   const fs::path kHistogramWeightsPath_;
+  const fs::path kVocabularyPruningPath_;
+  const fs::path kProductQuantizationPath_;
+  const fs::path kVladEncoderPath_;
+  const fs::path kVladVectorsPath_;
+  const fs::path kHistogramIndexPath_;
+  const fs::path kVladIndexPath_;
   const fs::path kWebDir_;
   std::vector<std::shared_ptr<const ImageItem>> items_;
 
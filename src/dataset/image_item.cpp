@@ -54,7 +54,12 @@ std::string ImageItem::HistogramBinaryFilename() const {
 
 
 Histogram<float> ImageItem::LoadHistogram() const {
-  return ReadFromBinary<float>(this->kHistogramBinaryPath_);
+  return ReadHistogramFromBinary<float>(this->kHistogramBinaryPath_);
+}
+
+
+SparseHistogram<float> ImageItem::LoadSparseHistogram() const {
+  return ReadSparseHistogramFromBinary<float>(this->kHistogramBinaryPath_);
 }
 
 } // namespace igg
@@ -97,6 +97,12 @@ public:
     */
    Histogram<float> LoadHistogram() const;
 
+   /**
+    * Loads the histogram representation of this image from file, without
+    * the zero bins. Preferable for large vocabularies.
+    */
+   SparseHistogram<float> LoadSparseHistogram() const;
+
  private:
    const std::string kImagePath_;
    const std::string kFeaturesBinaryPath_;
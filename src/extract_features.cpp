@@ -10,7 +10,11 @@ int main (int argc, char** argv) {
 
   po::options_description options_description("Options");
   options_description.add_options()
-    ("help,h", "Show help.");
+    ("help,h", "Show help.")
+    ("queue,", po::value<std::string>(), "Directory of a work queue shared with other extract_features processes, possibly on other hosts. Each process extracts the batches of images it claims, until all are done.")
+    ("batch-size,", po::value<size_t>()->default_value(64), "Number of images claimed at once, if the queue is new.")
+    ("lease-seconds,", po::value<size_t>()->default_value(600), "Time after which a batch of a stopped process is extracted again. Extracting a single image has to take less than half of it.")
+    ("worker-id,", po::value<std::string>()->default_value(igg::FileWorkQueue::DefaultWorkerId()), "Name of this process in the queue, unique among all processes.");
 
   po::variables_map variables_map;
   try {
@@ -23,7 +27,7 @@ int main (int argc, char** argv) {
 
   // Show help
   if (variables_map.count("help")) {
-    std::cout << "Extracts features from image dataset.\n";
+    std::cout << "Extracts features from image dataset, optionally together with other processes sharing a --queue directory.\n";
     std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set.\n";
     std::cout << options_description;
     return 0;
@@ -35,7 +39,15 @@ int main (int argc, char** argv) {
   const igg::BagOfWords kBagOfWords(kDataset, true); // True to allow terminal output
 
   try {
-    kBagOfWords.ExtractFeatures();
+    if (variables_map.count("queue")) {
+      kBagOfWords.ExtractFeatures
+        (variables_map["queue"].as<std::string>(),
+         variables_map["batch-size"].as<size_t>(),
+         std::chrono::seconds(variables_map["lease-seconds"].as<size_t>()),
+         variables_map["worker-id"].as<std::string>());
+    } else {
+      kBagOfWords.ExtractFeatures();
+    }
   } catch (const std::exception& kError) {
     std::cerr << "An error occured: " << kError.what() << "\n";
     return 1;
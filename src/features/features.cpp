@@ -11,8 +11,16 @@ namespace igg {
 cv::Mat ComputeFeatures
   (const cv::Mat& kImage)
 {
-  // Find keypoints
-  const auto kDetector = cv::xfeatures2d::SiftFeatureDetector::create();
+  return ComputeFeatures(kImage, 0);
+}
+
+
+cv::Mat ComputeFeatures
+  (const cv::Mat& kImage,
+   const int kMaxFeatures)
+{
+  // Find keypoints, the strongest ones if limited
+  const auto kDetector = cv::xfeatures2d::SiftFeatureDetector::create(kMaxFeatures);
   std::vector<cv::KeyPoint> keypoints;
   kDetector->detect(kImage, keypoints);
 
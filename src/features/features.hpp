@@ -29,6 +29,14 @@ namespace igg {
 cv::Mat ComputeFeatures
   (const cv::Mat& kImage);
 
+/*
+ * Same as above, but keep at most kMaxFeatures features, the ones with the strongest
+ * response (0 for no limit). Fewer features are faster to assign to visual words.
+ */
+cv::Mat ComputeFeatures
+  (const cv::Mat& kImage,
+   const int kMaxFeatures);
+
 // This function is no longer used an therefore deprecated.
 //cv::Mat VisualizeKeypoints
   //(const cv::Mat& kImage,
@@ -29,8 +29,8 @@ using Histogram = std::vector<T>;
  */
 template <class T>
 std::vector<T> ComputeSimilarities
-  (const Histogram<T> kHistogram,
-   const std::vector<Histogram<T>> kHistogramsToCompare);
+  (const Histogram<T>& kHistogram,
+   const std::vector<Histogram<T>>& kHistogramsToCompare);
 
 } // namespace igg
 
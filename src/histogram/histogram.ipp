@@ -7,8 +7,8 @@ namespace igg {
 
 template <class T>
 std::vector<T> ComputeSimilarities
-  (const Histogram<T> kHistogram,
-   const std::vector<Histogram<T>> kHistogramsToCompare)
+  (const Histogram<T>& kHistogram,
+   const std::vector<Histogram<T>>& kHistogramsToCompare)
 {
   const auto kHistogramNorm = L2Norm<Histogram<T>>(kHistogram);
 
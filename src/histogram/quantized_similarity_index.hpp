@@ -0,0 +1,150 @@
+#ifndef CPP_FINAL_PROJECT_HISTOGRAM_QUANTIZED_SIMILARITY_INDEX_HPP_
+#define CPP_FINAL_PROJECT_HISTOGRAM_QUANTIZED_SIMILARITY_INDEX_HPP_
+
+
+#include <cstdint>
+#include <vector>
+
+#include "histogram.hpp"
+#include "sparse_histogram.hpp"
+#include "ranking.hpp"
+
+
+namespace igg {
+
+/**
+ * Approximate cosine similarity search over histograms quantized to 8 bit,
+ * followed by exact re-ranking of the best candidates.
+ *
+ * Each histogram is L2-normalized and stored as one row of 8 bit integers with
+ * its own scale (the largest weight of the row maps to 127), a quarter of the
+ * memory of a SimilarityIndex<float>. A query is quantized the same way and
+ * scored against all rows with integer dot products. Only the kNumCandidates
+ * best rows are then scored exactly, with histograms provided by the caller
+ * from the full-precision store (e.g. the histogram files of a dataset), so the
+ * float histograms never have to be in memory at once.
+ *
+ * The more candidates, the more likely the exact top results are among them.
+ *
+ * Usage:
+ *
+ *   QuantizedSimilarityIndex<float> index(num_bins);
+ *   for (const auto& kItem: items) {index.Add(kItem->LoadHistogram());}
+ *
+ *   const auto kTop10 = index.TopK(query_histogram, 10, 200,
+ *     [&items](const size_t kIndex) {return items[kIndex]->LoadHistogram();});
+ */
+template <class T>
+class QuantizedSimilarityIndex {
+public:
+  /**
+   * Constructor of an empty index, see Add().
+   *
+   * @param kNumBins Number of bins of each histogram.
+   * @param kNumThreads Maximum number of threads per query, 0 to use all hardware threads.
+   * Small indices are always searched by a single thread.
+   */
+  explicit QuantizedSimilarityIndex(const size_t kNumBins, const size_t kNumThreads = 0);
+
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if the histograms do not all
+   * have the same number of bins.
+   */
+  explicit QuantizedSimilarityIndex
+    (const std::vector<Histogram<T>>& kHistograms, const size_t kNumThreads = 0);
+
+  /**
+   * Constructor. See above.
+   */
+  explicit QuantizedSimilarityIndex
+    (const std::vector<SparseHistogram<T>>& kHistograms, const size_t kNumThreads = 0);
+
+  /**
+   * Quantize a histogram and append it as the next row.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  void Add(const Histogram<T>& kHistogram);
+  void Add(const SparseHistogram<T>& kHistogram);
+
+  /**
+   * Number of histograms.
+   */
+  size_t Size() const {return this->scales_.size();}
+
+  /**
+   * Number of bins of each histogram.
+   */
+  size_t NumBins() const {return this->num_bins_;}
+
+  /**
+   * Memory used by the quantized histograms and their scales.
+   */
+  size_t MemoryBytes() const
+    {return this->codes_.size()*sizeof(int8_t)+this->scales_.size()*sizeof(T);}
+
+  /**
+   * Approximate cosine similarity of the query to each histogram, in order.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<T> Similarities(const Histogram<T>& kQuery) const;
+  std::vector<T> Similarities(const SparseHistogram<T>& kQuery) const;
+
+  /**
+   * The kNumCandidates most similar histograms by approximate similarity, as pairs
+   * of index and approximate similarity, most similar first.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<ScoredIndex<T>> Candidates(const Histogram<T>& kQuery, const size_t kNumCandidates) const;
+  std::vector<ScoredIndex<T>> Candidates(const SparseHistogram<T>& kQuery, const size_t kNumCandidates) const;
+
+  /**
+   * The kNumResults most similar histograms among the candidates (see Candidates())
+   * by exact cosine similarity, as pairs of index and similarity, most similar first.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   *
+   * @param kNumCandidates Number of candidates to re-rank, at least kNumResults are used.
+   * @param kLoadHistogram Called with the index of each candidate, returns its full-precision
+   * histogram as Histogram<T> or SparseHistogram<T>.
+   */
+  template <class HistogramLoader>
+  std::vector<ScoredIndex<T>> TopK
+    (const Histogram<T>& kQuery, const size_t kNumResults, const size_t kNumCandidates,
+     const HistogramLoader& kLoadHistogram) const;
+  template <class HistogramLoader>
+  std::vector<ScoredIndex<T>> TopK
+    (const SparseHistogram<T>& kQuery, const size_t kNumResults, const size_t kNumCandidates,
+     const HistogramLoader& kLoadHistogram) const;
+
+private:
+  size_t num_bins_;
+  size_t num_threads_;
+  // Quantized normalized histograms, one per row
+  std::vector<int8_t> codes_;
+  // Weight of one quantization step of each row
+  std::vector<T> scales_;
+
+  // Quantize the values as if they were normalized, returns the scale
+  static T Quantize(const T* kValues, const size_t kNumValues, int8_t* codes);
+
+  Histogram<T> NormalizedQuery(const Histogram<T>& kQuery) const;
+
+  // Quantized normalized query and its scale
+  std::vector<int8_t> QuantizedQuery(const Histogram<T>& kNormalizedQuery, T& scale) const;
+
+  static T NormalizedDotProduct(const Histogram<T>& kNormalizedQuery, const Histogram<T>& kHistogram);
+  static T NormalizedDotProduct(const Histogram<T>& kNormalizedQuery, const SparseHistogram<T>& kHistogram);
+
+  size_t NumThreadsForQuery() const;
+};
+
+} // namespace igg
+
+#include "quantized_similarity_index.ipp"
+
+#endif // CPP_FINAL_PROJECT_HISTOGRAM_QUANTIZED_SIMILARITY_INDEX_HPP_
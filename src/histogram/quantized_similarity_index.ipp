@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "similarity_index.hpp"
+#include "tools/simd.hpp"
+#include "tools/parallel.hpp"
+
+
+namespace igg {
+
+namespace internal {
+
+// Largest absolute value of a quantized weight
+const int32_t kMaxQuantizedWeight = 127;
+
+} // namespace internal
+
+
+template <class T>
+QuantizedSimilarityIndex<T>::QuantizedSimilarityIndex(const size_t kNumBins, const size_t kNumThreads):
+  num_bins_{kNumBins},
+  num_threads_{kNumThreads==0 ? DefaultNumThreads() : kNumThreads} {}
+
+
+template <class T>
+QuantizedSimilarityIndex<T>::QuantizedSimilarityIndex
+  (const std::vector<Histogram<T>>& kHistograms, const size_t kNumThreads):
+  QuantizedSimilarityIndex(kHistograms.empty() ? 0 : kHistograms[0].size(), kNumThreads)
+{
+  this->codes_.reserve(kHistograms.size()*this->num_bins_);
+  this->scales_.reserve(kHistograms.size());
+  for (const auto& kHistogram: kHistograms) {this->Add(kHistogram);}
+}
+
+
+template <class T>
+QuantizedSimilarityIndex<T>::QuantizedSimilarityIndex
+  (const std::vector<SparseHistogram<T>>& kHistograms, const size_t kNumThreads):
+  QuantizedSimilarityIndex(kHistograms.empty() ? 0 : kHistograms[0].NumBins(), kNumThreads)
+{
+  this->codes_.reserve(kHistograms.size()*this->num_bins_);
+  this->scales_.reserve(kHistograms.size());
+  for (const auto& kHistogram: kHistograms) {this->Add(kHistogram);}
+}
+
+
+template <class T>
+void QuantizedSimilarityIndex<T>::Add(const Histogram<T>& kHistogram) {
+  if (kHistogram.size()!=this->num_bins_)
+    {throw std::invalid_argument("Histograms differ in number of bins.");}
+
+  this->codes_.resize(this->codes_.size()+this->num_bins_);
+  this->scales_.emplace_back(Quantize
+    (kHistogram.data(), this->num_bins_, &this->codes_[this->codes_.size()-this->num_bins_]));
+}
+
+
+template <class T>
+void QuantizedSimilarityIndex<T>::Add(const SparseHistogram<T>& kHistogram) {
+  if (kHistogram.NumBins()!=this->num_bins_)
+    {throw std::invalid_argument("Histograms differ in number of bins.");}
+
+  // Quantize the non-zero weights only, the remaining codes stay zero
+  const auto kNumNonZeros = kHistogram.NumNonZeros();
+  std::vector<int8_t> codes(kNumNonZeros);
+  const auto kScale = Quantize(kHistogram.Weights().data(), kNumNonZeros, codes.data());
+
+  this->codes_.resize(this->codes_.size()+this->num_bins_, 0);
+  auto row = &this->codes_[this->codes_.size()-this->num_bins_];
+  for (size_t index = 0; index<kNumNonZeros; index++) {row[kHistogram.Bins()[index]] = codes[index];}
+  this->scales_.emplace_back(kScale);
+}
+
+
+template <class T>
+std::vector<T> QuantizedSimilarityIndex<T>::Similarities(const Histogram<T>& kQuery) const {
+  T query_scale;
+  const auto kQuantizedQuery = this->QuantizedQuery(this->NormalizedQuery(kQuery), query_scale);
+
+  std::vector<T> similarities(this->Size());
+  ParallelForBlocks(this->Size(), this->NumThreadsForQuery(),
+    [&](const size_t, const size_t kBegin, const size_t kEnd) {
+      for (size_t row = kBegin; row<kEnd; row++) {
+        similarities[row] = query_scale*this->scales_[row]*static_cast<T>(DenseDotProduct
+          (kQuantizedQuery.data(), &this->codes_[row*this->num_bins_], this->num_bins_));
+      }
+    });
+
+  return similarities;
+}
+
+
+template <class T>
+std::vector<T> QuantizedSimilarityIndex<T>::Similarities(const SparseHistogram<T>& kQuery) const {
+  return this->Similarities(kQuery.ToDense());
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> QuantizedSimilarityIndex<T>::Candidates
+  (const Histogram<T>& kQuery, const size_t kNumCandidates) const
+{
+  using Selector = TopKSelector<T, HigherScored<T>>;
+
+  T query_scale;
+  const auto kQuantizedQuery = this->QuantizedQuery(this->NormalizedQuery(kQuery), query_scale);
+  const auto kNumThreads = this->NumThreadsForQuery();
+
+  // Select by integer dot products, the scale of each row still matters
+  std::vector<Selector> selectors
+    (kNumThreads, Selector(std::min(kNumCandidates, this->Size()), HigherScored<T>()));
+  ParallelForBlocks(this->Size(), kNumThreads,
+    [&](const size_t kThreadIndex, const size_t kBegin, const size_t kEnd) {
+      auto& selector = selectors[kThreadIndex];
+      for (size_t row = kBegin; row<kEnd; row++) {
+        selector.Push(row, this->scales_[row]*static_cast<T>(DenseDotProduct
+          (kQuantizedQuery.data(), &this->codes_[row*this->num_bins_], this->num_bins_)));
+      }
+    });
+
+  for (size_t thread_index = 1; thread_index<kNumThreads; thread_index++)
+    {selectors[0].Merge(selectors[thread_index]);}
+
+  auto candidates = selectors[0].Sorted();
+  for (auto& candidate: candidates) {candidate.second *= query_scale;}
+  return candidates;
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> QuantizedSimilarityIndex<T>::Candidates
+  (const SparseHistogram<T>& kQuery, const size_t kNumCandidates) const
+{
+  return this->Candidates(kQuery.ToDense(), kNumCandidates);
+}
+
+
+template <class T>
+template <class HistogramLoader>
+std::vector<ScoredIndex<T>> QuantizedSimilarityIndex<T>::TopK
+  (const Histogram<T>& kQuery, const size_t kNumResults, const size_t kNumCandidates,
+   const HistogramLoader& kLoadHistogram) const
+{
+  const auto kNormalizedQuery = this->NormalizedQuery(kQuery);
+  const auto kCandidates = this->Candidates(kQuery, std::max(kNumCandidates, kNumResults));
+
+  TopKSelector<T, HigherScored<T>> selector(std::min(kNumResults, kCandidates.size()), HigherScored<T>());
+  for (const auto& kCandidate: kCandidates) {
+    selector.Push(kCandidate.first, NormalizedDotProduct(kNormalizedQuery, kLoadHistogram(kCandidate.first)));
+  }
+  return selector.Sorted();
+}
+
+
+template <class T>
+template <class HistogramLoader>
+std::vector<ScoredIndex<T>> QuantizedSimilarityIndex<T>::TopK
+  (const SparseHistogram<T>& kQuery, const size_t kNumResults, const size_t kNumCandidates,
+   const HistogramLoader& kLoadHistogram) const
+{
+  return this->TopK(kQuery.ToDense(), kNumResults, kNumCandidates, kLoadHistogram);
+}
+
+
+template <class T>
+T QuantizedSimilarityIndex<T>::Quantize(const T* kValues, const size_t kNumValues, int8_t* codes) {
+  T max_value = 0;
+  for (size_t index = 0; index<kNumValues; index++) {max_value = std::max(max_value, std::abs(kValues[index]));}
+  if (!(max_value>static_cast<T>(0))) {
+    std::fill(codes, codes+kNumValues, 0);
+    return 0;
+  }
+
+  // The largest weight maps to the largest code
+  const auto kStep = max_value/static_cast<T>(internal::kMaxQuantizedWeight);
+  for (size_t index = 0; index<kNumValues; index++) {
+    codes[index] = static_cast<int8_t>(std::lround(kValues[index]/kStep));
+  }
+
+  // Scale of a step of the normalized values
+  const auto kNorm = std::sqrt(DenseDotProduct(kValues, kValues, kNumValues));
+  return kStep/kNorm;
+}
+
+
+template <class T>
+Histogram<T> QuantizedSimilarityIndex<T>::NormalizedQuery(const Histogram<T>& kQuery) const {
+  if (kQuery.size()!=this->num_bins_ && this->Size()>0)
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  auto normalized_query = kQuery;
+  internal::NormalizeInPlace(normalized_query.data(), normalized_query.size());
+  return normalized_query;
+}
+
+
+template <class T>
+std::vector<int8_t> QuantizedSimilarityIndex<T>::QuantizedQuery
+  (const Histogram<T>& kNormalizedQuery, T& scale) const
+{
+  std::vector<int8_t> codes(kNormalizedQuery.size());
+  scale = Quantize(kNormalizedQuery.data(), kNormalizedQuery.size(), codes.data());
+  return codes;
+}
+
+
+template <class T>
+T QuantizedSimilarityIndex<T>::NormalizedDotProduct
+  (const Histogram<T>& kNormalizedQuery, const Histogram<T>& kHistogram)
+{
+  if (kHistogram.size()!=kNormalizedQuery.size()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto kNorm = std::sqrt(DenseDotProduct(kHistogram.data(), kHistogram.data(), kHistogram.size()));
+  if (!(kNorm>static_cast<T>(0))) {return 0;}
+  return DenseDotProduct(kNormalizedQuery.data(), kHistogram.data(), kHistogram.size())/kNorm;
+}
+
+
+template <class T>
+T QuantizedSimilarityIndex<T>::NormalizedDotProduct
+  (const Histogram<T>& kNormalizedQuery, const SparseHistogram<T>& kHistogram)
+{
+  if (kHistogram.NumBins()!=kNormalizedQuery.size()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto& kWeights = kHistogram.Weights();
+  const auto kNorm = std::sqrt(DenseDotProduct(kWeights.data(), kWeights.data(), kWeights.size()));
+  if (!(kNorm>static_cast<T>(0))) {return 0;}
+  return SparseDenseDotProduct
+    (kHistogram.Bins().data(), kWeights.data(), kWeights.size(), kNormalizedQuery.data())/kNorm;
+}
+
+
+template <class T>
+size_t QuantizedSimilarityIndex<T>::NumThreadsForQuery() const {
+  // Starting threads only pays off for enough work per thread
+  const size_t kMinWorkPerThread = static_cast<size_t>(1)<<20;
+  const auto kWork = this->codes_.size();
+  return std::max(std::min(this->num_threads_, kWork/kMinWorkPerThread), static_cast<size_t>(1));
+}
+
+} // namespace igg
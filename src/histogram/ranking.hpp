@@ -0,0 +1,132 @@
+#ifndef CPP_FINAL_PROJECT_HISTOGRAM_RANKING_HPP_
+#define CPP_FINAL_PROJECT_HISTOGRAM_RANKING_HPP_
+
+/**
+ * @file ranking.hpp
+ *
+ * The purpose of this file is to provide partial ordering of similarity scores,
+ * i.e. the most and least similar items, without sorting all of them.
+ *
+ * Results are pairs of the position of the score (e.g. the index of an image in
+ * the dataset) and the score.
+ */
+
+#include <utility>
+#include <vector>
+
+
+namespace igg {
+
+template <class T>
+using ScoredIndex = std::pair<size_t, T>;
+
+/**
+ * Order of top results: higher score first, lower index on ties.
+ */
+template <class T>
+bool IsHigherScored(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2);
+
+/**
+ * Order of bottom results: lower score first, lower index on ties.
+ */
+template <class T>
+bool IsLowerScored(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2);
+
+/**
+ * Function objects of the orders above. Prefer these over function pointers
+ * as Compare of TopKSelector, so comparisons can be inlined.
+ */
+template <class T>
+struct HigherScored {
+  bool operator()(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2) const
+    {return IsHigherScored(kResult1, kResult2);}
+};
+
+template <class T>
+struct LowerScored {
+  bool operator()(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2) const
+    {return IsLowerScored(kResult1, kResult2);}
+};
+
+/**
+ * Keeps the best kNumResults of a sequence of scored indices in a bounded heap,
+ * where best means first according to Compare (e.g. HigherScored).
+ * Costs O(log kNumResults) per pushed result.
+ */
+template <class T, class Compare>
+class TopKSelector {
+public:
+  TopKSelector(const size_t kNumResults, const Compare& kCompare);
+
+  void Push(const size_t kIndex, const T kScore);
+
+  /**
+   * Add all results kept by another selector.
+   */
+  void Merge(const TopKSelector<T, Compare>& kOther);
+
+  /**
+   * True if kNumResults results are kept, so further results have to beat Worst().
+   */
+  bool IsFull() const {return this->heap_.size()>=this->num_results_;}
+
+  /**
+   * The worst kept result. Requires at least one kept result.
+   */
+  const ScoredIndex<T>& Worst() const {return this->heap_.front();}
+
+  /**
+   * The kept results, best first.
+   */
+  std::vector<ScoredIndex<T>> Sorted() const;
+
+private:
+  size_t num_results_;
+  Compare compare_;
+  // Worst kept result on top
+  std::vector<ScoredIndex<T>> heap_;
+};
+
+/**
+ * Most and least similar results, each ordered beginning with the most extreme one.
+ */
+template <class T>
+struct Ranking {
+  std::vector<ScoredIndex<T>> top;
+  std::vector<ScoredIndex<T>> bottom;
+};
+
+/**
+ * Select the kNumTop highest and kNumBottom lowest scores in a single pass.
+ *
+ * Requires O(N log k) time instead of O(N log N) for a full sort. Large inputs are
+ * split over several threads, each keeping its own selection, which are merged.
+ *
+ * @param kNumThreads Maximum number of threads, 0 to use all hardware threads.
+ */
+template <class T>
+Ranking<T> RankScores
+  (const std::vector<T>& kScores,
+   const size_t kNumTop,
+   const size_t kNumBottom,
+   const size_t kNumThreads = 0);
+
+/**
+ * The kNumResults highest scores, highest first. See RankScores.
+ */
+template <class T>
+std::vector<ScoredIndex<T>> TopKScores
+  (const std::vector<T>& kScores, const size_t kNumResults, const size_t kNumThreads = 0);
+
+/**
+ * The kNumResults lowest scores, lowest first. See RankScores.
+ */
+template <class T>
+std::vector<ScoredIndex<T>> BottomKScores
+  (const std::vector<T>& kScores, const size_t kNumResults, const size_t kNumThreads = 0);
+
+} // namespace igg
+
+#include "ranking.ipp"
+
+#endif // CPP_FINAL_PROJECT_HISTOGRAM_RANKING_HPP_
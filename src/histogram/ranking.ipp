@@ -0,0 +1,121 @@
+
+
+#include <algorithm>
+
+#include "tools/parallel.hpp"
+
+
+namespace igg {
+
+template <class T>
+bool IsHigherScored(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2) {
+  return kResult1.second>kResult2.second ||
+    (kResult1.second==kResult2.second && kResult1.first<kResult2.first);
+}
+
+
+template <class T>
+bool IsLowerScored(const ScoredIndex<T>& kResult1, const ScoredIndex<T>& kResult2) {
+  return kResult1.second<kResult2.second ||
+    (kResult1.second==kResult2.second && kResult1.first<kResult2.first);
+}
+
+
+template <class T, class Compare>
+TopKSelector<T, Compare>::TopKSelector(const size_t kNumResults, const Compare& kCompare):
+  num_results_{kNumResults}, compare_{kCompare}
+{
+  this->heap_.reserve(kNumResults);
+}
+
+
+template <class T, class Compare>
+void TopKSelector<T, Compare>::Push(const size_t kIndex, const T kScore) {
+  if (this->num_results_==0) {return;}
+
+  const ScoredIndex<T> kResult{kIndex, kScore};
+  if (this->heap_.size()<this->num_results_) {
+    this->heap_.emplace_back(kResult);
+    std::push_heap(this->heap_.begin(), this->heap_.end(), this->compare_);
+  } else if (this->compare_(kResult, this->heap_.front())) {
+    std::pop_heap(this->heap_.begin(), this->heap_.end(), this->compare_);
+    this->heap_.back() = kResult;
+    std::push_heap(this->heap_.begin(), this->heap_.end(), this->compare_);
+  }
+}
+
+
+template <class T, class Compare>
+void TopKSelector<T, Compare>::Merge(const TopKSelector<T, Compare>& kOther) {
+  for (const auto& kResult: kOther.heap_) {this->Push(kResult.first, kResult.second);}
+}
+
+
+template <class T, class Compare>
+std::vector<ScoredIndex<T>> TopKSelector<T, Compare>::Sorted() const {
+  auto sorted = this->heap_;
+  std::sort_heap(sorted.begin(), sorted.end(), this->compare_);
+  return sorted;
+}
+
+
+template <class T>
+Ranking<T> RankScores
+  (const std::vector<T>& kScores,
+   const size_t kNumTop,
+   const size_t kNumBottom,
+   const size_t kNumThreads)
+{
+  using TopSelector = TopKSelector<T, HigherScored<T>>;
+  using BottomSelector = TopKSelector<T, LowerScored<T>>;
+
+  // Starting threads only pays off for enough scores per thread
+  const size_t kMinScoresPerThread = static_cast<size_t>(1)<<16;
+  const auto kNumScores = kScores.size();
+  const auto kNumUsedThreads = std::max(std::min
+    (kNumThreads==0 ? DefaultNumThreads() : kNumThreads, kNumScores/kMinScoresPerThread),
+     static_cast<size_t>(1));
+
+  std::vector<TopSelector> top_selectors
+    (kNumUsedThreads, TopSelector(std::min(kNumTop, kNumScores), HigherScored<T>()));
+  std::vector<BottomSelector> bottom_selectors
+    (kNumUsedThreads, BottomSelector(std::min(kNumBottom, kNumScores), LowerScored<T>()));
+
+  ParallelForBlocks(kNumScores, kNumUsedThreads,
+    [&](const size_t kThreadIndex, const size_t kBegin, const size_t kEnd) {
+      auto& top_selector = top_selectors[kThreadIndex];
+      auto& bottom_selector = bottom_selectors[kThreadIndex];
+      for (size_t index = kBegin; index<kEnd; index++) {
+        top_selector.Push(index, kScores[index]);
+        bottom_selector.Push(index, kScores[index]);
+      }
+    });
+
+  for (size_t thread_index = 1; thread_index<kNumUsedThreads; thread_index++) {
+    top_selectors[0].Merge(top_selectors[thread_index]);
+    bottom_selectors[0].Merge(bottom_selectors[thread_index]);
+  }
+
+  Ranking<T> ranking;
+  ranking.top = top_selectors[0].Sorted();
+  ranking.bottom = bottom_selectors[0].Sorted();
+  return ranking;
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> TopKScores
+  (const std::vector<T>& kScores, const size_t kNumResults, const size_t kNumThreads)
+{
+  return RankScores(kScores, kNumResults, 0, kNumThreads).top;
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> BottomKScores
+  (const std::vector<T>& kScores, const size_t kNumResults, const size_t kNumThreads)
+{
+  return RankScores(kScores, 0, kNumResults, kNumThreads).bottom;
+}
+
+} // namespace igg
@@ -0,0 +1,136 @@
+#ifndef CPP_FINAL_PROJECT_HISTOGRAM_SIMILARITY_INDEX_HPP_
+#define CPP_FINAL_PROJECT_HISTOGRAM_SIMILARITY_INDEX_HPP_
+
+
+#include <utility>
+#include <vector>
+
+#include "histogram.hpp"
+#include "sparse_histogram.hpp"
+#include "ranking.hpp"
+
+
+namespace igg {
+
+/**
+ * Cosine similarity search over a fixed set of histograms.
+ *
+ * The histograms are L2-normalized once on construction and stored in one
+ * contiguous row-major matrix, so a query is a single sweep of dot products
+ * (vectorized, see tools/simd.hpp) split over several threads. Equivalent to
+ * ComputeSimilarities, but without the per-query normalization.
+ *
+ * If only a small fraction of all bins is non-zero (large vocabularies), the
+ * histograms are stored in compressed sparse rows instead, so the cost of a
+ * query is proportional to the number of non-zero bins.
+ *
+ * Histograms (and queries) with all-zero bins have similarity 0 to everything.
+ *
+ * Usage:
+ *
+ *   const SimilarityIndex<float> kIndex(histograms);
+ *   const auto kSimilarities = kIndex.Similarities(query_histogram);
+ *   const auto kTop10 = kIndex.TopK(query_histogram, 10);
+ */
+template <class T>
+class SimilarityIndex {
+public:
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if the histograms do not all
+   * have the same number of bins.
+   *
+   * @param kHistograms Histograms to search.
+   * @param kNumThreads Maximum number of threads per query, 0 to use all hardware threads.
+   * Small indices are always searched by a single thread.
+   */
+  explicit SimilarityIndex
+    (const std::vector<Histogram<T>>& kHistograms, const size_t kNumThreads = 0);
+
+  /**
+   * Constructor. See above.
+   */
+  explicit SimilarityIndex
+    (const std::vector<SparseHistogram<T>>& kHistograms, const size_t kNumThreads = 0);
+
+  /**
+   * Number of histograms.
+   */
+  size_t Size() const {return this->num_rows_;}
+
+  /**
+   * Number of bins of each histogram.
+   */
+  size_t NumBins() const {return this->num_bins_;}
+
+  /**
+   * True, if the histograms are stored as sparse rows.
+   */
+  bool IsSparse() const {return this->is_sparse_;}
+
+  /**
+   * Cosine similarity of the query to each histogram, in order.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<T> Similarities(const Histogram<T>& kQuery) const;
+  std::vector<T> Similarities(const SparseHistogram<T>& kQuery) const;
+
+  /**
+   * The kNumResults most similar histograms as pairs of index and similarity,
+   * most similar first. Ties are broken by the lower index. Uses a bounded heap
+   * per thread instead of sorting all.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<ScoredIndex<T>> TopK(const Histogram<T>& kQuery, const size_t kNumResults) const;
+  std::vector<ScoredIndex<T>> TopK(const SparseHistogram<T>& kQuery, const size_t kNumResults) const;
+
+  /**
+   * Like TopK(), but for a query which is L2-normalized already (NumBins() values),
+   * searched by the calling thread only and without copying the query. Meant for
+   * many concurrent queries, see QueryEngine.
+   */
+  std::vector<ScoredIndex<T>> TopKNormalized(const T* kNormalizedQuery, const size_t kNumResults) const;
+
+  /**
+   * TopKNormalized() for several queries at once, as a blocked matrix-matrix product:
+   * the histograms are swept once, and each block of rows is scored against all queries
+   * while it is in the cache, instead of sweeping all histograms once per query. Uses
+   * several threads like TopK().
+   *
+   * @return The results of each query, in the order of the queries.
+   */
+  std::vector<std::vector<ScoredIndex<T>>> TopKNormalizedBatch
+    (const std::vector<const T*>& kNormalizedQueries, const size_t kNumResults) const;
+
+private:
+  size_t num_rows_;
+  size_t num_bins_;
+  size_t num_threads_;
+  bool is_sparse_;
+  // Normalized histograms, one per row, if stored densely
+  std::vector<T> matrix_;
+  // Normalized histograms, if stored sparse. Row r consists of the bins and weights
+  // from row_offsets_[r] (inclusive) to row_offsets_[r+1] (exclusive).
+  std::vector<size_t> row_offsets_;
+  std::vector<typename SparseHistogram<T>::BinType> sparse_bins_;
+  std::vector<T> sparse_weights_;
+
+  void AddRow(const Histogram<T>& kHistogram);
+  void AddRow(const SparseHistogram<T>& kHistogram);
+
+  Histogram<T> NormalizedQuery(const Histogram<T>& kQuery) const;
+
+  // Dot product of a normalized dense query and a row
+  T RowDotProduct(const T* kQuery, const size_t kRow) const;
+
+  size_t NumThreadsForQuery() const;
+};
+
+} // namespace igg
+
+#include "similarity_index.ipp"
+
+#endif // CPP_FINAL_PROJECT_HISTOGRAM_SIMILARITY_INDEX_HPP_
@@ -0,0 +1,254 @@
+
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "tools/simd.hpp"
+#include "tools/parallel.hpp"
+
+
+namespace igg {
+
+namespace internal {
+
+// Scale a histogram to unit L2 norm, leave it unchanged if all bins are zero
+template <class T>
+void NormalizeInPlace(T* histogram, const size_t kNumBins) {
+  const auto kNorm = std::sqrt(DenseDotProduct(histogram, histogram, kNumBins));
+  if (!(kNorm>static_cast<T>(0))) {return;}
+  for (size_t bin = 0; bin<kNumBins; bin++) {histogram[bin] /= kNorm;}
+}
+
+// Sparse rows pay off if at most this fraction of all bins is non-zero.
+// Accessing the query per non-zero bin is slower than the vectorized dense sweep,
+// so this is well below the break-even point in memory.
+const double kMaxSparseIndexDensity = 0.1;
+
+// Rows scored against all queries of a batch at once, about a fraction of the L2 cache,
+// so the queries fit alongside
+const size_t kBatchBlockBytes = 128*1024;
+
+} // namespace internal
+
+
+template <class T>
+SimilarityIndex<T>::SimilarityIndex
+  (const std::vector<Histogram<T>>& kHistograms, const size_t kNumThreads):
+  num_rows_{kHistograms.size()},
+  num_bins_{kHistograms.empty() ? 0 : kHistograms[0].size()},
+  num_threads_{kNumThreads==0 ? DefaultNumThreads() : kNumThreads},
+  row_offsets_{0}
+{
+  size_t num_non_zeros = 0;
+  for (const auto& kHistogram: kHistograms) {
+    if (kHistogram.size()!=this->num_bins_)
+      {throw std::invalid_argument("Histograms differ in number of bins.");}
+    num_non_zeros += this->num_bins_-static_cast<size_t>
+      (std::count(kHistogram.begin(), kHistogram.end(), static_cast<T>(0)));
+  }
+  this->is_sparse_ = num_non_zeros<internal::kMaxSparseIndexDensity*this->num_rows_*this->num_bins_;
+
+  if (this->is_sparse_) {
+    this->sparse_bins_.reserve(num_non_zeros);
+    this->sparse_weights_.reserve(num_non_zeros);
+    for (const auto& kHistogram: kHistograms) {this->AddRow(SparseHistogram<T>::FromDense(kHistogram));}
+  } else {
+    this->matrix_.reserve(this->num_rows_*this->num_bins_);
+    for (const auto& kHistogram: kHistograms) {this->AddRow(kHistogram);}
+  }
+}
+
+
+template <class T>
+SimilarityIndex<T>::SimilarityIndex
+  (const std::vector<SparseHistogram<T>>& kHistograms, const size_t kNumThreads):
+  num_rows_{kHistograms.size()},
+  num_bins_{kHistograms.empty() ? 0 : kHistograms[0].NumBins()},
+  num_threads_{kNumThreads==0 ? DefaultNumThreads() : kNumThreads},
+  row_offsets_{0}
+{
+  size_t num_non_zeros = 0;
+  for (const auto& kHistogram: kHistograms) {
+    if (kHistogram.NumBins()!=this->num_bins_)
+      {throw std::invalid_argument("Histograms differ in number of bins.");}
+    num_non_zeros += kHistogram.NumNonZeros();
+  }
+  this->is_sparse_ = num_non_zeros<internal::kMaxSparseIndexDensity*this->num_rows_*this->num_bins_;
+
+  if (this->is_sparse_) {
+    this->sparse_bins_.reserve(num_non_zeros);
+    this->sparse_weights_.reserve(num_non_zeros);
+    for (const auto& kHistogram: kHistograms) {this->AddRow(kHistogram);}
+  } else {
+    this->matrix_.reserve(this->num_rows_*this->num_bins_);
+    for (const auto& kHistogram: kHistograms) {this->AddRow(kHistogram.ToDense());}
+  }
+}
+
+
+template <class T>
+std::vector<T> SimilarityIndex<T>::Similarities(const Histogram<T>& kQuery) const {
+  const auto kNormalizedQuery = this->NormalizedQuery(kQuery);
+
+  std::vector<T> similarities(this->num_rows_);
+  ParallelForBlocks(this->num_rows_, this->NumThreadsForQuery(),
+    [&](const size_t, const size_t kBegin, const size_t kEnd) {
+      for (size_t row = kBegin; row<kEnd; row++) {
+        similarities[row] = this->RowDotProduct(kNormalizedQuery.data(), row);
+      }
+    });
+
+  return similarities;
+}
+
+
+template <class T>
+std::vector<T> SimilarityIndex<T>::Similarities(const SparseHistogram<T>& kQuery) const {
+  return this->Similarities(kQuery.ToDense());
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> SimilarityIndex<T>::TopK
+  (const Histogram<T>& kQuery, const size_t kNumResults) const
+{
+  using Selector = TopKSelector<T, HigherScored<T>>;
+
+  const auto kNormalizedQuery = this->NormalizedQuery(kQuery);
+  const auto kNumThreads = this->NumThreadsForQuery();
+
+  std::vector<Selector> selectors
+    (kNumThreads, Selector(std::min(kNumResults, this->num_rows_), HigherScored<T>()));
+  ParallelForBlocks(this->num_rows_, kNumThreads,
+    [&](const size_t kThreadIndex, const size_t kBegin, const size_t kEnd) {
+      auto& selector = selectors[kThreadIndex];
+      for (size_t row = kBegin; row<kEnd; row++) {
+        selector.Push(row, this->RowDotProduct(kNormalizedQuery.data(), row));
+      }
+    });
+
+  for (size_t thread_index = 1; thread_index<kNumThreads; thread_index++)
+    {selectors[0].Merge(selectors[thread_index]);}
+
+  return selectors[0].Sorted();
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> SimilarityIndex<T>::TopK
+  (const SparseHistogram<T>& kQuery, const size_t kNumResults) const
+{
+  return this->TopK(kQuery.ToDense(), kNumResults);
+}
+
+
+template <class T>
+std::vector<ScoredIndex<T>> SimilarityIndex<T>::TopKNormalized
+  (const T* kNormalizedQuery, const size_t kNumResults) const
+{
+  TopKSelector<T, HigherScored<T>> selector(std::min(kNumResults, this->num_rows_), HigherScored<T>());
+  for (size_t row = 0; row<this->num_rows_; row++) {
+    selector.Push(row, this->RowDotProduct(kNormalizedQuery, row));
+  }
+  return selector.Sorted();
+}
+
+
+template <class T>
+std::vector<std::vector<ScoredIndex<T>>> SimilarityIndex<T>::TopKNormalizedBatch
+  (const std::vector<const T*>& kNormalizedQueries, const size_t kNumResults) const
+{
+  using Selector = TopKSelector<T, HigherScored<T>>;
+
+  const auto kNumQueries = kNormalizedQueries.size();
+  const auto kNumThreads = this->NumThreadsForQuery();
+  const Selector kEmptySelector(std::min(kNumResults, this->num_rows_), HigherScored<T>());
+  std::vector<std::vector<Selector>> selectors
+    (kNumThreads, std::vector<Selector>(kNumQueries, kEmptySelector));
+
+  const auto kRowBytes = this->is_sparse_ ?
+    (sizeof(T)+sizeof(typename SparseHistogram<T>::BinType))*
+      std::max(this->sparse_weights_.size()/std::max(this->num_rows_, static_cast<size_t>(1)), static_cast<size_t>(1)) :
+    sizeof(T)*std::max(this->num_bins_, static_cast<size_t>(1));
+  const auto kBlockSize = std::max(internal::kBatchBlockBytes/kRowBytes, static_cast<size_t>(1));
+
+  ParallelForBlocks(this->num_rows_, kNumThreads,
+    [&](const size_t kThreadIndex, const size_t kBegin, const size_t kEnd) {
+      auto& thread_selectors = selectors[kThreadIndex];
+      for (size_t block_begin = kBegin; block_begin<kEnd; block_begin += kBlockSize) {
+        const auto kBlockEnd = std::min(block_begin+kBlockSize, kEnd);
+        for (size_t query = 0; query<kNumQueries; query++) {
+          auto& selector = thread_selectors[query];
+          for (size_t row = block_begin; row<kBlockEnd; row++) {
+            selector.Push(row, this->RowDotProduct(kNormalizedQueries[query], row));
+          }
+        }
+      }
+    });
+
+  std::vector<std::vector<ScoredIndex<T>>> results;
+  results.reserve(kNumQueries);
+  for (size_t query = 0; query<kNumQueries; query++) {
+    for (size_t thread_index = 1; thread_index<kNumThreads; thread_index++)
+      {selectors[0][query].Merge(selectors[thread_index][query]);}
+    results.emplace_back(selectors[0][query].Sorted());
+  }
+  return results;
+}
+
+
+template <class T>
+void SimilarityIndex<T>::AddRow(const Histogram<T>& kHistogram) {
+  this->matrix_.insert(this->matrix_.end(), kHistogram.begin(), kHistogram.end());
+  internal::NormalizeInPlace(&this->matrix_[this->matrix_.size()-this->num_bins_], this->num_bins_);
+}
+
+
+template <class T>
+void SimilarityIndex<T>::AddRow(const SparseHistogram<T>& kHistogram) {
+  this->sparse_bins_.insert
+    (this->sparse_bins_.end(), kHistogram.Bins().begin(), kHistogram.Bins().end());
+  this->sparse_weights_.insert
+    (this->sparse_weights_.end(), kHistogram.Weights().begin(), kHistogram.Weights().end());
+  this->row_offsets_.emplace_back(this->sparse_weights_.size());
+
+  const auto kNumNonZeros = kHistogram.NumNonZeros();
+  if (kNumNonZeros>0) {
+    internal::NormalizeInPlace(&this->sparse_weights_[this->sparse_weights_.size()-kNumNonZeros], kNumNonZeros);
+  }
+}
+
+
+template <class T>
+T SimilarityIndex<T>::RowDotProduct(const T* kQuery, const size_t kRow) const {
+  if (!this->is_sparse_)
+    {return DenseDotProduct(kQuery, &this->matrix_[kRow*this->num_bins_], this->num_bins_);}
+
+  const auto kBegin = this->row_offsets_[kRow];
+  return SparseDenseDotProduct
+    (this->sparse_bins_.data()+kBegin, this->sparse_weights_.data()+kBegin,
+     this->row_offsets_[kRow+1]-kBegin, kQuery);
+}
+
+
+template <class T>
+Histogram<T> SimilarityIndex<T>::NormalizedQuery(const Histogram<T>& kQuery) const {
+  if (kQuery.size()!=this->num_bins_ && this->num_rows_>0)
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  auto normalized_query = kQuery;
+  internal::NormalizeInPlace(normalized_query.data(), normalized_query.size());
+  return normalized_query;
+}
+
+
+template <class T>
+size_t SimilarityIndex<T>::NumThreadsForQuery() const {
+  // Starting threads only pays off for enough work per thread
+  const size_t kMinWorkPerThread = static_cast<size_t>(1)<<18;
+  const auto kWork = this->is_sparse_ ? this->sparse_weights_.size() : this->num_rows_*this->num_bins_;
+  return std::max(std::min(this->num_threads_, kWork/kMinWorkPerThread), static_cast<size_t>(1));
+}
+
+} // namespace igg
@@ -0,0 +1,125 @@
+#ifndef CPP_FINAL_PROJECT_HISTOGRAM_SPARSE_HISTOGRAM_HPP_
+#define CPP_FINAL_PROJECT_HISTOGRAM_SPARSE_HISTOGRAM_HPP_
+
+/**
+ * @file sparse_histogram.hpp
+ *
+ * The purpose of this file is to provide a histogram representation that only
+ * stores non-zero bins. With large vocabularies, an image only contains a small
+ * fraction of all words, so most bins of a dense Histogram<T> are zero.
+ */
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "histogram.hpp"
+
+
+namespace igg {
+
+/**
+ * Histogram given by its non-zero bins in increasing order and their weights.
+ *
+ * Usage:
+ *
+ *   const auto kSparse = SparseHistogram<float>::FromDense(histogram);
+ *   const auto kSimilarity = SparseDotProduct(kSparse, kOtherSparse);
+ */
+template <class T>
+class SparseHistogram {
+public:
+  using BinType = uint32_t;
+
+  /**
+   * Constructor. All kNumBins bins are zero.
+   */
+  explicit SparseHistogram(const size_t kNumBins = 0): num_bins_{kNumBins} {}
+
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if bins and weights differ in size,
+   * or the bins are not strictly increasing and smaller than kNumBins.
+   */
+  SparseHistogram(const size_t kNumBins, std::vector<BinType> bins, std::vector<T> weights);
+
+  /**
+   * Keep the non-zero bins of a dense histogram.
+   */
+  static SparseHistogram<T> FromDense(const Histogram<T>& kHistogram);
+
+  Histogram<T> ToDense() const;
+
+  /**
+   * Total number of bins, including the zero ones.
+   */
+  size_t NumBins() const {return this->num_bins_;}
+
+  size_t NumNonZeros() const {return this->bins_.size();}
+
+  /**
+   * Fraction of non-zero bins.
+   */
+  double Density() const;
+
+  const std::vector<BinType>& Bins() const {return this->bins_;}
+  const std::vector<T>& Weights() const {return this->weights_;}
+
+private:
+  size_t num_bins_;
+  std::vector<BinType> bins_;
+  std::vector<T> weights_;
+};
+
+/**
+ * Dot product of two sparse histograms by merging their bins, which costs
+ * O(number of non-zero bins).
+ *
+ * Throws an instance of std::invalid_argument if the number of bins does not match.
+ */
+template <class T>
+T SparseDotProduct(const SparseHistogram<T>& kHistogram1, const SparseHistogram<T>& kHistogram2);
+
+/**
+ * Squared L2 distance of two sparse histograms by merging their bins.
+ *
+ * Throws an instance of std::invalid_argument if the number of bins does not match.
+ */
+template <class T>
+T SparseSquaredL2Distance(const SparseHistogram<T>& kHistogram1, const SparseHistogram<T>& kHistogram2);
+
+/**
+ * Dot product of a sparse and a dense histogram.
+ *
+ * Throws an instance of std::invalid_argument if the number of bins does not match.
+ */
+template <class T>
+T SparseDenseDotProduct(const SparseHistogram<T>& kHistogram1, const Histogram<T>& kHistogram2);
+
+
+template <class PointType>
+struct HnswPointTraits;
+
+/**
+ * Lets HnswIndex search sparse histograms, which are stored with their non-zero bins
+ * only. See hnsw_index.hpp.
+ */
+template <class T>
+struct HnswPointTraits<SparseHistogram<T>> {
+  using ScalarType = T;
+
+  static size_t Dimension(const SparseHistogram<T>& kPoint) {return kPoint.NumBins();}
+
+  static T SquaredDistance(const SparseHistogram<T>& kPoint1, const SparseHistogram<T>& kPoint2)
+    {return SparseSquaredL2Distance(kPoint1, kPoint2);}
+
+  static void Write(std::ostream& file, const SparseHistogram<T>& kPoint);
+  static SparseHistogram<T> Read(std::istream& file, const size_t kDimension);
+};
+
+} // namespace igg
+
+#include "sparse_histogram.ipp"
+
+#endif // CPP_FINAL_PROJECT_HISTOGRAM_SPARSE_HISTOGRAM_HPP_
@@ -0,0 +1,154 @@
+
+
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+#include "tools/simd.hpp"
+
+
+namespace igg {
+
+template <class T>
+SparseHistogram<T>::SparseHistogram
+  (const size_t kNumBins, std::vector<BinType> bins, std::vector<T> weights):
+  num_bins_{kNumBins}, bins_{std::move(bins)}, weights_{std::move(weights)}
+{
+  if (this->bins_.size()!=this->weights_.size())
+    {throw std::invalid_argument("Number of bins and weights does not match.");}
+
+  for (size_t index = 0; index<this->bins_.size(); index++) {
+    if (this->bins_[index]>=kNumBins || (index>0 && this->bins_[index]<=this->bins_[index-1]))
+      {throw std::invalid_argument("Bins are not strictly increasing or out of range.");}
+  }
+}
+
+
+template <class T>
+SparseHistogram<T> SparseHistogram<T>::FromDense(const Histogram<T>& kHistogram) {
+  SparseHistogram<T> sparse(kHistogram.size());
+  for (size_t bin = 0; bin<kHistogram.size(); bin++) {
+    if (kHistogram[bin]!=static_cast<T>(0)) {
+      sparse.bins_.emplace_back(static_cast<BinType>(bin));
+      sparse.weights_.emplace_back(kHistogram[bin]);
+    }
+  }
+  return sparse;
+}
+
+
+template <class T>
+Histogram<T> SparseHistogram<T>::ToDense() const {
+  Histogram<T> histogram(this->num_bins_, static_cast<T>(0));
+  for (size_t index = 0; index<this->bins_.size(); index++) {
+    histogram[this->bins_[index]] = this->weights_[index];
+  }
+  return histogram;
+}
+
+
+template <class T>
+double SparseHistogram<T>::Density() const {
+  if (this->num_bins_==0) {return 0.0;}
+  return static_cast<double>(this->bins_.size())/static_cast<double>(this->num_bins_);
+}
+
+
+template <class T>
+T SparseDotProduct(const SparseHistogram<T>& kHistogram1, const SparseHistogram<T>& kHistogram2) {
+  if (kHistogram1.NumBins()!=kHistogram2.NumBins())
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto& kBins1 = kHistogram1.Bins();
+  const auto& kBins2 = kHistogram2.Bins();
+  const auto& kWeights1 = kHistogram1.Weights();
+  const auto& kWeights2 = kHistogram2.Weights();
+
+  T sum = 0;
+  size_t index1 = 0;
+  size_t index2 = 0;
+  while (index1<kBins1.size() && index2<kBins2.size()) {
+    if (kBins1[index1]<kBins2[index2]) {
+      index1++;
+    } else if (kBins2[index2]<kBins1[index1]) {
+      index2++;
+    } else {
+      sum += kWeights1[index1]*kWeights2[index2];
+      index1++;
+      index2++;
+    }
+  }
+
+  return sum;
+}
+
+
+template <class T>
+T SparseSquaredL2Distance(const SparseHistogram<T>& kHistogram1, const SparseHistogram<T>& kHistogram2) {
+  if (kHistogram1.NumBins()!=kHistogram2.NumBins())
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto& kBins1 = kHistogram1.Bins();
+  const auto& kBins2 = kHistogram2.Bins();
+  const auto& kWeights1 = kHistogram1.Weights();
+  const auto& kWeights2 = kHistogram2.Weights();
+
+  // Bins contained in only one of the histograms count with their full weight
+  T sum = 0;
+  size_t index1 = 0;
+  size_t index2 = 0;
+  while (index1<kBins1.size() || index2<kBins2.size()) {
+    if (index2==kBins2.size() || (index1<kBins1.size() && kBins1[index1]<kBins2[index2])) {
+      sum += kWeights1[index1]*kWeights1[index1];
+      index1++;
+    } else if (index1==kBins1.size() || kBins2[index2]<kBins1[index1]) {
+      sum += kWeights2[index2]*kWeights2[index2];
+      index2++;
+    } else {
+      const T kDifference = kWeights1[index1]-kWeights2[index2];
+      sum += kDifference*kDifference;
+      index1++;
+      index2++;
+    }
+  }
+
+  return sum;
+}
+
+
+template <class T>
+T SparseDenseDotProduct(const SparseHistogram<T>& kHistogram1, const Histogram<T>& kHistogram2) {
+  if (kHistogram1.NumBins()!=kHistogram2.size())
+    {throw std::invalid_argument("Dimension mismatch.");}
+
+  return SparseDenseDotProduct
+    (kHistogram1.Bins().data(), kHistogram1.Weights().data(),
+     kHistogram1.NumNonZeros(), kHistogram2.data());
+}
+
+
+
+template <class T>
+void HnswPointTraits<SparseHistogram<T>>::Write(std::ostream& file, const SparseHistogram<T>& kPoint) {
+  const uint64_t kNumNonZeros = kPoint.NumNonZeros();
+  file.write(reinterpret_cast<const char*>(&kNumNonZeros), sizeof(uint64_t));
+  file.write(reinterpret_cast<const char*>(kPoint.Bins().data()),
+             sizeof(typename SparseHistogram<T>::BinType)*kNumNonZeros);
+  file.write(reinterpret_cast<const char*>(kPoint.Weights().data()), sizeof(T)*kNumNonZeros);
+}
+
+
+template <class T>
+SparseHistogram<T> HnswPointTraits<SparseHistogram<T>>::Read(std::istream& file, const size_t kDimension) {
+  uint64_t num_non_zeros = 0;
+  file.read(reinterpret_cast<char*>(&num_non_zeros), sizeof(uint64_t));
+  if (!file || num_non_zeros>kDimension) {throw std::runtime_error("Cannot read sparse histogram.");}
+  std::vector<typename SparseHistogram<T>::BinType> bins(num_non_zeros);
+  std::vector<T> weights(num_non_zeros);
+  file.read(reinterpret_cast<char*>(bins.data()), sizeof(typename SparseHistogram<T>::BinType)*num_non_zeros);
+  file.read(reinterpret_cast<char*>(weights.data()), sizeof(T)*num_non_zeros);
+  if (!file) {throw std::runtime_error("Cannot read sparse histogram.");}
+  return SparseHistogram<T>(kDimension, std::move(bins), std::move(weights));
+}
+
+} // namespace igg
@@ -0,0 +1,114 @@
+#ifndef CPP_FINAL_PROJECT_HISTOGRAM_VOCABULARY_PRUNING_HPP_
+#define CPP_FINAL_PROJECT_HISTOGRAM_VOCABULARY_PRUNING_HPP_
+
+/**
+ * @file vocabulary_pruning.hpp
+ *
+ * The purpose of this file is to provide the removal of uninformative visual words
+ * from histograms, applied identically when indexing a dataset and when querying it.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "histogram.hpp"
+
+
+namespace igg {
+
+/**
+ * Words to drop from all histograms (stop words) and a limit on how often a word counts
+ * within a single image (burst cap).
+ *
+ * Stop words occur in a large fraction of the images. Their re-weighting factor is
+ * close to zero anyways, but their posting lists are the longest and dominate query
+ * cost. Bursts are words occurring many times in a single image, e.g. on repetitive
+ * textures, and would dominate its histogram otherwise.
+ *
+ * Reference: Jegou, Douze, Schmid: On the burstiness of visual elements, 2009
+ *
+ * Usage:
+ *
+ *   const auto kPruning = VocabularyPruning::FromDocumentFrequencies
+ *     (num_images_per_word, num_images, 0.5, 5);
+ *   kPruning.Apply(word_counts);
+ */
+class VocabularyPruning {
+public:
+  /**
+   * Constructor. No words are pruned and counts are not limited.
+   */
+  explicit VocabularyPruning(const size_t kNumWords = 0);
+
+  /**
+   * Select the stop words by their document frequency.
+   *
+   * @param kNumImagesPerWord For each word the number of images containing it.
+   * @param kNumImages Total number of images.
+   * @param kMaxDocumentFrequency Words contained in more than this fraction of the images
+   * are stop words. Use 1.0 to keep all words.
+   * @param kMaxWordCount Largest count of a word in a single image, 0 for no limit.
+   */
+  static VocabularyPruning FromDocumentFrequencies
+    (const std::vector<size_t>& kNumImagesPerWord,
+     const size_t kNumImages,
+     const double kMaxDocumentFrequency,
+     const size_t kMaxWordCount);
+
+  size_t NumWords() const {return this->is_stop_word_.size();}
+
+  /**
+   * The stop words in increasing order.
+   */
+  const std::vector<uint32_t>& StopWords() const {return this->stop_words_;}
+
+  bool IsStopWord(const size_t kWord) const {return this->is_stop_word_[kWord];}
+
+  /**
+   * Largest count of a word in a single image, 0 for no limit.
+   */
+  size_t MaxWordCount() const {return this->max_word_count_;}
+
+  /**
+   * True if no words are pruned and counts are not limited.
+   */
+  bool IsEmpty() const {return this->stop_words_.empty() && this->max_word_count_==0;}
+
+  /**
+   * Set the counts of stop words to zero and limit the others to MaxWordCount().
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   *
+   * @param word_counts Histogram of word counts, i.e. before re-weighting.
+   */
+  template <class T>
+  void Apply(Histogram<T>& word_counts) const;
+
+  /**
+   * Write the pruning to a binary file.
+   *
+   * In case the given file already exists it is overwritten.
+   *
+   * @return True, if writing was successful.
+   */
+  bool WriteToBinary(const std::string& kPath) const;
+
+  /**
+   * Read a pruning from a binary file as written by WriteToBinary.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  static VocabularyPruning ReadFromBinary(const std::string& kPath);
+
+private:
+  std::vector<uint32_t> stop_words_;
+  std::vector<bool> is_stop_word_;
+  size_t max_word_count_;
+};
+
+} // namespace igg
+
+#include "vocabulary_pruning.ipp"
+
+#endif // CPP_FINAL_PROJECT_HISTOGRAM_VOCABULARY_PRUNING_HPP_
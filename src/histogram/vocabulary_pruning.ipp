@@ -0,0 +1,107 @@
+
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace igg {
+
+inline VocabularyPruning::VocabularyPruning(const size_t kNumWords):
+  is_stop_word_(kNumWords, false), max_word_count_{0} {}
+
+
+inline VocabularyPruning VocabularyPruning::FromDocumentFrequencies
+  (const std::vector<size_t>& kNumImagesPerWord,
+   const size_t kNumImages,
+   const double kMaxDocumentFrequency,
+   const size_t kMaxWordCount)
+{
+  if (kMaxDocumentFrequency<0.0 || kMaxDocumentFrequency>1.0) {
+    throw std::invalid_argument("Maximum document frequency has to be in [0, 1].");
+  }
+
+  VocabularyPruning pruning(kNumImagesPerWord.size());
+  pruning.max_word_count_ = kMaxWordCount;
+  for (size_t word = 0; word<kNumImagesPerWord.size(); word++) {
+    if (kNumImagesPerWord[word]>kMaxDocumentFrequency*static_cast<double>(kNumImages)) {
+      pruning.stop_words_.emplace_back(static_cast<uint32_t>(word));
+      pruning.is_stop_word_[word] = true;
+    }
+  }
+  return pruning;
+}
+
+
+template <class T>
+void VocabularyPruning::Apply(Histogram<T>& word_counts) const {
+  if (word_counts.size()!=this->NumWords()) {
+    throw std::invalid_argument("Histogram does not match number of words of pruning.");
+  }
+
+  for (const auto kWord: this->stop_words_) {word_counts[kWord] = T(0);}
+  if (this->max_word_count_>0) {
+    const auto kMaxCount = static_cast<T>(this->max_word_count_);
+    for (auto& count: word_counts) {count = std::min(count, kMaxCount);}
+  }
+}
+
+
+inline bool VocabularyPruning::WriteToBinary(const std::string& kPath) const {
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  // Write header information (number of words, maximum count, number of stop words)
+  size_t num_words = this->NumWords();
+  size_t max_word_count = this->max_word_count_;
+  size_t num_stop_words = this->stop_words_.size();
+  file.write(reinterpret_cast<char*>(&num_words), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&max_word_count), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_stop_words), sizeof(size_t));
+
+  // Write stop words
+  file.write(reinterpret_cast<const char*>(this->stop_words_.data()), sizeof(uint32_t)*num_stop_words);
+
+  return true;
+}
+
+
+inline VocabularyPruning VocabularyPruning::ReadFromBinary(const std::string& kPath) {
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  // Read header information
+  size_t num_words = 0;
+  size_t max_word_count = 0;
+  size_t num_stop_words = 0;
+  file.read(reinterpret_cast<char*>(&num_words), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&max_word_count), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&num_stop_words), sizeof(size_t));
+  if (!file || num_stop_words>num_words) {
+    throw std::runtime_error("Cannot read header of file "+kPath+".");
+  }
+
+  // Read stop words
+  VocabularyPruning pruning(num_words);
+  pruning.max_word_count_ = max_word_count;
+  pruning.stop_words_.resize(num_stop_words);
+  file.read(reinterpret_cast<char*>(pruning.stop_words_.data()), sizeof(uint32_t)*num_stop_words);
+  if (!file) {throw std::runtime_error("Cannot read stop words from file "+kPath+".");}
+
+  for (const auto kWord: pruning.stop_words_) {
+    if (kWord>=num_words) {throw std::runtime_error("Inconsistent stop words in file "+kPath+".");}
+    pruning.is_stop_word_[kWord] = true;
+  }
+
+  return pruning;
+}
+
+} // namespace igg
@@ -0,0 +1,332 @@
+
+#include "inverted_index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace igg {
+
+namespace {
+
+// Query weights scaled to unit L2 norm
+std::vector<float> NormalizedWeights(const SparseHistogram<float>& kHistogram) {
+  auto weights = kHistogram.Weights();
+  const auto kNorm = std::sqrt(std::inner_product(weights.begin(), weights.end(), weights.begin(), 0.0f));
+  if (kNorm>0.0f) {
+    for (auto& weight: weights) {weight /= kNorm;}
+  }
+  return weights;
+}
+
+// Looking up a posting of an image costs about as much as accumulating this many postings
+const size_t kLookupCost = 16;
+
+// Add the weights of the postings times the query weight to the scores of the images.
+// Returns the largest updated score.
+float AccumulatePostings
+  (const CompressedPostingList& kList, const float kQueryWeight, std::vector<float>& scores)
+{
+  std::array<uint32_t, CompressedPostingList::kBlockSize> image_ids;
+  std::array<float, CompressedPostingList::kBlockSize> weights;
+  float max_score = 0.0f;
+  for (size_t block = 0; block<kList.NumBlocks(); block++) {
+    const auto kNumPostings = kList.DecodeBlock(block, image_ids.data(), weights.data());
+    for (size_t posting = 0; posting<kNumPostings; posting++) {
+      auto& score = scores[image_ids[posting]];
+      score += kQueryWeight*weights[posting];
+      max_score = std::max(max_score, score);
+    }
+  }
+  return max_score;
+}
+
+// The kNumResults-th largest of the scores in a single pass over them, keeping the
+// largest ones seen so far in a heap, using heap as scratch space
+float KthLargestScore
+  (const std::vector<float>& kScores, const size_t kNumResults, std::vector<float>& heap)
+{
+  heap.assign(kScores.begin(), kScores.begin()+kNumResults);
+  std::make_heap(heap.begin(), heap.end(), std::greater<float>());
+  for (size_t index = kNumResults; index<kScores.size(); index++) {
+    if (kScores[index]>heap.front()) {
+      std::pop_heap(heap.begin(), heap.end(), std::greater<float>());
+      heap.back() = kScores[index];
+      std::push_heap(heap.begin(), heap.end(), std::greater<float>());
+    }
+  }
+  return heap.front();
+}
+
+} // namespace
+
+
+InvertedIndex::InvertedIndex(const std::vector<SparseHistogram<float>>& kHistograms):
+  num_images_{kHistograms.size()}
+{
+  const size_t kNumWords = kHistograms.empty() ? 0 : kHistograms[0].NumBins();
+
+  // Collect postings in increasing order of image ids
+  std::vector<std::vector<uint32_t>> image_ids(kNumWords);
+  std::vector<std::vector<float>> weights(kNumWords);
+  for (size_t image_id = 0; image_id<kHistograms.size(); image_id++) {
+    const auto& kHistogram = kHistograms[image_id];
+    if (kHistogram.NumBins()!=kNumWords)
+      {throw std::invalid_argument("Histograms differ in number of bins.");}
+
+    const auto kWeights = NormalizedWeights(kHistogram);
+    for (size_t index = 0; index<kHistogram.NumNonZeros(); index++) {
+      const auto kWord = kHistogram.Bins()[index];
+      image_ids[kWord].emplace_back(static_cast<uint32_t>(image_id));
+      weights[kWord].emplace_back(kWeights[index]);
+    }
+  }
+
+  this->posting_lists_.reserve(kNumWords);
+  for (size_t word = 0; word<kNumWords; word++) {
+    this->posting_lists_.emplace_back(image_ids[word], weights[word]);
+  }
+}
+
+
+size_t InvertedIndex::MemoryBytes() const {
+  size_t bytes = sizeof(InvertedIndex);
+  for (const auto& kList: this->posting_lists_) {bytes += kList.MemoryBytes();}
+  return bytes;
+}
+
+
+std::vector<float> InvertedIndex::Similarities(const SparseHistogram<float>& kQuery) const {
+  if (kQuery.NumBins()!=this->NumWords()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto kQueryWeights = NormalizedWeights(kQuery);
+
+  // Term at a time, accumulate the contribution of each query word
+  std::vector<float> similarities(this->num_images_, 0.0f);
+
+  for (size_t index = 0; index<kQuery.NumNonZeros(); index++) {
+    AccumulatePostings(this->posting_lists_[kQuery.Bins()[index]], kQueryWeights[index], similarities);
+  }
+
+  return similarities;
+}
+
+
+std::vector<ScoredIndex<float>> InvertedIndex::TopK
+  (const SparseHistogram<float>& kQuery, const size_t kNumResults) const
+{
+  return TopKScores(this->Similarities(kQuery), kNumResults);
+}
+
+
+std::vector<ScoredIndex<float>> InvertedIndex::TopKTruncated
+  (const SparseHistogram<float>& kQuery,
+   const size_t kNumResults,
+   const size_t kMaxPostings,
+   size_t* num_visited) const
+{
+  if (kQuery.NumBins()!=this->NumWords()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto kQueryWeights = NormalizedWeights(kQuery);
+
+  // Query words ordered by decreasing bound on their contribution to any image
+  std::vector<std::pair<float, size_t>> terms;
+  terms.reserve(kQuery.NumNonZeros());
+  for (size_t index = 0; index<kQuery.NumNonZeros(); index++) {
+    const auto& kList = this->posting_lists_[kQuery.Bins()[index]];
+    if (kList.Size()==0 || kQueryWeights[index]<=0.0f) {continue;}
+    terms.emplace_back(kQueryWeights[index]*kList.MaxWeight(), index);
+  }
+  std::sort(terms.begin(), terms.end(),
+    [](const std::pair<float, size_t>& kTerm1, const std::pair<float, size_t>& kTerm2)
+      {return kTerm1.first>kTerm2.first;});
+
+  std::vector<float> scores(this->num_images_, 0.0f);
+  size_t visited = 0;
+  for (const auto& kTerm: terms) {
+    const auto& kList = this->posting_lists_[kQuery.Bins()[kTerm.second]];
+    if (visited>0 && visited+kList.Size()>kMaxPostings) {break;}
+    AccumulatePostings(kList, kQueryWeights[kTerm.second], scores);
+    visited += kList.Size();
+  }
+
+  if (num_visited) {*num_visited = visited;}
+  return TopKScores(scores, kNumResults);
+}
+
+
+size_t InvertedIndex::NumPostings(const SparseHistogram<float>& kQuery) const {
+  if (kQuery.NumBins()!=this->NumWords()) {throw std::invalid_argument("Dimension mismatch.");}
+  size_t num_postings = 0;
+  for (const auto kWord: kQuery.Bins()) {num_postings += this->posting_lists_[kWord].Size();}
+  return num_postings;
+}
+
+
+std::vector<ScoredIndex<float>> InvertedIndex::TopKPruned
+  (const SparseHistogram<float>& kQuery, const size_t kNumResults) const
+{
+  if (kQuery.NumBins()!=this->NumWords()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  const auto kQueryWeights = NormalizedWeights(kQuery);
+  const auto kNumResultsUsed = std::min(kNumResults, this->num_images_);
+  if (kNumResultsUsed==0) {return {};}
+
+  // Query words ordered by decreasing bound on their contribution to any image
+  struct Term {
+    const CompressedPostingList* list;
+    float weight;
+    float bound;
+  };
+  std::vector<Term> terms;
+  terms.reserve(kQuery.NumNonZeros());
+  for (size_t index = 0; index<kQuery.NumNonZeros(); index++) {
+    const auto& kList = this->posting_lists_[kQuery.Bins()[index]];
+    if (kList.Size()==0 || kQueryWeights[index]<=0.0f) {continue;}
+    terms.push_back({&kList, kQueryWeights[index], kQueryWeights[index]*kList.MaxWeight()});
+  }
+  std::sort(terms.begin(), terms.end(),
+    [](const Term& kTerm1, const Term& kTerm2) {return kTerm1.bound>kTerm2.bound;});
+
+  // Bound on the contribution of the terms from each position on
+  std::vector<float> remaining_bounds(terms.size()+1, 0.0f);
+  for (size_t position = terms.size(); position-->0;) {
+    remaining_bounds[position] = remaining_bounds[position+1]+terms[position].bound;
+  }
+
+  // Essential terms, until the remaining ones cannot lift an image without any of them
+  // above the worst result so far (threshold)
+  std::vector<float> scores(this->num_images_, 0.0f);
+  std::vector<float> candidate_scores;
+  std::vector<float> buffer;
+  float threshold = -std::numeric_limits<float>::infinity();
+  float max_score = 0.0f;
+  size_t num_essential = 0;
+  size_t num_postings_since_update = 0;
+  for (; num_essential<terms.size(); num_essential++) {
+    // The threshold is at most the largest score, only then an update may stop the loop.
+    // Updating costs about as much as accumulating one posting per image.
+    if (remaining_bounds[num_essential]<max_score && num_postings_since_update>=this->num_images_) {
+      threshold = KthLargestScore(scores, kNumResultsUsed, buffer);
+      num_postings_since_update = 0;
+    }
+    if (remaining_bounds[num_essential]<threshold) {break;}
+
+    const auto& kTerm = terms[num_essential];
+    max_score = std::max(max_score, AccumulatePostings(*kTerm.list, kTerm.weight, scores));
+    num_postings_since_update += kTerm.list->Size();
+  }
+  if (num_essential==terms.size()) {return TopKScores(scores, kNumResultsUsed, 1);}
+
+  // Candidates which may still reach the threshold
+  std::vector<uint32_t> candidates;
+  for (size_t image_id = 0; image_id<this->num_images_; image_id++) {
+    if (scores[image_id]+remaining_bounds[num_essential]>=threshold)
+      {candidates.emplace_back(static_cast<uint32_t>(image_id));}
+  }
+
+  // Look up non-essential terms for the candidates, dropping those which cannot reach
+  // the threshold anymore. Tighter bounds from the block maxima allow to skip blocks
+  // without decoding. If there are many candidates compared to the postings, accumulating
+  // all postings is cheaper than the lookups.
+  for (size_t position = num_essential; position<terms.size(); position++) {
+    const auto& kTerm = terms[position];
+    const auto kRemainingBound = remaining_bounds[position];
+
+    if (candidates.size()*kLookupCost>=kTerm.list->Size()) {
+      AccumulatePostings(*kTerm.list, kTerm.weight, scores);
+      num_postings_since_update += kTerm.list->Size();
+      const auto kNextRemainingBound = remaining_bounds[position+1];
+      candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+        [&](const uint32_t kImageId) {return scores[kImageId]+kNextRemainingBound<threshold;}),
+        candidates.end());
+    } else {
+      PostingListCursor cursor(*kTerm.list);
+      size_t num_kept = 0;
+      for (const auto kImageId: candidates) {
+        auto& score = scores[kImageId];
+        if (score+kRemainingBound<threshold) {continue;}
+
+        cursor.SkipBlocksTo(kImageId);
+        if (score+kRemainingBound-kTerm.bound+kTerm.weight*cursor.BlockMaxWeight()<threshold) {continue;}
+
+        cursor.NextGeq(kImageId);
+        if (cursor.ImageId()==kImageId) {score += kTerm.weight*cursor.Weight();}
+        candidates[num_kept++] = kImageId;
+      }
+      num_postings_since_update += kLookupCost*candidates.size();
+      candidates.resize(num_kept);
+    }
+
+    // Partial scores of the candidates are lower bounds, so may raise the threshold.
+    // Updating costs about as much as accumulating one posting per candidate.
+    if (candidates.size()>=kNumResultsUsed && num_postings_since_update>=candidates.size()) {
+      num_postings_since_update = 0;
+      candidate_scores.clear();
+      for (const auto kImageId: candidates) {candidate_scores.emplace_back(scores[kImageId]);}
+      threshold = std::max(threshold, KthLargestScore(candidate_scores, kNumResultsUsed, buffer));
+    }
+  }
+
+  // All images with a final score of at least the threshold are left, with exact scores
+  TopKSelector<float, HigherScored<float>> selector(kNumResultsUsed, HigherScored<float>());
+  for (const auto kImageId: candidates) {selector.Push(kImageId, scores[kImageId]);}
+  return selector.Sorted();
+}
+
+
+bool InvertedIndex::WriteToBinary(const std::string& kPath) const {
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  // Write header information (number of images, number of words)
+  size_t num_images = this->num_images_;
+  size_t num_words = this->posting_lists_.size();
+  file.write(reinterpret_cast<char*>(&num_images), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_words), sizeof(size_t));
+
+  // Write posting lists
+  for (const auto& kList: this->posting_lists_) {kList.Write(file);}
+
+  return true;
+}
+
+
+InvertedIndex InvertedIndex::ReadFromBinary(const std::string& kPath) {
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  // Read header information
+  InvertedIndex index;
+  size_t num_words = 0;
+  file.read(reinterpret_cast<char*>(&index.num_images_), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&num_words), sizeof(size_t));
+  if (!file) {throw std::runtime_error("Cannot read inverted index from file "+kPath+".");}
+
+  // Read posting lists
+  index.posting_lists_.reserve(num_words);
+  for (size_t word = 0; word<num_words; word++) {
+    index.posting_lists_.emplace_back(CompressedPostingList::Read(file));
+    if (index.posting_lists_.back().Size()>0 &&
+        index.posting_lists_.back().BlockLastId(index.posting_lists_.back().NumBlocks()-1)>=index.num_images_) {
+      throw std::runtime_error("Inconsistent inverted index in file "+kPath+".");
+    }
+  }
+
+  return index;
+}
+
+} // namespace igg
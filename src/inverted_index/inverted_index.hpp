@@ -0,0 +1,146 @@
+#ifndef CPP_FINAL_PROJECT_INVERTED_INDEX_INVERTED_INDEX_HPP_
+#define CPP_FINAL_PROJECT_INVERTED_INDEX_INVERTED_INDEX_HPP_
+
+
+#include <string>
+#include <vector>
+
+#include "histogram/sparse_histogram.hpp"
+#include "histogram/ranking.hpp"
+#include "posting_list.hpp"
+
+
+namespace igg {
+
+/**
+ * Maps each visual word to the images containing it (inverted file).
+ *
+ * Built from the (re-weighted) histograms of a dataset, which are L2-normalized
+ * first, so the cosine similarity of a query to an image is the sum over the
+ * words of the query of the query weight times the weight in the posting list.
+ * Only the posting lists of words occurring in the query are visited.
+ *
+ * Posting lists are compressed, see CompressedPostingList. Due to the quantization
+ * of the weights, similarities are approximate (error below 1% of the largest weight
+ * of each word).
+ *
+ * Usage:
+ *
+ *   const InvertedIndex kIndex(sparse_histograms);
+ *   const auto kTop10 = kIndex.TopKPruned(query_histogram, 10);
+ */
+class InvertedIndex {
+public:
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if the histograms do not all have the
+   * same number of bins.
+   *
+   * @param kHistograms One histogram per image. The position is used as image id.
+   */
+  explicit InvertedIndex(const std::vector<SparseHistogram<float>>& kHistograms);
+
+  size_t NumImages() const {return this->num_images_;}
+
+  /**
+   * Number of visual words, i.e. of posting lists.
+   */
+  size_t NumWords() const {return this->posting_lists_.size();}
+
+  const CompressedPostingList& PostingList(const size_t kWord) const
+    {return this->posting_lists_[kWord];}
+
+  /**
+   * Approximate memory used by the index in bytes.
+   */
+  size_t MemoryBytes() const;
+
+  /**
+   * Cosine similarity of the query to each image, in order of the image ids.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<float> Similarities(const SparseHistogram<float>& kQuery) const;
+
+  /**
+   * The kNumResults most similar images as pairs of image id and similarity,
+   * most similar first.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<ScoredIndex<float>> TopK
+    (const SparseHistogram<float>& kQuery, const size_t kNumResults) const;
+
+  /**
+   * Same results as TopK(), but skips postings which cannot change the results
+   * (term-at-a-time variant of MaxScore dynamic pruning).
+   *
+   * Each query word bounds its contribution to any image by its query weight times the
+   * largest weight of its posting list. Words are scored in decreasing order of bounds
+   * until the bounds of the remaining (non-essential) words sum up to less than the
+   * worst result so far. Images without an essential word are never visited, and the
+   * non-essential words are looked up for the other images only as long as the image
+   * may still enter the results. The largest weight of each block tightens the bounds
+   * and allows to skip blocks without decoding.
+   *
+   * Pays off for small kNumResults, if frequent words with long posting lists have small
+   * weights, e.g. due to tf-idf re-weighting.
+   *
+   * Reference: Turtle, Flood: Query evaluation: Strategies and optimizations, 1995
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::vector<ScoredIndex<float>> TopKPruned
+    (const SparseHistogram<float>& kQuery, const size_t kNumResults) const;
+
+  /**
+   * Approximate TopK() visiting at most kMaxPostings postings, to bound the query time.
+   *
+   * Query words are scored in decreasing order of the bound on their contribution (query
+   * weight times largest weight of the posting list), as in TopKPruned(). Once the posting
+   * list of the next word exceeds what is left of kMaxPostings, it and all further words are
+   * skipped. The first word is always scored.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   *
+   * @param num_visited Output, number of postings visited, if not nullptr.
+   */
+  std::vector<ScoredIndex<float>> TopKTruncated
+    (const SparseHistogram<float>& kQuery,
+     const size_t kNumResults,
+     const size_t kMaxPostings,
+     size_t* num_visited = nullptr) const;
+
+  /**
+   * Number of postings TopK() visits for the query, i.e. the total length of the posting
+   * lists of its words.
+   */
+  size_t NumPostings(const SparseHistogram<float>& kQuery) const;
+
+  /**
+   * Write the index to a binary file.
+   *
+   * In case the given file already exists it is overwritten.
+   *
+   * @return True, if writing was successful.
+   */
+  bool WriteToBinary(const std::string& kPath) const;
+
+  /**
+   * Read an index from a binary file as written by WriteToBinary.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  static InvertedIndex ReadFromBinary(const std::string& kPath);
+
+private:
+  size_t num_images_;
+  std::vector<CompressedPostingList> posting_lists_;
+
+  InvertedIndex(): num_images_{0} {}
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_INVERTED_INDEX_INVERTED_INDEX_HPP_
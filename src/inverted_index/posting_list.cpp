@@ -0,0 +1,323 @@
+
+#include "posting_list.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace igg {
+
+namespace {
+
+// Number of bits needed to represent the value
+uint8_t BitWidth(uint32_t value) {
+  uint8_t width = 0;
+  while (value>0) {
+    width++;
+    value >>= 1;
+  }
+  return width;
+}
+
+// Number of 32-bit words needed for kNumValues values of kBitWidth bits
+size_t NumPackedWords(const size_t kNumValues, const uint8_t kBitWidth) {
+  return (kNumValues*kBitWidth+31)/32;
+}
+
+// Unpack values of a fixed bit width, so shifts and masks are constants the compiler
+// can unroll with. Reads one word past the packed values, see the padding in the constructor.
+// Width 0 (all values 0) has no packed words and reads none.
+template <size_t kBitWidth>
+void UnpackFixedWidth(const uint32_t* packed, const size_t kNumValues, uint32_t* values) {
+  if (kBitWidth==0) {
+    std::fill(values, values+kNumValues, 0u);
+    return;
+  }
+  constexpr uint64_t kMask = (static_cast<uint64_t>(1)<<kBitWidth)-1;
+  for (size_t index = 0; index<kNumValues; index++) {
+    const size_t kBit = index*kBitWidth;
+    const uint64_t kWords = packed[kBit/32]|(static_cast<uint64_t>(packed[kBit/32+1])<<32);
+    values[index] = static_cast<uint32_t>((kWords>>(kBit%32))&kMask);
+  }
+}
+
+using UnpackFunction = void (*)(const uint32_t*, const size_t, uint32_t*);
+
+template <size_t... kBitWidths>
+std::array<UnpackFunction, sizeof...(kBitWidths)> MakeUnpackFunctions(std::index_sequence<kBitWidths...>) {
+  return {{&UnpackFixedWidth<kBitWidths>...}};
+}
+
+// Indexed by the bit width 0 to 32
+const auto kUnpackFunctions = MakeUnpackFunctions(std::make_index_sequence<33>());
+
+template <class T>
+void WriteVector(std::ostream& stream, const std::vector<T>& kValues) {
+  size_t num_values = kValues.size();
+  stream.write(reinterpret_cast<char*>(&num_values), sizeof(size_t));
+  stream.write(reinterpret_cast<const char*>(kValues.data()), sizeof(T)*num_values);
+}
+
+template <class T>
+std::vector<T> ReadVector(std::istream& stream) {
+  size_t num_values = 0;
+  stream.read(reinterpret_cast<char*>(&num_values), sizeof(size_t));
+  if (!stream) {throw std::runtime_error("Cannot read posting list.");}
+
+  std::vector<T> values(num_values);
+  stream.read(reinterpret_cast<char*>(values.data()), sizeof(T)*num_values);
+  if (!stream) {throw std::runtime_error("Cannot read posting list.");}
+  return values;
+}
+
+} // namespace
+
+
+const size_t CompressedPostingList::kBlockSize;
+const uint32_t PostingListCursor::kEndId;
+
+
+CompressedPostingList::CompressedPostingList():
+  size_{0}, max_weight_{0.0f}, weight_scale_{0.0f}, packed_gaps_(1, 0) {}
+
+
+CompressedPostingList::CompressedPostingList
+  (const std::vector<uint32_t>& kImageIds, const std::vector<float>& kWeights):
+  CompressedPostingList()
+{
+  if (kImageIds.size()!=kWeights.size())
+    {throw std::invalid_argument("Number of image ids and weights does not match.");}
+  for (size_t index = 1; index<kImageIds.size(); index++) {
+    if (kImageIds[index]<=kImageIds[index-1])
+      {throw std::invalid_argument("Image ids are not strictly increasing.");}
+  }
+  if (std::any_of(kWeights.begin(), kWeights.end(), [](const float kWeight) {return kWeight<0.0f;}))
+    {throw std::invalid_argument("Negative weights cannot be quantized.");}
+
+  this->size_ = kImageIds.size();
+  this->max_weight_ = kWeights.empty() ? 0.0f : *std::max_element(kWeights.begin(), kWeights.end());
+  this->weight_scale_ = this->max_weight_/255.0f;
+
+  this->packed_gaps_.clear();
+  this->quantized_weights_.reserve(this->size_);
+
+  // Id before the first one, wraps around to 0 when incremented
+  uint32_t previous_id = static_cast<uint32_t>(-1);
+  for (size_t begin = 0; begin<this->size_; begin += kBlockSize) {
+    const auto kEnd = std::min(begin+kBlockSize, this->size_);
+
+    // Gaps minus one, so consecutive ids take no bits at all
+    std::vector<uint32_t> gaps;
+    gaps.reserve(kEnd-begin);
+    for (size_t index = begin; index<kEnd; index++) {
+      gaps.emplace_back(kImageIds[index]-previous_id-1);
+      previous_id = kImageIds[index];
+    }
+    const auto kBitWidth = BitWidth(*std::max_element(gaps.begin(), gaps.end()));
+
+    // Bit-pack, nothing to pack if all ids are consecutive
+    const auto kOffset = this->packed_gaps_.size();
+    if (kBitWidth>0) {
+      this->packed_gaps_.resize(kOffset+NumPackedWords(gaps.size(), kBitWidth)+1, 0);
+      for (size_t index = 0; index<gaps.size(); index++) {
+        const size_t kBit = index*kBitWidth;
+        const uint64_t kShifted = static_cast<uint64_t>(gaps[index])<<(kBit%32);
+        this->packed_gaps_[kOffset+kBit/32] |= static_cast<uint32_t>(kShifted);
+        this->packed_gaps_[kOffset+kBit/32+1] |= static_cast<uint32_t>(kShifted>>32);
+      }
+      // Padding word only needed after the last block
+      this->packed_gaps_.pop_back();
+    }
+
+    // Quantize weights
+    uint8_t block_max_weight = 0;
+    for (size_t index = begin; index<kEnd; index++) {
+      const uint8_t kQuantized = this->weight_scale_>0.0f ?
+        static_cast<uint8_t>(std::min(std::round(kWeights[index]/this->weight_scale_), 255.0f)) : 0;
+      this->quantized_weights_.emplace_back(kQuantized);
+      block_max_weight = std::max(block_max_weight, kQuantized);
+    }
+
+    this->block_last_ids_.emplace_back(kImageIds[kEnd-1]);
+    this->block_bit_widths_.emplace_back(kBitWidth);
+    this->block_max_weights_.emplace_back(block_max_weight);
+    this->block_offsets_.emplace_back(static_cast<uint32_t>(kOffset));
+  }
+
+  // Allows to read 64 bits at any position
+  this->packed_gaps_.emplace_back(0);
+}
+
+
+size_t CompressedPostingList::DecodeBlock
+  (const size_t kBlock, uint32_t* image_ids, float* weights) const
+{
+  const size_t kBegin = kBlock*kBlockSize;
+  const size_t kNumPostings = std::min(kBlockSize, this->size_-kBegin);
+  const auto kBitWidth = this->block_bit_widths_[kBlock];
+  const uint32_t* kPacked = this->packed_gaps_.data()+this->block_offsets_[kBlock];
+
+  // Unpack gaps minus one
+  kUnpackFunctions[kBitWidth](kPacked, kNumPostings, image_ids);
+
+  // Prefix sum over the gaps, i.e. the unpacked values plus one
+  uint32_t previous_id = kBlock==0 ? static_cast<uint32_t>(-1) : this->block_last_ids_[kBlock-1];
+  size_t index = 0;
+#if defined(__SSE2__)
+  const __m128i kOne = _mm_set1_epi32(1);
+  __m128i carry = _mm_set1_epi32(static_cast<int>(previous_id));
+  for (; index+4<=kNumPostings; index += 4) {
+    __m128i ids = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(image_ids+index)), kOne);
+    ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 4));
+    ids = _mm_add_epi32(ids, _mm_slli_si128(ids, 8));
+    ids = _mm_add_epi32(ids, carry);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(image_ids+index), ids);
+    carry = _mm_shuffle_epi32(ids, 0xFF);
+  }
+  if (index>0) {previous_id = image_ids[index-1];}
+#endif
+  for (; index<kNumPostings; index++) {
+    previous_id += image_ids[index]+1;
+    image_ids[index] = previous_id;
+  }
+
+  // Dequantize weights
+  const uint8_t* kQuantized = this->quantized_weights_.data()+kBegin;
+  index = 0;
+#if defined(__SSE2__)
+  const __m128 kScale = _mm_set1_ps(this->weight_scale_);
+  const __m128i kZero = _mm_setzero_si128();
+  for (; index+16<=kNumPostings; index += 16) {
+    const __m128i kBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kQuantized+index));
+    const __m128i kLow = _mm_unpacklo_epi8(kBytes, kZero);
+    const __m128i kHigh = _mm_unpackhi_epi8(kBytes, kZero);
+    _mm_storeu_ps(weights+index, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(kLow, kZero)), kScale));
+    _mm_storeu_ps(weights+index+4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(kLow, kZero)), kScale));
+    _mm_storeu_ps(weights+index+8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(kHigh, kZero)), kScale));
+    _mm_storeu_ps(weights+index+12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(kHigh, kZero)), kScale));
+  }
+#endif
+  for (; index<kNumPostings; index++) {
+    weights[index] = kQuantized[index]*this->weight_scale_;
+  }
+
+  return kNumPostings;
+}
+
+
+void CompressedPostingList::Decode
+  (std::vector<uint32_t>& image_ids, std::vector<float>& weights) const
+{
+  image_ids.resize(this->NumBlocks()*kBlockSize);
+  weights.resize(this->NumBlocks()*kBlockSize);
+  for (size_t block = 0; block<this->NumBlocks(); block++) {
+    this->DecodeBlock(block, &image_ids[block*kBlockSize], &weights[block*kBlockSize]);
+  }
+  image_ids.resize(this->size_);
+  weights.resize(this->size_);
+}
+
+
+size_t CompressedPostingList::MemoryBytes() const {
+  return sizeof(CompressedPostingList)+
+    this->block_last_ids_.size()*sizeof(uint32_t)+
+    this->block_bit_widths_.size()*sizeof(uint8_t)+
+    this->block_max_weights_.size()*sizeof(uint8_t)+
+    this->block_offsets_.size()*sizeof(uint32_t)+
+    this->packed_gaps_.size()*sizeof(uint32_t)+
+    this->quantized_weights_.size()*sizeof(uint8_t);
+}
+
+
+void CompressedPostingList::Write(std::ostream& stream) const {
+  size_t size = this->size_;
+  float max_weight = this->max_weight_;
+  float weight_scale = this->weight_scale_;
+  stream.write(reinterpret_cast<char*>(&size), sizeof(size_t));
+  stream.write(reinterpret_cast<char*>(&max_weight), sizeof(float));
+  stream.write(reinterpret_cast<char*>(&weight_scale), sizeof(float));
+
+  WriteVector(stream, this->block_last_ids_);
+  WriteVector(stream, this->block_bit_widths_);
+  WriteVector(stream, this->block_max_weights_);
+  WriteVector(stream, this->block_offsets_);
+  WriteVector(stream, this->packed_gaps_);
+  WriteVector(stream, this->quantized_weights_);
+}
+
+
+CompressedPostingList CompressedPostingList::Read(std::istream& stream) {
+  CompressedPostingList list;
+  stream.read(reinterpret_cast<char*>(&list.size_), sizeof(size_t));
+  stream.read(reinterpret_cast<char*>(&list.max_weight_), sizeof(float));
+  stream.read(reinterpret_cast<char*>(&list.weight_scale_), sizeof(float));
+  if (!stream) {throw std::runtime_error("Cannot read posting list.");}
+
+  list.block_last_ids_ = ReadVector<uint32_t>(stream);
+  list.block_bit_widths_ = ReadVector<uint8_t>(stream);
+  list.block_max_weights_ = ReadVector<uint8_t>(stream);
+  list.block_offsets_ = ReadVector<uint32_t>(stream);
+  list.packed_gaps_ = ReadVector<uint32_t>(stream);
+  list.quantized_weights_ = ReadVector<uint8_t>(stream);
+
+  const auto kNumBlocks = (list.size_+kBlockSize-1)/kBlockSize;
+  if (list.block_last_ids_.size()!=kNumBlocks || list.block_bit_widths_.size()!=kNumBlocks ||
+      list.block_max_weights_.size()!=kNumBlocks || list.block_offsets_.size()!=kNumBlocks ||
+      list.quantized_weights_.size()!=list.size_ || list.packed_gaps_.empty()) {
+    throw std::runtime_error("Inconsistent posting list.");
+  }
+  // Words read by DecodeBlock: the packed gaps and the following word, none for width 0
+  for (size_t block = 0; block<kNumBlocks; block++) {
+    const auto kNumPostings = std::min(kBlockSize, list.size_-block*kBlockSize);
+    const auto kBitWidth = list.block_bit_widths_[block];
+    if (kBitWidth>32 || list.block_offsets_[block]>list.packed_gaps_.size() ||
+        (kBitWidth>0 && list.block_offsets_[block]+NumPackedWords(kNumPostings, kBitWidth)+1>
+         list.packed_gaps_.size())) {
+      throw std::runtime_error("Inconsistent posting list.");
+    }
+  }
+
+  return list;
+}
+
+PostingListCursor::PostingListCursor(const CompressedPostingList& kList):
+  kList_{&kList}, block_{0}, position_{0}, decoded_block_{kList.NumBlocks()}, num_postings_{0} {}
+
+
+void PostingListCursor::Next() {
+  if (this->AtEnd()) {return;}
+  this->DecodeCurrentBlock();
+  this->position_++;
+  if (this->position_>=this->num_postings_) {
+    this->block_++;
+    this->position_ = 0;
+  }
+}
+
+
+void PostingListCursor::SkipBlocks(const uint32_t kImageId) {
+  const auto kNumBlocks = this->kList_->NumBlocks();
+  while (this->block_<kNumBlocks && this->kList_->BlockLastId(this->block_)<kImageId) {this->block_++;}
+  this->position_ = 0;
+}
+
+
+float PostingListCursor::BlockMaxWeight() const {
+  return this->AtEnd() ? 0.0f : this->kList_->BlockMaxWeight(this->block_);
+}
+
+
+void PostingListCursor::DecodeBlock() const {
+  this->num_postings_ = this->kList_->DecodeBlock
+    (this->block_, this->image_ids_.data(), this->weights_.data());
+  this->decoded_block_ = this->block_;
+}
+
+} // namespace igg
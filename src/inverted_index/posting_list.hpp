@@ -0,0 +1,222 @@
+#ifndef CPP_FINAL_PROJECT_INVERTED_INDEX_POSTING_LIST_HPP_
+#define CPP_FINAL_PROJECT_INVERTED_INDEX_POSTING_LIST_HPP_
+
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+
+namespace igg {
+
+/**
+ * Compressed list of the images containing a certain visual word (the postings)
+ * and the weight of the word in each image.
+ *
+ * Image ids are split into blocks of kBlockSize. Within a block, the gaps between
+ * consecutive ids are bit-packed with the smallest bit width that fits the largest
+ * gap of the block. Weights are quantized to 8 bits relative to the largest weight
+ * of the list. For common words with many postings this takes about
+ * (gap bits + 8) bits per posting instead of 64.
+ *
+ * Decoding works a block at a time. The gaps are unpacked with 64-bit reads, the
+ * prefix sum over the gaps and the conversion of the weights use SSE2 where available.
+ *
+ * Usage:
+ *
+ *   const CompressedPostingList kList(image_ids, weights);
+ *   std::array<uint32_t, CompressedPostingList::kBlockSize> ids;
+ *   std::array<float, CompressedPostingList::kBlockSize> block_weights;
+ *   for (size_t block = 0; block<kList.NumBlocks(); block++) {
+ *     const auto kNumPostings = kList.DecodeBlock(block, ids.data(), block_weights.data());
+ *     ...
+ *   }
+ */
+class CompressedPostingList {
+public:
+  static const size_t kBlockSize = 128;
+
+  /**
+   * Constructor. Empty list.
+   */
+  CompressedPostingList();
+
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if the ids are not strictly increasing,
+   * the number of ids and weights differs, or there are negative weights.
+   *
+   * @param kImageIds Ids of the images containing the word, in increasing order.
+   * @param kWeights Weight of the word in each image.
+   */
+  CompressedPostingList
+    (const std::vector<uint32_t>& kImageIds, const std::vector<float>& kWeights);
+
+  /**
+   * Number of postings.
+   */
+  size_t Size() const {return this->size_;}
+
+  size_t NumBlocks() const {return this->block_last_ids_.size();}
+
+  /**
+   * Largest weight in the list (exact, not quantized).
+   */
+  float MaxWeight() const {return this->max_weight_;}
+
+  /**
+   * Largest (dequantized) weight within a block.
+   */
+  float BlockMaxWeight(const size_t kBlock) const
+    {return this->block_max_weights_[kBlock]*this->weight_scale_;}
+
+  /**
+   * Largest image id within a block, allows to skip blocks without decoding.
+   */
+  uint32_t BlockLastId(const size_t kBlock) const {return this->block_last_ids_[kBlock];}
+
+  /**
+   * Decode a block.
+   *
+   * @param kBlock Index of the block.
+   * @param image_ids Output, space for kBlockSize ids.
+   * @param weights Output, space for kBlockSize weights.
+   *
+   * @return Number of postings in the block (kBlockSize, except for the last block).
+   */
+  size_t DecodeBlock(const size_t kBlock, uint32_t* image_ids, float* weights) const;
+
+  /**
+   * Decode all postings.
+   */
+  void Decode(std::vector<uint32_t>& image_ids, std::vector<float>& weights) const;
+
+  /**
+   * Approximate memory used by the list in bytes.
+   */
+  size_t MemoryBytes() const;
+
+  /**
+   * Write the list to a binary stream.
+   */
+  void Write(std::ostream& stream) const;
+
+  /**
+   * Read a list from a binary stream as written by Write().
+   *
+   * Throws a std::runtime_error in case the stream cannot be read.
+   */
+  static CompressedPostingList Read(std::istream& stream);
+
+private:
+  size_t size_;
+  float max_weight_;
+  // Quantized weights times weight_scale_ are the weights
+  float weight_scale_;
+
+  std::vector<uint32_t> block_last_ids_;
+  std::vector<uint8_t> block_bit_widths_;
+  std::vector<uint8_t> block_max_weights_;
+  // Position of the first word of each block in packed_gaps_
+  std::vector<uint32_t> block_offsets_;
+  // Gaps minus one, bit-packed, with one padding word at the end
+  std::vector<uint32_t> packed_gaps_;
+  std::vector<uint8_t> quantized_weights_;
+};
+
+/**
+ * Iterates over the postings of a CompressedPostingList in increasing order of image ids,
+ * decoding one block at a time.
+ *
+ * NextGeq() skips blocks by their last id, and SkipBlocksTo() does so without decoding
+ * at all, which together with the block maximum weights allows to skip postings that
+ * cannot contribute to a result (see InvertedIndex::TopKPruned).
+ *
+ * The list has to outlive the cursor.
+ */
+class PostingListCursor {
+public:
+  /**
+   * Image id returned once all postings are visited.
+   */
+  static const uint32_t kEndId = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * Constructor. Positioned at the first posting.
+   */
+  explicit PostingListCursor(const CompressedPostingList& kList);
+
+  bool AtEnd() const {return this->block_>=this->kList_->NumBlocks();}
+
+  /**
+   * Image id of the current posting, kEndId at the end.
+   */
+  uint32_t ImageId() const {
+    if (this->AtEnd()) {return kEndId;}
+    this->DecodeCurrentBlock();
+    return this->image_ids_[this->position_];
+  }
+
+  /**
+   * Weight of the current posting. Requires !AtEnd().
+   */
+  float Weight() const {
+    this->DecodeCurrentBlock();
+    return this->weights_[this->position_];
+  }
+
+  /**
+   * Move to the next posting.
+   */
+  void Next();
+
+  /**
+   * Move to the first posting with an image id of at least kImageId. Does not move backwards.
+   */
+  void NextGeq(const uint32_t kImageId) {
+    this->SkipBlocksTo(kImageId);
+    if (this->AtEnd()) {return;}
+
+    // The block contains an id of at least kImageId
+    this->DecodeCurrentBlock();
+    while (this->image_ids_[this->position_]<kImageId) {this->position_++;}
+  }
+
+  /**
+   * Move to the block which may contain kImageId without decoding it, i.e. the first block
+   * with a last id of at least kImageId. Does not move backwards.
+   */
+  void SkipBlocksTo(const uint32_t kImageId) {
+    if (!this->AtEnd() && this->kList_->BlockLastId(this->block_)<kImageId) {this->SkipBlocks(kImageId);}
+  }
+
+  /**
+   * Largest weight in the current block, 0 at the end.
+   */
+  float BlockMaxWeight() const;
+
+private:
+  const CompressedPostingList* kList_;
+  size_t block_;
+  size_t position_;
+  // Block held in image_ids_ and weights_, decoded on access
+  mutable size_t decoded_block_;
+  mutable size_t num_postings_;
+  mutable std::array<uint32_t, CompressedPostingList::kBlockSize> image_ids_;
+  mutable std::array<float, CompressedPostingList::kBlockSize> weights_;
+
+  void DecodeCurrentBlock() const {
+    if (this->decoded_block_!=this->block_) {this->DecodeBlock();}
+  }
+
+  void DecodeBlock() const;
+
+  void SkipBlocks(const uint32_t kImageId);
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_INVERTED_INDEX_POSTING_LIST_HPP_
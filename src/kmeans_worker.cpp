@@ -0,0 +1,86 @@
+#include <boost/program_options.hpp>
+
+#include "binaryio/feature_file_stream.hpp"
+#include "clustering/distributed_kmeans/distributed_kmeans.hpp"
+#include "dataset/dataset.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("socket,", po::value<std::string>()->default_value("/tmp/kmeans_worker.sock"), "Path of the socket to listen on.")
+    ("shard,", po::value<size_t>()->default_value(0), "Index of the shard of images whose features this worker owns.")
+    ("num-shards,", po::value<size_t>()->default_value(1), "Number of shards the images are split into, one per worker.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::parse_command_line(argc, argv, options_description), variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help")) {
+    std::cout << "Clusters the features of a shard of the images for compute_cluster_centroids "
+      "--variant kmeans_distributed until interrupted.\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and features have be extracted.\n";
+    std::cout << options_description;
+    return 0;
+  }
+
+  const auto kShard = variables_map["shard"].as<size_t>();
+  const auto kNumShards = variables_map["num-shards"].as<size_t>();
+  if (kShard>=kNumShards) {
+    std::cerr << "Shard is expected to be smaller than the number of shards.\n";
+    return 1;
+  }
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  // Contiguous range of images, so the shards in order contain the features in the order of the dataset
+  const auto kNumImages = kDataset->Items().size();
+  const auto kBegin = kShard*kNumImages/kNumShards;
+  const auto kEnd = (kShard+1)*kNumImages/kNumShards;
+  std::vector<std::string> features_paths;
+  for (size_t index = kBegin; index<kEnd; index++) {
+    const auto& kItem = kDataset->Items()[index];
+    if (!kItem->HasFeatures()) {
+      std::cerr << "Expected to find features binary " << kItem->FeaturesBinaryFilename() <<
+        ". Did you call extract_features?\n";
+      return 1;
+    }
+    features_paths.emplace_back(kItem->FeaturesBinaryPath());
+  }
+
+  try {
+    const size_t kChunkSize = 100000;
+    igg::FeatureFileStream stream(features_paths, kChunkSize);
+    const igg::KmeansWorker kWorker(stream);
+    const igg::KmeansChannelListener kListener(variables_map["socket"].as<std::string>());
+    std::cout << "Serve " << stream.Size() << " features of images " << kBegin << " to " << kEnd << ".\n";
+
+    // A failed coordinator is simply restarted, so keep serving
+    while (true) {
+      const auto kChannel = kListener.Accept();
+      try {
+        const bool kFinished = kWorker.Serve(*kChannel);
+        std::cout << (kFinished ? "Clustering finished.\n" : "Coordinator disconnected.\n");
+      } catch (const std::runtime_error& kError) {
+        std::cerr << "Malformed request: " << kError.what() << "\n";
+      }
+    }
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -10,7 +10,17 @@ int main (int argc, char** argv) {
 
   po::options_description options_description("Options");
   options_description.add_options()
-    ("help,h", "Show help.");
+    ("help,h", "Show help.")
+    ("word-index,", "Build a search index over the cluster centroids first and use it to assign features to words (approximate, but faster for large vocabularies).")
+    ("hnsw-m,", po::value<size_t>()->default_value(16), "Number of connections per graph node of the word index.")
+    ("hnsw-ef-construction,", po::value<size_t>()->default_value(200), "Candidate list size while building the word index.")
+    ("hnsw-ef-search,", po::value<size_t>()->default_value(50), "Candidate list size while searching the word index.")
+    ("seed,s", po::value<int>()->default_value(0), "Seed for building the word index.")
+    ("max-document-frequency,", po::value<double>()->default_value(1.0), "Drop words contained in more than this fraction of the images (stop words).")
+    ("max-word-count,", po::value<size_t>()->default_value(0), "Limit the count of a word in a single image, 0 for no limit.")
+    ("inverted-index,", "Build a compressed inverted index (images per word) from the histograms afterwards.")
+    ("pq-code-size,", po::value<size_t>()->default_value(0), "Encode each histogram to a compact code of this many bytes afterwards (product quantization), 0 to skip.")
+    ("pq-iterations,", po::value<int>()->default_value(25), "Maximum number of K-means iterations to train the product quantizer.");
 
   po::variables_map variables_map;
   try {
@@ -26,6 +36,7 @@ int main (int argc, char** argv) {
     std::cout << "Generates and re-weights histograms from clustering.\n";
     std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set, "
       "features have be extracted and clustered.\n";
+    std::cout << options_description;
     return 0;
   }
 
@@ -35,7 +46,23 @@ int main (int argc, char** argv) {
   const igg::BagOfWords kBagOfWords(kDataset, true); // True to allow terminal output
 
   try {
-    kBagOfWords.MakeHistograms();
+    if (variables_map.count("word-index")) {
+      kBagOfWords.BuildWordIndex
+        (variables_map["hnsw-m"].as<size_t>(),
+         variables_map["hnsw-ef-construction"].as<size_t>(),
+         variables_map["hnsw-ef-search"].as<size_t>(),
+         variables_map["seed"].as<int>());
+    }
+    kBagOfWords.MakeHistograms
+      (variables_map["max-document-frequency"].as<double>(),
+       variables_map["max-word-count"].as<size_t>());
+    if (variables_map.count("inverted-index")) {kBagOfWords.BuildInvertedIndex();}
+    if (variables_map["pq-code-size"].as<size_t>()>0) {
+      kBagOfWords.BuildProductQuantization
+        (variables_map["pq-code-size"].as<size_t>(),
+         variables_map["pq-iterations"].as<int>(),
+         variables_map["seed"].as<int>());
+    }
   } catch (const std::exception& kError) {
     std::cerr << "An error occured: " << kError.what() << "\n";
     return 1;
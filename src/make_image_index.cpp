@@ -0,0 +1,62 @@
+
+#include <boost/program_options.hpp>
+
+#include "bag_of_words.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("encoding,", po::value<std::string>()->default_value("histogram"), "Vectors to index. Options: histogram, vlad.")
+    ("hnsw-m,", po::value<size_t>()->default_value(16), "Number of connections per graph node.")
+    ("hnsw-ef-construction,", po::value<size_t>()->default_value(200), "Candidate list size while building the graph.")
+    ("seed,s", po::value<int>()->default_value(0), "Seed for building the graph.")
+    ("rebuild,", "Discard a previously built index instead of inserting the images added since.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::parse_command_line(argc, argv, options_description), variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help")) {
+    std::cout << "Builds a graph based search index over the histograms or VLAD vectors of all images.\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and histograms or VLAD vectors have been computed.\n";
+    std::cout << options_description;
+    return 0;
+  }
+
+  const auto kEncodingName = variables_map["encoding"].as<std::string>();
+  if (kEncodingName!="histogram" && kEncodingName!="vlad") {
+    std::cerr << "Encoding " << kEncodingName << " not recognized.\n";
+    return 1;
+  }
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  const igg::BagOfWords kBagOfWords(kDataset, true); // True to allow terminal output
+
+  try {
+    kBagOfWords.BuildImageIndex
+      (kEncodingName=="vlad" ? igg::ImageEncoding::kVlad : igg::ImageEncoding::kHistogram,
+       variables_map["hnsw-m"].as<size_t>(),
+       variables_map["hnsw-ef-construction"].as<size_t>(),
+       variables_map["seed"].as<int>(),
+       variables_map.count("rebuild")>0);
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
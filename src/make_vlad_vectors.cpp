@@ -0,0 +1,72 @@
+
+#include <boost/program_options.hpp>
+
+#include "bag_of_words.hpp"
+#include "clustering/clustering_strategy_kmeans.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("num-clusters,k", po::value<size_t>()->default_value(64), "Number of clusters of the VLAD vocabulary, e.g. 64 to 256.")
+    ("iterations,i", po::value<int>()->default_value(25), "Maximum number of K-means iterations.")
+    ("epsilon,e", po::value<float>()->default_value(1e-3f), "Stop if centroid updates are smaller than this value.")
+    ("seed,s", po::value<int>()->default_value(0), "Seed for K-means and the samples.")
+    ("max-training-descriptors,", po::value<size_t>()->default_value(100000), "Cluster a random sample of this many features instead of all. 0 to use all features.")
+    ("pca-dimension,", po::value<size_t>()->default_value(0), "Project the vectors onto this many main components, e.g. 128 to 512. 0 to keep all dimensions.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::parse_command_line(argc, argv, options_description), variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help")) {
+    std::cout << "Aggregates the features of each image to a single dense vector (VLAD).\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and features have be extracted.\n";
+    std::cout << options_description;
+    return 0;
+  }
+
+  const auto kIterations = variables_map["iterations"].as<int>();
+  if (!(kIterations>0)) {
+    std::cerr << "Number of iterations is expected to be positive.\n";
+    return 1;
+  }
+  const auto kEpsilon = variables_map["epsilon"].as<float>();
+  if (kEpsilon<0.0f) {
+    std::cerr << "Epsilon is expected to be non-negative.\n";
+    return 1;
+  }
+  const auto kSeed = variables_map["seed"].as<int>();
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  const igg::BagOfWords kBagOfWords(kDataset, true); // True to allow terminal output
+
+  try {
+    const igg::ClusteringStrategyKmeans<float> kStrategy
+      (variables_map["num-clusters"].as<size_t>(), kIterations, kEpsilon, kSeed, true, // True to allow terminal output
+       igg::SeedingMethod::kKmeansPlusPlus);
+    kBagOfWords.MakeVladVectors
+      (kStrategy,
+       variables_map["pca-dimension"].as<size_t>(),
+       variables_map["max-training-descriptors"].as<size_t>(),
+       kSeed);
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,238 @@
+
+#include "product_quantized_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+// The shuffle scan is compiled for SSSE3 independent of the compiler flags and used if
+// the CPU supports it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPP_FINAL_PROJECT_PQ_SSSE3_SCAN
+#include <immintrin.h>
+#endif
+
+
+namespace igg {
+
+namespace {
+
+// Bytes of codes per subspace in a block
+const size_t kBytesPerSubspace = ProductQuantizedIndex::kBlockSize/2;
+
+// Inner product table quantized to 8 bit per entry. Each subspace is shifted to start
+// at zero and one common scale keeps the sums over the subspaces comparable, so the sum
+// of the entries of a vector is its approximate inner product up to offset and scale.
+std::vector<uint8_t> QuantizeTable(const std::vector<float>& kTable, const size_t kNumSubquantizers) {
+  const auto kNumCentroids = ProductQuantizer::kNumCentroids;
+
+  std::vector<float> min_entries(kNumSubquantizers);
+  float max_range = 0.0f;
+  for (size_t subspace = 0; subspace<kNumSubquantizers; subspace++) {
+    const auto kBegin = kTable.begin()+subspace*kNumCentroids;
+    const auto kMinMax = std::minmax_element(kBegin, kBegin+kNumCentroids);
+    min_entries[subspace] = *kMinMax.first;
+    max_range = std::max(max_range, *kMinMax.second-*kMinMax.first);
+  }
+  const float kScale = max_range>0.0f ? 255.0f/max_range : 1.0f;
+
+  std::vector<uint8_t> quantized_table(kTable.size());
+  for (size_t index = 0; index<kTable.size(); index++) {
+    quantized_table[index] = static_cast<uint8_t>(std::lround
+      ((kTable[index]-min_entries[index/kNumCentroids])*kScale));
+  }
+  return quantized_table;
+}
+
+// Sum of the quantized table entries of each vector of a block. With at most 256
+// subspaces, the sums fit into 16 bit.
+void ScanBlockScalar
+  (const uint8_t* kBlockCodes, const uint8_t* kTable, const size_t kNumSubquantizers, uint16_t* scores)
+{
+  std::fill(scores, scores+ProductQuantizedIndex::kBlockSize, 0);
+  for (size_t subspace = 0; subspace<kNumSubquantizers; subspace++) {
+    const auto kSubspaceTable = kTable+subspace*ProductQuantizer::kNumCentroids;
+    const auto kCodes = kBlockCodes+subspace*kBytesPerSubspace;
+    for (size_t index = 0; index<kBytesPerSubspace; index++) {
+      scores[index] += kSubspaceTable[kCodes[index]&0x0f];
+      scores[index+kBytesPerSubspace] += kSubspaceTable[kCodes[index]>>4];
+    }
+  }
+}
+
+#if defined(CPP_FINAL_PROJECT_PQ_SSSE3_SCAN)
+// Same as above, looking up the entries of 16 vectors by one shuffle of the table
+__attribute__((target("ssse3")))
+void ScanBlockSsse3
+  (const uint8_t* kBlockCodes, const uint8_t* kTable, const size_t kNumSubquantizers, uint16_t* scores)
+{
+  const __m128i kLowBits = _mm_set1_epi8(0x0f);
+  const __m128i kZero = _mm_setzero_si128();
+  __m128i scores0 = _mm_setzero_si128(); // Vectors 0 to 7
+  __m128i scores1 = _mm_setzero_si128(); // Vectors 8 to 15
+  __m128i scores2 = _mm_setzero_si128(); // Vectors 16 to 23
+  __m128i scores3 = _mm_setzero_si128(); // Vectors 24 to 31
+  for (size_t subspace = 0; subspace<kNumSubquantizers; subspace++) {
+    const __m128i kSubspaceTable = _mm_loadu_si128
+      (reinterpret_cast<const __m128i*>(kTable+subspace*ProductQuantizer::kNumCentroids));
+    const __m128i kCodes = _mm_loadu_si128
+      (reinterpret_cast<const __m128i*>(kBlockCodes+subspace*kBytesPerSubspace));
+    const __m128i kLowEntries = _mm_shuffle_epi8(kSubspaceTable, _mm_and_si128(kCodes, kLowBits));
+    const __m128i kHighEntries = _mm_shuffle_epi8
+      (kSubspaceTable, _mm_and_si128(_mm_srli_epi16(kCodes, 4), kLowBits));
+    scores0 = _mm_add_epi16(scores0, _mm_unpacklo_epi8(kLowEntries, kZero));
+    scores1 = _mm_add_epi16(scores1, _mm_unpackhi_epi8(kLowEntries, kZero));
+    scores2 = _mm_add_epi16(scores2, _mm_unpacklo_epi8(kHighEntries, kZero));
+    scores3 = _mm_add_epi16(scores3, _mm_unpackhi_epi8(kHighEntries, kZero));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scores), scores0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scores+8), scores1);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scores+16), scores2);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(scores+24), scores3);
+}
+#endif
+
+void ScanBlock
+  (const uint8_t* kBlockCodes, const uint8_t* kTable, const size_t kNumSubquantizers, uint16_t* scores)
+{
+#if defined(CPP_FINAL_PROJECT_PQ_SSSE3_SCAN)
+  static const bool kHasSsse3 = __builtin_cpu_supports("ssse3");
+  if (kHasSsse3) {
+    ScanBlockSsse3(kBlockCodes, kTable, kNumSubquantizers, scores);
+    return;
+  }
+#endif
+  ScanBlockScalar(kBlockCodes, kTable, kNumSubquantizers, scores);
+}
+
+} // namespace
+
+
+const size_t ProductQuantizedIndex::kBlockSize;
+
+
+ProductQuantizedIndex::ProductQuantizedIndex(ProductQuantizer quantizer):
+  quantizer_(std::move(quantizer)), size_{0} {}
+
+
+void ProductQuantizedIndex::Add(const std::vector<float>& kVector) {
+  const auto kCentroidIndices = this->quantizer_.Encode(kVector);
+  const auto kNumSubquantizers = this->quantizer_.NumSubquantizers();
+
+  // Start a new block
+  if (this->size_%kBlockSize==0) {
+    this->codes_.resize(this->codes_.size()+kNumSubquantizers*kBytesPerSubspace, 0);
+  }
+
+  const auto kPosition = this->size_%kBlockSize;
+  auto block_codes = &this->codes_[(this->size_/kBlockSize)*kNumSubquantizers*kBytesPerSubspace];
+  for (size_t subspace = 0; subspace<kNumSubquantizers; subspace++) {
+    auto& code = block_codes[subspace*kBytesPerSubspace+kPosition%kBytesPerSubspace];
+    code |= kPosition<kBytesPerSubspace ? kCentroidIndices[subspace] : kCentroidIndices[subspace]<<4;
+  }
+  this->size_++;
+}
+
+
+std::vector<float> ProductQuantizedIndex::Similarities(const std::vector<float>& kQuery) const {
+  const auto kTable = this->quantizer_.InnerProductTable(kQuery);
+
+  std::vector<float> similarities(this->size_);
+  for (size_t index = 0; index<this->size_; index++) {similarities[index] = this->Score(kTable, index);}
+  return similarities;
+}
+
+
+std::vector<ScoredIndex<float>> ProductQuantizedIndex::TopK
+  (const std::vector<float>& kQuery, const size_t kNumResults, const size_t kNumCandidates) const
+{
+  const auto kTable = this->quantizer_.InnerProductTable(kQuery);
+  const auto kQuantizedTable = QuantizeTable(kTable, this->quantizer_.NumSubquantizers());
+  const auto kBlockBytes = this->quantizer_.NumSubquantizers()*kBytesPerSubspace;
+
+  // Candidates by the 8 bit table
+  TopKSelector<float, HigherScored<float>> candidates
+    (std::min(std::max(kNumCandidates, kNumResults), this->size_), HigherScored<float>());
+  uint16_t scores[kBlockSize];
+  for (size_t block = 0; block*kBlockSize<this->size_; block++) {
+    ScanBlock(&this->codes_[block*kBlockBytes], kQuantizedTable.data(),
+      this->quantizer_.NumSubquantizers(), scores);
+    const auto kNumVectors = std::min(kBlockSize, this->size_-block*kBlockSize);
+    for (size_t position = 0; position<kNumVectors; position++) {
+      candidates.Push(block*kBlockSize+position, scores[position]);
+    }
+  }
+
+  // Score them again by the float table
+  TopKSelector<float, HigherScored<float>> results(std::min(kNumResults, this->size_), HigherScored<float>());
+  for (const auto& kCandidate: candidates.Sorted()) {
+    results.Push(kCandidate.first, this->Score(kTable, kCandidate.first));
+  }
+  return results.Sorted();
+}
+
+
+bool ProductQuantizedIndex::WriteToBinary(const std::string& kPath) const {
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  this->quantizer_.Write(file);
+
+  // Write number of vectors and their codes
+  size_t size = this->size_;
+  size_t num_code_bytes = this->codes_.size();
+  file.write(reinterpret_cast<char*>(&size), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&num_code_bytes), sizeof(size_t));
+  file.write(reinterpret_cast<const char*>(this->codes_.data()), num_code_bytes);
+
+  return true;
+}
+
+
+ProductQuantizedIndex ProductQuantizedIndex::ReadFromBinary(const std::string& kPath) {
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  ProductQuantizedIndex index(ProductQuantizer::Read(file));
+
+  size_t num_code_bytes = 0;
+  file.read(reinterpret_cast<char*>(&index.size_), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&num_code_bytes), sizeof(size_t));
+  const auto kNumBlocks = (index.size_+kBlockSize-1)/kBlockSize;
+  if (!file || num_code_bytes!=kNumBlocks*index.quantizer_.NumSubquantizers()*kBytesPerSubspace) {
+    throw std::runtime_error("Cannot read product quantized index from file "+kPath+".");
+  }
+  index.codes_.resize(num_code_bytes);
+  file.read(reinterpret_cast<char*>(index.codes_.data()), num_code_bytes);
+  if (!file) {throw std::runtime_error("Cannot read codes from file "+kPath+".");}
+
+  return index;
+}
+
+
+uint8_t ProductQuantizedIndex::CentroidIndex(const size_t kIndex, const size_t kSubspace) const {
+  const auto kPosition = kIndex%kBlockSize;
+  const auto kCode = this->codes_
+    [((kIndex/kBlockSize)*this->quantizer_.NumSubquantizers()+kSubspace)*kBytesPerSubspace+kPosition%kBytesPerSubspace];
+  return kPosition<kBytesPerSubspace ? kCode&0x0f : kCode>>4;
+}
+
+
+float ProductQuantizedIndex::Score(const std::vector<float>& kTable, const size_t kIndex) const {
+  float score = 0.0f;
+  for (size_t subspace = 0; subspace<this->quantizer_.NumSubquantizers(); subspace++) {
+    score += kTable[subspace*ProductQuantizer::kNumCentroids+this->CentroidIndex(kIndex, subspace)];
+  }
+  return score;
+}
+
+} // namespace igg
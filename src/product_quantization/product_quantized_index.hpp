@@ -0,0 +1,113 @@
+#ifndef CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZED_INDEX_HPP_
+#define CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZED_INDEX_HPP_
+
+
+#include <string>
+#include <vector>
+
+#include "histogram/ranking.hpp"
+#include "product_quantizer.hpp"
+
+
+namespace igg {
+
+/**
+ * Maximum inner product search over vectors encoded by a ProductQuantizer.
+ * For cosine similarity, add and query L2-normalized vectors.
+ *
+ * The codes are stored in blocks of kBlockSize vectors, transposed so that the 4 bit
+ * codes of all vectors of a block for one subspace are 16 consecutive bytes. A query
+ * quantizes its inner product table to 8 bit, so the table of a subspace fits into a
+ * SIMD register, and scores a whole block by one shuffle per subspace (SSSE3, if the
+ * CPU supports it, portable loop otherwise).
+ * The best kNumCandidates vectors of this scan are scored again with the float table.
+ *
+ * Reference: Andre, Kermarrec, Le Scouarnec: Cache locality is not enough:
+ * High-performance nearest neighbor search with product quantization fast scan, 2015
+ *
+ * Usage:
+ *
+ *   ProductQuantizedIndex index(ProductQuantizer::Train(training_vectors, 128, 25, 0));
+ *   for (const auto& kVector: vectors) {index.Add(kVector);}
+ *   const auto kTop10 = index.TopK(query, 10, 100);
+ */
+class ProductQuantizedIndex {
+public:
+  /**
+   * Number of vectors per block of codes.
+   */
+  static const size_t kBlockSize = 32;
+
+  explicit ProductQuantizedIndex(ProductQuantizer quantizer);
+
+  const ProductQuantizer& Quantizer() const {return this->quantizer_;}
+
+  /**
+   * Number of vectors.
+   */
+  size_t Size() const {return this->size_;}
+
+  /**
+   * Memory used by the codes in bytes.
+   */
+  size_t MemoryBytes() const {return this->codes_.size();}
+
+  /**
+   * Encode a vector and append it.
+   *
+   * Throws an instance of std::invalid_argument if the dimension does not match.
+   */
+  void Add(const std::vector<float>& kVector);
+
+  /**
+   * Approximate inner product of the query with each vector, in order.
+   *
+   * Throws an instance of std::invalid_argument if the dimension does not match.
+   */
+  std::vector<float> Similarities(const std::vector<float>& kQuery) const;
+
+  /**
+   * The kNumResults vectors with the largest approximate inner product as pairs of
+   * index and inner product, largest first.
+   *
+   * Throws an instance of std::invalid_argument if the dimension does not match.
+   *
+   * @param kNumCandidates Number of vectors selected by the scan with the 8 bit table
+   * and scored again with the float table, at least kNumResults are used.
+   */
+  std::vector<ScoredIndex<float>> TopK
+    (const std::vector<float>& kQuery, const size_t kNumResults, const size_t kNumCandidates) const;
+
+  /**
+   * Write the quantizer and the codes to a binary file.
+   *
+   * In case the given file already exists it is overwritten.
+   *
+   * @return True, if writing was successful.
+   */
+  bool WriteToBinary(const std::string& kPath) const;
+
+  /**
+   * Read an index from a binary file as written by WriteToBinary.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  static ProductQuantizedIndex ReadFromBinary(const std::string& kPath);
+
+private:
+  ProductQuantizer quantizer_;
+  size_t size_;
+  // For each block and subspace 16 bytes, the low 4 bit of byte i hold the code of
+  // vector i of the block, the high 4 bit the code of vector i+16
+  std::vector<uint8_t> codes_;
+
+  // Centroid index of the vector in the subspace
+  uint8_t CentroidIndex(const size_t kIndex, const size_t kSubspace) const;
+
+  // Score of a vector by the float table
+  float Score(const std::vector<float>& kTable, const size_t kIndex) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZED_INDEX_HPP_
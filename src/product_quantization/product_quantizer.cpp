@@ -0,0 +1,210 @@
+
+#include "product_quantizer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "clustering/seeding.hpp"
+#include "tools/simd.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// Index of the nearest of kNumCentroids consecutive centroids of the given dimension
+size_t NearestCentroid
+  (const float* kSubvector, const float* kCentroids, const size_t kNumCentroids, const size_t kDimension)
+{
+  size_t nearest = 0;
+  float min_distance = std::numeric_limits<float>::max();
+  for (size_t centroid = 0; centroid<kNumCentroids; centroid++) {
+    float distance = 0.0f;
+    for (size_t dimension = 0; dimension<kDimension; dimension++) {
+      const auto kDifference = kSubvector[dimension]-kCentroids[centroid*kDimension+dimension];
+      distance += kDifference*kDifference;
+    }
+    if (distance<min_distance) {
+      min_distance = distance;
+      nearest = centroid;
+    }
+  }
+  return nearest;
+}
+
+// Lloyd's algorithm on the subvectors of one subspace, returns the centroids one after another
+std::vector<float> TrainSubspace
+  (const std::vector<std::vector<float>>& kSubvectors,
+   const size_t kNumCentroids,
+   const int kNumIterations,
+   std::mt19937& engine)
+{
+  const auto kDimension = kSubvectors[0].size();
+  std::vector<float> centroids;
+  centroids.reserve(kNumCentroids*kDimension);
+  for (const auto kIndex: SampleCentroidIndices(kSubvectors, kNumCentroids, SeedingMethod::kKmeansPlusPlus, engine)) {
+    centroids.insert(centroids.end(), kSubvectors[kIndex].begin(), kSubvectors[kIndex].end());
+  }
+
+  std::vector<size_t> assignments(kSubvectors.size(), kNumCentroids);
+  for (int iteration = 0; iteration<kNumIterations; iteration++) {
+    bool changed = false;
+    for (size_t index = 0; index<kSubvectors.size(); index++) {
+      const auto kNearest = NearestCentroid(kSubvectors[index].data(), centroids.data(), kNumCentroids, kDimension);
+      changed = changed || kNearest!=assignments[index];
+      assignments[index] = kNearest;
+    }
+    if (!changed) {break;}
+
+    // Mean of the assigned subvectors, empty clusters keep their centroid
+    std::vector<float> sums(kNumCentroids*kDimension, 0.0f);
+    std::vector<size_t> counts(kNumCentroids, 0);
+    for (size_t index = 0; index<kSubvectors.size(); index++) {
+      counts[assignments[index]]++;
+      for (size_t dimension = 0; dimension<kDimension; dimension++) {
+        sums[assignments[index]*kDimension+dimension] += kSubvectors[index][dimension];
+      }
+    }
+    for (size_t centroid = 0; centroid<kNumCentroids; centroid++) {
+      if (counts[centroid]==0) {continue;}
+      for (size_t dimension = 0; dimension<kDimension; dimension++) {
+        centroids[centroid*kDimension+dimension] = sums[centroid*kDimension+dimension]/counts[centroid];
+      }
+    }
+  }
+
+  return centroids;
+}
+
+} // namespace
+
+
+const size_t ProductQuantizer::kNumCentroids;
+
+
+ProductQuantizer ProductQuantizer::Train
+  (const std::vector<std::vector<float>>& kVectors,
+   const size_t kNumSubquantizers,
+   const int kNumIterations,
+   const int kSeed)
+{
+  if (kVectors.size()<kNumCentroids) {
+    throw std::invalid_argument("Need at least as many training vectors as centroids.");
+  }
+  const auto kDimension = kVectors[0].size();
+  for (const auto& kVector: kVectors) {
+    if (kVector.size()!=kDimension) {throw std::invalid_argument("Training vectors differ in dimension.");}
+  }
+  if (kNumSubquantizers==0 || kNumSubquantizers>256 || kNumSubquantizers>kDimension) {
+    throw std::invalid_argument("Number of subquantizers has to be in [1, min(256, dimension)].");
+  }
+
+  ProductQuantizer quantizer;
+  for (size_t subspace = 1; subspace<=kNumSubquantizers; subspace++) {
+    quantizer.subspace_offsets_.emplace_back(subspace*kDimension/kNumSubquantizers);
+  }
+
+  std::mt19937 engine(kSeed);
+  quantizer.centroids_.reserve(kNumCentroids*kDimension);
+  for (size_t subspace = 0; subspace<kNumSubquantizers; subspace++) {
+    const auto kBegin = quantizer.subspace_offsets_[subspace];
+    const auto kEnd = quantizer.subspace_offsets_[subspace+1];
+    std::vector<std::vector<float>> subvectors;
+    subvectors.reserve(kVectors.size());
+    for (const auto& kVector: kVectors) {subvectors.emplace_back(kVector.begin()+kBegin, kVector.begin()+kEnd);}
+
+    const auto kCentroids = TrainSubspace(subvectors, kNumCentroids, kNumIterations, engine);
+    quantizer.centroids_.insert(quantizer.centroids_.end(), kCentroids.begin(), kCentroids.end());
+  }
+
+  return quantizer;
+}
+
+
+std::vector<uint8_t> ProductQuantizer::Encode(const std::vector<float>& kVector) const {
+  if (kVector.size()!=this->Dimension()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  std::vector<uint8_t> centroid_indices(this->NumSubquantizers());
+  for (size_t subspace = 0; subspace<this->NumSubquantizers(); subspace++) {
+    const auto kBegin = this->subspace_offsets_[subspace];
+    centroid_indices[subspace] = static_cast<uint8_t>(NearestCentroid
+      (kVector.data()+kBegin, this->Centroid(subspace, 0), kNumCentroids,
+       this->subspace_offsets_[subspace+1]-kBegin));
+  }
+  return centroid_indices;
+}
+
+
+std::vector<float> ProductQuantizer::Decode(const std::vector<uint8_t>& kCentroidIndices) const {
+  if (kCentroidIndices.size()!=this->NumSubquantizers()) {throw std::invalid_argument("Code size mismatch.");}
+
+  std::vector<float> vector;
+  vector.reserve(this->Dimension());
+  for (size_t subspace = 0; subspace<this->NumSubquantizers(); subspace++) {
+    const auto kCentroid = this->Centroid(subspace, kCentroidIndices[subspace]);
+    vector.insert(vector.end(), kCentroid,
+      kCentroid+this->subspace_offsets_[subspace+1]-this->subspace_offsets_[subspace]);
+  }
+  return vector;
+}
+
+
+std::vector<float> ProductQuantizer::InnerProductTable(const std::vector<float>& kQuery) const {
+  if (kQuery.size()!=this->Dimension()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  std::vector<float> table;
+  table.reserve(this->NumSubquantizers()*kNumCentroids);
+  for (size_t subspace = 0; subspace<this->NumSubquantizers(); subspace++) {
+    const auto kBegin = this->subspace_offsets_[subspace];
+    const auto kSubspaceDimension = this->subspace_offsets_[subspace+1]-kBegin;
+    for (size_t centroid = 0; centroid<kNumCentroids; centroid++) {
+      table.emplace_back(DenseDotProduct(kQuery.data()+kBegin, this->Centroid(subspace, centroid), kSubspaceDimension));
+    }
+  }
+  return table;
+}
+
+
+void ProductQuantizer::Write(std::ostream& stream) const {
+  size_t num_subspace_offsets = this->subspace_offsets_.size();
+  size_t num_centroid_values = this->centroids_.size();
+  stream.write(reinterpret_cast<char*>(&num_subspace_offsets), sizeof(size_t));
+  stream.write(reinterpret_cast<const char*>(this->subspace_offsets_.data()), sizeof(size_t)*num_subspace_offsets);
+  stream.write(reinterpret_cast<char*>(&num_centroid_values), sizeof(size_t));
+  stream.write(reinterpret_cast<const char*>(this->centroids_.data()), sizeof(float)*num_centroid_values);
+}
+
+
+ProductQuantizer ProductQuantizer::Read(std::istream& stream) {
+  ProductQuantizer quantizer;
+  size_t num_subspace_offsets = 0;
+  stream.read(reinterpret_cast<char*>(&num_subspace_offsets), sizeof(size_t));
+  if (!stream || num_subspace_offsets<2 || num_subspace_offsets>257) {
+    throw std::runtime_error("Cannot read product quantizer.");
+  }
+  quantizer.subspace_offsets_.resize(num_subspace_offsets);
+  stream.read(reinterpret_cast<char*>(quantizer.subspace_offsets_.data()), sizeof(size_t)*num_subspace_offsets);
+
+  size_t num_centroid_values = 0;
+  stream.read(reinterpret_cast<char*>(&num_centroid_values), sizeof(size_t));
+  if (!stream || !std::is_sorted(quantizer.subspace_offsets_.begin(), quantizer.subspace_offsets_.end()) ||
+      quantizer.subspace_offsets_.front()!=0 ||
+      num_centroid_values!=kNumCentroids*quantizer.subspace_offsets_.back()) {
+    throw std::runtime_error("Inconsistent product quantizer.");
+  }
+  quantizer.centroids_.resize(num_centroid_values);
+  stream.read(reinterpret_cast<char*>(quantizer.centroids_.data()), sizeof(float)*num_centroid_values);
+  if (!stream) {throw std::runtime_error("Cannot read product quantizer.");}
+
+  return quantizer;
+}
+
+
+const float* ProductQuantizer::Centroid(const size_t kSubspace, const size_t kCentroid) const {
+  const auto kBegin = this->subspace_offsets_[kSubspace];
+  return &this->centroids_[kNumCentroids*kBegin+kCentroid*(this->subspace_offsets_[kSubspace+1]-kBegin)];
+}
+
+} // namespace igg
@@ -0,0 +1,113 @@
+#ifndef CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZER_HPP_
+#define CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZER_HPP_
+
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+
+namespace igg {
+
+/**
+ * Encodes vectors (e.g. normalized histograms) to compact codes.
+ *
+ * The dimensions are split into kNumSubquantizers consecutive subspaces of (almost)
+ * equal size, and each subvector is replaced by the index of its nearest centroid
+ * among kNumCentroids centroids of its subspace, trained with K-means. With 16
+ * centroids, each subvector takes 4 bit, i.e. a code of kNumSubquantizers/2 bytes.
+ *
+ * The inner product of a query and an encoded vector is the sum over the subspaces of
+ * the inner products of the query subvector and the centroid (asymmetric distance
+ * computation). Those are looked up in a table computed once per query, see InnerProductTable().
+ *
+ * Reference: Jegou, Douze, Schmid: Product quantization for nearest neighbor search, 2011
+ *
+ * Usage:
+ *
+ *   const auto kQuantizer = ProductQuantizer::Train(training_vectors, 128, 25, 0);
+ *   const auto kCode = kQuantizer.Encode(vector);
+ *   const auto kTable = kQuantizer.InnerProductTable(query);
+ */
+class ProductQuantizer {
+public:
+  /**
+   * Number of centroids of each subspace, so subvectors are encoded by 4 bit.
+   */
+  static const size_t kNumCentroids = 16;
+
+  /**
+   * Train the centroids of each subspace with K-means (k-means++ seeding).
+   *
+   * Throws an instance of std::invalid_argument if the vectors do not all have the same
+   * dimension, there are less than kNumCentroids vectors or less dimensions than
+   * subquantizers.
+   *
+   * @param kVectors Training vectors.
+   * @param kNumSubquantizers Number of subspaces, two per byte of code. At most 256.
+   * @param kNumIterations Maximum number of K-means iterations.
+   * @param kSeed For the initialization of K-means.
+   */
+  static ProductQuantizer Train
+    (const std::vector<std::vector<float>>& kVectors,
+     const size_t kNumSubquantizers,
+     const int kNumIterations,
+     const int kSeed);
+
+  size_t Dimension() const {return this->subspace_offsets_.back();}
+
+  size_t NumSubquantizers() const {return this->subspace_offsets_.size()-1;}
+
+  /**
+   * Number of bytes of a code.
+   */
+  size_t CodeSize() const {return (this->NumSubquantizers()+1)/2;}
+
+  /**
+   * Index of the nearest centroid for each subspace.
+   *
+   * Throws an instance of std::invalid_argument if the dimension does not match.
+   */
+  std::vector<uint8_t> Encode(const std::vector<float>& kVector) const;
+
+  /**
+   * Approximation of a vector by the centroids given by its code.
+   */
+  std::vector<float> Decode(const std::vector<uint8_t>& kCentroidIndices) const;
+
+  /**
+   * Inner product of each subvector of the query with each centroid of its subspace,
+   * kNumCentroids values per subspace.
+   *
+   * Throws an instance of std::invalid_argument if the dimension does not match.
+   */
+  std::vector<float> InnerProductTable(const std::vector<float>& kQuery) const;
+
+  /**
+   * Write the centroids to a binary stream.
+   */
+  void Write(std::ostream& stream) const;
+
+  /**
+   * Read a quantizer from a binary stream as written by Write().
+   *
+   * Throws a std::runtime_error in case the stream cannot be read.
+   */
+  static ProductQuantizer Read(std::istream& stream);
+
+private:
+  // Subspace s consists of the dimensions from subspace_offsets_[s] (inclusive)
+  // to subspace_offsets_[s+1] (exclusive)
+  std::vector<size_t> subspace_offsets_;
+  // Centroids of all subspaces, kNumCentroids subvectors each, starting at
+  // kNumCentroids*subspace_offsets_[s] for subspace s
+  std::vector<float> centroids_;
+
+  ProductQuantizer(): subspace_offsets_{0} {}
+
+  const float* Centroid(const size_t kSubspace, const size_t kCentroid) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_PRODUCT_QUANTIZATION_PRODUCT_QUANTIZER_HPP_
@@ -0,0 +1,88 @@
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "features/features.hpp"
+#include "server/query_client.hpp"
+#include "server/shard_coordinator.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("image,", po::value<std::string>(), "Path of the query image.")
+    ("socket,", po::value<std::vector<std::string>>()->default_value({"/tmp/bag_of_words.sock"}, "/tmp/bag_of_words.sock"), "Path of the socket query_server listens on. Given several times, the query is sent to the server of each shard of a dataset split by shard_dataset, in the order of the shards.")
+    ("mode,", po::value<std::string>()->default_value("exhaustive"), "How to find the images. Options: exhaustive, pruned, quantized, product-quantized, vlad, graph, vlad-graph.")
+    ("num-results,n", po::value<uint32_t>()->default_value(5), "Number of most similar images.")
+    ("candidates,", po::value<uint32_t>()->default_value(200), "Number of candidates re-ranked or considered, see the query mode.")
+    ("send-features,", "Extract the features of the image here and send them, instead of its path. Use if the server cannot read the image.");
+
+  po::positional_options_description positional_options;
+  positional_options.add("image", 1);
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options_description).positional(positional_options).run(),
+      variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help") || !variables_map.count("image")) {
+    std::cout << "Usage: query_client [options] <image>\n";
+    std::cout << "Asks a running query_server for the most similar images and prints their similarities and paths.\n";
+    std::cout << options_description;
+    return variables_map.count("help") ? 0 : 1;
+  }
+
+  igg::QueryRequest request;
+  try {
+    request.mode = igg::QueryModeFromString(variables_map["mode"].as<std::string>());
+  } catch (const std::invalid_argument& kError) {
+    std::cerr << kError.what() << "\n";
+    return 1;
+  }
+  request.num_results = variables_map["num-results"].as<uint32_t>();
+  request.num_candidates = variables_map["candidates"].as<uint32_t>();
+
+  // Paths are resolved by the server, which may run in another directory
+  const auto kImagePath = boost::filesystem::absolute(variables_map["image"].as<std::string>()).string();
+  if (variables_map.count("send-features")) {
+    const cv::Mat kImage = cv::imread(kImagePath, CV_LOAD_IMAGE_COLOR);
+    if (!kImage.data) {std::cerr << "Error while reading image.\n"; return 1;}
+    request.type = igg::QueryType::kFeatures;
+    request.features = igg::FromMat<float>(igg::ComputeFeatures(kImage));
+  } else {
+    request.type = igg::QueryType::kImagePath;
+    request.image_path = kImagePath;
+  }
+
+  try {
+    const auto kSocketPaths = variables_map["socket"].as<std::vector<std::string>>();
+    const auto kResponse = kSocketPaths.size()>1 ?
+      igg::ShardCoordinator(kSocketPaths).Query(request) : igg::QueryClient(kSocketPaths[0]).Query(request);
+    if (!kResponse.ok) {
+      std::cerr << "Error while similarity query: " << kResponse.error << "\n";
+      return 1;
+    }
+    for (const auto& kResult: kResponse.results) {
+      std::cout << kResult.similarity << " " << kResult.image_path << "\n";
+    }
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
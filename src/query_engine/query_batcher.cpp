@@ -0,0 +1,117 @@
+
+#include "query_batcher.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+
+namespace igg {
+
+QueryBatcher::QueryBatcher
+  (const std::shared_ptr<const QueryEngine> kEngine,
+   const size_t kMaxBatchSize,
+   const std::chrono::microseconds kMaxWait):
+  kEngine_{kEngine}, kMaxBatchSize_{kMaxBatchSize}, kMaxWait_{kMaxWait}
+{
+  if (kMaxBatchSize==0) {throw std::invalid_argument("Batch size has to be positive.");}
+  this->thread_ = std::thread(&QueryBatcher::ScoreBatches, this);
+}
+
+
+QueryBatcher::~QueryBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_ = true;
+  }
+  this->queue_changed_.notify_all();
+  this->thread_.join();
+}
+
+
+std::future<std::vector<ScoredIndex<float>>> QueryBatcher::Submit
+  (SparseHistogram<float> query_histogram, const size_t kNumResults)
+{
+  if (query_histogram.NumBins()!=this->kEngine_->NumWords()) {
+    throw std::invalid_argument("Number of bins does not match.");
+  }
+
+  PendingQuery query{std::move(query_histogram), kNumResults, std::chrono::steady_clock::now(), {}};
+  auto future = query.results.get_future();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->queue_.emplace_back(std::move(query));
+  }
+  this->queue_changed_.notify_all();
+  return future;
+}
+
+
+std::vector<ScoredIndex<float>> QueryBatcher::MostSimilarItems
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults)
+{
+  return this->Submit(this->kEngine_->QueryHistogram(kQueryFeatures), kNumResults).get();
+}
+
+
+size_t QueryBatcher::NumBatches() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->num_batches_;
+}
+
+
+size_t QueryBatcher::NumQueries() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->num_queries_;
+}
+
+
+void QueryBatcher::ScoreBatches() {
+  while (true) {
+    std::vector<PendingQuery> batch;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->queue_changed_.wait(lock, [this]() {return this->stop_ || !this->queue_.empty();});
+      if (this->queue_.empty()) {return;}
+
+      // Wait for more queries until the batch is full or its first query waited long enough
+      const auto kDeadline = this->queue_.front().arrival+this->kMaxWait_;
+      this->queue_changed_.wait_until(lock, kDeadline,
+        [this]() {return this->stop_ || this->queue_.size()>=this->kMaxBatchSize_;});
+
+      const auto kBatchSize = std::min(this->queue_.size(), this->kMaxBatchSize_);
+      for (size_t query = 0; query<kBatchSize; query++) {
+        batch.emplace_back(std::move(this->queue_.front()));
+        this->queue_.pop_front();
+      }
+      this->num_batches_++;
+      this->num_queries_ += kBatchSize;
+    }
+
+    // Score with the largest number of results, shorten the others
+    std::vector<SparseHistogram<float>> histograms;
+    size_t max_num_results = 0;
+    for (auto& query: batch) {
+      histograms.emplace_back(std::move(query.histogram));
+      max_num_results = std::max(max_num_results, query.num_results);
+    }
+    size_t num_answered = 0;
+    try {
+      auto results = this->kEngine_->MostSimilarItemsBatch(histograms, max_num_results);
+      for (; num_answered<batch.size(); num_answered++) {
+        auto& query_results = results[num_answered];
+        if (query_results.size()>batch[num_answered].num_results)
+          {query_results.resize(batch[num_answered].num_results);}
+        batch[num_answered].results.set_value(std::move(query_results));
+      }
+    } catch (...) {
+      // Queries answered before the failure keep their results
+      for (size_t query = num_answered; query<batch.size(); query++) {
+        batch[query].results.set_exception(std::current_exception());
+      }
+    }
+  }
+}
+
+} // namespace igg
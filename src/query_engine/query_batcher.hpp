@@ -0,0 +1,106 @@
+#ifndef CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_BATCHER_HPP_
+#define CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_BATCHER_HPP_
+
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "query_engine.hpp"
+
+
+namespace igg {
+
+/**
+ * Collects queries of many threads into batches and scores each batch at once, see
+ * QueryEngine::MostSimilarItemsBatch(). Under load this raises the throughput, since
+ * the histograms of the dataset are swept once per batch instead of once per query.
+ *
+ * A batch is scored as soon as it has kMaxBatchSize queries, or kMaxWait after its
+ * first query arrived, so a query waits at most kMaxWait longer than scoring takes.
+ * Scoring runs on a thread of the batcher, the query histograms are made by the
+ * submitting threads.
+ *
+ * Usage:
+ *
+ *   QueryBatcher batcher(QueryEngine::Load(dataset), 32, std::chrono::microseconds(2000));
+ *   // In each thread
+ *   const auto kTop10 = batcher.MostSimilarItems(features, 10);
+ */
+class QueryBatcher {
+public:
+  /**
+   * Constructor. Starts the scoring thread.
+   *
+   * Throws an instance of std::invalid_argument if kMaxBatchSize is zero.
+   *
+   * @param kEngine The snapshot to query.
+   * @param kMaxBatchSize Most queries scored at once, e.g. 32.
+   * @param kMaxWait Longest time to wait for more queries, e.g. 1 to 5 ms.
+   */
+  QueryBatcher
+    (const std::shared_ptr<const QueryEngine> kEngine,
+     const size_t kMaxBatchSize,
+     const std::chrono::microseconds kMaxWait);
+
+  /**
+   * Scores the pending queries and stops the scoring thread.
+   */
+  ~QueryBatcher();
+
+  QueryBatcher(const QueryBatcher&) = delete;
+  QueryBatcher& operator=(const QueryBatcher&) = delete;
+
+  const QueryEngine& Engine() const {return *this->kEngine_;}
+
+  /**
+   * Queue a query, see QueryEngine::MostSimilarItems(). The future throws if scoring failed.
+   *
+   * Throws an instance of std::invalid_argument if the number of bins does not match.
+   */
+  std::future<std::vector<ScoredIndex<float>>> Submit
+    (SparseHistogram<float> query_histogram, const size_t kNumResults);
+
+  /**
+   * Make the histogram of the features, queue it and wait for the results.
+   */
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults);
+
+  /**
+   * Number of batches and queries scored so far, the average batch size is their ratio.
+   */
+  size_t NumBatches() const;
+  size_t NumQueries() const;
+
+private:
+  struct PendingQuery {
+    SparseHistogram<float> histogram;
+    size_t num_results;
+    std::chrono::steady_clock::time_point arrival;
+    std::promise<std::vector<ScoredIndex<float>>> results;
+  };
+
+  const std::shared_ptr<const QueryEngine> kEngine_;
+  const size_t kMaxBatchSize_;
+  const std::chrono::microseconds kMaxWait_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable queue_changed_;
+  std::deque<PendingQuery> queue_;
+  bool stop_ = false;
+  size_t num_batches_ = 0;
+  size_t num_queries_ = 0;
+  std::thread thread_;
+
+  void ScoreBatches();
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_BATCHER_HPP_
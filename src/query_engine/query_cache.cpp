@@ -0,0 +1,144 @@
+
+#include "query_cache.hpp"
+
+#include <cstring>
+#include <iterator>
+
+
+namespace igg {
+
+namespace {
+
+const uint64_t kHashMultiplier = 0xc6a4a7935bd1e995ULL;
+const int kHashShift = 47;
+
+// Approximate memory of an entry and its bookkeeping
+size_t EntryBytes(const QueryCache::Entry& kEntry) {
+  return sizeof(QueryCache::Entry)+64+
+    kEntry.histogram.NumNonZeros()*(sizeof(uint32_t)+sizeof(float))+
+    kEntry.results.size()*sizeof(ScoredIndex<float>);
+}
+
+} // namespace
+
+
+QueryCache::QueryCache(const size_t kMaxBytes): kMaxBytes_{kMaxBytes} {}
+
+
+uint64_t QueryCache::ContentHash(const void* kData, const size_t kSize) {
+  // MurmurHash64A, eight bytes at a time
+  const auto* kBytes = static_cast<const unsigned char*>(kData);
+  uint64_t hash = kSize*kHashMultiplier;
+  size_t position = 0;
+  for (; position+sizeof(uint64_t)<=kSize; position += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, kBytes+position, sizeof(uint64_t));
+    word *= kHashMultiplier;
+    word ^= word >> kHashShift;
+    word *= kHashMultiplier;
+    hash ^= word;
+    hash *= kHashMultiplier;
+  }
+  if (position<kSize) {
+    uint64_t word = 0;
+    std::memcpy(&word, kBytes+position, kSize-position);
+    hash ^= word;
+    hash *= kHashMultiplier;
+  }
+  hash ^= hash >> kHashShift;
+  hash *= kHashMultiplier;
+  hash ^= hash >> kHashShift;
+  return hash;
+}
+
+
+std::shared_ptr<const QueryCache::Entry> QueryCache::Find
+  (const uint64_t kContentHash, const uint64_t kIndexVersion)
+{
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->UseVersion(kIndexVersion);
+  const auto kPosition = this->positions_.find(kContentHash);
+  if (kPosition==this->positions_.end()) {
+    this->misses_++;
+    return nullptr;
+  }
+  this->hits_++;
+  this->items_.splice(this->items_.begin(), this->items_, kPosition->second);
+  return kPosition->second->second;
+}
+
+
+void QueryCache::Insert(const uint64_t kContentHash, const uint64_t kIndexVersion, Entry entry) {
+  const auto kBytes = EntryBytes(entry);
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->UseVersion(kIndexVersion);
+
+  const auto kPosition = this->positions_.find(kContentHash);
+  if (kPosition!=this->positions_.end()) {this->Erase(kPosition->second);}
+  if (kBytes>this->kMaxBytes_) {return;}
+
+  this->MakeRoom(kBytes);
+  this->items_.emplace_front(kContentHash, std::make_shared<const Entry>(std::move(entry)));
+  this->positions_[kContentHash] = this->items_.begin();
+  this->bytes_ += kBytes;
+}
+
+
+void QueryCache::Clear() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->items_.clear();
+  this->positions_.clear();
+  this->bytes_ = 0;
+}
+
+
+size_t QueryCache::Size() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->items_.size();
+}
+
+size_t QueryCache::Bytes() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->bytes_;
+}
+
+size_t QueryCache::Hits() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->hits_;
+}
+
+size_t QueryCache::Misses() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->misses_;
+}
+
+size_t QueryCache::Evictions() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->evictions_;
+}
+
+
+void QueryCache::UseVersion(const uint64_t kIndexVersion) {
+  if (kIndexVersion==this->index_version_) {return;}
+  this->items_.clear();
+  this->positions_.clear();
+  this->bytes_ = 0;
+  this->index_version_ = kIndexVersion;
+}
+
+
+void QueryCache::MakeRoom(const size_t kBytes) {
+  while (!this->items_.empty() && this->bytes_+kBytes>this->kMaxBytes_) {
+    this->Erase(std::prev(this->items_.end()));
+    this->evictions_++;
+  }
+}
+
+
+void QueryCache::Erase(const std::list<Item>::iterator item) {
+  this->bytes_ -= EntryBytes(*item->second);
+  this->positions_.erase(item->first);
+  this->items_.erase(item);
+}
+
+} // namespace igg
@@ -0,0 +1,112 @@
+#ifndef CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_CACHE_HPP_
+#define CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_CACHE_HPP_
+
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "histogram/ranking.hpp"
+#include "histogram/sparse_histogram.hpp"
+
+
+namespace igg {
+
+/**
+ * Least recently used cache of query histograms and results, for queries repeated
+ * with the same image. Entries are keyed by a hash of the image content, so a query
+ * hit skips decoding, feature extraction and scoring.
+ *
+ * Each lookup and insertion names the version of the index it is meant for, e.g.
+ * QueryEngine::Version(). When the version changes, all entries of the previous one
+ * are dropped, so results of outdated histograms are never returned.
+ *
+ * The memory of the entries is kept below kMaxBytes by dropping the least recently
+ * used ones. All methods may be called from several threads.
+ *
+ * Usage:
+ *
+ *   QueryCache cache(64 << 20);
+ *   const auto kHash = QueryCache::ContentHash(bytes.data(), bytes.size());
+ *   const auto kEntry = cache.Find(kHash, engine.Version());
+ *   if (kEntry && kEntry->num_results>=10) {
+ *     // Use kEntry->results
+ *   } else {
+ *     // Make the histogram (or use kEntry->histogram) and score it
+ *     cache.Insert(kHash, engine.Version(), {histogram, results, 10});
+ *   }
+ */
+class QueryCache {
+public:
+  struct Entry {
+    SparseHistogram<float> histogram;
+    // Most similar images, valid for up to num_results results
+    std::vector<ScoredIndex<float>> results;
+    size_t num_results = 0;
+  };
+
+  /**
+   * Constructor.
+   *
+   * @param kMaxBytes Most memory used by the entries, approximately.
+   */
+  explicit QueryCache(const size_t kMaxBytes);
+
+  /**
+   * Fast non-cryptographic 64 bit hash of some bytes, e.g. of an image file.
+   */
+  static uint64_t ContentHash(const void* kData, const size_t kSize);
+
+  /**
+   * Cached entry of an image, or nullptr if there is none for this version.
+   * Counts a hit or a miss.
+   */
+  std::shared_ptr<const Entry> Find(const uint64_t kContentHash, const uint64_t kIndexVersion);
+
+  /**
+   * Store an entry, replacing one of the same image. Entries larger than the cache
+   * are not stored.
+   */
+  void Insert(const uint64_t kContentHash, const uint64_t kIndexVersion, Entry entry);
+
+  /**
+   * Drop all entries, counters are kept.
+   */
+  void Clear();
+
+  size_t Size() const;
+  size_t Bytes() const;
+  size_t MaxBytes() const {return this->kMaxBytes_;}
+  size_t Hits() const;
+  size_t Misses() const;
+  size_t Evictions() const;
+
+private:
+  using Item = std::pair<uint64_t, std::shared_ptr<const Entry>>;
+
+  const size_t kMaxBytes_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first
+  std::list<Item> items_;
+  std::unordered_map<uint64_t, std::list<Item>::iterator> positions_;
+  uint64_t index_version_ = 0;
+  size_t bytes_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  size_t evictions_ = 0;
+
+  // Clears the entries of another version, mutex_ has to be locked
+  void UseVersion(const uint64_t kIndexVersion);
+  // Drops the least recently used entries until kBytes more fit, mutex_ has to be locked
+  void MakeRoom(const size_t kBytes);
+  void Erase(std::list<Item>::iterator item);
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_CACHE_HPP_
@@ -0,0 +1,188 @@
+
+#include "query_engine.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+#include "tools/simd.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// Buffers of the queries of each thread which did not pass their own
+thread_local QueryEngine::Scratch thread_scratch;
+
+// Version of the next snapshot
+std::atomic<uint64_t> next_version{1};
+
+void NormalizeInPlace(Histogram<float>& histogram) {
+  const auto kNorm = std::sqrt(DenseDotProduct(histogram.data(), histogram.data(), histogram.size()));
+  if (kNorm>0.0f) {
+    for (auto& weight: histogram) {weight /= kNorm;}
+  }
+}
+
+} // namespace
+
+
+QueryEngine::QueryEngine
+  (Vocabulary vocabulary,
+   const std::vector<SparseHistogram<float>>& kHistograms,
+   std::vector<std::string> image_paths):
+  kVocabulary_(std::move(vocabulary)), kIndex_(kHistograms), kImagePaths_(std::move(image_paths)),
+  kVersion_(next_version++)
+{
+  const auto kNumWords = this->kVocabulary_.centroids.size();
+  if (kNumWords==0) {throw std::invalid_argument("Need at least one visual word.");}
+  for (const auto& kCentroid: this->kVocabulary_.centroids) {
+    if (kCentroid.size()!=this->kVocabulary_.centroids[0].size()) {
+      throw std::invalid_argument("Centroids differ in dimension.");
+    }
+  }
+  if (this->kVocabulary_.weights.size()!=kNumWords || this->kVocabulary_.pruning.NumWords()!=kNumWords) {
+    throw std::invalid_argument("Weights or pruning do not match the number of words.");
+  }
+  if (this->kVocabulary_.word_index && this->kVocabulary_.word_index->Size()!=kNumWords) {
+    throw std::invalid_argument("Word index does not match the number of words.");
+  }
+  if (this->kIndex_.Size()!=this->kImagePaths_.size() ||
+      (this->kIndex_.Size()>0 && this->kIndex_.NumBins()!=kNumWords)) {
+    throw std::invalid_argument("Histograms do not match the images or the number of words.");
+  }
+}
+
+
+std::shared_ptr<const QueryEngine> QueryEngine::Load(const Dataset& kDataset) {
+  Vocabulary vocabulary;
+  vocabulary.centroids = kDataset.LoadCentroids();
+  vocabulary.weights = kDataset.LoadHistogramWeights();
+  vocabulary.pruning = kDataset.HasVocabularyPruning() ?
+    kDataset.LoadVocabularyPruning() : VocabularyPruning(vocabulary.centroids.size());
+  if (kDataset.HasWordIndex()) {
+    auto index = kDataset.LoadWordIndex();
+    if (index.Size()==vocabulary.centroids.size()) {
+      vocabulary.word_index = std::make_shared<const HnswIndex<FeaturePoint<float>>>(std::move(index));
+    }
+  }
+
+  const auto kItems = kDataset.Items();
+  std::vector<SparseHistogram<float>> histograms;
+  std::vector<std::string> image_paths;
+  histograms.reserve(kItems.size());
+  image_paths.reserve(kItems.size());
+  for (const auto& kItem: kItems) {
+    histograms.emplace_back(kItem->LoadSparseHistogram());
+    image_paths.emplace_back(kItem->ImagePath());
+  }
+
+  try {
+    return std::make_shared<const QueryEngine>(std::move(vocabulary), histograms, std::move(image_paths));
+  } catch (const std::invalid_argument& kError) {
+    throw std::runtime_error(std::string("Results of the dataset do not match: ")+kError.what());
+  }
+}
+
+
+SparseHistogram<float> QueryEngine::QueryHistogram
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures, Scratch& scratch) const
+{
+  this->MakeQueryHistogram(kQueryFeatures, scratch);
+  return SparseHistogram<float>::FromDense(scratch.histogram);
+}
+
+
+SparseHistogram<float> QueryEngine::QueryHistogram
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures) const
+{
+  return this->QueryHistogram(kQueryFeatures, thread_scratch);
+}
+
+
+std::vector<ScoredIndex<float>> QueryEngine::MostSimilarItems
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults, Scratch& scratch) const
+{
+  this->MakeQueryHistogram(kQueryFeatures, scratch);
+  return this->TopK(kNumResults, scratch);
+}
+
+
+std::vector<ScoredIndex<float>> QueryEngine::MostSimilarItems
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults) const
+{
+  return this->MostSimilarItems(kQueryFeatures, kNumResults, thread_scratch);
+}
+
+
+std::vector<ScoredIndex<float>> QueryEngine::MostSimilarItems
+  (const SparseHistogram<float>& kQueryHistogram, const size_t kNumResults, Scratch& scratch) const
+{
+  if (kQueryHistogram.NumBins()!=this->NumWords()) {throw std::invalid_argument("Number of bins does not match.");}
+  scratch.histogram.assign(this->NumWords(), 0.0f);
+  for (size_t index = 0; index<kQueryHistogram.NumNonZeros(); index++) {
+    scratch.histogram[kQueryHistogram.Bins()[index]] = kQueryHistogram.Weights()[index];
+  }
+  return this->TopK(kNumResults, scratch);
+}
+
+
+std::vector<ScoredIndex<float>> QueryEngine::MostSimilarItems
+  (const SparseHistogram<float>& kQueryHistogram, const size_t kNumResults) const
+{
+  return this->MostSimilarItems(kQueryHistogram, kNumResults, thread_scratch);
+}
+
+
+std::vector<std::vector<ScoredIndex<float>>> QueryEngine::MostSimilarItemsBatch
+  (const std::vector<SparseHistogram<float>>& kQueryHistograms, const size_t kNumResults) const
+{
+  std::vector<Histogram<float>> queries;
+  std::vector<const float*> query_pointers;
+  queries.reserve(kQueryHistograms.size());
+  for (const auto& kQueryHistogram: kQueryHistograms) {
+    if (kQueryHistogram.NumBins()!=this->NumWords()) {throw std::invalid_argument("Number of bins does not match.");}
+    queries.emplace_back(kQueryHistogram.ToDense());
+    NormalizeInPlace(queries.back());
+    query_pointers.emplace_back(queries.back().data());
+  }
+  return this->kIndex_.TopKNormalizedBatch(query_pointers, kNumResults);
+}
+
+
+void QueryEngine::MakeQueryHistogram
+  (const std::vector<FeaturePoint<float>>& kQueryFeatures, Scratch& scratch) const
+{
+  const auto& kCentroids = this->kVocabulary_.centroids;
+  auto& histogram = scratch.histogram;
+  histogram.assign(kCentroids.size(), 0.0f);
+
+  // Same steps as in BagOfWords::MakeHistograms()
+  for (const auto& kFeature: kQueryFeatures) {
+    if (kFeature.size()!=kCentroids[0].size()) {
+      throw std::invalid_argument("Dimension of query features does not match the visual words.");
+    }
+    const size_t kWord = this->kVocabulary_.word_index ?
+      this->kVocabulary_.word_index->NearestNeighbor(kFeature) : NearestNeighbor(kFeature, kCentroids);
+    histogram[kWord] += 1.0f;
+  }
+  this->kVocabulary_.pruning.Apply(histogram);
+
+  const float kNumFeatures = std::accumulate(histogram.begin(), histogram.end(), 0.0f);
+  if (kNumFeatures>0.0f) {
+    for (size_t word = 0; word<histogram.size(); word++) {
+      histogram[word] = histogram[word]/kNumFeatures*this->kVocabulary_.weights[word];
+    }
+  }
+}
+
+
+std::vector<ScoredIndex<float>> QueryEngine::TopK(const size_t kNumResults, Scratch& scratch) const {
+  NormalizeInPlace(scratch.histogram);
+  return this->kIndex_.TopKNormalized(scratch.histogram.data(), kNumResults);
+}
+
+} // namespace igg
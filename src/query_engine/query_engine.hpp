@@ -0,0 +1,153 @@
+#ifndef CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_ENGINE_HPP_
+#define CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_ENGINE_HPP_
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dataset/dataset.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "histogram/similarity_index.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+
+
+namespace igg {
+
+/**
+ * Immutable snapshot of everything a similarity query needs: the visual words,
+ * their weights and pruning, and the normalized histograms and image paths of the
+ * dataset. Nothing is loaded or modified after construction, so any number of
+ * threads may query the same instance concurrently without locks.
+ *
+ * A query only needs buffers of the size of the vocabulary, kept in a Scratch per
+ * thread. Either pass one explicitly, or use the overloads without, which use one
+ * per calling thread. Each query is answered by the calling thread only, the
+ * throughput is scaled by querying from several threads.
+ *
+ * Usage:
+ *
+ *   const auto kEngine = QueryEngine::Load(dataset);
+ *   // In each thread
+ *   QueryEngine::Scratch scratch;
+ *   const auto kTop10 = kEngine->MostSimilarItems(features, 10, scratch);
+ */
+class QueryEngine {
+public:
+  /**
+   * Visual words to make histograms of query features, see BagOfWords::MakeHistograms().
+   */
+  struct Vocabulary {
+    std::vector<FeaturePoint<float>> centroids;
+    // Optional, approximate assignment to the words if set
+    std::shared_ptr<const HnswIndex<FeaturePoint<float>>> word_index;
+    std::vector<float> weights;
+    VocabularyPruning pruning;
+  };
+
+  /**
+   * Buffers of a single query, reused by subsequent queries of the same thread.
+   */
+  struct Scratch {
+    Histogram<float> histogram;
+  };
+
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if the sizes of the vocabulary,
+   * histograms and image paths do not match.
+   *
+   * @param vocabulary The visual words.
+   * @param kHistograms Re-weighted histogram of each image.
+   * @param image_paths Path of each image.
+   */
+  QueryEngine
+    (Vocabulary vocabulary,
+     const std::vector<SparseHistogram<float>>& kHistograms,
+     std::vector<std::string> image_paths);
+
+  /**
+   * Load the snapshot of a dataset. A word index is used if it was built for the centroids.
+   *
+   * Throws an instance of std::runtime_error if something cannot be loaded or does not match.
+   */
+  static std::shared_ptr<const QueryEngine> Load(const Dataset& kDataset);
+
+  /**
+   * Number of images.
+   */
+  size_t Size() const {return this->kImagePaths_.size();}
+
+  /**
+   * Number of visual words.
+   */
+  size_t NumWords() const {return this->kVocabulary_.centroids.size();}
+
+  const std::string& ImagePath(const size_t kIndex) const {return this->kImagePaths_[kIndex];}
+
+  /**
+   * Identifies this snapshot among all constructed by the process, e.g. to invalidate
+   * cached results (see QueryCache) once the histograms were made again.
+   */
+  uint64_t Version() const {return this->kVersion_;}
+
+  /**
+   * Normalized histograms of the images.
+   */
+  const SimilarityIndex<float>& Index() const {return this->kIndex_;}
+
+  /**
+   * Re-weighted histogram of an image given by its features, comparable to the ones of
+   * the dataset.
+   *
+   * Throws an instance of std::invalid_argument if the dimension of the features does
+   * not match the words.
+   */
+  SparseHistogram<float> QueryHistogram(const std::vector<FeaturePoint<float>>& kQueryFeatures, Scratch& scratch) const;
+  SparseHistogram<float> QueryHistogram(const std::vector<FeaturePoint<float>>& kQueryFeatures) const;
+
+  /**
+   * Most similar images to an image given by its features or by its re-weighted histogram,
+   * as pairs of index of the image and cosine similarity, most similar first.
+   *
+   * Throws an instance of std::invalid_argument if the dimensions do not match.
+   */
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults, Scratch& scratch) const;
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const std::vector<FeaturePoint<float>>& kQueryFeatures, const size_t kNumResults) const;
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const SparseHistogram<float>& kQueryHistogram, const size_t kNumResults, Scratch& scratch) const;
+  std::vector<ScoredIndex<float>> MostSimilarItems
+    (const SparseHistogram<float>& kQueryHistogram, const size_t kNumResults) const;
+
+  /**
+   * Most similar images to several images at once, see SimilarityIndex::TopKNormalizedBatch().
+   * Scores many queries considerably faster than one after the other, but uses several
+   * threads, see QueryBatcher.
+   *
+   * Throws an instance of std::invalid_argument if the dimensions do not match.
+   *
+   * @return The results of each query, in the order of the queries.
+   */
+  std::vector<std::vector<ScoredIndex<float>>> MostSimilarItemsBatch
+    (const std::vector<SparseHistogram<float>>& kQueryHistograms, const size_t kNumResults) const;
+
+private:
+  const Vocabulary kVocabulary_;
+  const SimilarityIndex<float> kIndex_;
+  const std::vector<std::string> kImagePaths_;
+  const uint64_t kVersion_;
+
+  // Re-weighted histogram in scratch.histogram
+  void MakeQueryHistogram(const std::vector<FeaturePoint<float>>& kQueryFeatures, Scratch& scratch) const;
+
+  // Normalize scratch.histogram and score it
+  std::vector<ScoredIndex<float>> TopK(const size_t kNumResults, Scratch& scratch) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_QUERY_ENGINE_QUERY_ENGINE_HPP_
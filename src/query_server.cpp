@@ -0,0 +1,83 @@
+
+#include <chrono>
+#include <csignal>
+#include <boost/program_options.hpp>
+
+#include "server/query_server.hpp"
+
+
+namespace {
+
+igg::QueryServer* running_server = nullptr;
+
+void StopServer(int) {
+  if (running_server) {running_server->Stop();}
+}
+
+} // namespace
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("socket,", po::value<std::string>()->default_value("/tmp/bag_of_words.sock"), "Path of the socket to listen on.")
+    ("mode,", po::value<std::string>()->default_value("exhaustive"), "Query mode to load everything for on start. Options: exhaustive, pruned, quantized, product-quantized, vlad, graph, vlad-graph.")
+    ("cache-mb,", po::value<size_t>()->default_value(64), "Memory of the cache of repeated query images in MB, 0 to disable it.")
+    ("max-connections,", po::value<size_t>()->default_value(16), "Number of connections served at the same time.")
+    ("read-timeout,", po::value<size_t>()->default_value(60), "Seconds after which a connection without a new request is closed.")
+    ("quiet,q", "Do not log each query.");
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::parse_command_line(argc, argv, options_description), variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help")) {
+    std::cout << "Answers similarity queries of query_client until interrupted, keeping the visual dictionary in memory.\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and the visual dictionary has been created.\n";
+    std::cout << options_description;
+    return 0;
+  }
+
+  igg::QueryMode mode;
+  try {
+    mode = igg::QueryModeFromString(variables_map["mode"].as<std::string>());
+  } catch (const std::invalid_argument& kError) {
+    std::cerr << kError.what() << "\n";
+    return 1;
+  }
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  try {
+    igg::QueryServer server
+      (kDataset, variables_map["socket"].as<std::string>(), !variables_map.count("quiet"),
+       variables_map["cache-mb"].as<size_t>() << 20, variables_map["max-connections"].as<size_t>(),
+       std::chrono::seconds(variables_map["read-timeout"].as<size_t>()));
+    std::cout << "Load visual dictionary of " << kDataset->Items().size() << " images.\n";
+    server.Prepare(mode);
+
+    running_server = &server;
+    std::signal(SIGINT, StopServer);
+    std::signal(SIGTERM, StopServer);
+    server.Run();
+    running_server = nullptr;
+    std::cout << "Query cache: " << server.Cache().Hits() << " hits, " << server.Cache().Misses() << " misses.\n";
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
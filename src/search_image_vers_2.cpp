@@ -13,18 +13,44 @@ int main(int argc, char** argv)
 {
     if (argc<2)
     {
-        std::cerr << "Error while parsing arguments: Please provide the path to the query image.\n";
+        std::cerr << "Error while parsing arguments: Please provide the path to the query image "
+            "(and optionally a deadline in milliseconds), to its _features.binary file, "
+            "or --item and the index of an image of the dataset.\n";
         return 1;
     }
 
     const std::string kQueryImagePath = argv[1];
 
-    const cv::Mat kQueryImage = cv::imread(kQueryImagePath, CV_LOAD_IMAGE_COLOR);
+    // An image of the dataset is queried by its index, from its stored histogram
+    const bool kQueryItem = kQueryImagePath == "--item";
+    size_t query_item_index = 0;
+    if (kQueryItem)
+    {
+        try
+        {
+            query_item_index = std::stoul(argc>2 ? argv[2] : "");
+        }
+        catch (const std::exception&)
+        {
+            std::cerr << "Error while parsing arguments: Please provide the index of the image after --item.\n";
+            return 1;
+        }
+    }
+
+    // Descriptors computed beforehand are queried directly, without the image
+    const std::string kFeaturesSuffix = "_features.binary";
+    const bool kQueryFeatures = kQueryImagePath.size()>kFeaturesSuffix.size() &&
+        kQueryImagePath.compare(kQueryImagePath.size()-kFeaturesSuffix.size(), kFeaturesSuffix.size(), kFeaturesSuffix)==0;
 
-    if (!kQueryImage.data)
+    cv::Mat kQueryImage;
+    if (!kQueryFeatures && !kQueryItem)
     {
-        std::cerr << "Error while reading image.\n";
-        return 1;
+        kQueryImage = cv::imread(kQueryImagePath, CV_LOAD_IMAGE_COLOR);
+        if (!kQueryImage.data)
+        {
+            std::cerr << "Error while reading image.\n";
+            return 1;
+        }
     }
 
     int kNumIterations = 100;
@@ -33,11 +59,36 @@ int main(int argc, char** argv)
     bool kVerbose = true;
     igg::vers_2::bagofwords bag_of_words(kNumIterations, kEpsilon, kNumClusters, kVerbose);
 
+    const size_t kMaxExamplesSimilar = 5; // Do not show more than the five most similar images
     std::vector<std::shared_ptr<const igg::ImageItem>> items_odered_by_similarity;
 
     try
     {
-      items_odered_by_similarity = bag_of_words.SearchImage(kQueryImage);
+      if (kQueryItem)
+      {
+        items_odered_by_similarity = bag_of_words.SearchItem(query_item_index, kMaxExamplesSimilar);
+      }
+      else if (kQueryFeatures)
+      {
+        items_odered_by_similarity = bag_of_words.SearchFeaturesFile(kQueryImagePath, kMaxExamplesSimilar);
+      }
+      else if (argc>2)
+      {
+        // Optional deadline in milliseconds, the query is simplified as far as needed
+        igg::vers_2::SearchBudget budget;
+        budget.deadline = std::chrono::milliseconds(std::stoi(argv[2]));
+        const auto kResult = bag_of_words.SearchImage(kQueryImage, kMaxExamplesSimilar, budget);
+        items_odered_by_similarity = kResult.items;
+        std::cout << "Answered in " << kResult.elapsed.count()/1000.0 << " ms.\n";
+        for (const auto& kDegradation : kResult.degradations)
+        {
+            std::cout << "  * " << kDegradation << "\n";
+        }
+      }
+      else
+      {
+        items_odered_by_similarity = bag_of_words.SearchImage(kQueryImage, kMaxExamplesSimilar);
+      }
     }
     catch (const std::exception& kError)
     {
@@ -49,18 +100,13 @@ int main(int argc, char** argv)
     html_writer << igg::HtmlWriter::OpenBody{};
 
     html_writer << igg::HtmlWriter::Title{"Query:"};
-    html_writer << igg::HtmlWriter::Image{kQueryImagePath};
+    if (!kQueryFeatures && !kQueryItem)
+    {
+        html_writer << igg::HtmlWriter::Image{kQueryImagePath};
+    }
 
     html_writer << igg::HtmlWriter::Title{"Most similar:"};
-    size_t kMaxExamplesSimilar = 5; // Do not show more than the five most similar images
-    size_t current_index = 0;
     for (const auto& kItem: items_odered_by_similarity) {
-        if (current_index>=kMaxExamplesSimilar)
-        {
-            break;
-        }
-        current_index++;
-
         html_writer << igg::HtmlWriter::Image{kItem->ImagePath()};
     }
 
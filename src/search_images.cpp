@@ -0,0 +1,84 @@
+
+#include <fstream>
+#include <iostream>
+#include <boost/program_options.hpp>
+
+#include "bag_of_words.hpp"
+#include "batch_search/batch_search.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("queries,", po::value<std::string>(), "File listing one query image per line, or directory of query images.")
+    ("output,o", po::value<std::string>()->default_value("-"), "File to write the results to, - for the terminal.")
+    ("format,", po::value<std::string>()->default_value("csv"), "Format of the results. Options: csv, jsonl.")
+    ("num-results,n", po::value<size_t>()->default_value(5), "Number of most similar images per query.")
+    ("chunk-size,", po::value<size_t>()->default_value(256), "Number of queries extracted and scored at once.")
+    ("threads,j", po::value<size_t>()->default_value(igg::DefaultNumThreads()), "Number of threads to extract features with.");
+
+  po::positional_options_description positional_options;
+  positional_options.add("queries", 1);
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options_description).positional(positional_options).run(),
+      variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help") || !variables_map.count("queries")) {
+    std::cout << "Usage: search_images [options] <query list or directory>\n";
+    std::cout << "Searches the most similar images of many query images and writes them as CSV or JSON lines.\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and the visual dictionary has been created.\n";
+    std::cout << options_description;
+    return variables_map.count("help") ? 0 : 1;
+  }
+
+  igg::ResultFormat format;
+  try {
+    format = igg::ResultFormatFromString(variables_map["format"].as<std::string>());
+  } catch (const std::invalid_argument& kError) {
+    std::cerr << kError.what() << "\n";
+    return 1;
+  }
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  const igg::BagOfWords kBagOfWords(kDataset, false);
+
+  try {
+    const auto kQueryPaths = igg::ListQueryImages(variables_map["queries"].as<std::string>());
+    const igg::BatchSearch kSearch
+      (kBagOfWords.LoadQueryEngine(),
+       variables_map["num-results"].as<size_t>(),
+       variables_map["chunk-size"].as<size_t>(),
+       variables_map["threads"].as<size_t>());
+
+    // Statistics go to std::cerr, the results may go to the terminal
+    std::cerr << "Search " << kQueryPaths.size() << " queries in " << kDataset->Items().size() << " images.\n";
+    const auto kOutputPath = variables_map["output"].as<std::string>();
+    if (kOutputPath=="-") {
+      std::cerr << kSearch.Run(kQueryPaths, std::cout, format);
+    } else {
+      std::ofstream output(kOutputPath);
+      if (!output) {std::cerr << "Cannot write " << kOutputPath << ".\n"; return 1;}
+      std::cerr << kSearch.Run(kQueryPaths, output, format);
+    }
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,58 @@
+
+#include "query_client.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace igg {
+
+QueryClient::QueryClient(const std::string& kSocketPath) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (kSocketPath.empty() || kSocketPath.size()>=sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path "+kSocketPath+" is empty or too long.");
+  }
+  std::strncpy(address.sun_path, kSocketPath.c_str(), sizeof(address.sun_path)-1);
+
+  this->socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (this->socket_<0) {throw std::runtime_error("Cannot create socket.");}
+  if (::connect(this->socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address))<0) {
+    ::close(this->socket_);
+    throw std::runtime_error("Cannot connect to "+kSocketPath+": "+std::strerror(errno)+".");
+  }
+}
+
+
+QueryClient::~QueryClient() {
+  ::close(this->socket_);
+}
+
+
+QueryResponse QueryClient::Query(const QueryRequest& kRequest) const {
+  this->Send(kRequest);
+  return this->Receive();
+}
+
+
+void QueryClient::Send(const QueryRequest& kRequest) const {
+  if (!WriteFrame(this->socket_, EncodeQueryRequest(kRequest))) {
+    throw std::runtime_error("Connection to query server failed.");
+  }
+}
+
+
+QueryResponse QueryClient::Receive() const {
+  std::string message;
+  if (!ReadFrame(this->socket_, message)) {
+    throw std::runtime_error("Connection to query server failed.");
+  }
+  return DecodeQueryResponse(message);
+}
+
+} // namespace igg
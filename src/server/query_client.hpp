@@ -0,0 +1,59 @@
+#ifndef CPP_FINAL_PROJECT_SERVER_QUERY_CLIENT_HPP_
+#define CPP_FINAL_PROJECT_SERVER_QUERY_CLIENT_HPP_
+
+
+#include <string>
+
+#include "query_protocol.hpp"
+
+
+namespace igg {
+
+/**
+ * Connection to a QueryServer.
+ *
+ * Usage:
+ *
+ *   QueryClient client("/tmp/bag_of_words.sock");
+ *   QueryRequest request;
+ *   request.image_path = "query.png";
+ *   const auto kResponse = client.Query(request);
+ */
+class QueryClient {
+public:
+  /**
+   * Constructor. Connects to the server.
+   *
+   * Throws an instance of std::runtime_error if the server cannot be reached.
+   */
+  explicit QueryClient(const std::string& kSocketPath);
+
+  ~QueryClient();
+
+  QueryClient(const QueryClient&) = delete;
+  QueryClient& operator=(const QueryClient&) = delete;
+
+  /**
+   * Send a request and wait for the response.
+   *
+   * Throws an instance of std::runtime_error if the connection fails. Errors of the
+   * query itself are reported in the response.
+   */
+  QueryResponse Query(const QueryRequest& kRequest) const;
+
+  /**
+   * Query() in two steps, e.g. to send requests to several servers before waiting for
+   * any of them. Each Send() has to be followed by one Receive().
+   *
+   * Throw an instance of std::runtime_error if the connection fails.
+   */
+  void Send(const QueryRequest& kRequest) const;
+  QueryResponse Receive() const;
+
+private:
+  int socket_ = -1;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_SERVER_QUERY_CLIENT_HPP_
@@ -0,0 +1,224 @@
+
+#include "query_protocol.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace igg {
+
+namespace {
+
+// Appends plain values and sized strings to a message
+class MessageWriter {
+public:
+  template <class T>
+  void Write(const T kValue) {
+    this->message_.append(reinterpret_cast<const char*>(&kValue), sizeof(T));
+  }
+
+  void WriteString(const std::string& kString) {
+    this->Write(static_cast<uint32_t>(kString.size()));
+    this->message_.append(kString);
+  }
+
+  void WriteFloats(const float* kValues, const size_t kSize) {
+    this->message_.append(reinterpret_cast<const char*>(kValues), sizeof(float)*kSize);
+  }
+
+  std::string Message() const {return this->message_;}
+
+private:
+  std::string message_;
+};
+
+// Reads what MessageWriter appended, never beyond the end of the message
+class MessageReader {
+public:
+  explicit MessageReader(const std::string& kMessage): kMessage_(kMessage) {}
+
+  template <class T>
+  T Read() {
+    T value;
+    this->ReadBytes(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+  }
+
+  std::string ReadString() {
+    const auto kSize = this->Read<uint32_t>();
+    this->Require(kSize);
+    const auto kString = this->kMessage_.substr(this->position_, kSize);
+    this->position_ += kSize;
+    return kString;
+  }
+
+  void ReadFloats(float* values, const size_t kSize) {
+    this->ReadBytes(reinterpret_cast<char*>(values), sizeof(float)*kSize);
+  }
+
+  size_t Remaining() const {return this->kMessage_.size()-this->position_;}
+
+  void ExpectEnd() const {
+    if (this->Remaining()>0) {throw std::runtime_error("Unexpected data at the end of message.");}
+  }
+
+private:
+  const std::string& kMessage_;
+  size_t position_ = 0;
+
+  void Require(const size_t kSize) const {
+    if (kSize>this->Remaining()) {throw std::runtime_error("Message ends unexpectedly.");}
+  }
+
+  void ReadBytes(char* bytes, const size_t kSize) {
+    this->Require(kSize);
+    std::memcpy(bytes, this->kMessage_.data()+this->position_, kSize);
+    this->position_ += kSize;
+  }
+};
+
+const QueryMode kLastQueryMode = QueryMode::kVladGraph;
+
+} // namespace
+
+
+std::string EncodeQueryRequest(const QueryRequest& kRequest) {
+  MessageWriter writer;
+  writer.Write(static_cast<uint8_t>(kRequest.type));
+  writer.Write(static_cast<uint8_t>(kRequest.mode));
+  writer.Write(kRequest.num_results);
+  writer.Write(kRequest.num_candidates);
+
+  if (kRequest.type==QueryType::kImagePath) {
+    writer.WriteString(kRequest.image_path);
+  } else {
+    const uint32_t kNumCols = kRequest.features.empty() ? 0 : kRequest.features[0].size();
+    writer.Write(static_cast<uint32_t>(kRequest.features.size()));
+    writer.Write(kNumCols);
+    for (const auto& kFeature: kRequest.features) {
+      if (kFeature.size()!=kNumCols) {throw std::invalid_argument("Features differ in dimension.");}
+      writer.WriteFloats(kFeature.data(), kNumCols);
+    }
+  }
+  return writer.Message();
+}
+
+
+QueryRequest DecodeQueryRequest(const std::string& kMessage) {
+  MessageReader reader(kMessage);
+  QueryRequest request;
+
+  const auto kType = reader.Read<uint8_t>();
+  if (kType>static_cast<uint8_t>(QueryType::kFeatures)) {throw std::runtime_error("Unknown query type.");}
+  request.type = static_cast<QueryType>(kType);
+  const auto kMode = reader.Read<uint8_t>();
+  if (kMode>static_cast<uint8_t>(kLastQueryMode)) {throw std::runtime_error("Unknown query mode.");}
+  request.mode = static_cast<QueryMode>(kMode);
+  request.num_results = reader.Read<uint32_t>();
+  request.num_candidates = reader.Read<uint32_t>();
+
+  if (request.type==QueryType::kImagePath) {
+    request.image_path = reader.ReadString();
+  } else {
+    const auto kNumRows = reader.Read<uint32_t>();
+    const auto kNumCols = reader.Read<uint32_t>();
+    if (static_cast<uint64_t>(kNumRows)*kNumCols*sizeof(float)!=reader.Remaining()) {
+      throw std::runtime_error("Size of features does not match message.");
+    }
+    request.features.assign(kNumRows, FeaturePoint<float>(kNumCols));
+    for (auto& feature: request.features) {reader.ReadFloats(feature.data(), kNumCols);}
+  }
+  reader.ExpectEnd();
+  return request;
+}
+
+
+std::string EncodeQueryResponse(const QueryResponse& kResponse) {
+  MessageWriter writer;
+  writer.Write(static_cast<uint8_t>(kResponse.ok));
+  if (!kResponse.ok) {
+    writer.WriteString(kResponse.error);
+    return writer.Message();
+  }
+  writer.Write(static_cast<uint32_t>(kResponse.results.size()));
+  for (const auto& kResult: kResponse.results) {
+    writer.Write(kResult.index);
+    writer.Write(kResult.similarity);
+    writer.WriteString(kResult.image_path);
+  }
+  return writer.Message();
+}
+
+
+QueryResponse DecodeQueryResponse(const std::string& kMessage) {
+  MessageReader reader(kMessage);
+  QueryResponse response;
+
+  response.ok = reader.Read<uint8_t>()!=0;
+  if (!response.ok) {
+    response.error = reader.ReadString();
+  } else {
+    const auto kNumResults = reader.Read<uint32_t>();
+    for (uint32_t result = 0; result<kNumResults; result++) {
+      QueryResult query_result;
+      query_result.index = reader.Read<uint32_t>();
+      query_result.similarity = reader.Read<float>();
+      query_result.image_path = reader.ReadString();
+      response.results.emplace_back(std::move(query_result));
+    }
+  }
+  reader.ExpectEnd();
+  return response;
+}
+
+
+namespace {
+
+bool WriteAll(const int kDescriptor, const char* bytes, size_t size) {
+  while (size>0) {
+    // No SIGPIPE if the other side closed the connection
+    const auto kWritten = ::send(kDescriptor, bytes, size, MSG_NOSIGNAL);
+    if (kWritten<0 && errno==EINTR) {continue;}
+    if (kWritten<=0) {return false;}
+    bytes += kWritten;
+    size -= kWritten;
+  }
+  return true;
+}
+
+bool ReadAll(const int kDescriptor, char* bytes, size_t size) {
+  while (size>0) {
+    const auto kRead = ::read(kDescriptor, bytes, size);
+    if (kRead<0 && errno==EINTR) {continue;}
+    if (kRead<=0) {return false;}
+    bytes += kRead;
+    size -= kRead;
+  }
+  return true;
+}
+
+} // namespace
+
+
+bool WriteFrame(const int kDescriptor, const std::string& kMessage) {
+  if (kMessage.size()>kMaxQueryMessageSize) {return false;}
+  const uint32_t kSize = kMessage.size();
+  return WriteAll(kDescriptor, reinterpret_cast<const char*>(&kSize), sizeof(uint32_t)) &&
+    WriteAll(kDescriptor, kMessage.data(), kMessage.size());
+}
+
+
+bool ReadFrame(const int kDescriptor, std::string& message) {
+  uint32_t size = 0;
+  if (!ReadAll(kDescriptor, reinterpret_cast<char*>(&size), sizeof(uint32_t)) ||
+      size>kMaxQueryMessageSize) {
+    return false;
+  }
+  message.resize(size);
+  return ReadAll(kDescriptor, &message[0], size);
+}
+
+} // namespace igg
@@ -0,0 +1,92 @@
+#ifndef CPP_FINAL_PROJECT_SERVER_QUERY_PROTOCOL_HPP_
+#define CPP_FINAL_PROJECT_SERVER_QUERY_PROTOCOL_HPP_
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bag_of_words.hpp"
+
+
+namespace igg {
+
+/**
+ * What a QueryRequest contains.
+ */
+enum class QueryType: uint8_t {
+  kImagePath, // Path of an image the server can read, features are extracted by the server
+  kFeatures // Features extracted by the client, see ComputeFeatures()
+};
+
+/**
+ * Similarity query sent to a QueryServer, see BagOfWords::MostSimilarItems().
+ */
+struct QueryRequest {
+  QueryType type = QueryType::kImagePath;
+  QueryMode mode = QueryMode::kExhaustive;
+  uint32_t num_results = 5;
+  uint32_t num_candidates = 200;
+  std::string image_path; // For QueryType::kImagePath
+  std::vector<FeaturePoint<float>> features; // For QueryType::kFeatures
+};
+
+/**
+ * One of the most similar images.
+ */
+struct QueryResult {
+  uint32_t index; // Of the image in the dataset
+  float similarity;
+  std::string image_path;
+};
+
+/**
+ * Answer of a QueryServer, either the most similar images (most similar first)
+ * or the reason why the query failed.
+ */
+struct QueryResponse {
+  bool ok = true;
+  std::string error;
+  std::vector<QueryResult> results;
+};
+
+/**
+ * Largest message accepted, about 100k features of 128 dimensions.
+ */
+const uint32_t kMaxQueryMessageSize = 64*1024*1024;
+
+/**
+ * Messages are sent as frames of a 32 bit size followed by that many bytes, in the
+ * byte order of the machine (the protocol is meant for local sockets only).
+ *
+ * Messages encode the fields of the structs above in their order, strings and vectors
+ * prefixed with their 32 bit size, and the features as number of rows and columns
+ * followed by all values.
+ *
+ * Decode functions throw an instance of std::runtime_error if the message is malformed.
+ */
+std::string EncodeQueryRequest(const QueryRequest& kRequest);
+QueryRequest DecodeQueryRequest(const std::string& kMessage);
+std::string EncodeQueryResponse(const QueryResponse& kResponse);
+QueryResponse DecodeQueryResponse(const std::string& kMessage);
+
+/**
+ * Write a message as a frame to a connected socket. Sent without SIGPIPE, so a closed
+ * connection fails instead; pipes and files are not supported and fail as well.
+ *
+ * @return True on success, false if the connection was closed or failed, or the
+ * descriptor is not a socket.
+ */
+bool WriteFrame(const int kDescriptor, const std::string& kMessage);
+
+/**
+ * Read a frame from a socket, or any other readable file descriptor.
+ *
+ * @return True on success, false if the connection was closed or failed, or the
+ * frame is larger than kMaxQueryMessageSize.
+ */
+bool ReadFrame(const int kDescriptor, std::string& message);
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_SERVER_QUERY_PROTOCOL_HPP_
@@ -0,0 +1,302 @@
+
+#include "query_server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "features/features.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// How often Run() checks if it was stopped
+const int kPollTimeoutMilliseconds = 100;
+
+// Longest time an exhaustive query waits for queries of other connections to be
+// scored with, see QueryBatcher
+const std::chrono::microseconds kMaxBatchWait(1000);
+
+sockaddr_un MakeSocketAddress(const std::string& kSocketPath) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (kSocketPath.empty() || kSocketPath.size()>=sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path "+kSocketPath+" is empty or too long.");
+  }
+  std::strncpy(address.sun_path, kSocketPath.c_str(), sizeof(address.sun_path)-1);
+  return address;
+}
+
+std::vector<uchar> ReadFileBytes(const std::string& kPath) {
+  std::ifstream file(kPath, std::ios::binary);
+  if (!file) {throw std::runtime_error("Cannot read image "+kPath+".");}
+  return std::vector<uchar>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Results depend on the image, the mode and the candidates
+uint64_t CacheKey(const std::vector<uchar>& kBytes, const QueryRequest& kRequest) {
+  const uint64_t kKey[] =
+    {QueryCache::ContentHash(kBytes.data(), kBytes.size()),
+     static_cast<uint64_t>(kRequest.mode),
+     kRequest.num_candidates};
+  return QueryCache::ContentHash(kKey, sizeof(kKey));
+}
+
+// Reads and writes of a connection fail after the timeout, e.g. if a client stops
+// in the middle of a request or does not read its response
+void SetConnectionTimeout(const int kConnection, const std::chrono::milliseconds kTimeout) {
+  timeval time;
+  time.tv_sec = kTimeout.count()/1000;
+  time.tv_usec = (kTimeout.count()%1000)*1000;
+  ::setsockopt(kConnection, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time));
+  ::setsockopt(kConnection, SOL_SOCKET, SO_SNDTIMEO, &time, sizeof(time));
+}
+
+} // namespace
+
+
+const size_t QueryServer::kDefaultCacheBytes;
+const size_t QueryServer::kDefaultMaxConnections;
+
+
+QueryServer::QueryServer
+  (const std::shared_ptr<const Dataset> kDataset,
+   const std::string& kSocketPath,
+   const bool kVerbose,
+   const size_t kCacheBytes,
+   const size_t kMaxConnections,
+   const std::chrono::milliseconds kReadTimeout):
+  kDataset_{kDataset}, bag_of_words_(kDataset, false), kSocketPath_{kSocketPath}, kVerbose_{kVerbose},
+  kMaxConnections_{kMaxConnections}, kReadTimeout_{kReadTimeout}, cache_(kCacheBytes)
+{
+  if (kMaxConnections==0) {throw std::invalid_argument("Number of connections has to be positive.");}
+  if (kReadTimeout.count()<=0) {throw std::invalid_argument("Read timeout has to be positive.");}
+
+  const auto kAddress = MakeSocketAddress(kSocketPath);
+
+  // Replace a socket left over by a previous server, but nothing else
+  struct stat status;
+  if (::lstat(kSocketPath.c_str(), &status)==0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      throw std::runtime_error("Cannot create socket "+kSocketPath+", the file exists.");
+    }
+    ::unlink(kSocketPath.c_str());
+  }
+
+  this->socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (this->socket_<0) {throw std::runtime_error("Cannot create socket.");}
+  if (::bind(this->socket_, reinterpret_cast<const sockaddr*>(&kAddress), sizeof(kAddress))<0 ||
+      ::listen(this->socket_, SOMAXCONN)<0) {
+    ::close(this->socket_);
+    throw std::runtime_error("Cannot listen on socket "+kSocketPath+": "+std::strerror(errno)+".");
+  }
+}
+
+
+QueryServer::~QueryServer() {
+  ::close(this->socket_);
+  ::unlink(this->kSocketPath_.c_str());
+}
+
+
+void QueryServer::Run() {
+  if (this->kVerbose_) {std::cout << "Listen on " << this->kSocketPath_ << ".\n";}
+
+  // Accepted connections wait here for one of the connection threads
+  std::deque<int> connections;
+  std::mutex connections_mutex;
+  std::condition_variable connection_accepted;
+  bool stopped = false;
+
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread<this->kMaxConnections_; thread++) {
+    threads.emplace_back([this, &connections, &connections_mutex, &connection_accepted, &stopped]() {
+      while (true) {
+        int connection = -1;
+        {
+          std::unique_lock<std::mutex> lock(connections_mutex);
+          connection_accepted.wait(lock, [&connections, &stopped]() {return stopped || !connections.empty();});
+          if (connections.empty()) {return;}
+          connection = connections.front();
+          connections.pop_front();
+        }
+        this->Serve(connection);
+        ::close(connection);
+      }
+    });
+  }
+
+  while (this->WaitReadable(this->socket_)) {
+    const auto kConnection = ::accept(this->socket_, nullptr, nullptr);
+    if (kConnection<0) {continue;}
+    SetConnectionTimeout(kConnection, this->kReadTimeout_);
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex);
+      connections.push_back(kConnection);
+    }
+    connection_accepted.notify_one();
+  }
+
+  // Connections still waiting return right away, since the server is stopped
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    stopped = true;
+  }
+  connection_accepted.notify_all();
+  for (auto& thread: threads) {thread.join();}
+  if (this->kVerbose_) {std::cout << "Stop listening.\n";}
+}
+
+
+QueryResponse QueryServer::Answer(const QueryRequest& kRequest) const {
+  QueryResponse response;
+  try {
+    std::vector<ScoredIndex<float>> results;
+    if (kRequest.type==QueryType::kImagePath) {
+      results = this->AnswerImagePath(kRequest);
+    } else if (kRequest.mode==QueryMode::kVlad || kRequest.mode==QueryMode::kVladGraph) {
+      results = this->bag_of_words_.MostSimilarItems
+        (kRequest.features, kRequest.num_results, kRequest.mode, kRequest.num_candidates);
+    } else {
+      const auto kEngine = this->bag_of_words_.LoadQueryEngine();
+      results = this->AnswerHistogram(kEngine, kEngine->QueryHistogram(kRequest.features), kRequest);
+    }
+
+    const auto kItems = this->kDataset_->Items();
+    for (const auto& kResult: results) {
+      response.results.push_back
+        ({static_cast<uint32_t>(kResult.first), kResult.second, kItems[kResult.first]->ImagePath()});
+    }
+  } catch (const std::exception& kError) {
+    response.ok = false;
+    response.error = kError.what();
+    response.results.clear();
+  }
+  return response;
+}
+
+
+std::vector<ScoredIndex<float>> QueryServer::AnswerImagePath(const QueryRequest& kRequest) const {
+  const auto kBytes = ReadFileBytes(kRequest.image_path);
+  const auto kDecode = [&kBytes, &kRequest]() {
+    const cv::Mat kImage = cv::imdecode(kBytes, CV_LOAD_IMAGE_COLOR);
+    if (!kImage.data) {throw std::runtime_error("Cannot read image "+kRequest.image_path+".");}
+    return FromMat<float>(ComputeFeatures(kImage));
+  };
+
+  // VLAD vectors are made from the features, there is no histogram to keep
+  const bool kUseCache = this->cache_.MaxBytes()>0 &&
+    kRequest.mode!=QueryMode::kVlad && kRequest.mode!=QueryMode::kVladGraph;
+  if (!kUseCache) {
+    return this->bag_of_words_.MostSimilarItems
+      (kDecode(), kRequest.num_results, kRequest.mode, kRequest.num_candidates);
+  }
+
+  const auto kEngine = this->bag_of_words_.LoadQueryEngine();
+  const auto kKey = CacheKey(kBytes, kRequest);
+  const auto kEntry = this->cache_.Find(kKey, kEngine->Version());
+  if (kEntry && kEntry->num_results>=kRequest.num_results) {
+    const auto kNumResults = std::min(static_cast<size_t>(kRequest.num_results), kEntry->results.size());
+    return std::vector<ScoredIndex<float>>(kEntry->results.begin(), kEntry->results.begin()+kNumResults);
+  }
+
+  auto histogram = kEntry ? kEntry->histogram : kEngine->QueryHistogram(kDecode());
+  auto results = this->AnswerHistogram(kEngine, histogram, kRequest);
+  this->cache_.Insert(kKey, kEngine->Version(), {std::move(histogram), results, kRequest.num_results});
+  return results;
+}
+
+
+std::vector<ScoredIndex<float>> QueryServer::AnswerHistogram
+  (const std::shared_ptr<const QueryEngine>& kEngine,
+   const SparseHistogram<float>& kHistogram,
+   const QueryRequest& kRequest) const
+{
+  if (kRequest.mode!=QueryMode::kExhaustive) {
+    return this->bag_of_words_.MostSimilarItems
+      (kHistogram, kRequest.num_results, kRequest.mode, kRequest.num_candidates);
+  }
+  return this->LoadBatcher(kEngine)->Submit(kHistogram, kRequest.num_results).get();
+}
+
+
+std::shared_ptr<QueryBatcher> QueryServer::LoadBatcher(const std::shared_ptr<const QueryEngine>& kEngine) const {
+  std::lock_guard<std::mutex> lock(this->batcher_mutex_);
+  // A batcher keeps its snapshot alive, so no other snapshot has the same address
+  if (!this->batcher_ || &this->batcher_->Engine()!=kEngine.get()) {
+    this->batcher_ = std::make_shared<QueryBatcher>(kEngine, this->kMaxConnections_, kMaxBatchWait);
+  }
+  return this->batcher_;
+}
+
+
+size_t QueryServer::NumBatchedQueries() const {
+  std::lock_guard<std::mutex> lock(this->batcher_mutex_);
+  return this->batcher_ ? this->batcher_->NumQueries() : 0;
+}
+
+
+bool QueryServer::WaitReadable
+  (const int kDescriptor, const std::chrono::steady_clock::time_point kDeadline) const
+{
+  pollfd poll_descriptor{kDescriptor, POLLIN, 0};
+  while (!this->stop_) {
+    const auto kNow = std::chrono::steady_clock::now();
+    if (kNow>=kDeadline) {return false;}
+    const auto kRemaining = std::chrono::duration_cast<std::chrono::milliseconds>(kDeadline-kNow).count()+1;
+    const auto kReady = ::poll(&poll_descriptor, 1, static_cast<int>
+      (std::min<decltype(kRemaining)>(kRemaining, kPollTimeoutMilliseconds)));
+    if (kReady>0) {return true;}
+    if (kReady<0 && errno!=EINTR) {return false;}
+  }
+  return false;
+}
+
+
+void QueryServer::Serve(const int kConnection) const {
+  std::string message;
+  while (this->WaitReadable(kConnection, std::chrono::steady_clock::now()+this->kReadTimeout_) &&
+         ReadFrame(kConnection, message)) {
+    const auto kStart = std::chrono::steady_clock::now();
+
+    QueryResponse response;
+    try {
+      response = this->Answer(DecodeQueryRequest(message));
+    } catch (const std::runtime_error& kError) {
+      response.ok = false;
+      response.error = kError.what();
+    }
+    if (!WriteFrame(kConnection, EncodeQueryResponse(response))) {return;}
+
+    if (this->kVerbose_) {
+      // One write, so lines of concurrent connections do not interleave
+      const std::chrono::duration<double, std::milli> kDuration = std::chrono::steady_clock::now()-kStart;
+      std::ostringstream line;
+      line << "* Query answered in " << kDuration.count() << " ms" <<
+        (response.ok ? "" : " with error: "+response.error) << "\n";
+      std::cout << line.str();
+    }
+  }
+}
+
+} // namespace igg
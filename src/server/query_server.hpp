@@ -0,0 +1,143 @@
+#ifndef CPP_FINAL_PROJECT_SERVER_QUERY_SERVER_HPP_
+#define CPP_FINAL_PROJECT_SERVER_QUERY_SERVER_HPP_
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "bag_of_words.hpp"
+#include "query_engine/query_batcher.hpp"
+#include "query_engine/query_cache.hpp"
+#include "query_protocol.hpp"
+
+
+namespace igg {
+
+/**
+ * Long running process answering similarity queries over a local (Unix domain) socket,
+ * see QueryClient. The dataset is scanned once and everything a query needs is kept in
+ * memory, so each query only pays for feature extraction and scoring.
+ *
+ * Each connection may send any number of requests and receives one response for each,
+ * see query_protocol.hpp. Up to kMaxConnections connections are served at the same time,
+ * each by a thread of the server, further ones wait until one of them is closed. A
+ * connection is closed if its next request does not arrive within the read timeout, so
+ * idle clients do not hold a thread forever. Exhaustive queries of all connections are
+ * scored together by one QueryBatcher.
+ *
+ * Queries by image path are cached by the content of the image file, see QueryCache,
+ * so a repeated image skips feature extraction and, if asked for with the same mode and
+ * candidates again, scoring. The cache is dropped once the histograms are made again.
+ *
+ * Usage:
+ *
+ *   QueryServer server(Dataset::Default(), "/tmp/bag_of_words.sock", true);
+ *   server.Prepare(QueryMode::kExhaustive);
+ *   server.Run(); // Until Stop() is called
+ */
+class QueryServer {
+public:
+  static const size_t kDefaultCacheBytes = 64 << 20;
+  static const size_t kDefaultMaxConnections = 16;
+
+  /**
+   * Constructor. Listens on the socket, a socket left over at the path is replaced.
+   *
+   * Throws an instance of std::runtime_error if the socket cannot be created.
+   *
+   * @param kDataset The dataset to query.
+   * @param kSocketPath Where to create the socket, at most 107 characters.
+   * @param kVerbose If true, each query is logged to the terminal.
+   * @param kCacheBytes Memory of the query cache, 0 to disable it.
+   * @param kMaxConnections Number of connections served at the same time.
+   * @param kReadTimeout How long a connection may take to send its next request.
+   */
+  QueryServer
+    (const std::shared_ptr<const Dataset> kDataset,
+     const std::string& kSocketPath,
+     const bool kVerbose,
+     const size_t kCacheBytes = kDefaultCacheBytes,
+     const size_t kMaxConnections = kDefaultMaxConnections,
+     const std::chrono::milliseconds kReadTimeout = std::chrono::seconds(60));
+
+  /**
+   * Closes and removes the socket.
+   */
+  ~QueryServer();
+
+  QueryServer(const QueryServer&) = delete;
+  QueryServer& operator=(const QueryServer&) = delete;
+
+  /**
+   * Load everything queries with the given mode need, see BagOfWords::PrepareQueries().
+   */
+  void Prepare(const QueryMode kMode) const {this->bag_of_words_.PrepareQueries(kMode);}
+
+  /**
+   * Serve connections until Stop() is called, then wait for the connections being served.
+   */
+  void Run();
+
+  /**
+   * Let Run() return within a fraction of a second. May be called from a signal handler
+   * or another thread.
+   */
+  void Stop() {this->stop_ = true;}
+
+  /**
+   * Answer a single request, errors are reported in the response.
+   */
+  QueryResponse Answer(const QueryRequest& kRequest) const;
+
+  const std::string& SocketPath() const {return this->kSocketPath_;}
+
+  /**
+   * The query cache, e.g. for its hit and miss counts.
+   */
+  const QueryCache& Cache() const {return this->cache_;}
+
+  /**
+   * Number of exhaustive queries scored by the batcher of the current snapshot, see
+   * QueryBatcher::NumQueries().
+   */
+  size_t NumBatchedQueries() const;
+
+private:
+  const std::shared_ptr<const Dataset> kDataset_;
+  const BagOfWords bag_of_words_;
+  const std::string kSocketPath_;
+  const bool kVerbose_;
+  const size_t kMaxConnections_;
+  const std::chrono::milliseconds kReadTimeout_;
+  mutable QueryCache cache_;
+  // Shared by all connections, made again for a new snapshot of the dataset
+  mutable std::shared_ptr<QueryBatcher> batcher_;
+  mutable std::mutex batcher_mutex_;
+  int socket_ = -1;
+  std::atomic<bool> stop_{false};
+
+  // Wait until data can be read, false if stopped or the deadline passed meanwhile
+  bool WaitReadable
+    (const int kDescriptor,
+     const std::chrono::steady_clock::time_point kDeadline = std::chrono::steady_clock::time_point::max()) const;
+
+  void Serve(const int kConnection) const;
+
+  // Results for the image file, from the cache if possible
+  std::vector<ScoredIndex<float>> AnswerImagePath(const QueryRequest& kRequest) const;
+
+  // Results for a histogram of the snapshot, exhaustive queries are scored by the batcher
+  std::vector<ScoredIndex<float>> AnswerHistogram
+    (const std::shared_ptr<const QueryEngine>& kEngine,
+     const SparseHistogram<float>& kHistogram,
+     const QueryRequest& kRequest) const;
+
+  std::shared_ptr<QueryBatcher> LoadBatcher(const std::shared_ptr<const QueryEngine>& kEngine) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_SERVER_QUERY_SERVER_HPP_
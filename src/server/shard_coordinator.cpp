@@ -0,0 +1,165 @@
+#include "shard_coordinator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "bag_of_words.hpp"
+#include "features/features.hpp"
+
+
+namespace igg {
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+void CopyIfExists(const std::string& kSource, const std::string& kDestination) {
+  if (fs::exists(kSource)) {fs::copy_file(kSource, kDestination);}
+}
+
+// Most similar first, ties by index like a single index would
+bool MoreSimilar(const QueryResult& kResult_1, const QueryResult& kResult_2) {
+  if (kResult_1.similarity!=kResult_2.similarity) {return kResult_1.similarity>kResult_2.similarity;}
+  return kResult_1.index<kResult_2.index;
+}
+
+// Results of several shards, most similar first and at most kNumResults
+QueryResponse Merge(const std::vector<QueryResponse>& kResponses, const size_t kNumResults) {
+  QueryResponse merged;
+  for (size_t shard = 0; shard<kResponses.size(); shard++) {
+    for (auto result: kResponses[shard].results) {
+      result.index = GlobalItemIndex(shard, result.index, kResponses.size());
+      merged.results.emplace_back(std::move(result));
+    }
+  }
+
+  const auto kNumMerged = std::min(kNumResults, merged.results.size());
+  std::partial_sort
+    (merged.results.begin(), merged.results.begin()+kNumMerged, merged.results.end(), MoreSimilar);
+  merged.results.resize(kNumMerged);
+  return merged;
+}
+
+} // namespace
+
+
+std::vector<std::string> PartitionDataset
+  (const Dataset& kDataset, const size_t kNumShards, const std::string& kOutputDir)
+{
+  if (kNumShards==0) {throw std::invalid_argument("Need at least one shard.");}
+  if (!kDataset.HasCentroids() || !kDataset.HasHistogramWeights() || !kDataset.AllItemsHaveHistograms()) {
+    throw DictionaryIncomplete
+      ("Expected to find centroids, histogram weights and histograms, but they do not exist. "
+       "Did you call CreateDictionary()?");
+  }
+
+  const auto kItems = kDataset.Items();
+  const fs::path kImagesDir(kDataset.ImagesDir());
+  std::vector<std::string> shard_dirs;
+
+  for (size_t shard = 0; shard<kNumShards; shard++) {
+    const auto kShardDir = fs::path(kOutputDir)/("shard_"+std::to_string(shard));
+    if (fs::exists(kShardDir)) {
+      throw std::runtime_error("Cannot create shard "+kShardDir.string()+", it exists already.");
+    }
+    fs::create_directories(kShardDir/"images");
+
+    // Images keep their path below images/, so they keep their order within the shard
+    for (size_t index = shard; index<kItems.size(); index += kNumShards) {
+      const fs::path kImagePath(kItems[index]->ImagePath());
+      const auto kDestination = kShardDir/"images"/fs::relative(kImagePath, kImagesDir);
+      fs::create_directories(kDestination.parent_path());
+      boost::system::error_code error;
+      fs::create_hard_link(kImagePath, kDestination, error);
+      if (error) {fs::copy_file(kImagePath, kDestination);}
+    }
+
+    const Dataset kShard(kShardDir.string());
+    const auto kShardItems = kShard.Items();
+    for (size_t shard_index = 0; shard_index<kShardItems.size(); shard_index++) {
+      const auto& kItem = kItems[GlobalItemIndex(shard, shard_index, kNumShards)];
+      fs::copy_file(kItem->HistogramBinaryPath(), kShardItems[shard_index]->HistogramBinaryPath());
+      CopyIfExists(kItem->FeaturesBinaryPath(), kShardItems[shard_index]->FeaturesBinaryPath());
+    }
+
+    // Shared by all shards
+    fs::copy_file(kDataset.CentroidsPath(), kShard.CentroidsPath());
+    fs::copy_file(kDataset.HistogramWeightsPath(), kShard.HistogramWeightsPath());
+    CopyIfExists(kDataset.WordIndexPath(), kShard.WordIndexPath());
+    CopyIfExists(kDataset.VocabularyPruningPath(), kShard.VocabularyPruningPath());
+    CopyIfExists(kDataset.VladEncoderPath(), kShard.VladEncoderPath());
+
+    shard_dirs.push_back(kShardDir.string());
+  }
+  return shard_dirs;
+}
+
+
+ShardCoordinator::ShardCoordinator(const std::vector<std::string>& kSocketPaths):
+  kSocketPaths_{kSocketPaths}
+{
+  if (kSocketPaths.empty()) {throw std::invalid_argument("Need at least one shard.");}
+  for (const auto& kSocketPath: kSocketPaths) {
+    this->clients_.emplace_back(std::make_unique<const QueryClient>(kSocketPath));
+  }
+}
+
+
+QueryResponse ShardCoordinator::Query(const QueryRequest& kRequest) const {
+  // Extract the features once instead of on every shard
+  QueryRequest request = kRequest;
+  if (request.type==QueryType::kImagePath) {
+    const cv::Mat kImage = cv::imread(request.image_path, CV_LOAD_IMAGE_COLOR);
+    if (!kImage.data) {
+      QueryResponse response;
+      response.ok = false;
+      response.error = "Cannot read image "+request.image_path+".";
+      return response;
+    }
+    request.type = QueryType::kFeatures;
+    request.features = FromMat<float>(ComputeFeatures(kImage));
+    request.image_path.clear();
+  }
+
+  // All shards work at the same time, each response is read so the connections stay usable.
+  // A shard whose connection was closed is asked again on a new one.
+  std::vector<bool> sent(this->clients_.size(), true);
+  for (size_t shard = 0; shard<this->clients_.size(); shard++) {
+    try {
+      this->clients_[shard]->Send(request);
+    } catch (const std::runtime_error&) {
+      sent[shard] = false;
+    }
+  }
+  std::vector<QueryResponse> responses;
+  for (size_t shard = 0; shard<this->clients_.size(); shard++) {
+    if (sent[shard]) {
+      try {
+        responses.emplace_back(this->clients_[shard]->Receive());
+        continue;
+      } catch (const std::runtime_error&) {}
+    }
+    this->Reconnect(shard);
+    responses.emplace_back(this->clients_[shard]->Query(request));
+  }
+
+  for (size_t shard = 0; shard<responses.size(); shard++) {
+    if (!responses[shard].ok) {
+      QueryResponse response;
+      response.ok = false;
+      response.error = "Shard "+std::to_string(shard)+" failed: "+responses[shard].error;
+      return response;
+    }
+  }
+  return Merge(responses, request.num_results);
+}
+
+
+void ShardCoordinator::Reconnect(const size_t kShard) const {
+  this->clients_[kShard].reset();
+  this->clients_[kShard] = std::make_unique<const QueryClient>(this->kSocketPaths_[kShard]);
+}
+
+} // namespace igg
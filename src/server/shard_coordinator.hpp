@@ -0,0 +1,103 @@
+#ifndef CPP_FINAL_PROJECT_SERVER_SHARD_COORDINATOR_HPP_
+#define CPP_FINAL_PROJECT_SERVER_SHARD_COORDINATOR_HPP_
+
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dataset/dataset.hpp"
+#include "query_client.hpp"
+
+
+namespace igg {
+
+/**
+ * Split a dataset with a complete visual dictionary into kNumShards datasets, each
+ * owning every kNumShards-th image (in the order of Dataset::Items()) together with its
+ * features and histogram. The directories are <kOutputDir>/shard_<i>/.
+ *
+ * All shards share the visual words, the word index, the vocabulary pruning and the
+ * histogram weights of the whole dataset. As the histograms are already re-weighted with
+ * these global weights, the similarities within a shard are the ones of the whole
+ * dataset. Do not make the histograms of a shard again, they would be re-weighted with
+ * the document frequencies of the shard only. Indexes over the histograms (inverted
+ * index, product quantization, image index) are built per shard as usual.
+ *
+ * Images are hard linked if possible and copied otherwise.
+ *
+ * Throws an instance of std::invalid_argument if kNumShards is 0, of
+ * igg::DictionaryIncomplete if the histograms have not been made, and of
+ * std::runtime_error if a shard directory exists already.
+ *
+ * @return The directories of the shards.
+ */
+std::vector<std::string> PartitionDataset
+  (const Dataset& kDataset, const size_t kNumShards, const std::string& kOutputDir);
+
+/**
+ * Index of an image in the dataset split by PartitionDataset(), given its index within
+ * a shard.
+ */
+inline size_t GlobalItemIndex(const size_t kShard, const size_t kShardIndex, const size_t kNumShards) {
+  return kShardIndex*kNumShards+kShard;
+}
+
+/**
+ * Answers similarity queries of a dataset split by PartitionDataset(), with one
+ * QueryServer per shard. Each query is sent to all shards at once, their most similar
+ * images are merged to the overall most similar ones. As the shards share the global
+ * histogram weights, the results match the ones of the whole dataset for exhaustive
+ * queries.
+ *
+ * Image paths are read and their features extracted once here, the shards only receive
+ * the features. Image indices in the responses refer to the whole dataset, see
+ * GlobalItemIndex().
+ *
+ * The connection to each shard is kept open between queries. Since a QueryServer serves
+ * several connections at once, other clients of the shards are answered meanwhile. A
+ * connection the server closed, e.g. after its read timeout, is opened again and the
+ * request is sent once more, which is safe as queries do not change anything.
+ *
+ * A single coordinator must not be queried from several threads at once.
+ *
+ * Usage:
+ *
+ *   ShardCoordinator coordinator({"/tmp/shard_0.sock", "/tmp/shard_1.sock"});
+ *   QueryRequest request;
+ *   request.image_path = "query.png";
+ *   const auto kResponse = coordinator.Query(request);
+ */
+class ShardCoordinator {
+public:
+  /**
+   * Constructor. Connects to the server of each shard.
+   *
+   * Throws an instance of std::runtime_error if a server cannot be reached.
+   *
+   * @param kSocketPaths Socket of the server of each shard, in the order of the shards.
+   */
+  explicit ShardCoordinator(const std::vector<std::string>& kSocketPaths);
+
+  size_t NumShards() const {return this->clients_.size();}
+
+  /**
+   * Send a request to all shards and merge their responses. Errors of the query or of
+   * any shard are reported in the response.
+   *
+   * Throws an instance of std::runtime_error if a shard cannot be reached, even on a
+   * new connection.
+   */
+  QueryResponse Query(const QueryRequest& kRequest) const;
+
+private:
+  const std::vector<std::string> kSocketPaths_;
+  mutable std::vector<std::unique_ptr<const QueryClient>> clients_;
+
+  // Replace the connection to the shard with a new one
+  void Reconnect(const size_t kShard) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_SERVER_SHARD_COORDINATOR_HPP_
@@ -0,0 +1,55 @@
+
+#include <iostream>
+#include <boost/program_options.hpp>
+
+#include "server/shard_coordinator.hpp"
+
+
+int main (int argc, char** argv) {
+  // Parse terminal input using boost functionality
+  namespace po = boost::program_options;
+
+  po::options_description options_description("Options");
+  options_description.add_options()
+    ("help,h", "Show help.")
+    ("output,", po::value<std::string>(), "Directory to create the shard datasets in.")
+    ("shards,n", po::value<size_t>()->default_value(2), "Number of shards.");
+
+  po::positional_options_description positional_options;
+  positional_options.add("output", 1);
+
+  po::variables_map variables_map;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(options_description).positional(positional_options).run(),
+      variables_map);
+  } catch(po::error& error) {
+    std::cerr << "Command not recognized.\n";
+    std::cerr << error.what() << "\n.";
+    return 1;
+  }
+
+  // Show help
+  if (variables_map.count("help") || !variables_map.count("output")) {
+    std::cout << "Usage: shard_dataset [options] <output directory>\n";
+    std::cout << "Splits the dataset into shards sharing its visual dictionary, to be served by one query_server each.\n";
+    std::cout << "Please make sure the CPP_FINAL_PROJECT_DATA_DIR environment variable is set "
+      "and the visual dictionary has been created.\n";
+    std::cout << options_description;
+    return variables_map.count("help") ? 0 : 1;
+  }
+
+  const auto kDataset = igg::Dataset::Default();
+  if (!kDataset) {std::cerr << "Error while loading dataset.\n"; return 1;}
+
+  try {
+    const auto kShardDirs = igg::PartitionDataset
+      (*kDataset, variables_map["shards"].as<size_t>(), variables_map["output"].as<std::string>());
+    std::cout << "Split " << kDataset->Items().size() << " images into " << kShardDirs.size() << " shards:\n";
+    for (const auto& kShardDir: kShardDirs) {std::cout << kShardDir << "\n";}
+  } catch (const std::exception& kError) {
+    std::cerr << "An error occured: " << kError.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -49,6 +49,20 @@ auto L2Norm(const VectorType& kVector);
 template <class VectorType>
 auto SquaredL2Norm (const VectorType& kVector);
 
+/**
+ * Get the squared L2 distance between two vectors.
+ *
+ * Equivalent to SquaredL2Norm(Difference(kVector1, kVector2)), but without creating
+ * a temporary vector, as this is usually used in innermost loops.
+ *
+ * Both vectors are expected to have the same number of dimensions. If this
+ * is not the case, the behaviour is undefined.
+ */
+template <class VectorType>
+auto SquaredL2Distance
+  (const VectorType& kVector1,
+   const VectorType& kVector2);
+
 /**
  * Compute the centroid (mean) of a set of vectors.
  *
@@ -1,5 +1,6 @@
 
 #include <cmath>
+#include <stdexcept>
 #include <numeric>
 #include <algorithm>
 
@@ -67,6 +68,24 @@ auto SquaredL2Norm (const VectorType& kVector) {
 }
 
 
+template <class VectorType>
+auto SquaredL2Distance
+  (const VectorType& kVector1,
+   const VectorType& kVector2)
+{
+  using ScalarType = typename VectorType::value_type;
+
+  ScalarType sum = 0;
+  const auto kSize = kVector1.size();
+  for (size_t index = 0; index<kSize; index++) {
+    const ScalarType kDifference = kVector1[index]-kVector2[index];
+    sum += kDifference*kDifference;
+  }
+
+  return sum;
+}
+
+
 template <class VectorType>
 VectorType Centroid (const std::vector<VectorType const *>& kVectorSet) {
   if (kVectorSet.empty())
@@ -0,0 +1,56 @@
+#ifndef CPP_FINAL_PROJECT_TOOLS_PARALLEL_HPP_
+#define CPP_FINAL_PROJECT_TOOLS_PARALLEL_HPP_
+
+/**
+ * @file parallel.hpp
+ *
+ * The purpose of this file is to provide a minimal helper to split loops
+ * over several threads.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+namespace igg {
+
+/**
+ * Number of threads to use if not specified otherwise, i.e. the number
+ * of hardware threads (at least 1).
+ */
+inline size_t DefaultNumThreads() {
+  return std::max(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(1));
+}
+
+/**
+ * Split the range 0 (inclusive) to kNumItems (exclusive) into kNumThreads contiguous
+ * blocks and call function(kThreadIndex, kBegin, kEnd) for each, in parallel.
+ * The calling thread processes the first block itself.
+ *
+ * Exceptions thrown by the function are not handled, so it should not throw.
+ */
+template <class Function>
+void ParallelForBlocks
+  (const size_t kNumItems, const size_t kNumThreads, const Function& function)
+{
+  const auto kNumBlocks = std::max(std::min(kNumThreads, kNumItems), static_cast<size_t>(1));
+  const auto kBlockSize = (kNumItems+kNumBlocks-1)/kNumBlocks;
+
+  std::vector<std::thread> threads;
+  threads.reserve(kNumBlocks-1);
+  for (size_t block_index = 1; block_index<kNumBlocks; block_index++) {
+    const auto kBegin = std::min(block_index*kBlockSize, kNumItems);
+    const auto kEnd = std::min(kBegin+kBlockSize, kNumItems);
+    threads.emplace_back(std::cref(function), block_index, kBegin, kEnd);
+  }
+
+  function(static_cast<size_t>(0), static_cast<size_t>(0), std::min(kBlockSize, kNumItems));
+
+  for (auto& thread: threads) {thread.join();}
+}
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_TOOLS_PARALLEL_HPP_
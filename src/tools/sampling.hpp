@@ -52,7 +52,8 @@ std::vector<T> SampleVectorFromMultivariateNormalDistrubution
 /**
  * Sample indices in range 0 (inclusive) to kNumTotal (exclusive).
  *
- * Sampling is done without replacement.
+ * Sampling is done without replacement. Time and memory are linear in the
+ * number of sampled indices, not in the total number.
  *
  * @param kNumSample Number of indices to sample.
  */
@@ -62,6 +63,66 @@ std::vector<T> SampleIndicesWithoutReplacement
    const T kNumTotal,
    std::mt19937& engine);
 
+/**
+ * Uniform sample of fixed size from a sequence of unknown length
+ * (reservoir sampling, Algorithm R).
+ *
+ * Usage:
+ *
+ *   ReservoirSampler<FeaturePoint<float>> sampler(1000, engine);
+ *   for (const auto& kPoint: points) {sampler.Add(kPoint);}
+ *   const auto& kSample = sampler.Sample();
+ *
+ * Note the sampler keeps a reference to the engine.
+ */
+template <class T>
+class ReservoirSampler {
+public:
+  /**
+   * @param kCapacity Size of the sample (or less, if less items are added).
+   */
+  ReservoirSampler(const size_t kCapacity, std::mt19937& engine);
+
+  /**
+   * Offer an item to the sample.
+   */
+  void Add(const T& kItem);
+
+  /**
+   * Uniform sample of all items added so far, in no particular order.
+   */
+  const std::vector<T>& Sample() const {return this->sample_;}
+
+  /**
+   * Number of items added so far.
+   */
+  size_t NumSeen() const {return this->num_seen_;}
+
+private:
+  const size_t kCapacity_;
+  size_t num_seen_;
+  size_t next_position_;
+  std::mt19937& engine_;
+  std::vector<T> sample_;
+
+  // Decide if the next item goes into the sample and where
+  bool Accepts();
+};
+
+/**
+ * Split a sample across strata (e.g. the images of a dataset), so that each
+ * stratum gets about the same number of elements. Strata smaller than their share
+ * are taken completely and the remainder is distributed over the others.
+ *
+ * @param kStratumSizes Number of elements in each stratum.
+ * @param kNumElementsInSample Total sample size. If larger than the sum of all
+ * stratum sizes, all elements are taken.
+ *
+ * @return Sample size for each stratum.
+ */
+std::vector<size_t> StratifiedSampleSizes
+  (const std::vector<size_t>& kStratumSizes, const size_t kNumElementsInSample);
+
 } // namespace igg
 
 #include "tools/sampling.ipp"
@@ -1,6 +1,9 @@
 
 
+#include <algorithm>
+#include <numeric>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace igg {
 
@@ -81,26 +84,107 @@ std::vector<T> SampleIndicesWithoutReplacement
     throw std::invalid_argument("Sample size larger than total size.");
   }
 
-  std::vector<size_t> all_indices(kNumElementsTotal);
-  // Fill with values 0, 1, ..., kNumElements-1
-  std::iota(all_indices.begin(), all_indices.end(), 0);
-
-  // Swap the first kNumElementsInSample indices with a randomly selected one
+  // Swap the first kNumElementsInSample indices of 0, 1, ..., kNumElementsTotal-1
+  // with a randomly selected one. Instead of the whole array of indices, only the
+  // positions touched by a swap are stored, so memory is O(kNumElementsInSample)
   // Can be replaced with std::sample in C++17
+  std::unordered_map<size_t, size_t> swapped;
+  swapped.reserve(2*static_cast<size_t>(kNumElementsInSample));
+  const auto IndexAt = [&swapped](const size_t kPosition) {
+    const auto kIterator = swapped.find(kPosition);
+    return kIterator==swapped.end() ? kPosition : kIterator->second;
+  };
+
   size_t random_index = 0;
   // -1 because intervall is closed
   std::uniform_int_distribution<size_t> uniform(0, kNumElementsTotal-1);
   for (size_t sample_index = 0;
-       sample_index<kNumElementsInSample;
+       sample_index<static_cast<size_t>(kNumElementsInSample);
        sample_index++)
   {
     random_index = uniform(engine);
-    std::swap(all_indices[sample_index], all_indices[random_index]);
+    const auto kIndexAtRandom = IndexAt(random_index);
+    swapped[random_index] = IndexAt(sample_index);
+    swapped[sample_index] = kIndexAtRandom;
+  }
+
+  // Later swaps may still change earlier positions, so collect at the end
+  std::vector<T> sample;
+  sample.reserve(kNumElementsInSample);
+  for (size_t sample_index = 0;
+       sample_index<static_cast<size_t>(kNumElementsInSample);
+       sample_index++)
+  {
+    sample.emplace_back(static_cast<T>(IndexAt(sample_index)));
+  }
+
+  return sample;
+}
+
+
+template <class T>
+ReservoirSampler<T>::ReservoirSampler(const size_t kCapacity, std::mt19937& engine):
+  kCapacity_{kCapacity},
+  num_seen_{0},
+  next_position_{0},
+  engine_(engine)
+{
+  this->sample_.reserve(kCapacity);
+}
+
+
+template <class T>
+bool ReservoirSampler<T>::Accepts() {
+  this->num_seen_++;
+  if (this->sample_.size()<this->kCapacity_) {
+    this->next_position_ = this->sample_.size();
+    return true;
+  }
+
+  std::uniform_int_distribution<size_t> uniform(0, this->num_seen_-1);
+  this->next_position_ = uniform(this->engine_);
+  return this->next_position_<this->kCapacity_;
+}
+
+
+template <class T>
+void ReservoirSampler<T>::Add(const T& kItem) {
+  if (!this->Accepts()) {return;}
+
+  if (this->next_position_<this->sample_.size()) {
+    this->sample_[this->next_position_] = kItem;
+  } else {
+    this->sample_.emplace_back(kItem);
+  }
+}
+
+
+inline std::vector<size_t> StratifiedSampleSizes
+  (const std::vector<size_t>& kStratumSizes, const size_t kNumElementsInSample)
+{
+  const size_t kNumStrata = kStratumSizes.size();
+  std::vector<size_t> sample_sizes(kNumStrata, 0);
+
+  // Visit strata from smallest to largest, small strata are used completely
+  // and their unused share is passed on to the larger ones
+  std::vector<size_t> order(kNumStrata);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort
+    (order.begin(), order.end(),
+     [&kStratumSizes](const size_t kIndex1, const size_t kIndex2)
+       {return kStratumSizes[kIndex1]<kStratumSizes[kIndex2];});
+
+  size_t remaining = kNumElementsInSample;
+  for (size_t rank = 0; rank<kNumStrata; rank++) {
+    const auto kIndex = order[rank];
+    const size_t kNumRemainingStrata = kNumStrata-rank;
+    // Round up, so the sample size is reached if possible
+    const size_t kShare = (remaining+kNumRemainingStrata-1)/kNumRemainingStrata;
+    sample_sizes[kIndex] = std::min(kShare, kStratumSizes[kIndex]);
+    remaining -= sample_sizes[kIndex];
   }
 
-  return std::vector<T>
-    (all_indices.begin(),
-     all_indices.begin()+kNumElementsInSample);
+  return sample_sizes;
 }
 
 } // namespace igg
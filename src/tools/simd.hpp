@@ -0,0 +1,55 @@
+#ifndef CPP_FINAL_PROJECT_TOOLS_SIMD_HPP_
+#define CPP_FINAL_PROJECT_TOOLS_SIMD_HPP_
+
+/**
+ * @file simd.hpp
+ *
+ * The purpose of this file is to provide vectorized kernels for the innermost
+ * loops of the similarity search, working on raw contiguous memory.
+ *
+ * For float and 8 bit integers, SSE (or AVX, if the compiler is allowed to use it,
+ * e.g. with -march=native) intrinsics are used on x86. Other types and platforms use a
+ * portable unrolled loop.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace igg {
+
+/**
+ * Get the dot product of two arrays with kSize elements each.
+ *
+ * Note the summation order differs from a plain loop, so results may differ
+ * in the last bits.
+ */
+template <class T>
+T DenseDotProduct(const T* kVector1, const T* kVector2, const size_t kSize);
+
+/**
+ * Overload for float using SIMD intrinsics where available.
+ */
+float DenseDotProduct(const float* kVector1, const float* kVector2, const size_t kSize);
+
+/**
+ * Overload for 8 bit integers, e.g. quantized histograms, summed exactly in 32 bit.
+ * Uses SSE2 (or AVX2, if the compiler is allowed to use it) intrinsics where available.
+ *
+ * Note the sum overflows for more than 2^17 products of -128*-128.
+ */
+int32_t DenseDotProduct(const int8_t* kVector1, const int8_t* kVector2, const size_t kSize);
+
+/**
+ * Get the dot product of a sparse vector, given by kNumNonZeros (index, value)
+ * pairs, and a dense array covering all indices.
+ */
+template <class T>
+T SparseDenseDotProduct
+  (const uint32_t* kIndices, const T* kValues, const size_t kNumNonZeros, const T* kDense);
+
+} // namespace igg
+
+#include "tools/simd.ipp"
+
+#endif // CPP_FINAL_PROJECT_TOOLS_SIMD_HPP_
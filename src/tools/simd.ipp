@@ -0,0 +1,139 @@
+
+
+#if defined(__AVX__) || defined(__SSE__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace igg {
+
+template <class T>
+T DenseDotProduct(const T* kVector1, const T* kVector2, const size_t kSize) {
+  // Independent accumulators allow the compiler to pipeline the multiplications
+  T sum0 = 0;
+  T sum1 = 0;
+  T sum2 = 0;
+  T sum3 = 0;
+
+  size_t index = 0;
+  for (; index+4<=kSize; index += 4) {
+    sum0 += kVector1[index]*kVector2[index];
+    sum1 += kVector1[index+1]*kVector2[index+1];
+    sum2 += kVector1[index+2]*kVector2[index+2];
+    sum3 += kVector1[index+3]*kVector2[index+3];
+  }
+  for (; index<kSize; index++) {
+    sum0 += kVector1[index]*kVector2[index];
+  }
+
+  return (sum0+sum1)+(sum2+sum3);
+}
+
+
+inline float DenseDotProduct(const float* kVector1, const float* kVector2, const size_t kSize) {
+  size_t index = 0;
+  float sum = 0.0f;
+
+#if defined(__AVX__)
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  for (; index+16<=kSize; index += 16) {
+    sum0 = _mm256_add_ps(sum0, _mm256_mul_ps
+      (_mm256_loadu_ps(kVector1+index), _mm256_loadu_ps(kVector2+index)));
+    sum1 = _mm256_add_ps(sum1, _mm256_mul_ps
+      (_mm256_loadu_ps(kVector1+index+8), _mm256_loadu_ps(kVector2+index+8)));
+  }
+  const __m256 kSum256 = _mm256_add_ps(sum0, sum1);
+  __m128 sum128 = _mm_add_ps(_mm256_castps256_ps128(kSum256), _mm256_extractf128_ps(kSum256, 1));
+  sum128 = _mm_add_ps(sum128, _mm_movehl_ps(sum128, sum128));
+  sum128 = _mm_add_ss(sum128, _mm_shuffle_ps(sum128, sum128, 1));
+  sum = _mm_cvtss_f32(sum128);
+#elif defined(__SSE__)
+  __m128 sum0 = _mm_setzero_ps();
+  __m128 sum1 = _mm_setzero_ps();
+  for (; index+8<=kSize; index += 8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps
+      (_mm_loadu_ps(kVector1+index), _mm_loadu_ps(kVector2+index)));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps
+      (_mm_loadu_ps(kVector1+index+4), _mm_loadu_ps(kVector2+index+4)));
+  }
+  __m128 sum128 = _mm_add_ps(sum0, sum1);
+  sum128 = _mm_add_ps(sum128, _mm_movehl_ps(sum128, sum128));
+  sum128 = _mm_add_ss(sum128, _mm_shuffle_ps(sum128, sum128, 1));
+  sum = _mm_cvtss_f32(sum128);
+#endif
+
+  // Remaining elements (all of them without SIMD support)
+  return sum+DenseDotProduct<float>(kVector1+index, kVector2+index, kSize-index);
+}
+
+
+inline int32_t DenseDotProduct(const int8_t* kVector1, const int8_t* kVector2, const size_t kSize) {
+  size_t index = 0;
+  int32_t sum = 0;
+
+#if defined(__AVX2__)
+  __m256i sum256 = _mm256_setzero_si256();
+  for (; index+32<=kSize; index += 32) {
+    const __m256i kVector1Block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kVector1+index));
+    const __m256i kVector2Block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kVector2+index));
+    // Widen to 16 bit, multiply and add pairs to 32 bit
+    sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16
+      (_mm256_cvtepi8_epi16(_mm256_castsi256_si128(kVector1Block)),
+       _mm256_cvtepi8_epi16(_mm256_castsi256_si128(kVector2Block))));
+    sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16
+      (_mm256_cvtepi8_epi16(_mm256_extracti128_si256(kVector1Block, 1)),
+       _mm256_cvtepi8_epi16(_mm256_extracti128_si256(kVector2Block, 1))));
+  }
+  __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+  sum = _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+  __m128i sum128 = _mm_setzero_si128();
+  for (; index+16<=kSize; index += 16) {
+    const __m128i kVector1Block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kVector1+index));
+    const __m128i kVector2Block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kVector2+index));
+    // Widen to 16 bit (each byte duplicated into both halves, then shifted arithmetically),
+    // multiply and add pairs to 32 bit
+    sum128 = _mm_add_epi32(sum128, _mm_madd_epi16
+      (_mm_srai_epi16(_mm_unpacklo_epi8(kVector1Block, kVector1Block), 8),
+       _mm_srai_epi16(_mm_unpacklo_epi8(kVector2Block, kVector2Block), 8)));
+    sum128 = _mm_add_epi32(sum128, _mm_madd_epi16
+      (_mm_srai_epi16(_mm_unpackhi_epi8(kVector1Block, kVector1Block), 8),
+       _mm_srai_epi16(_mm_unpackhi_epi8(kVector2Block, kVector2Block), 8)));
+  }
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+  sum = _mm_cvtsi128_si32(sum128);
+#endif
+
+  // Remaining elements (all of them without SIMD support)
+  for (; index<kSize; index++) {
+    sum += static_cast<int32_t>(kVector1[index])*static_cast<int32_t>(kVector2[index]);
+  }
+  return sum;
+}
+
+
+template <class T>
+T SparseDenseDotProduct
+  (const uint32_t* kIndices, const T* kValues, const size_t kNumNonZeros, const T* kDense)
+{
+  // Gathers do not vectorize well, but independent accumulators still help
+  T sum0 = 0;
+  T sum1 = 0;
+
+  size_t index = 0;
+  for (; index+2<=kNumNonZeros; index += 2) {
+    sum0 += kValues[index]*kDense[kIndices[index]];
+    sum1 += kValues[index+1]*kDense[kIndices[index+1]];
+  }
+  if (index<kNumNonZeros) {
+    sum0 += kValues[index]*kDense[kIndices[index]];
+  }
+
+  return sum0+sum1;
+}
+
+} // namespace igg
@@ -0,0 +1,211 @@
+
+#include "vlad_encoder.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <eigen3/Eigen/Dense>
+
+#include "tools/linalg.hpp"
+#include "tools/simd.hpp"
+
+
+namespace igg {
+
+namespace {
+
+void NormalizeInPlace(std::vector<float>& vector) {
+  const auto kNorm = std::sqrt(DenseDotProduct(vector.data(), vector.data(), vector.size()));
+  if (kNorm>0.0f) {
+    for (auto& value: vector) {value /= kNorm;}
+  }
+}
+
+} // namespace
+
+
+VladEncoder::VladEncoder(std::vector<FeaturePoint<float>> centroids):
+  centroids_(std::move(centroids))
+{
+  if (this->centroids_.empty()) {throw std::invalid_argument("Need at least one centroid.");}
+  for (const auto& kCentroid: this->centroids_) {
+    if (kCentroid.size()!=this->centroids_[0].size() || kCentroid.empty()) {
+      throw std::invalid_argument("Centroids differ in dimension.");
+    }
+  }
+}
+
+
+std::vector<float> VladEncoder::EncodeRaw(const std::vector<FeaturePoint<float>>& kDescriptors) const {
+  const auto kDescriptorDimension = this->DescriptorDimension();
+  std::vector<float> vector(this->RawDimension(), 0.0f);
+
+  // Sum of residuals to the nearest centroid
+  for (const auto& kDescriptor: kDescriptors) {
+    if (kDescriptor.size()!=kDescriptorDimension) {throw std::invalid_argument("Dimension mismatch.");}
+    size_t nearest = 0;
+    float min_distance = std::numeric_limits<float>::max();
+    for (size_t cluster = 0; cluster<this->NumClusters(); cluster++) {
+      const auto kDistance = SquaredL2Distance(kDescriptor, this->centroids_[cluster]);
+      if (kDistance<min_distance) {
+        min_distance = kDistance;
+        nearest = cluster;
+      }
+    }
+    auto residuals = &vector[nearest*kDescriptorDimension];
+    for (size_t dimension = 0; dimension<kDescriptorDimension; dimension++) {
+      residuals[dimension] += kDescriptor[dimension]-this->centroids_[nearest][dimension];
+    }
+  }
+
+  // Power normalization
+  for (auto& value: vector) {value = std::copysign(std::sqrt(std::abs(value)), value);}
+  NormalizeInPlace(vector);
+  return vector;
+}
+
+
+std::vector<float> VladEncoder::Encode(const std::vector<FeaturePoint<float>>& kDescriptors) const {
+  const auto kRawVector = this->EncodeRaw(kDescriptors);
+  return this->HasPca() ? this->Project(kRawVector) : kRawVector;
+}
+
+
+std::vector<float> VladEncoder::Project(const std::vector<float>& kRawVector) const {
+  if (!this->HasPca()) {throw std::invalid_argument("No projection trained.");}
+  if (kRawVector.size()!=this->RawDimension()) {throw std::invalid_argument("Dimension mismatch.");}
+
+  std::vector<float> centered(kRawVector.size());
+  for (size_t dimension = 0; dimension<centered.size(); dimension++) {
+    centered[dimension] = kRawVector[dimension]-this->pca_mean_[dimension];
+  }
+
+  std::vector<float> vector(this->Dimension());
+  for (size_t component = 0; component<vector.size(); component++) {
+    vector[component] = DenseDotProduct
+      (&this->pca_components_[component*centered.size()], centered.data(), centered.size());
+  }
+  NormalizeInPlace(vector);
+  return vector;
+}
+
+
+void VladEncoder::TrainPca(const std::vector<std::vector<float>>& kRawVectors, const size_t kNumComponents) {
+  const auto kRawDimension = this->RawDimension();
+  const auto kNumVectors = kRawVectors.size();
+  if (kNumComponents==0 || kNumComponents>=kNumVectors || kNumComponents>kRawDimension) {
+    throw std::invalid_argument
+      ("Number of components has to be positive, less than the number of vectors and at most the dimension.");
+  }
+  for (const auto& kVector: kRawVectors) {
+    if (kVector.size()!=kRawDimension) {throw std::invalid_argument("Dimension mismatch.");}
+  }
+
+  std::vector<float> mean(kRawDimension, 0.0f);
+  for (const auto& kVector: kRawVectors) {
+    for (size_t dimension = 0; dimension<kRawDimension; dimension++) {mean[dimension] += kVector[dimension];}
+  }
+  for (auto& value: mean) {value /= kNumVectors;}
+
+  // Centered vectors as rows
+  Eigen::MatrixXf data(kNumVectors, kRawDimension);
+  for (size_t row = 0; row<kNumVectors; row++) {
+    for (size_t dimension = 0; dimension<kRawDimension; dimension++) {
+      data(row, dimension) = kRawVectors[row][dimension]-mean[dimension];
+    }
+  }
+
+  // Eigenvectors with the largest eigenvalues, in ascending order of the eigenvalues
+  Eigen::MatrixXf components(kRawDimension, kNumComponents);
+  if (kNumVectors<kRawDimension) {
+    // For an eigenvector u of the Gram matrix X X^T, X^T u is one of the covariance X^T X
+    Eigen::MatrixXf gram = Eigen::MatrixXf::Zero(kNumVectors, kNumVectors);
+    gram.selfadjointView<Eigen::Lower>().rankUpdate(data);
+    const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> kSolver(gram);
+    components = data.transpose()*kSolver.eigenvectors().rightCols(kNumComponents);
+    components.colwise().normalize();
+  } else {
+    Eigen::MatrixXf covariance = Eigen::MatrixXf::Zero(kRawDimension, kRawDimension);
+    covariance.selfadjointView<Eigen::Lower>().rankUpdate(data.transpose());
+    const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> kSolver(covariance);
+    components = kSolver.eigenvectors().rightCols(kNumComponents);
+  }
+
+  this->pca_mean_ = std::move(mean);
+  this->pca_components_.resize(kNumComponents*kRawDimension);
+  for (size_t component = 0; component<kNumComponents; component++) {
+    for (size_t dimension = 0; dimension<kRawDimension; dimension++) {
+      this->pca_components_[component*kRawDimension+dimension] =
+        components(dimension, kNumComponents-1-component);
+    }
+  }
+}
+
+
+bool VladEncoder::WriteToBinary(const std::string& kPath) const {
+  auto file = std::ofstream
+    (kPath, std::ofstream::binary|std::ofstream::out|std::ofstream::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Cannot write to file " << kPath << ".\n";
+    return false;
+  }
+
+  // Write number of clusters, dimension and centroids
+  size_t num_clusters = this->NumClusters();
+  size_t descriptor_dimension = this->DescriptorDimension();
+  file.write(reinterpret_cast<char*>(&num_clusters), sizeof(size_t));
+  file.write(reinterpret_cast<char*>(&descriptor_dimension), sizeof(size_t));
+  for (const auto& kCentroid: this->centroids_) {
+    file.write(reinterpret_cast<const char*>(kCentroid.data()), sizeof(float)*descriptor_dimension);
+  }
+
+  // Write number of components, mean and components
+  size_t num_components = this->HasPca() ? this->Dimension() : 0;
+  file.write(reinterpret_cast<char*>(&num_components), sizeof(size_t));
+  file.write(reinterpret_cast<const char*>(this->pca_mean_.data()), sizeof(float)*this->pca_mean_.size());
+  file.write(reinterpret_cast<const char*>(this->pca_components_.data()), sizeof(float)*this->pca_components_.size());
+
+  return true;
+}
+
+
+VladEncoder VladEncoder::ReadFromBinary(const std::string& kPath) {
+  std::ifstream file = std::ifstream
+    (kPath, std::ifstream::binary|std::ifstream::in);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open file "+kPath+".");
+  }
+
+  size_t num_clusters = 0;
+  size_t descriptor_dimension = 0;
+  file.read(reinterpret_cast<char*>(&num_clusters), sizeof(size_t));
+  file.read(reinterpret_cast<char*>(&descriptor_dimension), sizeof(size_t));
+  if (!file || num_clusters==0 || descriptor_dimension==0) {
+    throw std::runtime_error("Cannot read VLAD encoder from file "+kPath+".");
+  }
+  std::vector<FeaturePoint<float>> centroids(num_clusters, FeaturePoint<float>(descriptor_dimension));
+  for (auto& centroid: centroids) {
+    file.read(reinterpret_cast<char*>(centroid.data()), sizeof(float)*descriptor_dimension);
+  }
+  VladEncoder encoder(std::move(centroids));
+
+  size_t num_components = 0;
+  file.read(reinterpret_cast<char*>(&num_components), sizeof(size_t));
+  if (!file || num_components>encoder.RawDimension()) {
+    throw std::runtime_error("Cannot read VLAD projection from file "+kPath+".");
+  }
+  if (num_components>0) {
+    encoder.pca_mean_.resize(encoder.RawDimension());
+    encoder.pca_components_.resize(num_components*encoder.RawDimension());
+    file.read(reinterpret_cast<char*>(encoder.pca_mean_.data()), sizeof(float)*encoder.pca_mean_.size());
+    file.read(reinterpret_cast<char*>(encoder.pca_components_.data()), sizeof(float)*encoder.pca_components_.size());
+  }
+  if (!file) {throw std::runtime_error("Cannot read VLAD projection from file "+kPath+".");}
+
+  return encoder;
+}
+
+} // namespace igg
@@ -0,0 +1,125 @@
+#ifndef CPP_FINAL_PROJECT_VLAD_VLAD_ENCODER_HPP_
+#define CPP_FINAL_PROJECT_VLAD_VLAD_ENCODER_HPP_
+
+
+#include <string>
+#include <vector>
+
+#include "clustering/feature_point.hpp"
+
+
+namespace igg {
+
+/**
+ * Aggregates the descriptors of an image to a single dense vector (VLAD, vector of
+ * locally aggregated descriptors).
+ *
+ * Each descriptor is assigned to its nearest centroid of a small vocabulary (e.g. 64 to
+ * 256 words) and the residuals descriptor - centroid are summed per centroid. The sums
+ * of all centroids are concatenated, power-normalized (signed square root, which damps
+ * bursts of similar descriptors) and L2-normalized, so inner products are cosine
+ * similarities. Optionally the vectors are projected onto their main components (PCA)
+ * and L2-normalized again.
+ *
+ * References:
+ * Jegou, Douze, Schmid, Perez: Aggregating local descriptors into a compact image representation, 2010
+ * Jegou, Chum: Negative evidences and co-occurrences in image retrieval: the benefit of PCA and whitening, 2012
+ *
+ * Usage:
+ *
+ *   VladEncoder encoder(centroids);
+ *   encoder.TrainPca(raw_vectors, 256); // Optional, raw_vectors from EncodeRaw()
+ *   const auto kVector = encoder.Encode(descriptors);
+ */
+class VladEncoder {
+public:
+  /**
+   * Constructor.
+   *
+   * Throws an instance of std::invalid_argument if there are no centroids or they
+   * differ in dimension.
+   *
+   * @param centroids The vocabulary, e.g. from K-means on a sample of descriptors.
+   */
+  explicit VladEncoder(std::vector<FeaturePoint<float>> centroids);
+
+  size_t NumClusters() const {return this->centroids_.size();}
+
+  size_t DescriptorDimension() const {return this->centroids_[0].size();}
+
+  /**
+   * Dimension of vectors before the projection, i.e. number of clusters times
+   * descriptor dimension.
+   */
+  size_t RawDimension() const {return this->NumClusters()*this->DescriptorDimension();}
+
+  /**
+   * Dimension of encoded vectors.
+   */
+  size_t Dimension() const
+    {return this->HasPca() ? this->pca_components_.size()/this->RawDimension() : this->RawDimension();}
+
+  bool HasPca() const {return !this->pca_mean_.empty();}
+
+  /**
+   * Power- and L2-normalized sums of residuals, without projection. A vector of zeros
+   * if there are no descriptors.
+   *
+   * Throws an instance of std::invalid_argument if a descriptor does not match the
+   * dimension of the centroids.
+   */
+  std::vector<float> EncodeRaw(const std::vector<FeaturePoint<float>>& kDescriptors) const;
+
+  /**
+   * EncodeRaw() followed by Project(), if a projection was trained.
+   */
+  std::vector<float> Encode(const std::vector<FeaturePoint<float>>& kDescriptors) const;
+
+  /**
+   * Project a raw vector onto the main components and L2-normalize it.
+   *
+   * Throws an instance of std::invalid_argument if no projection was trained or the
+   * dimension does not match.
+   */
+  std::vector<float> Project(const std::vector<float>& kRawVector) const;
+
+  /**
+   * Compute the main components of raw vectors (see EncodeRaw()) of a sample of images.
+   * If there are fewer vectors than dimensions, as usual, the components are computed
+   * from their Gram matrix, so the cost depends on the number of vectors squared.
+   *
+   * Throws an instance of std::invalid_argument if the vectors do not match the raw
+   * dimension or there are not more vectors than components.
+   *
+   * @param kRawVectors Training vectors.
+   * @param kNumComponents Dimension after the projection, e.g. 128 to 512.
+   */
+  void TrainPca(const std::vector<std::vector<float>>& kRawVectors, const size_t kNumComponents);
+
+  /**
+   * Write the centroids and the projection to a binary file.
+   *
+   * In case the given file already exists it is overwritten.
+   *
+   * @return True, if writing was successful.
+   */
+  bool WriteToBinary(const std::string& kPath) const;
+
+  /**
+   * Read an encoder from a binary file as written by WriteToBinary.
+   *
+   * Throws a std::runtime_error in case the file cannot be read.
+   */
+  static VladEncoder ReadFromBinary(const std::string& kPath);
+
+private:
+  std::vector<FeaturePoint<float>> centroids_;
+  // Mean of the raw training vectors, empty without projection
+  std::vector<float> pca_mean_;
+  // Main components one after another, each of raw dimension, most significant first
+  std::vector<float> pca_components_;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_VLAD_VLAD_ENCODER_HPP_
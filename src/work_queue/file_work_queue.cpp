@@ -0,0 +1,201 @@
+
+#include "file_work_queue.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+
+namespace igg {
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+const size_t kMaxHostNameSize = 256;
+
+int64_t MillisecondsSinceEpoch() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>
+    (std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Worker and expiry of a lease, false if there is none
+bool ReadLease(const fs::path& kPath, std::string& worker_id, int64_t& expiry) {
+  std::ifstream file(kPath.string());
+  return static_cast<bool>(std::getline(file, worker_id) && file >> expiry);
+}
+
+bool LeaseExpired(const fs::path& kPath) {
+  std::string worker_id;
+  int64_t expiry;
+  return ReadLease(kPath, worker_id, expiry) && expiry<MillisecondsSinceEpoch();
+}
+
+} // namespace
+
+
+FileWorkQueue::FileWorkQueue
+  (const std::string& kDir,
+   const size_t kNumItems,
+   const size_t kBatchSize,
+   const std::chrono::milliseconds kLeaseDuration,
+   const std::string& kWorkerId):
+  kDir_{kDir}, kNumItems_{kNumItems}, kLeaseDuration_{kLeaseDuration}, kWorkerId_{kWorkerId},
+  batch_size_{kBatchSize}, next_batch_{0}
+{
+  if (kBatchSize==0) {throw std::invalid_argument("Batch size has to be positive.");}
+  if (kLeaseDuration.count()<=0) {throw std::invalid_argument("Lease duration has to be positive.");}
+  if (kWorkerId.empty() || kWorkerId.find_first_of("/\n")!=std::string::npos) {
+    throw std::invalid_argument("Worker id "+kWorkerId+" is empty or contains / or line breaks.");
+  }
+
+  // The first worker decides the batches, all others use the same
+  fs::create_directories(this->kDir_);
+  const auto kManifestPath = this->kDir_/"queue.txt";
+  this->CreateExclusive(kManifestPath, std::to_string(kNumItems)+" "+std::to_string(kBatchSize)+"\n");
+  std::ifstream manifest(kManifestPath.string());
+  size_t num_items = 0;
+  if (!(manifest >> num_items >> this->batch_size_) || this->batch_size_==0) {
+    throw std::runtime_error("Cannot read work queue "+kManifestPath.string()+".");
+  }
+  if (num_items!=kNumItems) {
+    throw std::runtime_error
+      ("Work queue "+this->kDir_.string()+" was created for "+std::to_string(num_items)+
+       " items, not "+std::to_string(kNumItems)+".");
+  }
+
+  if (this->NumBatches()>0) {this->next_batch_ = std::hash<std::string>()(kWorkerId)%this->NumBatches();}
+}
+
+
+std::string FileWorkQueue::DefaultWorkerId() {
+  char host_name[kMaxHostNameSize] = {0};
+  if (::gethostname(host_name, kMaxHostNameSize-1)!=0) {host_name[0] = '\0';}
+  std::string worker_id(host_name);
+  std::replace(worker_id.begin(), worker_id.end(), '/', '_');
+  return (worker_id.empty() ? "localhost" : worker_id)+"-"+std::to_string(::getpid());
+}
+
+
+bool FileWorkQueue::Claim(WorkBatch& batch) {
+  for (size_t offset = 0; offset<this->NumBatches(); offset++) {
+    const auto kBatch = (this->next_batch_+offset)%this->NumBatches();
+    if (fs::exists(this->DonePath(kBatch))) {continue;}
+    if (fs::exists(this->LeasePath(kBatch)) && !this->BreakExpiredLease(kBatch)) {continue;}
+    if (!this->CreateExclusive(this->LeasePath(kBatch), this->LeaseContent())) {continue;}
+
+    // Completed by the previous owner meanwhile
+    if (fs::exists(this->DonePath(kBatch))) {
+      boost::system::error_code error;
+      fs::remove(this->LeasePath(kBatch), error);
+      continue;
+    }
+    this->next_batch_ = kBatch+1;
+    batch = this->Batch(kBatch);
+    return true;
+  }
+  return false;
+}
+
+
+bool FileWorkQueue::Renew(const WorkBatch& kBatch) {
+  std::string worker_id;
+  int64_t expiry;
+  if (!ReadLease(this->LeasePath(kBatch.index), worker_id, expiry) || worker_id!=this->kWorkerId_) {
+    return false;
+  }
+
+  const auto kTemporaryPath = this->kDir_/("."+this->kWorkerId_+".renew");
+  {
+    std::ofstream file(kTemporaryPath.string());
+    file << this->LeaseContent();
+  }
+  fs::rename(kTemporaryPath, this->LeasePath(kBatch.index));
+  return true;
+}
+
+
+void FileWorkQueue::Complete(const WorkBatch& kBatch) {
+  this->CreateExclusive(this->DonePath(kBatch.index), this->kWorkerId_+"\n");
+
+  std::string worker_id;
+  int64_t expiry;
+  if (ReadLease(this->LeasePath(kBatch.index), worker_id, expiry) && worker_id==this->kWorkerId_) {
+    boost::system::error_code error;
+    fs::remove(this->LeasePath(kBatch.index), error);
+  }
+}
+
+
+size_t FileWorkQueue::NumDone() const {
+  size_t num_done = 0;
+  for (size_t batch = 0; batch<this->NumBatches(); batch++) {
+    if (fs::exists(this->DonePath(batch))) {num_done++;}
+  }
+  return num_done;
+}
+
+
+fs::path FileWorkQueue::LeasePath(const size_t kBatch) const {
+  return this->kDir_/("batch_"+std::to_string(kBatch)+".lease");
+}
+
+
+fs::path FileWorkQueue::DonePath(const size_t kBatch) const {
+  return this->kDir_/("batch_"+std::to_string(kBatch)+".done");
+}
+
+
+WorkBatch FileWorkQueue::Batch(const size_t kBatch) const {
+  return {kBatch, kBatch*this->batch_size_, std::min((kBatch+1)*this->batch_size_, this->kNumItems_)};
+}
+
+
+bool FileWorkQueue::CreateExclusive(const fs::path& kPath, const std::string& kContent) const {
+  const auto kTemporaryPath = this->kDir_/("."+this->kWorkerId_+".create");
+  {
+    std::ofstream file(kTemporaryPath.string());
+    file << kContent;
+    if (!file) {throw std::runtime_error("Cannot write to work queue "+this->kDir_.string()+".");}
+  }
+
+  // Fails if the file exists, the file is never seen incomplete
+  boost::system::error_code error;
+  fs::create_hard_link(kTemporaryPath, kPath, error);
+  fs::remove(kTemporaryPath);
+  if (error && !fs::exists(kPath)) {
+    throw std::runtime_error("Cannot create "+kPath.string()+": "+error.message()+".");
+  }
+  return !error;
+}
+
+
+std::string FileWorkQueue::LeaseContent() const {
+  std::ostringstream content;
+  content << this->kWorkerId_ << "\n" << MillisecondsSinceEpoch()+this->kLeaseDuration_.count() << "\n";
+  return content.str();
+}
+
+
+bool FileWorkQueue::BreakExpiredLease(const size_t kBatch) const {
+  const auto kLeasePath = this->LeasePath(kBatch);
+  if (!LeaseExpired(kLeasePath)) {return !fs::exists(kLeasePath);}
+
+  // Only one worker can move the lease away, the others fail
+  const auto kExpiredPath = this->kDir_/(kLeasePath.filename().string()+"."+this->kWorkerId_+".expired");
+  boost::system::error_code error;
+  fs::rename(kLeasePath, kExpiredPath, error);
+  if (error) {return false;}
+
+  // The lease was renewed or claimed again since it was read, put it back
+  const bool kExpired = LeaseExpired(kExpiredPath);
+  if (!kExpired) {fs::create_hard_link(kExpiredPath, kLeasePath, error);}
+  fs::remove(kExpiredPath);
+  return kExpired;
+}
+
+} // namespace igg
@@ -0,0 +1,146 @@
+#ifndef CPP_FINAL_PROJECT_WORK_QUEUE_FILE_WORK_QUEUE_HPP_
+#define CPP_FINAL_PROJECT_WORK_QUEUE_FILE_WORK_QUEUE_HPP_
+
+
+#include <chrono>
+#include <string>
+#include <boost/filesystem.hpp>
+
+
+namespace igg {
+
+/**
+ * Consecutive items processed together, [begin, end).
+ */
+struct WorkBatch {
+  size_t index;
+  size_t begin;
+  size_t end;
+};
+
+/**
+ * Work queue shared by several worker processes through a directory only, e.g. on a
+ * filesystem mounted by several hosts. There is no central service: the items
+ * 0, ..., kNumItems-1 are split into batches, and each worker claims one batch after
+ * the other by creating a lease file for it, processes it and marks it done.
+ *
+ * A lease expires kLeaseDuration after it was taken or last renewed. Batches of workers
+ * which died (or lost their connection) are claimed again once their lease expired.
+ * Workers should renew their lease well before it expires, see Renew().
+ *
+ * The directory contains:
+ *
+ *   <kDir>/
+ *       |_ queue.txt (number of items and batch size, written by the first worker)
+ *       |_ batch_<index>.lease (worker and expiry of a claimed batch)
+ *       |_ batch_<index>.done (processed batches)
+ *
+ * Files are created by hard linking a complete temporary file, which is atomic also on
+ * network filesystems, and replaced by renaming. The expiry is wall clock time, so the
+ * clocks of the hosts need to be roughly in sync, differences well below the lease
+ * duration are fine.
+ *
+ * A batch may still be processed twice, e.g. if a worker outlives its lease. Results
+ * therefore have to be written atomically and be the same whoever writes them, e.g. by
+ * writing to a temporary file which is renamed once complete.
+ *
+ * Usage (in each worker):
+ *
+ *   FileWorkQueue queue("/shared/queue", items.size(), 64, std::chrono::minutes(10));
+ *   WorkBatch batch;
+ *   while (!queue.Done()) {
+ *     if (!queue.Claim(batch)) {std::this_thread::sleep_for(std::chrono::seconds(1)); continue;}
+ *     for (auto index = batch.begin; index<batch.end; index++) {
+ *       // Process items[index], call queue.Renew(batch) now and then
+ *     }
+ *     queue.Complete(batch);
+ *   }
+ */
+class FileWorkQueue {
+public:
+  /**
+   * Constructor. Creates the queue, or joins the one in the directory.
+   *
+   * Throws an instance of std::invalid_argument if kBatchSize or kLeaseDuration is not
+   * positive, and of std::runtime_error if the queue in the directory was created for
+   * another number of items or cannot be read. The batch size of an existing queue is
+   * used instead of kBatchSize.
+   *
+   * @param kDir Directory of the queue, created if it does not exist.
+   * @param kNumItems Number of items to process.
+   * @param kBatchSize Number of items per batch.
+   * @param kLeaseDuration Time a worker may process a batch without renewing its lease.
+   * @param kWorkerId Name of this worker, unique among all workers of the queue.
+   */
+  FileWorkQueue
+    (const std::string& kDir,
+     const size_t kNumItems,
+     const size_t kBatchSize,
+     const std::chrono::milliseconds kLeaseDuration,
+     const std::string& kWorkerId = DefaultWorkerId());
+
+  /**
+   * Name of the host and id of the process.
+   */
+  static std::string DefaultWorkerId();
+
+  size_t NumItems() const {return this->kNumItems_;}
+  size_t BatchSize() const {return this->batch_size_;}
+  size_t NumBatches() const {return (this->kNumItems_+this->batch_size_-1)/this->batch_size_;}
+  std::chrono::milliseconds LeaseDuration() const {return this->kLeaseDuration_;}
+  const std::string& WorkerId() const {return this->kWorkerId_;}
+
+  /**
+   * Claim a batch which is not done and not leased, or whose lease expired.
+   *
+   * @return True if a batch was claimed, false if all remaining batches are leased.
+   */
+  bool Claim(WorkBatch& batch);
+
+  /**
+   * Extend the lease of a claimed batch by the lease duration.
+   *
+   * @return False if the lease was lost, e.g. it expired and another worker claimed the
+   * batch. The batch should not be processed further then.
+   */
+  bool Renew(const WorkBatch& kBatch);
+
+  /**
+   * Mark a claimed batch as done and release its lease.
+   */
+  void Complete(const WorkBatch& kBatch);
+
+  /**
+   * Number of batches done by any worker.
+   */
+  size_t NumDone() const;
+
+  bool Done() const {return this->NumDone()==this->NumBatches();}
+
+private:
+  const boost::filesystem::path kDir_;
+  const size_t kNumItems_;
+  const std::chrono::milliseconds kLeaseDuration_;
+  const std::string kWorkerId_;
+  size_t batch_size_;
+  // Workers start looking for batches at different ones to avoid contention
+  size_t next_batch_;
+
+  boost::filesystem::path LeasePath(const size_t kBatch) const;
+  boost::filesystem::path DonePath(const size_t kBatch) const;
+
+  WorkBatch Batch(const size_t kBatch) const;
+
+  // Create a file with the content unless it exists, false if it exists
+  bool CreateExclusive(const boost::filesystem::path& kPath, const std::string& kContent) const;
+
+  // Lease of this worker expiring a lease duration from now
+  std::string LeaseContent() const;
+
+  // Remove the lease if it expired, true if the batch may be claimed now
+  bool BreakExpiredLease(const size_t kBatch) const;
+};
+
+} // namespace igg
+
+#endif // CPP_FINAL_PROJECT_WORK_QUEUE_FILE_WORK_QUEUE_HPP_
@@ -0,0 +1,288 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "inverted_index/inverted_index.hpp"
+#include "histogram/sparse_histogram.hpp"
+#include "histogram/ranking.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+
+
+namespace igg {
+
+/*
+ * Compare compressed posting lists to uncompressed ones (pairs of 32 bit id and float weight)
+ * in size and query latency. Arguments are the number of images and the number of words.
+ *
+ * Words are drawn from a Zipf-like distribution, so few words are contained in most images
+ * like in real vocabularies, and weighted by tf-idf. Optionally, images are grouped into
+ * scenes of kNumImagesPerScene images, taking the given fraction of their words from the
+ * words of their scene, so similar images exist.
+ */
+
+const size_t kNumResults = 10;
+const size_t kNumWordsPerImage = 200;
+const size_t kNumImagesPerScene = 20;
+
+// Words of each image (sorted, with repetitions) and the scene it was drawn from
+struct BenchmarkWords {
+  std::vector<std::vector<uint32_t>> words;
+  std::vector<size_t> scenes;
+};
+
+/*
+ * Optionally, the given fraction of the words of each image is a single repeated word,
+ * like a repetitive texture (burst).
+ */
+BenchmarkWords MakeBenchmarkWords
+  (const size_t kNumImages, const size_t kNumWords, const double kSceneFraction, const double kBurstFraction = 0.0)
+{
+  std::mt19937 engine(0);
+  std::vector<double> word_weights(kNumWords);
+  for (size_t word = 0; word<kNumWords; word++) {word_weights[word] = 1.0/std::pow(word+1.0, 0.8);}
+  std::discrete_distribution<uint32_t> zipf(word_weights.begin(), word_weights.end());
+
+  // Images of a scene share part of their words
+  const size_t kNumScenes = (kNumImages+kNumImagesPerScene-1)/kNumImagesPerScene;
+  std::vector<std::vector<uint32_t>> scenes(kNumScenes);
+  for (auto& scene: scenes) {
+    for (size_t index = 0; index<kNumWordsPerImage; index++) {scene.emplace_back(zipf(engine));}
+  }
+  std::uniform_int_distribution<size_t> uniform_scene(0, kNumScenes-1);
+  std::uniform_int_distribution<size_t> uniform_position(0, kNumWordsPerImage-1);
+  std::uniform_int_distribution<uint32_t> uniform_word(0, kNumWords-1);
+  std::bernoulli_distribution is_from_scene(kSceneFraction);
+  const auto kNumBurstWords = static_cast<size_t>(kBurstFraction*kNumWordsPerImage);
+
+  BenchmarkWords benchmark_words;
+  benchmark_words.words.resize(kNumImages);
+  for (auto& image_words: benchmark_words.words) {
+    benchmark_words.scenes.emplace_back(uniform_scene(engine));
+    const auto& kScene = scenes[benchmark_words.scenes.back()];
+    for (size_t index = kNumBurstWords; index<kNumWordsPerImage; index++) {
+      image_words.emplace_back(is_from_scene(engine) ? kScene[uniform_position(engine)] : zipf(engine));
+    }
+    if (kNumBurstWords>0) {image_words.insert(image_words.end(), kNumBurstWords, uniform_word(engine));}
+    std::sort(image_words.begin(), image_words.end());
+  }
+  return benchmark_words;
+}
+
+
+// Re-weight like MakeHistograms(), frequent words get small weights
+std::vector<SparseHistogram<float>> MakeWeightedHistograms
+  (const std::vector<std::vector<uint32_t>>& kWords, const size_t kNumWords,
+   const double kMaxDocumentFrequency = 1.0, const size_t kMaxWordCount = 0)
+{
+  std::vector<size_t> num_occurrences(kNumWords, 0);
+  for (const auto& kImageWords: kWords) {
+    for (size_t index = 0; index<kImageWords.size(); index++) {
+      if (index==0 || kImageWords[index]!=kImageWords[index-1]) {num_occurrences[kImageWords[index]]++;}
+    }
+  }
+  const auto kPruning = VocabularyPruning::FromDocumentFrequencies
+    (num_occurrences, kWords.size(), kMaxDocumentFrequency, kMaxWordCount);
+  const auto kMaxCount = kPruning.MaxWordCount()>0 ? kPruning.MaxWordCount() : kNumWordsPerImage;
+
+  std::vector<SparseHistogram<float>> histograms;
+  histograms.reserve(kWords.size());
+  for (const auto& kImageWords: kWords) {
+    std::vector<uint32_t> bins;
+    std::vector<float> weights;
+    size_t count = 0;
+    for (const auto kWord: kImageWords) {
+      if (kPruning.IsStopWord(kWord)) {continue;}
+      if (bins.empty() || bins.back()!=kWord) {
+        bins.emplace_back(kWord);
+        weights.emplace_back(0.0f);
+        count = 0;
+      }
+      if (++count<=kMaxCount) {
+        weights.back() += std::log(kWords.size()/static_cast<float>(num_occurrences[kWord]));
+      }
+    }
+    histograms.emplace_back(kNumWords, bins, weights);
+  }
+  return histograms;
+}
+
+
+std::vector<SparseHistogram<float>> MakeBenchmarkHistograms
+  (const size_t kNumImages, const size_t kNumWords, const double kSceneFraction = 0.0)
+{
+  return MakeWeightedHistograms(MakeBenchmarkWords(kNumImages, kNumWords, kSceneFraction).words, kNumWords);
+}
+
+
+// Uncompressed baseline, same normalization and term-at-a-time scoring as InvertedIndex
+class UncompressedInvertedIndex {
+public:
+  explicit UncompressedInvertedIndex(const std::vector<SparseHistogram<float>>& kHistograms)
+    : num_images_{kHistograms.size()}, posting_lists_(kHistograms[0].NumBins())
+  {
+    for (size_t image = 0; image<kHistograms.size(); image++) {
+      const auto& kWeights = kHistograms[image].Weights();
+      float norm = 0.0f;
+      for (const auto kWeight: kWeights) {norm += kWeight*kWeight;}
+      norm = std::sqrt(norm);
+      for (size_t index = 0; index<kWeights.size(); index++) {
+        this->posting_lists_[kHistograms[image].Bins()[index]].emplace_back(image, kWeights[index]/norm);
+      }
+    }
+  }
+
+  std::vector<ScoredIndex<float>> TopK(const SparseHistogram<float>& kQuery, const size_t kNumResults) const {
+    std::vector<float> scores(this->num_images_, 0.0f);
+    for (size_t index = 0; index<kQuery.NumNonZeros(); index++) {
+      const auto kWeight = kQuery.Weights()[index];
+      for (const auto& kPosting: this->posting_lists_[kQuery.Bins()[index]]) {
+        scores[kPosting.first] += kWeight*kPosting.second;
+      }
+    }
+    return TopKScores(scores, kNumResults);
+  }
+
+  size_t MemoryBytes() const {
+    size_t bytes = 0;
+    for (const auto& kList: this->posting_lists_) {bytes += kList.size()*sizeof(kList[0]);}
+    return bytes;
+  }
+
+private:
+  size_t num_images_;
+  std::vector<std::vector<std::pair<uint32_t, float>>> posting_lists_;
+};
+
+
+static void BM_UncompressedPostings(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const UncompressedInvertedIndex kIndex(kHistograms);
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[query], kNumResults));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["memory_bytes"] = kIndex.MemoryBytes();
+}
+
+
+static void BM_CompressedPostings(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const InvertedIndex kIndex(kHistograms);
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[query], kNumResults));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["memory_bytes"] = kIndex.MemoryBytes();
+}
+
+
+static void BM_CompressPostings(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(InvertedIndex(kHistograms).NumWords());
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+/*
+ * Query latency of exhaustive and pruned top-k retrieval, reported as percentiles
+ * over the queries (in microseconds). Arguments are the number of images, the
+ * number of words and the percentage of words shared within a scene.
+ */
+void SetLatencyPercentiles(benchmark::State& state, std::vector<double> latencies) {
+  if (latencies.empty()) {return;}
+  std::sort(latencies.begin(), latencies.end());
+  for (const auto kPercentile: {50, 90, 99}) {
+    const auto kIndex = std::min(latencies.size()*kPercentile/100, latencies.size()-1);
+    state.counters["p"+std::to_string(kPercentile)+"_us"] = latencies[kIndex];
+  }
+}
+
+
+template <class QueryFunction>
+void RunQueries(benchmark::State& state, const std::vector<SparseHistogram<float>>& kQueries, const QueryFunction& kQuery) {
+  std::vector<double> latencies;
+  size_t query = 0;
+  for(auto _: state) {
+    const auto kStart = std::chrono::steady_clock::now();
+    benchmark::DoNotOptimize(kQuery(kQueries[query]));
+    latencies.emplace_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-kStart).count());
+    query = (query+1)%kQueries.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  SetLatencyPercentiles(state, latencies);
+}
+
+
+static void BM_QueryExhaustive(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1), state.range(2)/100.0);
+  const InvertedIndex kIndex(kHistograms);
+  RunQueries(state, kHistograms, [&kIndex](const SparseHistogram<float>& kQuery)
+    {return kIndex.TopK(kQuery, kNumResults);});
+}
+
+
+static void BM_QueryPruned(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1), state.range(2)/100.0);
+  const InvertedIndex kIndex(kHistograms);
+  RunQueries(state, kHistograms, [&kIndex](const SparseHistogram<float>& kQuery)
+    {return kIndex.TopKPruned(kQuery, kNumResults);});
+}
+
+/*
+ * Impact of dropping stop words and limiting bursts on index size, query latency (pruned
+ * top-k) and retrieval quality, measured as the fraction of the top results from the
+ * same scene as the query (precision_at_10). A fifth of the words of each image is a
+ * burst. Arguments are the number of images, the number of words, the maximum document
+ * frequency in percent and the maximum count of a word in an image (0 for no limit).
+ */
+static void BM_VocabularyPruning(benchmark::State& state) {
+  const size_t kNumWords = state.range(1);
+  const auto kWords = MakeBenchmarkWords(state.range(0), kNumWords, 0.5, 0.2);
+  const auto kHistograms = MakeWeightedHistograms(kWords.words, kNumWords, state.range(2)/100.0, state.range(3));
+  const InvertedIndex kIndex(kHistograms);
+
+  const size_t kNumQualityQueries = 1000;
+  size_t num_relevant = 0;
+  for (size_t query = 0; query<kNumQualityQueries; query++) {
+    for (const auto& kResult: kIndex.TopK(kHistograms[query], kNumResults)) {
+      if (kWords.scenes[kResult.first]==kWords.scenes[query]) {num_relevant++;}
+    }
+  }
+
+  RunQueries(state, kHistograms, [&kIndex](const SparseHistogram<float>& kQuery)
+    {return kIndex.TopKPruned(kQuery, kNumResults);});
+  state.counters["memory_bytes"] = kIndex.MemoryBytes();
+  state.counters["precision_at_10"] = num_relevant/static_cast<double>(kNumQualityQueries*kNumResults);
+}
+
+BENCHMARK(BM_UncompressedPostings)->Args({10000, 1000})->Args({10000, 20000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CompressedPostings)->Args({10000, 1000})->Args({10000, 20000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CompressPostings)->Args({10000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QueryExhaustive)->Args({10000, 20000, 0})->Args({10000, 20000, 50})->Args({100000, 20000, 0})
+  ->Args({100000, 20000, 50})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QueryPruned)->Args({10000, 20000, 0})->Args({10000, 20000, 50})->Args({100000, 20000, 0})
+  ->Args({100000, 20000, 50})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_VocabularyPruning)->Args({100000, 20000, 100, 0})->Args({100000, 20000, 100, 5})
+  ->Args({100000, 20000, 10, 0})->Args({100000, 20000, 5, 5})->Args({100000, 20000, 2, 5})
+  ->Unit(benchmark::kMillisecond);
+
+} // namespace igg
+
+BENCHMARK_MAIN();
@@ -0,0 +1,148 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <iostream>
+#include <random>
+
+#include "clustering/feature_point.hpp"
+#include "clustering/kmeans_with_index/index.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "tools/sampling.hpp"
+#include "make_clustering_test_data.hpp"
+
+
+namespace igg {
+
+/*
+ * Compare different ways to assign descriptors to visual words (cluster centroids).
+ *
+ * Each benchmark reports the fraction of queries for which the exact nearest
+ * centroid was found as counter "recall" alongside the throughput.
+ */
+
+const size_t kNumFeatures = 128;
+const size_t kNumQueries = 1000;
+
+/*
+ * Descriptors are drawn from a number of normal distributions, centroids are a
+ * subset of them and queries are the remaining ones (similar to descriptors of
+ * unseen images).
+ */
+std::pair<std::vector<FeaturePoint<float>>, std::vector<FeaturePoint<float>>>
+  MakeBenchmarkCentroidsAndQueries(const size_t kNumCentroids)
+{
+  std::mt19937 engine(0);
+  const size_t kNumDistributions = 100;
+  const size_t kNumSamplesPerDistribution = (kNumCentroids+kNumQueries)/kNumDistributions+1;
+  auto point_set = MakeClusteringTestData
+    (engine, kNumFeatures, kNumDistributions, 0.0f, 1.0f, 0.1f, 0.1f,
+     kNumSamplesPerDistribution, kNumSamplesPerDistribution);
+
+  const std::vector<FeaturePoint<float>> kQueries
+    (point_set.begin()+kNumCentroids, point_set.begin()+kNumCentroids+kNumQueries);
+  point_set.resize(kNumCentroids);
+
+  return std::make_pair(point_set, kQueries);
+}
+
+
+std::vector<size_t> ExactNearestNeighbors
+  (const std::vector<FeaturePoint<float>>& kQueries,
+   const std::vector<FeaturePoint<float>>& kCentroids)
+{
+  std::vector<size_t> nearest_neighbors;
+  nearest_neighbors.reserve(kQueries.size());
+  for (const auto& kQuery: kQueries) {
+    nearest_neighbors.emplace_back(NearestNeighbor(kQuery, kCentroids));
+  }
+  return nearest_neighbors;
+}
+
+
+static void BM_QuantizeBruteForce(benchmark::State& state) {
+  std::vector<FeaturePoint<float>> centroids;
+  std::vector<FeaturePoint<float>> queries;
+  std::tie(centroids, queries) = MakeBenchmarkCentroidsAndQueries(state.range(0));
+  const auto& kCentroids = centroids;
+  const auto& kQueries = queries;
+
+  for(auto _: state) {
+    for (const auto& kQuery: kQueries) {
+      benchmark::DoNotOptimize(NearestNeighbor(kQuery, kCentroids));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations()*kNumQueries);
+  state.counters["recall"] = 1.0;
+}
+
+
+static void BM_QuantizeRandomTrees(benchmark::State& state) {
+  std::vector<FeaturePoint<float>> centroids;
+  std::vector<FeaturePoint<float>> queries;
+  std::tie(centroids, queries) = MakeBenchmarkCentroidsAndQueries(state.range(0));
+  const auto& kCentroids = centroids;
+  const auto& kQueries = queries;
+  const auto kExpected = ExactNearestNeighbors(kQueries, kCentroids);
+
+  const auto kCentroidPointers = GetPointers(kCentroids);
+  const size_t kNumTrees = 10;
+  const size_t kSearchLimit = state.range(1);
+  const size_t kNumSplitDimensions = 5;
+  Index<FeaturePoint<float>> index
+    (kCentroidPointers, kNumTrees, kSearchLimit, kNumSplitDimensions, 0);
+
+  for(auto _: state) {
+    for (const auto& kQuery: kQueries) {
+      benchmark::DoNotOptimize(index.ApproximateNearestNeighbor(kQuery));
+    }
+  }
+
+  size_t num_correct = 0;
+  for (size_t query_index = 0; query_index<kNumQueries; query_index++) {
+    if (index.ApproximateNearestNeighbor(kQueries[query_index])==kCentroidPointers[kExpected[query_index]])
+      {num_correct++;}
+  }
+
+  state.SetItemsProcessed(state.iterations()*kNumQueries);
+  state.counters["recall"] = static_cast<double>(num_correct)/kNumQueries;
+}
+
+
+static void BM_QuantizeHnsw(benchmark::State& state) {
+  std::vector<FeaturePoint<float>> centroids;
+  std::vector<FeaturePoint<float>> queries;
+  std::tie(centroids, queries) = MakeBenchmarkCentroidsAndQueries(state.range(0));
+  const auto& kCentroids = centroids;
+  const auto& kQueries = queries;
+  const auto kExpected = ExactNearestNeighbors(kQueries, kCentroids);
+
+  const size_t kMaxConnections = 16;
+  const size_t kEfConstruction = 200;
+  const size_t kEfSearch = state.range(1);
+  const HnswIndex<FeaturePoint<float>> kIndex
+    (kCentroids, kMaxConnections, kEfConstruction, kEfSearch, 0);
+
+  for(auto _: state) {
+    for (const auto& kQuery: kQueries) {
+      benchmark::DoNotOptimize(kIndex.NearestNeighbor(kQuery));
+    }
+  }
+
+  size_t num_correct = 0;
+  for (size_t query_index = 0; query_index<kNumQueries; query_index++) {
+    if (kIndex.NearestNeighbor(kQueries[query_index])==kExpected[query_index])
+      {num_correct++;}
+  }
+
+  state.SetItemsProcessed(state.iterations()*kNumQueries);
+  state.counters["recall"] = static_cast<double>(num_correct)/kNumQueries;
+}
+
+// Arguments: number of centroids, search effort
+BENCHMARK(BM_QuantizeBruteForce)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QuantizeRandomTrees)->Args({1000, 100})->Args({10000, 100})->Args({10000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QuantizeHnsw)->Args({1000, 10})->Args({1000, 50})->Args({10000, 10})->Args({10000, 50})->Args({10000, 200})->Unit(benchmark::kMillisecond);
+
+} // namespace igg
+
+BENCHMARK_MAIN();
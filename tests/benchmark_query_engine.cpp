@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "query_engine/query_engine.hpp"
+
+
+namespace igg {
+
+/*
+ * Throughput of concurrent queries on a shared QueryEngine, from 1 to N threads.
+ * Compare items_per_second (queries per second of all threads together).
+ *
+ * The engine has 1000 words of 128 dimensions (SIFT) and 20k images of 200 words each,
+ * a query image 300 features. BM_QueryEngineHistogramBatch scores Arg() queries at once,
+ * compare its items_per_second with BM_QueryEngineHistogram on one thread.
+ */
+
+const size_t kNumResults = 10;
+const size_t kNumQueries = 64;
+
+std::vector<FeaturePoint<float>> MakeBenchmarkFeatures
+  (const size_t kNumFeatures, std::mt19937& engine)
+{
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<FeaturePoint<float>> features(kNumFeatures, FeaturePoint<float>(128));
+  for (auto& feature: features) {
+    for (auto& value: feature) {value = uniform(engine);}
+  }
+  return features;
+}
+
+// Built once and shared by all benchmarks and threads
+const QueryEngine& BenchmarkQueryEngine() {
+  static const auto kEngine = []() {
+    const size_t kNumWords = 1000;
+    const size_t kNumImages = 20000;
+    std::mt19937 engine(0);
+    std::uniform_int_distribution<size_t> random_word(0, kNumWords-1);
+
+    QueryEngine::Vocabulary vocabulary;
+    vocabulary.centroids = MakeBenchmarkFeatures(kNumWords, engine);
+    vocabulary.weights.assign(kNumWords, 1.0f);
+    vocabulary.pruning = VocabularyPruning(kNumWords);
+
+    std::vector<SparseHistogram<float>> histograms;
+    std::vector<std::string> image_paths;
+    for (size_t image = 0; image<kNumImages; image++) {
+      Histogram<float> histogram(kNumWords, 0.0f);
+      for (size_t word = 0; word<200; word++) {histogram[random_word(engine)] += 1.0f;}
+      histograms.emplace_back(SparseHistogram<float>::FromDense(histogram));
+      image_paths.emplace_back(std::to_string(image)+".png");
+    }
+    return std::make_unique<const QueryEngine>(std::move(vocabulary), histograms, std::move(image_paths));
+  }();
+  return *kEngine;
+}
+
+const std::vector<std::vector<FeaturePoint<float>>>& BenchmarkQueries() {
+  static const auto kQueries = []() {
+    std::mt19937 engine(1);
+    std::vector<std::vector<FeaturePoint<float>>> queries;
+    for (size_t query = 0; query<kNumQueries; query++) {queries.emplace_back(MakeBenchmarkFeatures(300, engine));}
+    return queries;
+  }();
+  return kQueries;
+}
+
+
+// Assign the features to words and score all images
+static void BM_QueryEngineFeatures(benchmark::State& state) {
+  const auto& kEngine = BenchmarkQueryEngine();
+  const auto& kQueries = BenchmarkQueries();
+  QueryEngine::Scratch scratch;
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kEngine.MostSimilarItems(kQueries[query++%kNumQueries], kNumResults, scratch));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+
+// Score all images only
+static void BM_QueryEngineHistogram(benchmark::State& state) {
+  const auto& kEngine = BenchmarkQueryEngine();
+  std::vector<SparseHistogram<float>> histograms;
+  for (const auto& kQuery: BenchmarkQueries()) {histograms.emplace_back(kEngine.QueryHistogram(kQuery));}
+  QueryEngine::Scratch scratch;
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kEngine.MostSimilarItems(histograms[query++%kNumQueries], kNumResults, scratch));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+
+// Score all images for a batch of queries at once
+static void BM_QueryEngineHistogramBatch(benchmark::State& state) {
+  const auto& kEngine = BenchmarkQueryEngine();
+  const size_t kBatchSize = state.range(0);
+  std::vector<SparseHistogram<float>> histograms;
+  for (const auto& kQuery: BenchmarkQueries()) {histograms.emplace_back(kEngine.QueryHistogram(kQuery));}
+
+  size_t query = 0;
+  for(auto _: state) {
+    std::vector<SparseHistogram<float>> batch;
+    for (size_t index = 0; index<kBatchSize; index++) {batch.emplace_back(histograms[query++%kNumQueries]);}
+    benchmark::DoNotOptimize(kEngine.MostSimilarItemsBatch(batch, kNumResults));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kBatchSize);
+}
+
+BENCHMARK(BM_QueryEngineFeatures)->ThreadRange(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QueryEngineHistogram)->ThreadRange(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QueryEngineHistogramBatch)->Arg(1)->Arg(8)->Arg(32)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace igg
+
+BENCHMARK_MAIN();
@@ -0,0 +1,374 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <memory>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+#include "histogram/histogram.hpp"
+#include "histogram/similarity_index.hpp"
+#include "histogram/quantized_similarity_index.hpp"
+#include "histogram/ranking.hpp"
+#include "histogram/sparse_histogram.hpp"
+#include "product_quantization/product_quantized_index.hpp"
+#include "vlad/vlad_encoder.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "tools/sampling.hpp"
+
+
+namespace igg {
+
+/*
+ * Compare ways to score a query histogram against all histograms of a dataset.
+ *
+ * Arguments are the number of histograms and the number of bins (= words).
+ */
+
+const size_t kNumResults = 10;
+
+std::vector<Histogram<float>> MakeBenchmarkHistograms
+  (const size_t kNumHistograms, const size_t kNumBins)
+{
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<Histogram<float>> histograms(kNumHistograms, Histogram<float>(kNumBins));
+  for (auto& histogram: histograms) {
+    for (auto& bin: histogram) {bin = uniform(engine);}
+  }
+  return histograms;
+}
+
+
+static void BM_ComputeSimilarities(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(ComputeSimilarities(kHistograms[0], kHistograms));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+
+static void BM_SimilarityIndexSingleThreaded(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const SimilarityIndex<float> kIndex(kHistograms, 1);
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.Similarities(kHistograms[0]));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+
+static void BM_SimilarityIndex(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const SimilarityIndex<float> kIndex(kHistograms);
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.Similarities(kHistograms[0]));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+
+static void BM_SimilarityIndexTopK(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const SimilarityIndex<float> kIndex(kHistograms);
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[0], kNumResults));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+/*
+ * Histograms of a large vocabulary with few words per image, compare to
+ * BM_SimilarityIndexTopK with the same number of histograms and bins. Arguments are the number
+ * of histograms, the number of bins and the number of non-zero bins per histogram.
+ */
+std::vector<SparseHistogram<float>> MakeBenchmarkSparseHistograms
+  (const size_t kNumHistograms, const size_t kNumBins, const size_t kNumNonZeros)
+{
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<SparseHistogram<float>> histograms;
+  histograms.reserve(kNumHistograms);
+  for (size_t index = 0; index<kNumHistograms; index++) {
+    const auto kBins = SampleIndicesWithoutReplacement<uint32_t>(kNumNonZeros, kNumBins, engine);
+    Histogram<float> histogram(kNumBins, 0.0f);
+    for (const auto kBin: kBins) {histogram[kBin] = uniform(engine);}
+    histograms.emplace_back(SparseHistogram<float>::FromDense(histogram));
+  }
+  return histograms;
+}
+
+
+static void BM_SimilarityIndexSparseLargeVocabulary(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkSparseHistograms(state.range(0), state.range(1), state.range(2));
+  const SimilarityIndex<float> kIndex(kHistograms);
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[0], kNumResults));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+  state.counters["sparse"] = kIndex.IsSparse();
+}
+
+
+/*
+ * Quantized histograms with exact re-ranking of the best candidates. Arguments are the
+ * number of histograms, the number of bins and the number of candidates. Reports the
+ * fraction of the exact top results found (recall_at_10) and the memory used by the
+ * quantized and the float histograms.
+ */
+static void BM_QuantizedSimilarityIndexTopK(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkHistograms(state.range(0), state.range(1));
+  const QuantizedSimilarityIndex<float> kIndex(kHistograms);
+  const size_t kNumCandidates = state.range(2);
+  // The full-precision store, e.g. histogram files
+  const auto kLoadHistogram = [&kHistograms](const size_t kIndex) {return kHistograms[kIndex];};
+
+  const SimilarityIndex<float> kExactIndex(kHistograms);
+  const size_t kNumRecallQueries = 100;
+  size_t num_found = 0;
+  for (size_t query = 0; query<kNumRecallQueries; query++) {
+    const auto kExpected = kExactIndex.TopK(kHistograms[query], kNumResults);
+    const auto kResults = kIndex.TopK(kHistograms[query], kNumResults, kNumCandidates, kLoadHistogram);
+    for (const auto& kResult: kResults) {
+      num_found += std::count_if(kExpected.begin(), kExpected.end(),
+        [&kResult](const ScoredIndex<float>& kExpectedResult) {return kExpectedResult.first==kResult.first;});
+    }
+  }
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[query], kNumResults, kNumCandidates, kLoadHistogram));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+  state.counters["recall_at_10"] = num_found/static_cast<double>(kNumRecallQueries*kNumResults);
+  state.counters["memory_bytes"] = kIndex.MemoryBytes();
+  state.counters["float_memory_bytes"] = kHistograms.size()*kIndex.NumBins()*sizeof(float);
+}
+
+
+/*
+ * Normalized histograms of images showing one of a few scenes, i.e. the words of the
+ * scene plus some random words. Product quantization relies on such structure,
+ * unlike the uniform histograms above.
+ */
+std::vector<Histogram<float>> MakeBenchmarkSceneHistograms
+  (const size_t kNumHistograms, const size_t kNumBins)
+{
+  const size_t kNumScenes = 100;
+  const size_t kNumWordsPerImage = 100;
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<size_t> word(0, kNumBins-1);
+  std::uniform_int_distribution<size_t> scene(0, kNumScenes-1);
+  std::vector<std::vector<size_t>> scene_words(kNumScenes, std::vector<size_t>(kNumWordsPerImage));
+  for (auto& words: scene_words) {
+    for (auto& scene_word: words) {scene_word = word(engine);}
+  }
+
+  std::vector<Histogram<float>> histograms(kNumHistograms, Histogram<float>(kNumBins, 0.0f));
+  for (auto& histogram: histograms) {
+    for (const auto kWord: scene_words[scene(engine)]) {histogram[kWord] += 1.0f;}
+    for (size_t count = 0; count<kNumWordsPerImage; count++) {histogram[word(engine)] += 1.0f;}
+    float norm = 0.0f;
+    for (const auto kBin: histogram) {norm += kBin*kBin;}
+    for (auto& bin: histogram) {bin /= std::sqrt(norm);}
+  }
+  return histograms;
+}
+
+
+/*
+ * Product quantized codes scored by the 8 bit table scan, then re-scored with the float
+ * table. Arguments are the number of histograms, the number of bins, the code size in
+ * bytes and the number of candidates. Reports recall_at_10 against the exact top results
+ * and the memory used by the codes and the float histograms.
+ */
+static void BM_ProductQuantizedIndexTopK(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkSceneHistograms(state.range(0), state.range(1));
+  const size_t kNumCandidates = state.range(3);
+  const std::vector<Histogram<float>> kTrainingHistograms
+    (kHistograms.begin(), kHistograms.begin()+std::min<size_t>(kHistograms.size(), 5000));
+  ProductQuantizedIndex index(ProductQuantizer::Train(kTrainingHistograms, 2*state.range(2), 10, 0));
+  for (const auto& kHistogram: kHistograms) {index.Add(kHistogram);}
+
+  const SimilarityIndex<float> kExactIndex(kHistograms);
+  const size_t kNumRecallQueries = 100;
+  size_t num_found = 0;
+  for (size_t query = 0; query<kNumRecallQueries; query++) {
+    const auto kExpected = kExactIndex.TopK(kHistograms[query], kNumResults);
+    const auto kResults = index.TopK(kHistograms[query], kNumResults, kNumCandidates);
+    for (const auto& kResult: kResults) {
+      num_found += std::count_if(kExpected.begin(), kExpected.end(),
+        [&kResult](const ScoredIndex<float>& kExpectedResult) {return kExpectedResult.first==kResult.first;});
+    }
+  }
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(index.TopK(kHistograms[query], kNumResults, kNumCandidates));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+  state.counters["recall_at_10"] = num_found/static_cast<double>(kNumRecallQueries*kNumResults);
+  state.counters["memory_bytes"] = index.MemoryBytes();
+  state.counters["float_memory_bytes"] = kHistograms.size()*state.range(1)*sizeof(float);
+}
+
+
+/*
+ * Exact scores of the scene histograms for comparison with BM_ProductQuantizedIndexTopK.
+ */
+static void BM_SimilarityIndexTopKScenes(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkSceneHistograms(state.range(0), state.range(1));
+  const SimilarityIndex<float> kIndex(kHistograms, 1);
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(kIndex.TopK(kHistograms[query], kNumResults));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations()*kHistograms.size());
+}
+
+
+/*
+ * Graph search over normalized image vectors. Arguments are the number of histograms,
+ * the number of bins and the size of the candidate list (efSearch). Reports recall_at_10
+ * against the exact top results, compare the time with BM_SimilarityIndexTopKScenes.
+ */
+static void BM_HnswImageIndexTopK(benchmark::State& state) {
+  const auto kHistograms = MakeBenchmarkSceneHistograms(state.range(0), state.range(1));
+  const size_t kEfSearch = state.range(2);
+  // Built once for all candidate list sizes
+  static std::unique_ptr<const HnswIndex<Histogram<float>>> index;
+  if (!index || index->Size()!=kHistograms.size() || index->Point(0).size()!=kHistograms[0].size()) {
+    index = std::make_unique<const HnswIndex<Histogram<float>>>(kHistograms, 16, 100, 50, 0);
+  }
+
+  const SimilarityIndex<float> kExactIndex(kHistograms);
+  const size_t kNumRecallQueries = 100;
+  size_t num_found = 0;
+  for (size_t query = 0; query<kNumRecallQueries; query++) {
+    const auto kExpected = kExactIndex.TopK(kHistograms[query], kNumResults);
+    for (const auto kResult: index->NearestNeighbors(kHistograms[query], kNumResults, kEfSearch)) {
+      num_found += std::count_if(kExpected.begin(), kExpected.end(),
+        [kResult](const ScoredIndex<float>& kExpectedResult) {return kExpectedResult.first==kResult;});
+    }
+  }
+
+  size_t query = 0;
+  for(auto _: state) {
+    benchmark::DoNotOptimize(index->NearestNeighbors(kHistograms[query], kNumResults, kEfSearch));
+    query = (query+1)%kHistograms.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["recall_at_10"] = num_found/static_cast<double>(kNumRecallQueries*kNumResults);
+}
+
+
+/*
+ * VLAD encoding of the descriptors of one image. Arguments are the number of clusters,
+ * the number of descriptors (128 dimensions) and the number of main components (0 for
+ * none). The resulting vectors are searched like histograms, see BM_SimilarityIndexTopK
+ * with 256 bins.
+ */
+static void BM_VladEncode(benchmark::State& state) {
+  const size_t kDescriptorDimension = 128;
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  const auto MakeDescriptors = [&engine, &uniform](const size_t kNumDescriptors) {
+    std::vector<FeaturePoint<float>> descriptors(kNumDescriptors, FeaturePoint<float>(kDescriptorDimension));
+    for (auto& descriptor: descriptors) {
+      for (auto& value: descriptor) {value = uniform(engine);}
+    }
+    return descriptors;
+  };
+
+  VladEncoder encoder(MakeDescriptors(state.range(0)));
+  const auto kDescriptors = MakeDescriptors(state.range(1));
+  if (state.range(2)>0) {
+    std::vector<std::vector<float>> training_vectors;
+    for (int image = 0; image<2*state.range(2); image++) {training_vectors.emplace_back(encoder.EncodeRaw(MakeDescriptors(50)));}
+    encoder.TrainPca(training_vectors, state.range(2));
+  }
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(encoder.Encode(kDescriptors));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kDescriptors.size());
+  state.counters["dimension"] = encoder.Dimension();
+}
+
+
+/*
+ * Ordering of given scores, argument is the number of scores.
+ */
+std::vector<float> MakeBenchmarkScores(const size_t kNumScores) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<float> scores(kNumScores);
+  for (auto& score: scores) {score = uniform(engine);}
+  return scores;
+}
+
+
+static void BM_RankFullSort(benchmark::State& state) {
+  const auto kScores = MakeBenchmarkScores(state.range(0));
+
+  for(auto _: state) {
+    std::vector<size_t> indices(kScores.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::sort(indices.begin(), indices.end(),
+      [&kScores](const size_t kIndex1, const size_t kIndex2) {return kScores[kIndex1]>kScores[kIndex2];});
+    benchmark::DoNotOptimize(indices.data());
+  }
+
+  state.SetItemsProcessed(state.iterations()*kScores.size());
+}
+
+
+static void BM_RankTopAndBottom(benchmark::State& state) {
+  const auto kScores = MakeBenchmarkScores(state.range(0));
+
+  for(auto _: state) {
+    benchmark::DoNotOptimize(RankScores(kScores, kNumResults, kNumResults));
+  }
+
+  state.SetItemsProcessed(state.iterations()*kScores.size());
+}
+
+BENCHMARK(BM_ComputeSimilarities)->Args({1000, 1000})->Args({10000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimilarityIndexSingleThreaded)->Args({1000, 1000})->Args({10000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimilarityIndex)->Args({1000, 1000})->Args({10000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimilarityIndexTopK)->Args({1000, 1000})->Args({10000, 1000})->Args({2000, 20000})->Args({100000, 256})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QuantizedSimilarityIndexTopK)->Args({10000, 1000, 10})->Args({10000, 1000, 50})
+  ->Args({10000, 1000, 200})->Args({10000, 1000, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimilarityIndexTopKScenes)->Args({20000, 1000})->Args({20000, 256})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HnswImageIndexTopK)->Args({20000, 256, 10})->Args({20000, 256, 50})->Args({20000, 256, 200})
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ProductQuantizedIndexTopK)->Args({20000, 1000, 16, 100})->Args({20000, 1000, 64, 10})
+  ->Args({20000, 1000, 64, 100})->Args({20000, 1000, 64, 1000})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_VladEncode)->Args({64, 1000, 0})->Args({256, 1000, 0})->Args({64, 1000, 256})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimilarityIndexSparseLargeVocabulary)->Args({2000, 20000, 200})->Args({2000, 100000, 200})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RankFullSort)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RankTopAndBottom)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+} // namespace igg
+
+BENCHMARK_MAIN();
@@ -48,7 +48,7 @@ std::vector<FeaturePoint<T>> MakeClusteringTestData
 }
 
 
-std::vector<FeaturePoint<float>> MakeClusteringTestData
+inline std::vector<FeaturePoint<float>> MakeClusteringTestData
   (std::mt19937& engine,
    const size_t kNumFeatures = 2,
    const size_t kNumClusters = 5,
@@ -1,14 +1,57 @@
 #include <gtest/gtest.h>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 
 #include "bag_of_words.hpp"
 #include "clustering/clustering_strategy_kmeans.hpp"
+#include "features/features.hpp"
 
 #include "make_test_dataset.hpp"
 
 
 namespace igg {
 
+namespace {
+
+// K-means with an additional centroid far from all features, i.e. an empty cluster
+class KmeansWithEmptyCluster: public ClusteringStrategyKmeans<float> {
+public:
+  using ClusteringStrategyKmeans<float>::ClusteringStrategyKmeans;
+
+  std::vector<FeaturePoint<float>> ClusterCentroids
+    (const std::vector<FeaturePoint<float>>& kPointSet) const override
+  {
+    auto centroids = ClusteringStrategyKmeans<float>::ClusterCentroids(kPointSet);
+    centroids.emplace_back(centroids[0].size(), 1e6f);
+    return centroids;
+  }
+};
+
+} // namespace
+
+
+TEST(BagOfWordsTest, EmptyCluster) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const size_t kNumClusters = 10;
+  const KmeansWithEmptyCluster kStrategy(kNumClusters, 25, 1e-3f, 0, false);
+  kBagOfWords.CreateDictionary(kStrategy, true);
+
+  // The word of no image is weighted zero instead of infinity, so no histogram is NaN
+  const auto kWeights = kDataset->LoadHistogramWeights();
+  ASSERT_EQ(kWeights.size(), kNumClusters+1);
+  EXPECT_FLOAT_EQ(kWeights[kNumClusters], 0.0f);
+  for (const auto& kItem: kDataset->Items()) {
+    for (const auto kBin: kItem->LoadHistogram()) {EXPECT_TRUE(std::isfinite(kBin));}
+  }
+  for (const auto kSimilarity: kBagOfWords.Similarities(kDataset->Items()[0])) {
+    EXPECT_TRUE(std::isfinite(kSimilarity));
+  }
+  EXPECT_EQ(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 1)[0].first, 0u);
+}
+
+
 TEST(BagOfWordsTest, BagOfWordsWithTestDataset) {
   const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
   const BagOfWords kBagOfWords(kDataset, false); // False for no terminal output
@@ -44,10 +87,144 @@ TEST(BagOfWordsTest, BagOfWordsWithTestDataset) {
   EXPECT_NO_THROW(kBagOfWords.CreateDictionary(kStrategy, false));
   EXPECT_TRUE(kBagOfWords.DictionaryComplete());
 
+  // Partial ranking agrees with the full order
+  const auto kSimilarities = kBagOfWords.Similarities(kDataset->Items()[0]);
+  const auto kOrdered = kBagOfWords.OrderItemsBySimilarity(kSimilarities);
+  const auto kRanking = kBagOfWords.RankItemsBySimilarity(kSimilarities, 3, 2);
+  ASSERT_EQ(kRanking.top.size(), 3u);
+  ASSERT_EQ(kRanking.bottom.size(), 2u);
+  for (size_t rank = 0; rank<kRanking.top.size(); rank++) {
+    EXPECT_EQ(kDataset->Items()[kRanking.top[rank].first], kOrdered.first[rank]);
+    EXPECT_EQ(kRanking.top[rank].second, kOrdered.second[rank]);
+  }
+  EXPECT_EQ(kDataset->Items()[kRanking.bottom[0].first], kOrdered.first.back());
+  EXPECT_THROW(kBagOfWords.RankItemsBySimilarity({1.0f}, 3, 2), std::invalid_argument);
+
+  // Query modes agree up to the quantization of the inverted index
+  const auto kExhaustive = kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kExhaustive);
+  ASSERT_EQ(kExhaustive.size(), 3u);
+  EXPECT_EQ(kExhaustive[0].first, kRanking.top[0].first);
+
+  EXPECT_THROW(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kPruned), DictionaryIncomplete);
+  EXPECT_NO_THROW(kBagOfWords.BuildInvertedIndex());
+  const auto kPruned = kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kPruned);
+  ASSERT_EQ(kPruned.size(), 3u);
+  for (size_t rank = 0; rank<kPruned.size(); rank++) {
+    EXPECT_NEAR(kPruned[rank].second, kExhaustive[rank].second, 0.01f);
+  }
+
+  // The snapshot for concurrent queries scores the features of an image like the image
+  const auto kEngine = kBagOfWords.LoadQueryEngine();
+  EXPECT_EQ(kEngine->Size(), kDataset->Items().size());
+  const auto kFromEngine = kEngine->MostSimilarItems(FromMat<float>(kDataset->Items()[0]->LoadFeatures()), 3);
+  ASSERT_EQ(kFromEngine.size(), 3u);
+  for (size_t rank = 0; rank<kFromEngine.size(); rank++) {
+    EXPECT_NEAR(kFromEngine[rank].second, kExhaustive[rank].second, 1e-5f);
+  }
+
+  // Re-ranking all images is exact
+  const auto kQuantized = kBagOfWords.MostSimilarItems
+    (kDataset->Items()[0], 3, QueryMode::kQuantized, kDataset->Items().size());
+  ASSERT_EQ(kQuantized.size(), 3u);
+  for (size_t rank = 0; rank<kQuantized.size(); rank++) {
+    EXPECT_NEAR(kQuantized[rank].second, kExhaustive[rank].second, 1e-5f);
+  }
+  EXPECT_EQ(QueryModeFromString("quantized"), QueryMode::kQuantized);
+
+  // Product quantization has to be built explicitly, re-ranking all images is exact again
+  EXPECT_THROW(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kProductQuantized), DictionaryIncomplete);
+  EXPECT_NO_THROW(kBagOfWords.BuildProductQuantization(2, 10, kSeed));
+  ASSERT_TRUE(kDataset->HasProductQuantization());
+  EXPECT_EQ(kDataset->LoadProductQuantization().Size(), kDataset->Items().size());
+  const auto kProductQuantized = kBagOfWords.MostSimilarItems
+    (kDataset->Items()[0], 3, QueryMode::kProductQuantized, kDataset->Items().size());
+  ASSERT_EQ(kProductQuantized.size(), 3u);
+  for (size_t rank = 1; rank<kProductQuantized.size(); rank++) {
+    EXPECT_LE(kProductQuantized[rank].second, kProductQuantized[rank-1].second);
+  }
+  EXPECT_EQ(QueryModeFromString("product-quantized"), QueryMode::kProductQuantized);
+
+  // VLAD vectors from a separate small vocabulary, the query image is the most similar
+  EXPECT_THROW(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kVlad), DictionaryIncomplete);
+  const ClusteringStrategyKmeans<float> kVladStrategy(4, kIterations, kEpsilon, kSeed, false);
+  EXPECT_NO_THROW(kBagOfWords.MakeVladVectors(kVladStrategy, 8, 0, kSeed));
+  ASSERT_TRUE(kDataset->HasVladVectors());
+  EXPECT_EQ(kDataset->LoadVladEncoder().Dimension(), 8u);
+  EXPECT_EQ(kDataset->LoadVladVectors().size(), kDataset->Items().size());
+  const auto kVlad = kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kVlad);
+  ASSERT_EQ(kVlad.size(), 3u);
+  EXPECT_EQ(kVlad[0].first, 0u);
+  EXPECT_NEAR(kVlad[0].second, 1.0f, 1e-5f);
+  EXPECT_EQ(QueryModeFromString("vlad"), QueryMode::kVlad);
+
+  // Graph search with a candidate list of all images agrees with the exhaustive search
+  EXPECT_THROW(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kGraph), DictionaryIncomplete);
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 4, 20, kSeed));
+  ASSERT_TRUE(kDataset->HasHistogramIndex());
+  EXPECT_EQ(kDataset->LoadHistogramIndex().Size(), kDataset->Items().size());
+  const auto kGraph = kBagOfWords.MostSimilarItems
+    (kDataset->Items()[0], 3, QueryMode::kGraph, kDataset->Items().size());
+  ASSERT_EQ(kGraph.size(), 3u);
+  for (size_t rank = 0; rank<kGraph.size(); rank++) {
+    EXPECT_NEAR(kGraph[rank].second, kExhaustive[rank].second, 1e-5f);
+  }
+  // Building again keeps the index, the images did not change
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 4, 20, kSeed));
+  EXPECT_EQ(kDataset->LoadHistogramIndex().Size(), kDataset->Items().size());
+  // Other graph parameters need a new index
+  EXPECT_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 6, 20, kSeed), std::invalid_argument);
+  EXPECT_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 4, 30, kSeed), std::invalid_argument);
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 6, 30, kSeed, true));
+  EXPECT_EQ(kDataset->LoadHistogramIndex().MaxConnections(), 6u);
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 4, 20, kSeed, true));
+  // The images are told by a hash of their filenames, an index over other images is rebuilt
+  const auto kItemsPath = kDataset->HistogramIndexPath()+".items";
+  ASSERT_TRUE(fs::exists(kItemsPath));
+  const auto ReadItems = [&kItemsPath]() {
+    std::ifstream file(kItemsPath, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  };
+  const auto kItems = ReadItems();
+  { std::ofstream(kItemsPath, std::ios::binary) << "other images...."; }
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kHistogram, 4, 20, kSeed));
+  EXPECT_EQ(ReadItems(), kItems);
+  EXPECT_EQ(kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3, QueryMode::kGraph, kDataset->Items().size()), kGraph);
+  EXPECT_NO_THROW(kBagOfWords.BuildImageIndex(ImageEncoding::kVlad, 4, 20, kSeed));
+  const auto kVladGraph = kBagOfWords.MostSimilarItems
+    (kDataset->Items()[0], 3, QueryMode::kVladGraph, kDataset->Items().size());
+  ASSERT_EQ(kVladGraph.size(), 3u);
+  EXPECT_EQ(kVladGraph[0].first, 0u);
+  EXPECT_EQ(QueryModeFromString("graph"), QueryMode::kGraph);
+  EXPECT_EQ(QueryModeFromString("vlad-graph"), QueryMode::kVladGraph);
+  EXPECT_THROW(QueryModeFromString("none"), std::invalid_argument);
+
   // Generate web output
   EXPECT_NO_THROW(kBagOfWords.MakeWebOutput
     (kNumExamples, kNumExamplesSimilar, kNumExamplesDifferent,
      kExampleImageSize, kExampleImageSizeSmall));
+
+  // Stop words are dropped from all histograms and recorded for queries
+  ASSERT_TRUE(kDataset->HasVocabularyPruning());
+  EXPECT_TRUE(kDataset->LoadVocabularyPruning().IsEmpty());
+  EXPECT_NO_THROW(kBagOfWords.MakeHistograms(0.5, 2));
+  const auto kPruning = kDataset->LoadVocabularyPruning();
+  EXPECT_EQ(kPruning.NumWords(), kNumClusters);
+  EXPECT_EQ(kPruning.MaxWordCount(), 2u);
+  const auto kWeights = kDataset->LoadHistogramWeights();
+  const auto kHistogram = kDataset->Items()[0]->LoadHistogram();
+  for (const auto kWord: kPruning.StopWords()) {
+    EXPECT_FLOAT_EQ(kWeights[kWord], 0.0f);
+    EXPECT_FLOAT_EQ(kHistogram[kWord], 0.0f);
+  }
+  // Queries by features are pruned the same way as the stored histograms
+  const auto kByItem = kBagOfWords.MostSimilarItems(kDataset->Items()[0], 3);
+  const auto kByFeatures = kBagOfWords.MostSimilarItems(FromMat<float>(kDataset->Items()[0]->LoadFeatures()), 3);
+  ASSERT_EQ(kByFeatures.size(), kByItem.size());
+  for (size_t rank = 0; rank<kByItem.size(); rank++) {
+    EXPECT_NEAR(kByFeatures[rank].second, kByItem[rank].second, 1e-5f);
+  }
+  EXPECT_FALSE(kDataset->HasInvertedIndex());
+  EXPECT_FALSE(kDataset->HasHistogramIndex());
 }
 
 } // namespace igg
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+
+#include "bag_of_words_vers_2.hpp"
+
+#include "make_test_dataset.hpp"
+
+
+namespace igg {
+
+TEST(BagOfWordsVers2Test, SearchItemAndDescriptors) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  vers_2::bagofwords bag_of_words(kDataset, 25, 1e-3, 10, false);
+  bag_of_words.CreateDictionary(0, "kmeans");
+
+  // An image of the dataset is the most similar to itself, queried by index or by its descriptors
+  const auto kItems = kDataset->Items();
+  const size_t kNumResults = 3;
+  for (const size_t kIndex: {size_t(0), kItems.size()/2, kItems.size()-1}) {
+    const auto kFromItem = bag_of_words.SearchItem(kIndex, kNumResults);
+    ASSERT_EQ(kFromItem.size(), kNumResults);
+    EXPECT_EQ(kFromItem[0], kItems[kIndex]);
+
+    const auto kFromDescriptors = bag_of_words.SearchDescriptors(kItems[kIndex]->LoadFeatures(), kNumResults);
+    ASSERT_EQ(kFromDescriptors.size(), kNumResults);
+    EXPECT_EQ(kFromDescriptors[0], kItems[kIndex]);
+
+    const auto kFromFile = bag_of_words.SearchFeaturesFile(kItems[kIndex]->FeaturesBinaryPath(), kNumResults);
+    ASSERT_EQ(kFromFile.size(), kNumResults);
+    EXPECT_EQ(kFromFile, kFromDescriptors);
+  }
+
+  // Descriptors which do not match the words
+  const auto kFeatures = kItems[0]->LoadFeatures();
+  EXPECT_THROW(bag_of_words.SearchDescriptors(cv::Mat(2, kFeatures.cols+1, CV_32FC1), kNumResults), std::invalid_argument);
+  EXPECT_THROW(bag_of_words.SearchDescriptors(cv::Mat(2, kFeatures.cols, CV_64FC1), kNumResults), std::invalid_argument);
+  EXPECT_THROW(bag_of_words.SearchItem(kItems.size(), kNumResults), std::invalid_argument);
+}
+
+
+TEST(BagOfWordsVers2Test, RecomputeAfterQuery) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  vers_2::bagofwords bag_of_words(kDataset, 25, 1e-3, 10, false);
+  bag_of_words.CreateDictionary(0, "kmeans");
+
+  const auto kItems = kDataset->Items();
+  const size_t kNumResults = 3;
+  const auto kImage = kItems[1]->LoadImage();
+  const auto kBefore = bag_of_words.SearchImage(kImage, kNumResults);
+  EXPECT_EQ(bag_of_words.SearchImage(kImage, kNumResults), kBefore);
+  EXPECT_EQ(bag_of_words.GetQueryCache().Hits(), 1u);
+  EXPECT_EQ(bag_of_words.SearchItem(1, kNumResults)[0], kItems[1]);
+
+  // Histograms computed again replace the loaded ones, one row per item
+  bag_of_words.SaveHistogramImageDataset();
+  EXPECT_EQ(bag_of_words.CompareHistogram(std::vector<float>(10, 1.0f)).size(), kItems.size());
+  for (size_t index = 0; index<kItems.size(); index++) {
+    const auto kFromItem = bag_of_words.SearchItem(index, kItems.size());
+    ASSERT_EQ(kFromItem.size(), kItems.size());
+    EXPECT_EQ(kFromItem[0], kItems[index]);
+  }
+
+  // The cached query is out of date and answered again, with the same histograms
+  const auto kMisses = bag_of_words.GetQueryCache().Misses();
+  EXPECT_EQ(bag_of_words.SearchImage(kImage, kNumResults), kBefore);
+  EXPECT_EQ(bag_of_words.GetQueryCache().Hits(), 1u);
+  EXPECT_EQ(bag_of_words.GetQueryCache().Misses(), kMisses+1);
+}
+
+
+TEST(BagOfWordsVers2Test, SearchImageWithBudget) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  vers_2::bagofwords bag_of_words(kDataset, 25, 1e-3, 10, false);
+  bag_of_words.CreateDictionary(0, "kmeans");
+
+  const auto kItems = kDataset->Items();
+  const size_t kNumResults = 3;
+  const auto kImage = kItems[1]->LoadImage();
+
+  // Answered in full with plenty of time
+  vers_2::SearchBudget generous_budget;
+  generous_budget.deadline = std::chrono::seconds(60);
+  const auto kFull = bag_of_words.SearchImage(kImage, kNumResults, generous_budget);
+  EXPECT_TRUE(kFull.degradations.empty());
+  EXPECT_FALSE(kFull.downscaled || kFull.keypoints_capped || kFull.search_effort_reduced || kFull.postings_truncated);
+  ASSERT_EQ(kFull.items.size(), kNumResults);
+  EXPECT_EQ(kFull.items[0], kItems[1]);
+
+  // Simplified as far as possible without time, each step reported. The image is large
+  // enough to be downscaled.
+  cv::Mat large_image;
+  cv::repeat(kImage, 4, 4, large_image);
+  vers_2::SearchBudget tiny_budget;
+  tiny_budget.deadline = std::chrono::microseconds(1);
+  tiny_budget.max_image_side = 1;
+  const auto kReduced = bag_of_words.SearchImage(large_image, kNumResults, tiny_budget);
+  EXPECT_TRUE(kReduced.downscaled);
+  EXPECT_TRUE(kReduced.keypoints_capped);
+  EXPECT_FALSE(kReduced.degradations.empty());
+  EXPECT_EQ(kReduced.degradations.size(),
+    static_cast<size_t>(kReduced.downscaled+kReduced.keypoints_capped+kReduced.search_effort_reduced+kReduced.postings_truncated));
+}
+
+} // namespace igg
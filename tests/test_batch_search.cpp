@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bag_of_words.hpp"
+#include "batch_search/batch_search.hpp"
+#include "clustering/clustering_strategy_kmeans.hpp"
+
+#include "get_tests_data_path.hpp"
+#include "make_test_dataset.hpp"
+
+
+namespace igg {
+
+namespace {
+
+std::vector<std::string> Lines(const std::string& kText) {
+  std::istringstream stream(kText);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(stream, line)) {lines.push_back(line);}
+  return lines;
+}
+
+} // namespace
+
+
+TEST(BatchSearchTest, SearchQueryList) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const ClusteringStrategyKmeans<float> kStrategy(10, 25, 1e-3f, 0, false);
+  kBagOfWords.CreateDictionary(kStrategy, false);
+  const auto kItems = kDataset->Items();
+
+  // The images of the dataset in a list, and one which does not exist
+  const auto kListPath = (GetTestsOutputPath()/"batch_search_queries.txt").string();
+  {
+    std::ofstream list(kListPath);
+    list << kItems[0]->ImagePath() << "\n" << kItems[1]->ImagePath() << "\r\n\n" << "missing.png\n";
+  }
+  const auto kQueryPaths = ListQueryImages(kListPath);
+  ASSERT_EQ(kQueryPaths.size(), 3u);
+  EXPECT_EQ(kQueryPaths[1], kItems[1]->ImagePath());
+  EXPECT_EQ(ListQueryImages((GetTestsOutputPath()/"test_dataset").string()).size(), kItems.size());
+  EXPECT_THROW(ListQueryImages((GetTestsOutputPath()/"missing.txt").string()), std::runtime_error);
+
+  // Chunks smaller than the list, results as if queried one by one
+  const BatchSearch kSearch(kBagOfWords.LoadQueryEngine(), 3, 2, 2);
+  std::ostringstream csv;
+  const auto kStats = kSearch.Run(kQueryPaths, csv, ResultFormat::kCsv);
+  EXPECT_EQ(kStats.num_queries, 3u);
+  EXPECT_EQ(kStats.num_failed, 1u);
+  EXPECT_GT(kStats.num_features, 0u);
+
+  const auto kLines = Lines(csv.str());
+  ASSERT_EQ(kLines.size(), 1u+2*3);
+  EXPECT_EQ(kLines[0], "query,rank,index,similarity,image_path");
+  const auto kExpected = kBagOfWords.MostSimilarItems(kItems[1], 3);
+  const auto kPrefix = kItems[1]->ImagePath()+",1,"+std::to_string(kExpected[0].first)+",";
+  EXPECT_EQ(kLines[4].substr(0, kPrefix.size()), kPrefix);
+
+  std::ostringstream json_lines;
+  kSearch.Run(kQueryPaths, json_lines, ResultFormat::kJsonLines);
+  const auto kJsonLines = Lines(json_lines.str());
+  ASSERT_EQ(kJsonLines.size(), 3u);
+  EXPECT_NE(kJsonLines[0].find("\"results\": [{\"rank\": 1"), std::string::npos);
+  EXPECT_EQ(kJsonLines[2], "{\"query\": \"missing.png\", \"error\": \"Cannot read image missing.png.\"}");
+
+  EXPECT_EQ(ResultFormatFromString("jsonl"), ResultFormat::kJsonLines);
+  EXPECT_THROW(ResultFormatFromString("xml"), std::invalid_argument);
+  EXPECT_THROW(BatchSearch(kBagOfWords.LoadQueryEngine(), 3, 0), std::invalid_argument);
+}
+
+} // namespace igg
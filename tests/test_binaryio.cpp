@@ -6,6 +6,11 @@
 #include <array>
 
 #include "binaryio/binaryio.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "binaryio/feature_file_stream.hpp"
+#include "clustering/clustering_strategy_kmeans.hpp"
+#include "clustering/clustering_strategy_kmeans_streaming.hpp"
+#include "tools/sampling.hpp"
 
 #include "get_tests_data_path.hpp"
 
@@ -109,6 +114,116 @@ TEST(BinaryioTest, WriteReadCentroids) {
 }
 
 
+TEST(BinaryioTest, WriteReadHistograms) {
+  Histogram<float> sparse_histogram(1000, 0.0f);
+  sparse_histogram[3] = 1.5f;
+  sparse_histogram[999] = 0.25f;
+  const Histogram<float> kDenseHistogram{1.0f, 0.0f, 2.0f, 3.0f};
+
+  const auto kSparsePath = GetTestsOutputPath()/"test_sparse_histogram.binary";
+  const auto kDensePath = GetTestsOutputPath()/"test_dense_histogram.binary";
+  if (fs::exists(kSparsePath)) {fs::remove(kSparsePath);}
+  if (fs::exists(kDensePath)) {fs::remove(kDensePath);}
+
+  // The smaller encoding is chosen
+  ASSERT_TRUE(WriteHistogramToBinary(kSparsePath.string(), sparse_histogram));
+  ASSERT_TRUE(WriteHistogramToBinary(kDensePath.string(), kDenseHistogram));
+  EXPECT_TRUE(IsSparseHistogramBinary(kSparsePath.string()));
+  EXPECT_FALSE(IsSparseHistogramBinary(kDensePath.string()));
+  EXPECT_LT(FileSize(kSparsePath.string()), 100);
+
+  // Both can be read either way
+  EXPECT_EQ(ReadHistogramFromBinary<float>(kSparsePath.string()), sparse_histogram);
+  EXPECT_EQ(ReadHistogramFromBinary<float>(kDensePath.string()), kDenseHistogram);
+
+  const auto kSparse = ReadSparseHistogramFromBinary<float>(kSparsePath.string());
+  EXPECT_EQ(kSparse.NumBins(), 1000u);
+  EXPECT_EQ(kSparse.Bins(), std::vector<uint32_t>({3, 999}));
+  EXPECT_EQ(ReadSparseHistogramFromBinary<float>(kDensePath.string()).NumNonZeros(), 3u);
+
+  EXPECT_THROW(ReadHistogramFromBinary<float>("does_not_exist.binary"), std::runtime_error);
+
+  // Writing to a full device fails in either encoding
+  if (fs::exists("/dev/full")) {
+    EXPECT_FALSE(WriteSparseHistogramToBinary("/dev/full", kSparse));
+    EXPECT_FALSE(WriteHistogramToBinary("/dev/full", kDenseHistogram));
+  }
+}
+
+
+TEST(BinaryioTest, WriteReadHnswIndex) {
+  const std::vector<FeaturePoint<float>> kPointSet
+    {{1.3f, 2.0f, 3.0f}, {2.0f, 4.6f, 5.0f}, {3.0f, -3.0f, 1.9f},
+     {5.0f, 8.0f, -3.1f}, {0.1f, 0.2f, 0.3f}, {-4.0f, 1.0f, 2.5f}};
+
+  const HnswIndex<FeaturePoint<float>> kIndex(kPointSet, 2, 10, 5, 0);
+
+  const auto kBinaryPath = GetTestsOutputPath()/"test_hnsw_index.binary";
+  if (fs::exists(kBinaryPath)) {fs::remove(kBinaryPath);}
+
+  EXPECT_TRUE(kIndex.WriteToBinary(kBinaryPath.string()));
+
+  const auto kIndexFromBinary = HnswIndex<FeaturePoint<float>>::ReadFromBinary(kBinaryPath.string());
+
+  EXPECT_EQ(kIndexFromBinary.Size(), kPointSet.size());
+  EXPECT_EQ(kIndexFromBinary.MaxConnections(), static_cast<size_t>(2));
+  EXPECT_EQ(kIndexFromBinary.EfSearch(), static_cast<size_t>(5));
+  EXPECT_FLOAT_EQ(kIndexFromBinary.Point(3)[2], -3.1f);
+
+  // Both should give the same search results
+  const FeaturePoint<float> kQueryPoint{2.9f, -2.0f, 2.0f};
+  EXPECT_EQ(kIndexFromBinary.NearestNeighbor(kQueryPoint), kIndex.NearestNeighbor(kQueryPoint));
+  EXPECT_EQ(kIndexFromBinary.NearestNeighbor(kQueryPoint), static_cast<size_t>(2));
+}
+
+
+TEST(BinaryioTest, StreamFeatureFiles) {
+  std::mt19937 engine(0);
+
+  // Write features of several images, including one without any features
+  const std::vector<size_t> kNumFeaturesPerFile {7, 0, 12, 3, 20};
+  std::vector<std::string> paths;
+  std::vector<FeaturePoint<float>> all_features;
+  for (size_t file_index = 0; file_index<kNumFeaturesPerFile.size(); file_index++) {
+    const auto kFeatures = SampleVectorsFromUniformDistribution<float>
+      (kNumFeaturesPerFile[file_index], 4, -10.0f, 10.0f, engine);
+    all_features.insert(all_features.end(), kFeatures.begin(), kFeatures.end());
+
+    const auto kPath = GetTestsOutputPath()/("stream_features_"+std::to_string(file_index)+".binary");
+    const auto kMat = kFeatures.empty() ? cv::Mat(0, 4, CV_32F) : ToMat<float>(kFeatures);
+    ASSERT_TRUE(WriteMatToBinary(kPath.string(), kMat));
+    paths.emplace_back(kPath.string());
+  }
+
+  // Chunks consist of whole files, features are provided in order
+  const size_t kChunkSize = 10;
+  FeatureFileStream stream(paths, kChunkSize);
+  ASSERT_EQ(stream.Size(), all_features.size());
+
+  for (size_t pass = 0; pass<2; pass++) {
+    stream.Rewind();
+    std::vector<size_t> chunk_sizes;
+    size_t index = 0;
+    for (auto chunk = stream.NextChunk(); !chunk.empty(); chunk = stream.NextChunk()) {
+      chunk_sizes.emplace_back(chunk.size());
+      for (const auto kFeature: chunk) {
+        ASSERT_LT(index, all_features.size());
+        EXPECT_EQ(*kFeature, all_features[index]);
+        index++;
+      }
+    }
+    EXPECT_EQ(index, all_features.size());
+    EXPECT_EQ(chunk_sizes, (std::vector<size_t>{19, 23}));
+  }
+
+  // Streaming K-means gives the same result as in memory
+  const ClusteringStrategyKmeans<float> kKmeans(4, 10, 1e-3f, 0, false);
+  const ClusteringStrategyKmeansStreaming<float> kKmeansStreaming(4, 10, 1e-3f, 0, false);
+  EXPECT_EQ(kKmeansStreaming.ClusterCentroidsFromStream(stream), kKmeans.ClusterCentroids(all_features));
+  EXPECT_EQ(kKmeans.ClusterCentroidsFromStream(stream), kKmeans.ClusterCentroids(all_features));
+}
+
+
 TEST(BinaryioTest, FileExist) {
   const auto kImagePath = GetTestsDataPath()/"lenna.png";
   EXPECT_EQ(FileExists(kImagePath.string()), true);
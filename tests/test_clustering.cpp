@@ -6,6 +6,7 @@
 #include <type_traits>
 #include <typeinfo>
 #include <stdexcept>
+#include <set>
 #include <boost/filesystem.hpp>
 
 #include "clustering/feature_point.hpp"
@@ -13,9 +14,15 @@
 #include "clustering/clustering_strategy_kmeans_vers_2.hpp"
 #include "clustering/clustering_strategy_kmeans_opencv.hpp"
 #include "clustering/clustering_strategy_kmeans_with_index.hpp"
+#include "clustering/clustering_strategy_kmeans_with_hnsw.hpp"
+#include "clustering/clustering_strategy_kmeans_streaming.hpp"
+#include "clustering/training_set.hpp"
 #include "tools/sampling.hpp"
 #include "tools/terminalout.hpp"
 #include "clustering/kmeans_with_index/index.hpp"
+#include "clustering/hnsw_index/hnsw_index.hpp"
+#include "clustering/seeding.hpp"
+#include "clustering/kmeans_vers_2/kmeans.hpp"
 
 #include "make_clustering_test_data.hpp"
 
@@ -247,5 +254,242 @@ TEST(ClusteringTest, KmeansWithIndex) {
 }
 
 
-} // namespace igg
+TEST(ClusteringTest, BuildHnswIndexAndSearch) {
+  // Use a certain seed to get reproduceable results
+  const int kSeed = 0;
+
+  // Test data, this time with some more dimensions
+  const size_t kNumFeatures = 32;
+  const size_t kNumClusters = 16;
+  const float kMinValue = -10.0f;
+  const float kMaxValue = 10.0f;
+  const float kMinStd = 0.5f;
+  const float kMaxStd = 0.5f;
+  const size_t kMinNumSamplesPerCluster = 64;
+  const size_t kMaxNumSamplesPerCluster = 64;
+
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData
+    (engine,
+     kNumFeatures,
+     kNumClusters,
+     kMinValue,
+     kMaxValue,
+     kMinStd,
+     kMaxStd,
+     kMinNumSamplesPerCluster,
+     kMaxNumSamplesPerCluster);
+
+  const size_t kMaxConnections = 16;
+  const size_t kEfConstruction = 100;
+  const size_t kEfSearch = 50;
+
+  const HnswIndex<FeaturePoint<float>> kIndex
+    (kPointSet, kMaxConnections, kEfConstruction, kEfSearch, kSeed);
+  EXPECT_EQ(kIndex.Size(), kPointSet.size());
+
+  // Indexed points should be found exactly
+  EXPECT_EQ(kIndex.NearestNeighbor(kPointSet[512]), static_cast<size_t>(512));
+
+  // Compare with brute force search for some unseen points
+  const auto kQueryPointSet = MakeClusteringTestData
+    (engine, kNumFeatures, kNumClusters, kMinValue, kMaxValue, kMinStd, kMaxStd, 4, 4);
+
+  size_t num_correct = 0;
+  for (const auto& kQueryPoint: kQueryPointSet) {
+    if (kIndex.NearestNeighbor(kQueryPoint)==NearestNeighbor(kQueryPoint, kPointSet))
+      {num_correct++;}
+  }
+  EXPECT_GE(static_cast<float>(num_correct)/kQueryPointSet.size(), 0.9f);
+
+  // Neighbors are ordered by distance
+  const auto kNeighbors = kIndex.NearestNeighbors(kQueryPointSet[0], 5);
+  ASSERT_EQ(kNeighbors.size(), static_cast<size_t>(5));
+  for (size_t index = 1; index<kNeighbors.size(); index++) {
+    EXPECT_LE
+      (SquaredL2Norm(Difference(kQueryPointSet[0], kPointSet[kNeighbors[index-1]])),
+       SquaredL2Norm(Difference(kQueryPointSet[0], kPointSet[kNeighbors[index]])));
+  }
+
+  // A candidate list as large as the index finds the exact neighbors
+  const auto kExhaustive = kIndex.NearestNeighbors(kQueryPointSet[0], 5, kPointSet.size());
+  ASSERT_EQ(kExhaustive.size(), static_cast<size_t>(5));
+  EXPECT_EQ(kExhaustive[0], NearestNeighbor(kQueryPointSet[0], kPointSet));
+  EXPECT_EQ(kIndex.EfSearch(), kEfSearch);
+}
+
+
+TEST(ClusteringTest, KmeansWithHnsw) {
+  // Use a certain seed to get reproduceable results
+  const int kSeed = 0;
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData(engine);
+
+  const int kNumIterations = 10;
+  const float kEpsilon = 1e-3f;
+  const size_t kNumClusters = 5;
+  const size_t kMaxConnections = 4;
+  const size_t kEfConstruction = 20;
+  const size_t kEfSearch = 10;
+  const bool kVerbose = false;
+
+  ClusteringStrategyKmeansWithHnsw<float> kmeans
+    (kNumClusters, kNumIterations, kEpsilon, kMaxConnections, kEfConstruction, kEfSearch, kSeed, kVerbose);
+
+  std::vector<FeaturePoint<float>> centroids;
+  EXPECT_NO_THROW(centroids = kmeans.ClusterCentroids(kPointSet));
+  EXPECT_EQ(centroids.size(), kNumClusters);
+}
+
+
+TEST(ClusteringTest, SeedingKmeansPlusPlus) {
+  std::mt19937 engine(0);
+  const auto kPointSet = MakeClusteringTestData(engine);
+  const size_t kNumClusters = 5;
+
+  const auto kIndices = SampleCentroidIndicesKmeansPlusPlus(kPointSet, kNumClusters, engine);
+  ASSERT_EQ(kIndices.size(), kNumClusters);
+  EXPECT_EQ(std::set<size_t>(kIndices.begin(), kIndices.end()).size(), kNumClusters);
+  for (const auto kIndex: kIndices) {EXPECT_LT(kIndex, kPointSet.size());}
+
+  // Points with zero weight are never selected
+  std::vector<double> weights(kPointSet.size(), 0.0);
+  for (size_t index = 0; index<10; index++) {weights[index] = 1.0;}
+  for (const auto kIndex: SampleCentroidIndicesKmeansPlusPlus(kPointSet, kNumClusters, engine, weights))
+    {EXPECT_LT(kIndex, static_cast<size_t>(10));}
+
+  // Duplicate points still give different indices
+  const std::vector<FeaturePoint<float>> kDuplicates(8, FeaturePoint<float>{1.0f, 2.0f});
+  const auto kDuplicateIndices = SampleCentroidIndicesKmeansPlusPlus(kDuplicates, 8, engine);
+  EXPECT_EQ(std::set<size_t>(kDuplicateIndices.begin(), kDuplicateIndices.end()).size(), static_cast<size_t>(8));
 
+  EXPECT_THROW(SampleCentroidIndicesKmeansPlusPlus(kDuplicates, 9, engine), std::invalid_argument);
+}
+
+
+TEST(ClusteringTest, SeedingKmeansParallel) {
+  std::mt19937 engine(0);
+  const auto kPointSet = MakeClusteringTestData(engine);
+
+  for (const size_t kNumClusters: {static_cast<size_t>(1), static_cast<size_t>(5), kPointSet.size()}) {
+    const auto kIndices = SampleCentroidIndicesKmeansParallel(kPointSet, kNumClusters, engine);
+    ASSERT_EQ(kIndices.size(), kNumClusters);
+    EXPECT_EQ(std::set<size_t>(kIndices.begin(), kIndices.end()).size(), kNumClusters);
+  }
+
+  EXPECT_EQ(SeedingMethodFromString("kmeans||"), SeedingMethod::kKmeansParallel);
+  EXPECT_THROW(SeedingMethodFromString("unknown"), std::invalid_argument);
+}
+
+
+TEST(ClusteringTest, KmeansWithSeeding) {
+  const int kSeed = 0;
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData(engine);
+
+  const int kNumIterations = 10;
+  const float kEpsilon = 1e-3f;
+  const size_t kNumClusters = 5;
+  const bool kVerbose = false;
+
+  for (const auto kSeeding: {SeedingMethod::kKmeansPlusPlus, SeedingMethod::kKmeansParallel}) {
+    ClusteringStrategyKmeans<float> kmeans
+      (kNumClusters, kNumIterations, kEpsilon, kSeed, kVerbose, kSeeding);
+    EXPECT_EQ(kmeans.ClusterCentroids(kPointSet).size(), kNumClusters);
+
+    ClusteringStrategyKmeansVers2<float> kmeans_vers_2
+      (kNumClusters, kNumIterations, kVerbose, kSeeding);
+    EXPECT_EQ(kmeans_vers_2.ClusterCentroids(kPointSet).size(), kNumClusters);
+  }
+}
+
+
+TEST(ClusteringTest, KmeansVers2CentroidsAreClusterMeans) {
+  std::mt19937 engine(0);
+  const std::vector<std::vector<float>> kMeans {{-5.0f, -5.0f}, {5.0f, 5.0f}, {5.0f, -5.0f}};
+  const std::vector<std::vector<float>> kStds (3, {0.5f, 0.5f});
+  const auto kPointSet = MakeClusteringTestData<float>(kMeans, kStds, {20, 30, 40}, engine);
+
+  // Start with one point of each cluster
+  std::vector<size_t> initial_indices;
+  std::vector<vers_2::FeaturePoint<float>> converted_point_set;
+  for (size_t index = 0; index<kPointSet.size(); index++) {
+    vers_2::FeaturePoint<float> converted_point;
+    converted_point.SetVector(kPointSet[index]);
+    converted_point_set.emplace_back(converted_point);
+    if (initial_indices.size()==NearestNeighbor(kPointSet[index], kMeans))
+      {initial_indices.emplace_back(index);}
+  }
+  ASSERT_EQ(initial_indices.size(), static_cast<size_t>(3));
+
+  vers_2::KMeans<float> kmeans(3, 10, kPointSet.size());
+  std::cout.setstate(std::ios_base::failbit);
+  kmeans.RunKMeans(converted_point_set, initial_indices);
+  std::cout.clear();
+  const auto kCentroids = kmeans.GetCentroids();
+
+  // Compare against the mean of the points of each cluster
+  std::vector<std::vector<FeaturePoint<float> const *>> clusters(3);
+  for (const auto& kPoint: kPointSet) {clusters[NearestNeighbor(kPoint, kMeans)].emplace_back(&kPoint);}
+
+  ASSERT_EQ(kCentroids.size(), static_cast<size_t>(3));
+  for (size_t cluster_index = 0; cluster_index<3; cluster_index++) {
+    const auto kExpected = Centroid<FeaturePoint<float>>(clusters[cluster_index]);
+    EXPECT_NEAR(kCentroids[cluster_index][0], kExpected[0], 1e-4f);
+    EXPECT_NEAR(kCentroids[cluster_index][1], kExpected[1], 1e-4f);
+  }
+}
+
+
+TEST(ClusteringTest, KmeansStreaming) {
+  // Use a certain seed to get reproduceable results
+  const int kSeed = 0;
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData(engine, 8, 10);
+
+  const int kNumIterations = 10;
+  const float kEpsilon = 1e-3f;
+  const size_t kNumClusters = 10;
+  const bool kVerbose = false;
+
+  ClusteringStrategyKmeans<float> kmeans
+    (kNumClusters, kNumIterations, kEpsilon, kSeed, kVerbose);
+  ClusteringStrategyKmeansStreaming<float> kmeans_streaming
+    (kNumClusters, kNumIterations, kEpsilon, kSeed, kVerbose);
+
+  // Identical centroids, independent of the chunk size
+  const auto kCentroids = kmeans.ClusterCentroids(kPointSet);
+  EXPECT_EQ(kmeans_streaming.ClusterCentroids(kPointSet), kCentroids);
+  for (const size_t kChunkSize: {1, 7, 1000}) {
+    InMemoryPointStream<float> stream(kPointSet, kChunkSize);
+    EXPECT_EQ(kmeans_streaming.ClusterCentroidsFromStream(stream), kCentroids);
+  }
+}
+
+
+TEST(ClusteringTest, SampleTrainingSet) {
+  std::mt19937 engine(0);
+  const auto kPointSet = SampleVectorsFromUniformDistribution<float>(100, 3, -1.0f, 1.0f, engine);
+  InMemoryPointStream<float> stream(kPointSet, 16);
+
+  const auto IsFromPointSet = [&kPointSet](const FeaturePoint<float>& kPoint)
+    {return std::find(kPointSet.begin(), kPointSet.end(), kPoint)!=kPointSet.end();};
+
+  const auto kTrainingSet = SampleTrainingSet(stream, 30, engine);
+  ASSERT_EQ(kTrainingSet.size(), static_cast<size_t>(30));
+  for (const auto& kPoint: kTrainingSet) {EXPECT_TRUE(IsFromPointSet(kPoint));}
+
+  // First stratum is small and taken completely, the others share the rest
+  const std::vector<size_t> kStratumSizes {5, 80, 15};
+  const auto kStratifiedSet = SampleTrainingSetStratified(stream, kStratumSizes, 30, engine);
+  ASSERT_EQ(kStratifiedSet.size(), static_cast<size_t>(30));
+  for (size_t index = 0; index<5; index++) {EXPECT_EQ(kStratifiedSet[index], kPointSet[index]);}
+  for (const auto& kPoint: kStratifiedSet) {EXPECT_TRUE(IsFromPointSet(kPoint));}
+  EXPECT_EQ(std::count_if(kStratifiedSet.begin(), kStratifiedSet.end(),
+    [&kPointSet](const FeaturePoint<float>& kPoint)
+      {return std::find(kPointSet.begin()+85, kPointSet.end(), kPoint)!=kPointSet.end();}), 13);
+
+  EXPECT_THROW(SampleTrainingSetStratified(stream, {5, 5}, 3, engine), std::invalid_argument);
+}
+
+} // namespace igg
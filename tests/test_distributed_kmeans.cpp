@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "clustering/clustering_strategy_kmeans_streaming.hpp"
+#include "clustering/distributed_kmeans/distributed_kmeans.hpp"
+
+#include "get_tests_data_path.hpp"
+#include "make_clustering_test_data.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// Coordinator side of a channel whose connection fails after some messages
+class FailingChannel: public KmeansChannel {
+public:
+  FailingChannel(std::unique_ptr<KmeansChannel> channel, const size_t kNumMessages):
+    channel_(std::move(channel)), num_messages_left_(kNumMessages) {}
+
+  bool Send(const std::string& kMessage) override {return this->channel_->Send(kMessage);}
+
+  bool Receive(std::string& message) override {
+    if (this->num_messages_left_==0) {return false;}
+    this->num_messages_left_--;
+    return this->channel_->Receive(message);
+  }
+
+private:
+  std::unique_ptr<KmeansChannel> channel_;
+  size_t num_messages_left_;
+};
+
+// Cluster with one worker thread per shard, the second worker fails after kFailAfter messages if non-zero
+std::vector<FeaturePoint<float>> ClusterWithWorkers
+  (const DistributedKmeans& kKmeans,
+   const std::vector<std::vector<FeaturePoint<float>>>& kShards,
+   const size_t kFailAfter = 0)
+{
+  std::vector<std::unique_ptr<KmeansChannel>> channels;
+  std::vector<std::thread> workers;
+  for (size_t shard = 0; shard<kShards.size(); shard++) {
+    auto pair = FileDescriptorChannel::MakePipePair();
+    channels.emplace_back(shard==1 && kFailAfter>0 ?
+      std::make_unique<FailingChannel>(std::move(pair.first), kFailAfter) : std::move(pair.first));
+    workers.emplace_back([&kShards, shard](std::unique_ptr<KmeansChannel> channel) {
+      InMemoryPointStream<float> stream(kShards[shard], 7);
+      KmeansWorker(stream).Serve(*channel);
+    }, std::move(pair.second));
+  }
+
+  std::vector<FeaturePoint<float>> centroids;
+  try {
+    centroids = kKmeans.ClusterCentroids(channels);
+  } catch (...) {
+    channels.clear(); // Let the workers stop
+    for (auto& worker: workers) {worker.join();}
+    throw;
+  }
+  for (auto& worker: workers) {worker.join();}
+  return centroids;
+}
+
+} // namespace
+
+
+TEST(DistributedKmeansTest, PipeClosedByOtherEnd) {
+  auto pair = FileDescriptorChannel::MakePipePair();
+  ASSERT_TRUE(pair.first->Send("request"));
+  std::string message;
+  ASSERT_TRUE(pair.second->Receive(message));
+  EXPECT_EQ(message, "request");
+
+  // Fails instead of raising SIGPIPE, which would terminate the test
+  pair.second.reset();
+  EXPECT_FALSE(pair.first->Send("request"));
+  EXPECT_FALSE(pair.first->Receive(message));
+}
+
+
+TEST(DistributedKmeansTest, MatchesStreaming) {
+  const int kSeed = 0;
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData(engine, 8, 10);
+
+  const int kNumIterations = 10;
+  const float kEpsilon = 1e-3f;
+  const size_t kNumClusters = 10;
+  const bool kVerbose = false;
+
+  // Shards of different size, in the order of the point set
+  const std::vector<std::vector<FeaturePoint<float>>> kShards
+    {{kPointSet.begin(), kPointSet.begin()+5},
+     {kPointSet.begin()+5, kPointSet.begin()+40},
+     {kPointSet.begin()+40, kPointSet.end()}};
+
+  ClusteringStrategyKmeansStreaming<float> kmeans_streaming
+    (kNumClusters, kNumIterations, kEpsilon, kSeed, kVerbose);
+  const auto kExpected = kmeans_streaming.ClusterCentroids(kPointSet);
+
+  const DistributedKmeans kKmeans(kNumClusters, kNumIterations, kEpsilon, kSeed, kVerbose);
+  const auto kCentroids = ClusterWithWorkers(kKmeans, kShards);
+  ASSERT_EQ(kCentroids.size(), kExpected.size());
+  for (size_t cluster = 0; cluster<kCentroids.size(); cluster++) {
+    ASSERT_EQ(kCentroids[cluster].size(), kExpected[cluster].size());
+    for (size_t index = 0; index<kCentroids[cluster].size(); index++) {
+      EXPECT_NEAR(kCentroids[cluster][index], kExpected[cluster][index], 1e-4f);
+    }
+  }
+
+  // Same result, independent of which worker is faster
+  EXPECT_EQ(ClusterWithWorkers(kKmeans, kShards), kCentroids);
+
+  EXPECT_THROW(kKmeans.ClusterCentroids({}), std::invalid_argument);
+  EXPECT_THROW(ClusterWithWorkers(kKmeans, {{kPointSet.begin(), kPointSet.begin()+5}}), std::invalid_argument);
+}
+
+
+TEST(DistributedKmeansTest, ContinueFromCheckpoint) {
+  const int kSeed = 1;
+  std::mt19937 engine(kSeed);
+  const auto kPointSet = MakeClusteringTestData(engine, 8, 10);
+  const std::vector<std::vector<FeaturePoint<float>>> kShards
+    {{kPointSet.begin(), kPointSet.begin()+30},
+     {kPointSet.begin()+30, kPointSet.begin()+50},
+     {kPointSet.begin()+50, kPointSet.end()}};
+
+  const int kNumIterations = 8;
+  const float kEpsilon = 0.0f;
+  const size_t kNumClusters = 10;
+  const auto kExpected = ClusterWithWorkers
+    (DistributedKmeans(kNumClusters, kNumIterations, kEpsilon, kSeed, false), kShards);
+
+  const auto kCheckpointPath = (GetTestsOutputPath()/"kmeans.checkpoint").string();
+  if (fs::exists(kCheckpointPath)) {fs::remove(kCheckpointPath);}
+  const DistributedKmeans kKmeans(kNumClusters, kNumIterations, kEpsilon, kSeed, false, kCheckpointPath);
+
+  // The second worker fails while answering the fourth iteration (after size, points and three iterations)
+  EXPECT_THROW(ClusterWithWorkers(kKmeans, kShards, 5), std::runtime_error);
+  ASSERT_TRUE(fs::exists(kCheckpointPath));
+
+  // A checkpoint of another number of clusters, seed or shards is not used
+  const DistributedKmeans kOtherClustersKmeans
+    (kNumClusters+1, kNumIterations, kEpsilon, kSeed, false, kCheckpointPath);
+  EXPECT_THROW(ClusterWithWorkers(kOtherClustersKmeans, kShards), std::runtime_error);
+  const DistributedKmeans kOtherSeedKmeans(kNumClusters, kNumIterations, kEpsilon, kSeed+1, false, kCheckpointPath);
+  EXPECT_THROW(ClusterWithWorkers(kOtherSeedKmeans, kShards), std::runtime_error);
+  const std::vector<std::vector<FeaturePoint<float>>> kOtherShards
+    {{kPointSet.begin(), kPointSet.begin()+20},
+     {kPointSet.begin()+20, kPointSet.begin()+50},
+     {kPointSet.begin()+50, kPointSet.end()}};
+  EXPECT_THROW(ClusterWithWorkers(kKmeans, kOtherShards), std::runtime_error);
+  EXPECT_THROW(ClusterWithWorkers(kKmeans, {kShards[0], kShards[1]}), std::runtime_error);
+  ASSERT_TRUE(fs::exists(kCheckpointPath));
+
+  // Restarted coordinator and workers continue with the fourth iteration, so size and
+  // the remaining five iterations are all that is received
+  EXPECT_EQ(ClusterWithWorkers(kKmeans, kShards, 6), kExpected);
+
+  // The finished clustering removes the checkpoint, so the next run starts over
+  EXPECT_FALSE(fs::exists(kCheckpointPath));
+  EXPECT_EQ(ClusterWithWorkers(kKmeans, kShards), kExpected);
+  EXPECT_FALSE(fs::exists(kCheckpointPath));
+}
+
+} // namespace igg
@@ -1,7 +1,19 @@
 #include <gtest/gtest.h>
 #include <vector>
 
+#include <random>
+#include <algorithm>
+
+#include "clustering/hnsw_index/hnsw_index.hpp"
 #include "histogram/histogram.hpp"
+#include "histogram/similarity_index.hpp"
+#include "histogram/quantized_similarity_index.hpp"
+#include "histogram/ranking.hpp"
+#include "histogram/sparse_histogram.hpp"
+#include "histogram/vocabulary_pruning.hpp"
+#include "tools/simd.hpp"
+
+#include "get_tests_data_path.hpp"
 
 
 namespace igg {
@@ -38,7 +50,381 @@ TEST(HistogramTest, HistogramCompareDimensionMismatch) {
 }
 
 
+TEST(HistogramTest, DenseDotProduct) {
+  // Odd size to cover the non-vectorized tail
+  std::vector<float> vector1(37);
+  std::vector<float> vector2(37);
+  float expected = 0.0f;
+  for (size_t index = 0; index<vector1.size(); index++) {
+    vector1[index] = 0.5f*index;
+    vector2[index] = 1.0f-0.1f*index;
+    expected += vector1[index]*vector2[index];
+  }
 
+  EXPECT_NEAR(DenseDotProduct(vector1.data(), vector2.data(), vector1.size()), expected, 1e-3f);
+  EXPECT_FLOAT_EQ(DenseDotProduct(vector1.data(), vector2.data(), 0), 0.0f);
 
-} // namespace igg
+  const std::vector<double> kVector3{1.0, 2.0, 3.0};
+  EXPECT_DOUBLE_EQ(DenseDotProduct(kVector3.data(), kVector3.data(), kVector3.size()), 14.0);
+}
+
+
+TEST(HistogramTest, SimilarityIndexMatchesComputeSimilarities) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<Histogram<float>> histograms(50, Histogram<float>(21));
+  for (auto& histogram: histograms) {
+    for (auto& bin: histogram) {bin = uniform(engine);}
+  }
+
+  const SimilarityIndex<float> kIndex(histograms);
+  EXPECT_EQ(kIndex.Size(), histograms.size());
+  EXPECT_EQ(kIndex.NumBins(), 21u);
+
+  const auto kExpected = ComputeSimilarities(histograms[3], histograms);
+  const auto kSimilarities = kIndex.Similarities(histograms[3]);
+  ASSERT_EQ(kSimilarities.size(), kExpected.size());
+  for (size_t index = 0; index<kExpected.size(); index++) {
+    EXPECT_NEAR(kSimilarities[index], kExpected[index], 1e-5f);
+  }
+
+  const Histogram<float> kWrongSize(20, 1.0f);
+  EXPECT_THROW(kIndex.Similarities(kWrongSize), std::invalid_argument);
+  EXPECT_THROW(SimilarityIndex<float>({Histogram<float>(3), Histogram<float>(2)}), std::invalid_argument);
+}
+
+
+TEST(HistogramTest, SimilarityIndexTopK) {
+  const std::vector<Histogram<float>> kHistograms
+    {{0.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f}, {2.0f, 0.0f}, {1.0f, 1.0f}};
+  const SimilarityIndex<float> kIndex(kHistograms);
+
+  // All-zero histograms are not similar to anything
+  EXPECT_FLOAT_EQ(kIndex.Similarities({1.0f, 0.0f})[2], 0.0f);
+  EXPECT_FLOAT_EQ(kIndex.Similarities({0.0f, 0.0f})[1], 0.0f);
+
+  // Ties are broken by the lower index
+  const auto kTop = kIndex.TopK({1.0f, 0.0f}, 3);
+  ASSERT_EQ(kTop.size(), 3u);
+  EXPECT_EQ(kTop[0].first, 1u);
+  EXPECT_EQ(kTop[1].first, 3u);
+  EXPECT_EQ(kTop[2].first, 4u);
+  EXPECT_FLOAT_EQ(kTop[0].second, 1.0f);
+  EXPECT_NEAR(kTop[2].second, 0.70710677f, 1e-6f);
+
+  EXPECT_EQ(kIndex.TopK({1.0f, 0.0f}, 10).size(), kHistograms.size());
+  EXPECT_TRUE(kIndex.TopK({1.0f, 0.0f}, 0).empty());
+}
+
+
+TEST(HistogramTest, SimilarityIndexMultithreaded) {
+  // Large enough to be split over threads
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<Histogram<float>> histograms(4000, Histogram<float>(300));
+  for (auto& histogram: histograms) {
+    for (auto& bin: histogram) {bin = uniform(engine);}
+  }
+
+  const SimilarityIndex<float> kSingleThreaded(histograms, 1);
+  const SimilarityIndex<float> kMultiThreaded(histograms, 4);
+
+  const auto& kQuery = histograms[123];
+  EXPECT_EQ(kSingleThreaded.Similarities(kQuery), kMultiThreaded.Similarities(kQuery));
+
+  const auto kTop = kMultiThreaded.TopK(kQuery, 20);
+  EXPECT_EQ(kSingleThreaded.TopK(kQuery, 20), kTop);
+  EXPECT_EQ(kTop[0].first, 123u);
+  for (size_t rank = 1; rank<kTop.size(); rank++) {
+    EXPECT_GE(kTop[rank-1].second, kTop[rank].second);
+  }
+}
+
+
+TEST(HistogramTest, SimilarityIndexBatch) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::uniform_int_distribution<size_t> uniform_bin(0, 299);
+  std::vector<Histogram<float>> histograms(4000, Histogram<float>(300));
+  std::vector<SparseHistogram<float>> sparse_histograms;
+  for (auto& histogram: histograms) {
+    for (auto& bin: histogram) {bin = uniform(engine);}
+    Histogram<float> sparse_histogram(300, 0.0f);
+    for (size_t word = 0; word<10; word++) {sparse_histogram[uniform_bin(engine)] = uniform(engine);}
+    sparse_histograms.emplace_back(SparseHistogram<float>::FromDense(sparse_histogram));
+  }
+
+  // Batches agree with single queries, for dense and sparse rows
+  std::vector<Histogram<float>> queries;
+  std::vector<const float*> query_pointers;
+  for (const size_t kIndex: {1, 123, 3999}) {queries.emplace_back(histograms[kIndex]);}
+  for (auto& query: queries) {
+    internal::NormalizeInPlace(query.data(), query.size());
+    query_pointers.emplace_back(query.data());
+  }
+  for (const auto& kIndex: {SimilarityIndex<float>(histograms, 4), SimilarityIndex<float>(sparse_histograms, 4)}) {
+    const auto kBatch = kIndex.TopKNormalizedBatch(query_pointers, 20);
+    ASSERT_EQ(kBatch.size(), queries.size());
+    for (size_t query = 0; query<queries.size(); query++) {
+      EXPECT_EQ(kBatch[query], kIndex.TopKNormalized(queries[query].data(), 20));
+      const auto kSingle = kIndex.TopK(queries[query], 20);
+      ASSERT_EQ(kBatch[query].size(), kSingle.size());
+      for (size_t rank = 0; rank<kSingle.size(); rank++) {
+        EXPECT_NEAR(kBatch[query][rank].second, kSingle[rank].second, 1e-5f);
+      }
+    }
+  }
+  EXPECT_TRUE(SimilarityIndex<float>(histograms).TopKNormalizedBatch({}, 20).empty());
+}
+
+
+TEST(HistogramTest, RankScores) {
+  const std::vector<float> kScores{0.5f, 0.9f, 0.1f, 0.9f, 0.3f, 0.1f};
+
+  const auto kRanking = RankScores(kScores, 3, 2);
+  const std::vector<ScoredIndex<float>> kExpectedTop{{1, 0.9f}, {3, 0.9f}, {0, 0.5f}};
+  const std::vector<ScoredIndex<float>> kExpectedBottom{{2, 0.1f}, {5, 0.1f}};
+  EXPECT_EQ(kRanking.top, kExpectedTop);
+  EXPECT_EQ(kRanking.bottom, kExpectedBottom);
+
+  EXPECT_EQ(TopKScores(kScores, 3), kExpectedTop);
+  EXPECT_EQ(BottomKScores(kScores, 2), kExpectedBottom);
+
+  // More results than scores
+  EXPECT_EQ(TopKScores(kScores, 10).size(), kScores.size());
+  EXPECT_EQ(BottomKScores(kScores, 10).back().first, 3u);
+  EXPECT_TRUE(TopKScores(kScores, 0).empty());
+  EXPECT_TRUE(TopKScores(std::vector<float>(), 3).empty());
+}
+
+
+TEST(HistogramTest, RankScoresMultithreaded) {
+  // Large enough to be split over threads
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> uniform(0, 1000);
+  std::vector<float> scores(300000);
+  for (auto& score: scores) {score = static_cast<float>(uniform(engine));}
+
+  const auto kSingleThreaded = RankScores(scores, 50, 50, 1);
+  const auto kMultiThreaded = RankScores(scores, 50, 50, 4);
+  EXPECT_EQ(kSingleThreaded.top, kMultiThreaded.top);
+  EXPECT_EQ(kSingleThreaded.bottom, kMultiThreaded.bottom);
+
+  // Same as a full sort
+  auto sorted = TopKScores(scores, scores.size(), 1);
+  ASSERT_EQ(sorted.size(), scores.size());
+  EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end(), IsHigherScored<float>));
+  EXPECT_TRUE(std::equal(kMultiThreaded.top.begin(), kMultiThreaded.top.end(), sorted.begin()));
+  for (size_t rank = 0; rank<kMultiThreaded.bottom.size(); rank++) {
+    EXPECT_EQ(kMultiThreaded.bottom[rank].second, sorted[sorted.size()-1-rank].second);
+  }
+}
 
+
+TEST(HistogramTest, SparseHistogram) {
+  const Histogram<float> kDense{0.0f, 2.0f, 0.0f, 0.0f, 1.0f};
+  const auto kSparse = SparseHistogram<float>::FromDense(kDense);
+
+  EXPECT_EQ(kSparse.NumBins(), 5u);
+  EXPECT_EQ(kSparse.NumNonZeros(), 2u);
+  EXPECT_DOUBLE_EQ(kSparse.Density(), 0.4);
+  EXPECT_EQ(kSparse.Bins(), std::vector<uint32_t>({1, 4}));
+  EXPECT_EQ(kSparse.Weights(), std::vector<float>({2.0f, 1.0f}));
+  EXPECT_EQ(kSparse.ToDense(), kDense);
+
+  EXPECT_THROW(SparseHistogram<float>(5, {1, 1}, {1.0f, 1.0f}), std::invalid_argument);
+  EXPECT_THROW(SparseHistogram<float>(5, {5}, {1.0f}), std::invalid_argument);
+  EXPECT_THROW(SparseHistogram<float>(5, {1, 2}, {1.0f}), std::invalid_argument);
+
+  // Dot products
+  const SparseHistogram<float> kOther(5, {0, 1, 4}, {3.0f, 0.5f, 2.0f});
+  EXPECT_FLOAT_EQ(SparseDotProduct(kSparse, kOther), 3.0f);
+  EXPECT_FLOAT_EQ(SparseDenseDotProduct(kOther, kDense), 3.0f);
+  EXPECT_THROW(SparseDotProduct(kSparse, SparseHistogram<float>(4)), std::invalid_argument);
+  EXPECT_THROW(SparseDenseDotProduct(kSparse, Histogram<float>(4)), std::invalid_argument);
+}
+
+
+TEST(HistogramTest, SparseHistogramGraph) {
+  // Random histograms with few non-zero bins
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> bin_distribution(0, 99);
+  std::uniform_real_distribution<float> weight_distribution(0.1f, 1.0f);
+  std::vector<SparseHistogram<float>> histograms;
+  for (size_t index = 0; index<50; index++) {
+    Histogram<float> dense(100, 0.0f);
+    for (size_t word = 0; word<20; word++) {dense[bin_distribution(engine)] = weight_distribution(engine);}
+    histograms.emplace_back(SparseHistogram<float>::FromDense(dense));
+  }
+
+  // Same distance as the dense histograms
+  const auto kDense1 = histograms[0].ToDense();
+  const auto kDense2 = histograms[1].ToDense();
+  float expected_distance = 0.0f;
+  for (size_t bin = 0; bin<kDense1.size(); bin++) {
+    expected_distance += (kDense1[bin]-kDense2[bin])*(kDense1[bin]-kDense2[bin]);
+  }
+  EXPECT_FLOAT_EQ(SparseSquaredL2Distance(histograms[0], histograms[1]), expected_distance);
+  EXPECT_FLOAT_EQ(SparseSquaredL2Distance(histograms[0], histograms[0]), 0.0f);
+  EXPECT_THROW(SparseSquaredL2Distance(histograms[0], SparseHistogram<float>(4)), std::invalid_argument);
+
+  // The graph stores the non-zero bins only and finds each histogram itself
+  const HnswIndex<SparseHistogram<float>> kIndex(histograms, 4, 20, 50, 0);
+  for (size_t index = 0; index<histograms.size(); index++) {
+    EXPECT_EQ(kIndex.NearestNeighbor(histograms[index]), index);
+  }
+  EXPECT_THROW(HnswIndex<SparseHistogram<float>>(kIndex).Insert(SparseHistogram<float>(4)), std::invalid_argument);
+
+  const auto kBinaryPath = GetTestsOutputPath()/"sparse_histograms_hnsw.binary";
+  ASSERT_TRUE(kIndex.WriteToBinary(kBinaryPath.string()));
+  const auto kIndexFromBinary = HnswIndex<SparseHistogram<float>>::ReadFromBinary(kBinaryPath.string());
+  ASSERT_EQ(kIndexFromBinary.Size(), histograms.size());
+  for (size_t index = 0; index<histograms.size(); index++) {
+    EXPECT_EQ(kIndexFromBinary.Point(index).Bins(), histograms[index].Bins());
+    EXPECT_EQ(kIndexFromBinary.Point(index).Weights(), histograms[index].Weights());
+    EXPECT_EQ(kIndexFromBinary.NearestNeighbor(histograms[index]), index);
+  }
+}
+
+
+TEST(HistogramTest, SimilarityIndexSparse) {
+  // Few non-zero bins, so the index stores sparse rows
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::uniform_int_distribution<size_t> uniform_bin(0, 999);
+  std::vector<Histogram<float>> histograms(100, Histogram<float>(1000, 0.0f));
+  std::vector<SparseHistogram<float>> sparse_histograms;
+  for (auto& histogram: histograms) {
+    for (size_t word = 0; word<20; word++) {histogram[uniform_bin(engine)] = uniform(engine);}
+    sparse_histograms.emplace_back(SparseHistogram<float>::FromDense(histogram));
+  }
+
+  const SimilarityIndex<float> kIndex(histograms);
+  const SimilarityIndex<float> kSparseIndex(sparse_histograms);
+  EXPECT_TRUE(kIndex.IsSparse());
+  EXPECT_TRUE(kSparseIndex.IsSparse());
+
+  const auto kExpected = ComputeSimilarities(histograms[7], histograms);
+  const auto kSimilarities = kSparseIndex.Similarities(sparse_histograms[7]);
+  for (size_t index = 0; index<kExpected.size(); index++) {
+    EXPECT_NEAR(kSimilarities[index], kExpected[index], 1e-5f);
+  }
+  EXPECT_EQ(kIndex.Similarities(histograms[7]), kSimilarities);
+  EXPECT_EQ(kSparseIndex.TopK(sparse_histograms[7], 1)[0].first, 7u);
+
+  // Dense input stays dense
+  EXPECT_FALSE(SimilarityIndex<float>({{1.0f, 2.0f}, {0.0f, 1.0f}}).IsSparse());
+}
+
+
+TEST(HistogramTest, VocabularyPruning) {
+  // Words 1 and 3 are contained in more than half of the 10 images
+  const auto kPruning = VocabularyPruning::FromDocumentFrequencies({5, 6, 0, 10}, 10, 0.5, 3);
+  EXPECT_EQ(kPruning.NumWords(), 4u);
+  EXPECT_EQ(kPruning.StopWords(), std::vector<uint32_t>({1, 3}));
+  EXPECT_TRUE(kPruning.IsStopWord(1));
+  EXPECT_FALSE(kPruning.IsStopWord(0));
+  EXPECT_EQ(kPruning.MaxWordCount(), 3u);
+
+  Histogram<float> counts{7.0f, 2.0f, 1.0f, 4.0f};
+  kPruning.Apply(counts);
+  EXPECT_EQ(counts, Histogram<float>({3.0f, 0.0f, 1.0f, 0.0f}));
+
+  // Nothing pruned
+  const auto kUnpruned = VocabularyPruning::FromDocumentFrequencies({5, 6, 0, 10}, 10, 1.0, 0);
+  EXPECT_TRUE(kUnpruned.IsEmpty());
+  Histogram<float> unpruned_counts{7.0f, 2.0f, 1.0f, 4.0f};
+  kUnpruned.Apply(unpruned_counts);
+  EXPECT_EQ(unpruned_counts, Histogram<float>({7.0f, 2.0f, 1.0f, 4.0f}));
+
+  Histogram<float> wrong_counts(3, 1.0f);
+  EXPECT_THROW(kPruning.Apply(wrong_counts), std::invalid_argument);
+  EXPECT_THROW(VocabularyPruning::FromDocumentFrequencies({1}, 10, 1.5, 0), std::invalid_argument);
+
+  // Write and read
+  const auto kBinaryPath = GetTestsOutputPath()/"vocabulary_pruning.binary";
+  ASSERT_TRUE(kPruning.WriteToBinary(kBinaryPath.string()));
+  const auto kReadPruning = VocabularyPruning::ReadFromBinary(kBinaryPath.string());
+  EXPECT_EQ(kReadPruning.NumWords(), kPruning.NumWords());
+  EXPECT_EQ(kReadPruning.StopWords(), kPruning.StopWords());
+  EXPECT_EQ(kReadPruning.MaxWordCount(), kPruning.MaxWordCount());
+  EXPECT_TRUE(kReadPruning.IsStopWord(3));
+  EXPECT_THROW(VocabularyPruning::ReadFromBinary((GetTestsOutputPath()/"missing.binary").string()), std::runtime_error);
+}
+
+
+TEST(HistogramTest, QuantizedSimilarityIndex) {
+  // Histograms with some empty bins
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  std::vector<Histogram<float>> histograms(200, Histogram<float>(300));
+  for (auto& histogram: histograms) {
+    for (auto& bin: histogram) {bin = std::max(uniform(engine), 0.0f);}
+  }
+  const auto& kHistograms = histograms;
+  std::vector<SparseHistogram<float>> sparse_histograms;
+  for (const auto& kHistogram: kHistograms) {sparse_histograms.emplace_back(SparseHistogram<float>::FromDense(kHistogram));}
+
+  const QuantizedSimilarityIndex<float> kIndex(kHistograms);
+  const QuantizedSimilarityIndex<float> kSparseIndex(sparse_histograms);
+  EXPECT_EQ(kIndex.Size(), kHistograms.size());
+  EXPECT_EQ(kIndex.NumBins(), 300u);
+  EXPECT_LT(kIndex.MemoryBytes(), kHistograms.size()*300*sizeof(float)/3);
+
+  // Approximate similarities
+  const auto kExpected = ComputeSimilarities(kHistograms[7], kHistograms);
+  const auto kSimilarities = kIndex.Similarities(kHistograms[7]);
+  ASSERT_EQ(kSimilarities.size(), kExpected.size());
+  for (size_t index = 0; index<kExpected.size(); index++) {
+    EXPECT_NEAR(kSimilarities[index], kExpected[index], 0.01f);
+  }
+  const auto kSparseSimilarities = kSparseIndex.Similarities(sparse_histograms[7]);
+  for (size_t index = 0; index<kExpected.size(); index++) {
+    EXPECT_NEAR(kSparseSimilarities[index], kSimilarities[index], 1e-5f);
+  }
+  EXPECT_EQ(kIndex.Candidates(kHistograms[7], 1)[0].first, 7u);
+
+  // Re-ranking all histograms is exact, with dense or sparse full-precision histograms
+  const SimilarityIndex<float> kExactIndex(kHistograms);
+  const auto kExactTop = kExactIndex.TopK(kHistograms[7], 10);
+  const auto kTop = kIndex.TopK(kHistograms[7], 10, kHistograms.size(),
+    [&kHistograms](const size_t kIndex) {return kHistograms[kIndex];});
+  const auto kSparseTop = kSparseIndex.TopK(sparse_histograms[7], 10, 0,
+    [&sparse_histograms](const size_t kIndex) {return sparse_histograms[kIndex];});
+  ASSERT_EQ(kTop.size(), kExactTop.size());
+  ASSERT_EQ(kSparseTop.size(), kExactTop.size());
+  for (size_t rank = 0; rank<kTop.size(); rank++) {
+    EXPECT_NEAR(kTop[rank].second, kExactTop[rank].second, 1e-5f);
+  }
+  // At least kNumResults candidates are re-ranked
+  EXPECT_EQ(kSparseTop[0].first, 7u);
+
+  // Added one after the other
+  QuantizedSimilarityIndex<float> index(300);
+  for (const auto& kHistogram: kHistograms) {index.Add(kHistogram);}
+  EXPECT_EQ(index.Similarities(kHistograms[7]), kSimilarities);
+  index.Add(Histogram<float>(300, 0.0f));
+  EXPECT_FLOAT_EQ(index.Similarities(kHistograms[7]).back(), 0.0f);
+
+  EXPECT_THROW(index.Add(Histogram<float>(10)), std::invalid_argument);
+  EXPECT_THROW(kIndex.Similarities(Histogram<float>(10)), std::invalid_argument);
+}
+
+
+TEST(HistogramTest, QuantizedDotProduct) {
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> uniform(-128, 127);
+  for (const size_t kSize: {0, 1, 15, 16, 33, 1000}) {
+    std::vector<int8_t> vector1(kSize);
+    std::vector<int8_t> vector2(kSize);
+    int32_t expected = 0;
+    for (size_t index = 0; index<kSize; index++) {
+      vector1[index] = static_cast<int8_t>(uniform(engine));
+      vector2[index] = static_cast<int8_t>(uniform(engine));
+      expected += vector1[index]*vector2[index];
+    }
+    EXPECT_EQ(DenseDotProduct(vector1.data(), vector2.data(), kSize), expected);
+  }
+}
+
+} // namespace igg
@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <boost/filesystem.hpp>
+
+#include "inverted_index/posting_list.hpp"
+#include "inverted_index/inverted_index.hpp"
+#include "histogram/histogram.hpp"
+#include "histogram/sparse_histogram.hpp"
+#include "tools/sampling.hpp"
+
+#include "get_tests_data_path.hpp"
+
+
+namespace igg {
+
+// Ids with consecutive runs (zero bit width) and large gaps, over several blocks
+void MakePostings(std::vector<uint32_t>& ids, std::vector<float>& weights) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 2.0f);
+  uint32_t id = 3;
+  for (size_t index = 0; index<1000; index++) {
+    ids.emplace_back(id);
+    weights.emplace_back(uniform(engine));
+    if (index<300) {id += 1;}
+    else if (index<600) {id += 1+index%7;}
+    else {id += 1+(index%5)*100000;}
+  }
+}
+
+
+TEST(InvertedIndexTest, PostingListRoundTrip) {
+  std::vector<uint32_t> ids;
+  std::vector<float> weights;
+  MakePostings(ids, weights);
+
+  const CompressedPostingList kList(ids, weights);
+  EXPECT_EQ(kList.Size(), ids.size());
+  EXPECT_EQ(kList.NumBlocks(), (ids.size()+CompressedPostingList::kBlockSize-1)/CompressedPostingList::kBlockSize);
+  EXPECT_EQ(kList.BlockLastId(kList.NumBlocks()-1), ids.back());
+  EXPECT_LT(kList.MemoryBytes(), ids.size()*(sizeof(uint32_t)+sizeof(float)));
+
+  std::vector<uint32_t> decoded_ids;
+  std::vector<float> decoded_weights;
+  kList.Decode(decoded_ids, decoded_weights);
+  ASSERT_EQ(decoded_ids, ids);
+  ASSERT_EQ(decoded_weights.size(), weights.size());
+
+  const float kMaxError = 0.5f*kList.MaxWeight()/255.0f+1e-6f;
+  for (size_t index = 0; index<weights.size(); index++) {
+    EXPECT_NEAR(decoded_weights[index], weights[index], kMaxError);
+    EXPECT_LE(decoded_weights[index], kList.BlockMaxWeight(index/CompressedPostingList::kBlockSize)+1e-6f);
+  }
+}
+
+
+TEST(InvertedIndexTest, PostingListWriteRead) {
+  std::vector<uint32_t> ids;
+  std::vector<float> weights;
+  MakePostings(ids, weights);
+  const CompressedPostingList kList(ids, weights);
+
+  std::stringstream stream;
+  kList.Write(stream);
+  const auto kReadList = CompressedPostingList::Read(stream);
+
+  std::vector<uint32_t> ids1, ids2;
+  std::vector<float> weights1, weights2;
+  kList.Decode(ids1, weights1);
+  kReadList.Decode(ids2, weights2);
+  EXPECT_EQ(ids1, ids2);
+  EXPECT_EQ(weights1, weights2);
+
+  // Empty list
+  std::stringstream empty_stream;
+  CompressedPostingList().Write(empty_stream);
+  EXPECT_EQ(CompressedPostingList::Read(empty_stream).Size(), 0u);
+}
+
+
+TEST(InvertedIndexTest, PostingListConsecutiveIds) {
+  // A word in every image, a single block of zero bit width without packed gaps
+  std::vector<uint32_t> ids(CompressedPostingList::kBlockSize);
+  std::iota(ids.begin(), ids.end(), 0u);
+  const std::vector<float> kWeights(ids.size(), 1.0f);
+  const CompressedPostingList kList(ids, kWeights);
+
+  std::vector<uint32_t> decoded_ids;
+  std::vector<float> decoded_weights;
+  kList.Decode(decoded_ids, decoded_weights);
+  EXPECT_EQ(decoded_ids, ids);
+  EXPECT_EQ(decoded_weights, kWeights);
+
+  std::stringstream stream;
+  kList.Write(stream);
+  CompressedPostingList::Read(stream).Decode(decoded_ids, decoded_weights);
+  EXPECT_EQ(decoded_ids, ids);
+}
+
+
+TEST(InvertedIndexTest, PostingListInvalid) {
+  EXPECT_THROW(CompressedPostingList({1, 2}, {1.0f}), std::invalid_argument);
+  EXPECT_THROW(CompressedPostingList({2, 2}, {1.0f, 1.0f}), std::invalid_argument);
+  EXPECT_THROW(CompressedPostingList({1, 2}, {1.0f, -1.0f}), std::invalid_argument);
+}
+
+
+std::vector<SparseHistogram<float>> MakeTestSparseHistograms() {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<SparseHistogram<float>> histograms;
+  for (size_t index = 0; index<300; index++) {
+    Histogram<float> histogram(500, 0.0f);
+    for (const auto kBin: SampleIndicesWithoutReplacement<size_t>(20, 500, engine)) {
+      histogram[kBin] = uniform(engine);
+    }
+    histograms.emplace_back(SparseHistogram<float>::FromDense(histogram));
+  }
+  // Empty image
+  histograms.emplace_back(500);
+  return histograms;
+}
+
+
+TEST(InvertedIndexTest, Similarities) {
+  const auto kHistograms = MakeTestSparseHistograms();
+  const InvertedIndex kIndex(kHistograms);
+  EXPECT_EQ(kIndex.NumImages(), kHistograms.size());
+  EXPECT_EQ(kIndex.NumWords(), 500u);
+
+  std::vector<Histogram<float>> dense_histograms;
+  for (const auto& kHistogram: kHistograms) {dense_histograms.emplace_back(kHistogram.ToDense());}
+
+  for (const size_t kQuery: {0, 7, 299}) {
+    const auto kExpected = ComputeSimilarities(dense_histograms[kQuery], dense_histograms);
+    const auto kSimilarities = kIndex.Similarities(kHistograms[kQuery]);
+    ASSERT_EQ(kSimilarities.size(), kExpected.size());
+    for (size_t index = 0; index+1<kExpected.size(); index++) {
+      EXPECT_NEAR(kSimilarities[index], kExpected[index], 0.01f);
+    }
+    EXPECT_FLOAT_EQ(kSimilarities.back(), 0.0f);
+
+    const auto kTop = kIndex.TopK(kHistograms[kQuery], 5);
+    ASSERT_EQ(kTop.size(), 5u);
+    EXPECT_EQ(kTop[0].first, kQuery);
+    EXPECT_TRUE(std::is_sorted(kTop.begin(), kTop.end(),
+      [](const ScoredIndex<float>& kLhs, const ScoredIndex<float>& kRhs) {return kLhs.second>kRhs.second;}));
+  }
+
+  EXPECT_THROW(kIndex.Similarities(SparseHistogram<float>(10)), std::invalid_argument);
+}
+
+
+TEST(InvertedIndexTest, PostingListCursor) {
+  std::vector<uint32_t> ids;
+  std::vector<float> weights;
+  MakePostings(ids, weights);
+  const CompressedPostingList kList(ids, weights);
+
+  // Visit all
+  PostingListCursor cursor(kList);
+  for (const auto kId: ids) {
+    ASSERT_EQ(cursor.ImageId(), kId);
+    cursor.Next();
+  }
+  EXPECT_TRUE(cursor.AtEnd());
+  EXPECT_EQ(cursor.ImageId(), PostingListCursor::kEndId);
+
+  // Jump to ids in and between postings
+  PostingListCursor skipping_cursor(kList);
+  for (size_t index = 0; index<ids.size(); index += 97) {
+    skipping_cursor.NextGeq(ids[index]-1);
+    EXPECT_EQ(skipping_cursor.ImageId(), index==0 || ids[index-1]<ids[index]-1 ? ids[index] : ids[index-1]);
+    skipping_cursor.NextGeq(ids[index]);
+    EXPECT_EQ(skipping_cursor.ImageId(), ids[index]);
+    EXPECT_LE(skipping_cursor.Weight(), skipping_cursor.BlockMaxWeight());
+  }
+  skipping_cursor.NextGeq(ids.back()+1);
+  EXPECT_TRUE(skipping_cursor.AtEnd());
+}
+
+
+TEST(InvertedIndexTest, TopKPruned) {
+  const auto kHistograms = MakeTestSparseHistograms();
+  const InvertedIndex kIndex(kHistograms);
+
+  // Including more results than matching images
+  for (const size_t kNumResults: {0, 1, 10, 100, 301}) {
+    for (const size_t kQuery: {0, 7, 299, 300}) {
+      const auto kExpected = kIndex.TopK(kHistograms[kQuery], kNumResults);
+      const auto kResults = kIndex.TopKPruned(kHistograms[kQuery], kNumResults);
+      ASSERT_EQ(kResults.size(), kExpected.size());
+      for (size_t rank = 0; rank<kResults.size(); rank++) {
+        EXPECT_NEAR(kResults[rank].second, kExpected[rank].second, 1e-5f);
+      }
+    }
+  }
+  EXPECT_EQ(kIndex.TopKPruned(kHistograms[3], 1)[0].first, 3u);
+
+  // Frequent words with small weights, which are skipped or looked up
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<SparseHistogram<float>> weighted_histograms;
+  for (size_t index = 0; index<1000; index++) {
+    Histogram<float> histogram(500, 0.0f);
+    for (size_t word = 0; word<30; word++) {histogram[word] = 0.1f*uniform(engine);}
+    for (const auto kBin: SampleIndicesWithoutReplacement<size_t>(10, 470, engine)) {
+      histogram[30+kBin] = uniform(engine);
+    }
+    weighted_histograms.emplace_back(SparseHistogram<float>::FromDense(histogram));
+  }
+  const InvertedIndex kWeightedIndex(weighted_histograms);
+  for (const size_t kNumResults: {1, 10}) {
+    for (const size_t kQuery: {0, 500, 999}) {
+      const auto kExpected = kWeightedIndex.TopK(weighted_histograms[kQuery], kNumResults);
+      const auto kResults = kWeightedIndex.TopKPruned(weighted_histograms[kQuery], kNumResults);
+      ASSERT_EQ(kResults.size(), kExpected.size());
+      for (size_t rank = 0; rank<kResults.size(); rank++) {
+        EXPECT_EQ(kResults[rank].first, kExpected[rank].first);
+        EXPECT_NEAR(kResults[rank].second, kExpected[rank].second, 1e-5f);
+      }
+    }
+  }
+
+  EXPECT_THROW(kIndex.TopKPruned(SparseHistogram<float>(10), 1), std::invalid_argument);
+}
+
+
+TEST(InvertedIndexTest, TopKTruncated) {
+  const auto kHistograms = MakeTestSparseHistograms();
+  const InvertedIndex kIndex(kHistograms);
+
+  // Enough postings for all words is exact
+  for (const size_t kQuery: {0, 7, 299}) {
+    const auto kNumPostings = kIndex.NumPostings(kHistograms[kQuery]);
+    size_t num_visited = 0;
+    const auto kResults = kIndex.TopKTruncated(kHistograms[kQuery], 10, kNumPostings, &num_visited);
+    EXPECT_EQ(num_visited, kNumPostings);
+    const auto kExpected = kIndex.TopK(kHistograms[kQuery], 10);
+    ASSERT_EQ(kResults.size(), kExpected.size());
+    for (size_t rank = 0; rank<kResults.size(); rank++) {
+      EXPECT_EQ(kResults[rank].first, kExpected[rank].first);
+      EXPECT_NEAR(kResults[rank].second, kExpected[rank].second, 1e-5f);
+    }
+
+    // Otherwise fewer postings are visited, at least the first word
+    const auto kTruncated = kIndex.TopKTruncated(kHistograms[kQuery], 10, kNumPostings/2, &num_visited);
+    EXPECT_LE(num_visited, kNumPostings/2);
+    EXPECT_EQ(kTruncated.size(), 10u);
+    kIndex.TopKTruncated(kHistograms[kQuery], 10, 0, &num_visited);
+    EXPECT_GT(num_visited, 0u);
+  }
+
+  EXPECT_THROW(kIndex.TopKTruncated(SparseHistogram<float>(10), 1, 100), std::invalid_argument);
+  EXPECT_THROW(kIndex.NumPostings(SparseHistogram<float>(10)), std::invalid_argument);
+}
+
+
+TEST(InvertedIndexTest, WriteReadBinary) {
+  const auto kBinaryPath = GetTestsOutputPath()/"inverted_index.binary";
+  if (fs::exists(kBinaryPath)) {fs::remove(kBinaryPath);}
+
+  const auto kHistograms = MakeTestSparseHistograms();
+  const InvertedIndex kIndex(kHistograms);
+  ASSERT_TRUE(kIndex.WriteToBinary(kBinaryPath.string()));
+
+  const auto kReadIndex = InvertedIndex::ReadFromBinary(kBinaryPath.string());
+  EXPECT_EQ(kReadIndex.NumImages(), kIndex.NumImages());
+  EXPECT_EQ(kReadIndex.NumWords(), kIndex.NumWords());
+  EXPECT_EQ(kReadIndex.Similarities(kHistograms[3]), kIndex.Similarities(kHistograms[3]));
+
+  EXPECT_THROW(InvertedIndex::ReadFromBinary((GetTestsOutputPath()/"missing.binary").string()), std::runtime_error);
+}
+
+} // namespace igg
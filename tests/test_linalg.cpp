@@ -31,6 +31,13 @@ TEST(LinalgTest, SquaredL2Norm) {
 }
 
 
+TEST(LinalgTest, SquaredL2Distance) {
+  const VectorType kVector1{1.0f, 5.0f, 2.0f};
+  const VectorType kVector2{2.0f, 3.0f, 2.0f};
+  EXPECT_FLOAT_EQ(SquaredL2Distance(kVector1, kVector2), 5.0f);
+}
+
+
 TEST(LinalgTest, Centroid) {
   const VectorType kVector1{1.3f, 2.0f, 3.0f};
   const VectorType kVector2{2.0f, 4.6f, 5.0f};
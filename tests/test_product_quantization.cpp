@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+#include "product_quantization/product_quantizer.hpp"
+#include "product_quantization/product_quantized_index.hpp"
+#include "histogram/histogram.hpp"
+#include "tools/linalg.hpp"
+
+#include "get_tests_data_path.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// Normalized vectors around a few prototypes
+std::vector<std::vector<float>> MakeTestVectors(const size_t kNumVectors, const size_t kDimension) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<std::vector<float>> prototypes(8, std::vector<float>(kDimension));
+  for (auto& prototype: prototypes) {
+    for (auto& value: prototype) {value = uniform(engine);}
+  }
+
+  std::vector<std::vector<float>> vectors;
+  for (size_t index = 0; index<kNumVectors; index++) {
+    auto vector = prototypes[index%prototypes.size()];
+    for (auto& value: vector) {value += 0.2f*uniform(engine);}
+    const auto kNorm = L2Norm(vector);
+    for (auto& value: vector) {value /= kNorm;}
+    vectors.emplace_back(std::move(vector));
+  }
+  return vectors;
+}
+
+} // namespace
+
+
+TEST(ProductQuantizationTest, ProductQuantizer) {
+  const auto kVectors = MakeTestVectors(200, 30);
+  const auto kQuantizer = ProductQuantizer::Train(kVectors, 7, 25, 0);
+  EXPECT_EQ(kQuantizer.Dimension(), 30u);
+  EXPECT_EQ(kQuantizer.NumSubquantizers(), 7u);
+  EXPECT_EQ(kQuantizer.CodeSize(), 4u);
+
+  // Decoded vectors are close, inner products by table match decoded vectors
+  const auto kTable = kQuantizer.InnerProductTable(kVectors[1]);
+  ASSERT_EQ(kTable.size(), 7*ProductQuantizer::kNumCentroids);
+  for (size_t index = 0; index<10; index++) {
+    const auto kCode = kQuantizer.Encode(kVectors[index]);
+    ASSERT_EQ(kCode.size(), 7u);
+    EXPECT_TRUE(std::all_of(kCode.begin(), kCode.end(), [](const uint8_t kIndex) {return kIndex<16;}));
+    const auto kDecoded = kQuantizer.Decode(kCode);
+    EXPECT_LT(L2Norm(Difference(kDecoded, kVectors[index])), 0.15f);
+
+    float inner_product = 0.0f;
+    for (size_t subspace = 0; subspace<7; subspace++) {
+      inner_product += kTable[subspace*ProductQuantizer::kNumCentroids+kCode[subspace]];
+    }
+    EXPECT_NEAR(inner_product, DotProduct(kDecoded, kVectors[1]), 1e-5f);
+  }
+
+  EXPECT_THROW(kQuantizer.Encode(std::vector<float>(29)), std::invalid_argument);
+  EXPECT_THROW(ProductQuantizer::Train(MakeTestVectors(10, 30), 7, 25, 0), std::invalid_argument);
+  EXPECT_THROW(ProductQuantizer::Train(kVectors, 31, 25, 0), std::invalid_argument);
+}
+
+
+TEST(ProductQuantizationTest, ProductQuantizedIndex) {
+  // Not a multiple of the block size
+  const auto kVectors = MakeTestVectors(1000, 64);
+  ProductQuantizedIndex index(ProductQuantizer::Train(kVectors, 16, 25, 0));
+  for (const auto& kVector: kVectors) {index.Add(kVector);}
+  EXPECT_EQ(index.Size(), kVectors.size());
+  EXPECT_EQ(index.MemoryBytes(), (kVectors.size()+31)/32*32*index.Quantizer().CodeSize());
+
+  // Similarities by the float table
+  const auto kSimilarities = index.Similarities(kVectors[5]);
+  ASSERT_EQ(kSimilarities.size(), kVectors.size());
+  for (const size_t kIndex: {0, 5, 31, 32, 999}) {
+    EXPECT_FLOAT_EQ(kSimilarities[kIndex],
+      DotProduct(index.Quantizer().Decode(index.Quantizer().Encode(kVectors[kIndex])), kVectors[5]));
+  }
+
+  // Scoring all candidates again gives the top of the similarities
+  const auto kExpected = TopKScores(kSimilarities, 20);
+  const auto kTop = index.TopK(kVectors[5], 20, kVectors.size());
+  ASSERT_EQ(kTop.size(), kExpected.size());
+  for (size_t rank = 0; rank<kTop.size(); rank++) {
+    EXPECT_NEAR(kTop[rank].second, kExpected[rank].second, 1e-5f);
+  }
+
+  // The scan with the 8 bit table finds most of them
+  const auto kScanned = index.TopK(kVectors[5], 20, 100);
+  ASSERT_EQ(kScanned.size(), 20u);
+  size_t num_found = 0;
+  for (const auto& kResult: kScanned) {
+    num_found += std::count_if(kExpected.begin(), kExpected.end(),
+      [&kResult](const ScoredIndex<float>& kExpectedResult) {return kExpectedResult.first==kResult.first;});
+  }
+  EXPECT_GE(num_found, 18u);
+
+  EXPECT_THROW(index.TopK(std::vector<float>(10), 1, 1), std::invalid_argument);
+}
+
+
+TEST(ProductQuantizationTest, WriteReadBinary) {
+  const auto kBinaryPath = GetTestsOutputPath()/"product_quantization.binary";
+  if (fs::exists(kBinaryPath)) {fs::remove(kBinaryPath);}
+
+  const auto kVectors = MakeTestVectors(100, 32);
+  ProductQuantizedIndex index(ProductQuantizer::Train(kVectors, 8, 25, 0));
+  for (const auto& kVector: kVectors) {index.Add(kVector);}
+  ASSERT_TRUE(index.WriteToBinary(kBinaryPath.string()));
+
+  const auto kReadIndex = ProductQuantizedIndex::ReadFromBinary(kBinaryPath.string());
+  EXPECT_EQ(kReadIndex.Size(), index.Size());
+  EXPECT_EQ(kReadIndex.Quantizer().NumSubquantizers(), 8u);
+  EXPECT_EQ(kReadIndex.Similarities(kVectors[3]), index.Similarities(kVectors[3]));
+
+  EXPECT_THROW(ProductQuantizedIndex::ReadFromBinary((GetTestsOutputPath()/"missing.binary").string()), std::runtime_error);
+}
+
+} // namespace igg
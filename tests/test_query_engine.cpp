@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "query_engine/query_batcher.hpp"
+#include "query_engine/query_cache.hpp"
+#include "query_engine/query_engine.hpp"
+
+
+namespace igg {
+
+namespace {
+
+// Three words in the plane, the last one a stop word
+QueryEngine::Vocabulary MakeTestVocabulary() {
+  QueryEngine::Vocabulary vocabulary;
+  vocabulary.centroids = {{0.0f, 0.0f}, {10.0f, 0.0f}, {0.0f, 10.0f}};
+  vocabulary.weights = {1.0f, 2.0f, 0.0f};
+  vocabulary.pruning = VocabularyPruning::FromDocumentFrequencies({1, 1, 3}, 3, 0.5, 0);
+  return vocabulary;
+}
+
+} // namespace
+
+
+TEST(QueryEngineTest, QueryHistogram) {
+  const QueryEngine kEngine
+    (MakeTestVocabulary(),
+     {SparseHistogram<float>(3, {0}, {1.0f}), SparseHistogram<float>(3, {1}, {1.0f}),
+      SparseHistogram<float>(3, {0, 1}, {1.0f, 1.0f})},
+     {"a.png", "b.png", "c.png"});
+  EXPECT_EQ(kEngine.Size(), 3u);
+  EXPECT_EQ(kEngine.NumWords(), 3u);
+  EXPECT_EQ(kEngine.ImagePath(1), "b.png");
+
+  // Counts 1, 2 and 1 (stop word), re-weighted by 1/3 and 2/3 without the stop word
+  const std::vector<FeaturePoint<float>> kFeatures = {{1.0f, 0.0f}, {9.0f, 1.0f}, {10.0f, 1.0f}, {0.0f, 9.0f}};
+  QueryEngine::Scratch scratch;
+  const auto kHistogram = kEngine.QueryHistogram(kFeatures, scratch).ToDense();
+  ASSERT_EQ(kHistogram.size(), 3u);
+  EXPECT_FLOAT_EQ(kHistogram[0], 1.0f/3.0f);
+  EXPECT_FLOAT_EQ(kHistogram[1], 4.0f/3.0f);
+  EXPECT_FLOAT_EQ(kHistogram[2], 0.0f);
+
+  const auto kResults = kEngine.MostSimilarItems(kFeatures, 2, scratch);
+  ASSERT_EQ(kResults.size(), 2u);
+  EXPECT_EQ(kResults[0].first, 1u);
+  EXPECT_EQ(kResults[1].first, 2u);
+  EXPECT_EQ(kEngine.MostSimilarItems(kEngine.QueryHistogram(kFeatures), 2), kResults);
+
+  EXPECT_THROW(kEngine.MostSimilarItems(std::vector<FeaturePoint<float>>{{1.0f}}, 2), std::invalid_argument);
+  EXPECT_THROW(kEngine.MostSimilarItems(SparseHistogram<float>(2), 2), std::invalid_argument);
+  EXPECT_THROW(QueryEngine(MakeTestVocabulary(), {SparseHistogram<float>(3)}, {}), std::invalid_argument);
+  EXPECT_THROW(QueryEngine(MakeTestVocabulary(), {SparseHistogram<float>(2)}, {"a.png"}), std::invalid_argument);
+}
+
+
+TEST(QueryEngineTest, ConcurrentQueries) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> distribution(0.0f, 10.0f);
+  const auto RandomFeatures = [&](const size_t kNumFeatures) {
+    std::vector<FeaturePoint<float>> features(kNumFeatures, FeaturePoint<float>(2));
+    for (auto& feature: features) {feature = {distribution(engine), distribution(engine)};}
+    return features;
+  };
+
+  // Vocabulary of the test above without stop words, an image per random set of features
+  auto vocabulary = MakeTestVocabulary();
+  vocabulary.pruning = VocabularyPruning(3);
+  vocabulary.weights = {1.0f, 1.0f, 1.0f};
+  const QueryEngine kVocabularyOnly(vocabulary, {}, {});
+  std::vector<SparseHistogram<float>> histograms;
+  std::vector<std::string> image_paths;
+  for (size_t image = 0; image<200; image++) {
+    histograms.emplace_back(kVocabularyOnly.QueryHistogram(RandomFeatures(20)));
+    image_paths.emplace_back(std::to_string(image)+".png");
+  }
+  const QueryEngine kEngine(vocabulary, histograms, image_paths);
+
+  std::vector<std::vector<FeaturePoint<float>>> queries;
+  std::vector<std::vector<ScoredIndex<float>>> expected;
+  for (size_t query = 0; query<40; query++) {
+    queries.emplace_back(RandomFeatures(20));
+    expected.emplace_back(kEngine.MostSimilarItems(queries.back(), 5));
+  }
+
+  // Each thread answers every query with its own buffers
+  const size_t kNumThreads = 4;
+  std::vector<std::vector<std::vector<ScoredIndex<float>>>> results(kNumThreads);
+  std::vector<std::thread> threads;
+  for (size_t thread_index = 0; thread_index<kNumThreads; thread_index++) {
+    threads.emplace_back([&, thread_index]() {
+      for (const auto& kQuery: queries) {results[thread_index].emplace_back(kEngine.MostSimilarItems(kQuery, 5));}
+    });
+  }
+  for (auto& thread: threads) {thread.join();}
+  for (const auto& kThreadResults: results) {EXPECT_EQ(kThreadResults, expected);}
+}
+
+
+TEST(QueryEngineTest, Batches) {
+  std::mt19937 engine(0);
+  std::uniform_real_distribution<float> distribution(0.0f, 10.0f);
+  auto vocabulary = MakeTestVocabulary();
+  vocabulary.pruning = VocabularyPruning(3);
+  std::vector<SparseHistogram<float>> histograms;
+  for (size_t image = 0; image<100; image++) {
+    histograms.emplace_back(3, std::vector<uint32_t>{0, 1, 2},
+      std::vector<float>{distribution(engine), distribution(engine), distribution(engine)});
+  }
+  const auto kEngine = std::make_shared<const QueryEngine>(vocabulary, histograms, std::vector<std::string>(100));
+
+  // Scoring at once agrees with one after the other
+  const std::vector<SparseHistogram<float>> kQueries(histograms.begin(), histograms.begin()+10);
+  const auto kBatch = kEngine->MostSimilarItemsBatch(kQueries, 5);
+  ASSERT_EQ(kBatch.size(), kQueries.size());
+  for (size_t query = 0; query<kQueries.size(); query++) {
+    EXPECT_EQ(kBatch[query], kEngine->MostSimilarItems(kQueries[query], 5));
+  }
+  EXPECT_THROW(kEngine->MostSimilarItemsBatch({SparseHistogram<float>(2)}, 5), std::invalid_argument);
+
+  // Queries submitted within the waiting time are scored together
+  {
+    QueryBatcher batcher(kEngine, 4, std::chrono::seconds(10));
+    std::vector<std::future<std::vector<ScoredIndex<float>>>> futures;
+    for (size_t query = 0; query<kQueries.size(); query++) {
+      futures.emplace_back(batcher.Submit(kQueries[query], 1+query%5));
+    }
+    for (size_t query = 0; query<8; query++) {
+      const auto kResults = futures[query].get();
+      ASSERT_EQ(kResults.size(), 1+query%5);
+      EXPECT_TRUE(std::equal(kResults.begin(), kResults.end(), kBatch[query].begin()));
+    }
+    EXPECT_EQ(batcher.NumBatches(), 2u);
+    EXPECT_EQ(batcher.NumQueries(), 8u);
+    EXPECT_THROW(batcher.Submit(SparseHistogram<float>(2), 5), std::invalid_argument);
+    // The last two queries are scored on destruction
+  }
+
+  // Without waiting, a single query is answered alone
+  const std::vector<FeaturePoint<float>> kFeatures = {{1.0f, 1.0f}, {9.0f, 0.0f}};
+  QueryBatcher batcher(kEngine, 32, std::chrono::microseconds(0));
+  EXPECT_EQ(batcher.MostSimilarItems(kFeatures, 5), kEngine->MostSimilarItems(kFeatures, 5));
+  EXPECT_THROW(QueryBatcher(kEngine, 0, std::chrono::microseconds(0)), std::invalid_argument);
+}
+
+
+TEST(QueryEngineTest, Cache) {
+  const std::string kImage = "image bytes";
+  const auto kHash = QueryCache::ContentHash(kImage.data(), kImage.size());
+  EXPECT_EQ(kHash, QueryCache::ContentHash(kImage.data(), kImage.size()));
+  EXPECT_NE(kHash, QueryCache::ContentHash(kImage.data(), kImage.size()-1));
+  EXPECT_NE(kHash, QueryCache::ContentHash("image bytez", kImage.size()));
+
+  // Room for about three entries of three results each
+  const QueryCache::Entry kEntry{SparseHistogram<float>(3, {0}, {1.0f}), {{0, 1.0f}, {1, 0.5f}, {2, 0.1f}}, 3};
+  QueryCache cache(3*(sizeof(QueryCache::Entry)+128));
+  EXPECT_EQ(cache.Find(1, 1), nullptr);
+  cache.Insert(1, 1, kEntry);
+  cache.Insert(2, 1, kEntry);
+  cache.Insert(3, 1, kEntry);
+  ASSERT_NE(cache.Find(1, 1), nullptr);
+  EXPECT_EQ(cache.Find(1, 1)->results, kEntry.results);
+  EXPECT_EQ(cache.Size(), 3u);
+  EXPECT_LE(cache.Bytes(), cache.MaxBytes());
+
+  // The least recently used entry is dropped first
+  cache.Insert(4, 1, kEntry);
+  EXPECT_EQ(cache.Size(), 3u);
+  EXPECT_EQ(cache.Evictions(), 1u);
+  EXPECT_EQ(cache.Find(2, 1), nullptr);
+  EXPECT_NE(cache.Find(1, 1), nullptr);
+  EXPECT_EQ(cache.Hits(), 3u);
+  EXPECT_EQ(cache.Misses(), 2u);
+
+  // Another index version outdates all entries
+  EXPECT_EQ(cache.Find(1, 2), nullptr);
+  EXPECT_EQ(cache.Size(), 0u);
+  EXPECT_EQ(cache.Bytes(), 0u);
+
+  // Too large for the cache
+  QueryCache small_cache(16);
+  small_cache.Insert(1, 1, kEntry);
+  EXPECT_EQ(small_cache.Size(), 0u);
+
+  // Each snapshot is a new version
+  const QueryEngine kFirst(MakeTestVocabulary(), {SparseHistogram<float>(3, {0}, {1.0f})}, {"a.png"});
+  const QueryEngine kSecond(MakeTestVocabulary(), {SparseHistogram<float>(3, {0}, {1.0f})}, {"a.png"});
+  EXPECT_NE(kFirst.Version(), kSecond.Version());
+}
+
+} // namespace igg
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "server/query_client.hpp"
+#include "server/query_server.hpp"
+#include "server/shard_coordinator.hpp"
+#include "clustering/clustering_strategy_kmeans.hpp"
+
+#include "get_tests_data_path.hpp"
+#include "make_test_dataset.hpp"
+
+
+namespace igg {
+
+TEST(QueryServerTest, Protocol) {
+  QueryRequest request;
+  request.type = QueryType::kFeatures;
+  request.mode = QueryMode::kGraph;
+  request.num_results = 3;
+  request.num_candidates = 50;
+  request.features = {{1.0f, 2.0f}, {3.0f, 4.0f}, {5.0f, 6.0f}};
+  const auto kRequest = DecodeQueryRequest(EncodeQueryRequest(request));
+  EXPECT_EQ(kRequest.type, QueryType::kFeatures);
+  EXPECT_EQ(kRequest.mode, QueryMode::kGraph);
+  EXPECT_EQ(kRequest.num_results, 3u);
+  EXPECT_EQ(kRequest.num_candidates, 50u);
+  EXPECT_EQ(kRequest.features, request.features);
+
+  request.type = QueryType::kImagePath;
+  request.image_path = "image.png";
+  EXPECT_EQ(DecodeQueryRequest(EncodeQueryRequest(request)).image_path, "image.png");
+
+  QueryResponse response;
+  response.results = {{4, 0.5f, "a.png"}, {2, 0.25f, "b.png"}};
+  const auto kResponse = DecodeQueryResponse(EncodeQueryResponse(response));
+  ASSERT_TRUE(kResponse.ok);
+  ASSERT_EQ(kResponse.results.size(), 2u);
+  EXPECT_EQ(kResponse.results[1].index, 2u);
+  EXPECT_EQ(kResponse.results[1].similarity, 0.25f);
+  EXPECT_EQ(kResponse.results[1].image_path, "b.png");
+
+  response.ok = false;
+  response.error = "Failed.";
+  EXPECT_EQ(DecodeQueryResponse(EncodeQueryResponse(response)).error, "Failed.");
+
+  // Truncated or padded messages are rejected
+  const auto kMessage = EncodeQueryRequest(request);
+  EXPECT_THROW(DecodeQueryRequest(kMessage.substr(0, kMessage.size()-1)), std::runtime_error);
+  EXPECT_THROW(DecodeQueryRequest(kMessage+"x"), std::runtime_error);
+  EXPECT_THROW(DecodeQueryRequest(std::string(1, '\x07')), std::runtime_error);
+}
+
+
+TEST(QueryServerTest, QueryOverSocket) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const ClusteringStrategyKmeans<float> kStrategy(10, 25, 1e-3f, 0, false);
+  kBagOfWords.CreateDictionary(kStrategy, false);
+
+  // Features of an image of the dataset are scored like the image itself
+  const auto kItems = kDataset->Items();
+  const auto kFeatures = FromMat<float>(kItems[0]->LoadFeatures());
+  const auto kExpected = kBagOfWords.MostSimilarItems(kItems[0], 3);
+  const auto kFromFeatures = kBagOfWords.MostSimilarItems(kFeatures, 3);
+  ASSERT_EQ(kFromFeatures.size(), 3u);
+  for (size_t rank = 0; rank<kExpected.size(); rank++) {
+    EXPECT_EQ(kFromFeatures[rank].first, kExpected[rank].first);
+    EXPECT_NEAR(kFromFeatures[rank].second, kExpected[rank].second, 1e-5f);
+  }
+
+  const auto kSocketPath = (GetTestsOutputPath()/"query_server.sock").string();
+  QueryServer server(kDataset, kSocketPath, false);
+  EXPECT_NO_THROW(server.Prepare(QueryMode::kExhaustive));
+  EXPECT_THROW(server.Prepare(QueryMode::kPruned), DictionaryIncomplete);
+  std::thread server_thread([&server]() {server.Run();});
+
+  // No assertions before the server is stopped
+  {
+    const QueryClient kClient(kSocketPath);
+    QueryRequest request;
+    request.type = QueryType::kFeatures;
+    request.num_results = 3;
+    request.features = kFeatures;
+    const auto kResponse = kClient.Query(request);
+    EXPECT_TRUE(kResponse.ok);
+    EXPECT_EQ(kResponse.results.size(), 3u);
+    for (size_t rank = 0; rank<std::min(kExpected.size(), kResponse.results.size()); rank++) {
+      EXPECT_EQ(kResponse.results[rank].index, kExpected[rank].first);
+      EXPECT_EQ(kResponse.results[rank].image_path, kItems[kExpected[rank].first]->ImagePath());
+    }
+
+    // Errors are reported, the connection stays usable
+    request.mode = QueryMode::kPruned;
+    EXPECT_FALSE(kClient.Query(request).ok);
+    request.type = QueryType::kImagePath;
+    request.mode = QueryMode::kExhaustive;
+    request.image_path = "missing.png";
+    EXPECT_FALSE(kClient.Query(request).ok);
+    request.image_path = kItems[0]->ImagePath();
+    const auto kFromPath = kClient.Query(request);
+    EXPECT_TRUE(kFromPath.ok);
+
+    // Repeated images are answered from the cache, fewer results too
+    request.num_results = 2;
+    const auto kCached = kClient.Query(request);
+    EXPECT_TRUE(kCached.ok);
+    EXPECT_EQ(kCached.results.size(), 2u);
+    for (size_t rank = 0; rank<std::min(kCached.results.size(), kFromPath.results.size()); rank++) {
+      EXPECT_EQ(kCached.results[rank].index, kFromPath.results[rank].index);
+    }
+  }
+  EXPECT_EQ(server.Cache().Hits(), 1u);
+  EXPECT_EQ(server.Cache().Size(), 1u);
+
+  server.Stop();
+  server_thread.join();
+}
+
+
+TEST(QueryServerTest, ConcurrentConnections) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const ClusteringStrategyKmeans<float> kStrategy(10, 25, 1e-3f, 0, false);
+  kBagOfWords.CreateDictionary(kStrategy, false);
+
+  const auto kSocketPath = (GetTestsOutputPath()/"query_server_concurrent.sock").string();
+  const auto kReadTimeout = std::chrono::milliseconds(500);
+  QueryServer server(kDataset, kSocketPath, false, QueryServer::kDefaultCacheBytes, 2, kReadTimeout);
+  server.Prepare(QueryMode::kExhaustive);
+  std::thread server_thread([&server]() {server.Run();});
+
+  QueryRequest request;
+  request.type = QueryType::kFeatures;
+  request.num_results = 3;
+  request.features = FromMat<float>(kDataset->Items()[0]->LoadFeatures());
+
+  // No assertions before the server is stopped
+  {
+    // A client staying connected without sending anything does not block others
+    const QueryClient kIdleClient(kSocketPath);
+    {
+      const QueryClient kClient(kSocketPath);
+      const auto kResponse = kClient.Query(request);
+      EXPECT_TRUE(kResponse.ok);
+      EXPECT_EQ(kResponse.results.size(), 3u);
+    }
+    // With both connection threads taken by idle clients, a further client is answered
+    // once the first of them is closed after the read timeout
+    const QueryClient kSecondIdleClient(kSocketPath);
+    const QueryClient kWaitingClient(kSocketPath);
+    EXPECT_TRUE(kWaitingClient.Query(request).ok);
+    std::this_thread::sleep_for(2*kReadTimeout);
+    EXPECT_THROW(kIdleClient.Query(request), std::runtime_error);
+  }
+
+  server.Stop();
+  server_thread.join();
+  // Exhaustive queries of all connections are scored by one batcher
+  EXPECT_EQ(server.NumBatchedQueries(), 2u);
+  EXPECT_THROW(QueryServer(kDataset, kSocketPath, false, QueryServer::kDefaultCacheBytes, 0), std::invalid_argument);
+}
+
+
+TEST(QueryServerTest, ShardedQuery) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const ClusteringStrategyKmeans<float> kStrategy(10, 25, 1e-3f, 0, false);
+  kBagOfWords.CreateDictionary(kStrategy, false);
+
+  const auto kShardsDir = GetTestsOutputPath()/"shards";
+  if (fs::exists(kShardsDir)) {fs::remove_all(kShardsDir);}
+  const size_t kNumShards = 3;
+  const auto kShardDirs = PartitionDataset(*kDataset, kNumShards, kShardsDir.string());
+  ASSERT_EQ(kShardDirs.size(), kNumShards);
+  EXPECT_THROW(PartitionDataset(*kDataset, kNumShards, kShardsDir.string()), std::runtime_error);
+  EXPECT_THROW(PartitionDataset(*kDataset, 0, kShardsDir.string()), std::invalid_argument);
+
+  // Each shard owns every third image, with the weights of the whole dataset. The shard
+  // servers run as threads of the test, standing in for one query_server process each.
+  const auto kItems = kDataset->Items();
+  const auto kReadTimeout = std::chrono::milliseconds(300);
+  std::vector<std::unique_ptr<QueryServer>> servers;
+  std::vector<std::string> socket_paths;
+  size_t num_items = 0;
+  for (size_t shard = 0; shard<kNumShards; shard++) {
+    const auto kShard = std::make_shared<const Dataset>(kShardDirs[shard]);
+    const auto kShardItems = kShard->Items();
+    num_items += kShardItems.size();
+    ASSERT_FALSE(kShardItems.empty());
+    EXPECT_EQ(kShardItems[1]->ImageFilename(), kItems[GlobalItemIndex(shard, 1, kNumShards)]->ImageFilename());
+    EXPECT_EQ(kShardItems[1]->LoadHistogram(), kItems[GlobalItemIndex(shard, 1, kNumShards)]->LoadHistogram());
+
+    socket_paths.push_back((GetTestsOutputPath()/("shard_"+std::to_string(shard)+".sock")).string());
+    servers.emplace_back(std::make_unique<QueryServer>
+      (kShard, socket_paths.back(), false, QueryServer::kDefaultCacheBytes,
+       QueryServer::kDefaultMaxConnections, kReadTimeout));
+    servers.back()->Prepare(QueryMode::kExhaustive);
+  }
+  EXPECT_EQ(num_items, kItems.size());
+
+  std::vector<std::thread> server_threads;
+  for (const auto& kServer: servers) {
+    server_threads.emplace_back([&kServer]() {kServer->Run();});
+  }
+
+  // No assertions before the servers are stopped
+  {
+    const ShardCoordinator kCoordinator(socket_paths);
+    QueryRequest request;
+    request.type = QueryType::kFeatures;
+    request.num_results = 5;
+    request.features = FromMat<float>(kItems[4]->LoadFeatures());
+    const auto kExpected = kBagOfWords.MostSimilarItems(request.features, 5);
+    const auto kResponse = kCoordinator.Query(request);
+    EXPECT_TRUE(kResponse.ok);
+    EXPECT_EQ(kResponse.results.size(), kExpected.size());
+    for (size_t rank = 0; rank<std::min(kExpected.size(), kResponse.results.size()); rank++) {
+      EXPECT_EQ(kResponse.results[rank].index, kExpected[rank].first);
+      EXPECT_NEAR(kResponse.results[rank].similarity, kExpected[rank].second, 1e-5f);
+    }
+
+    request.type = QueryType::kImagePath;
+    request.image_path = kItems[4]->ImagePath();
+    const auto kFromPath = kCoordinator.Query(request);
+    EXPECT_TRUE(kFromPath.ok);
+    EXPECT_EQ(kFromPath.results.size(), kExpected.size());
+    request.image_path = "missing.png";
+    EXPECT_FALSE(kCoordinator.Query(request).ok);
+
+    // Errors of a shard are reported, the connections stay usable
+    request.type = QueryType::kFeatures;
+    request.mode = QueryMode::kPruned;
+    EXPECT_FALSE(kCoordinator.Query(request).ok);
+    request.mode = QueryMode::kExhaustive;
+    EXPECT_TRUE(kCoordinator.Query(request).ok);
+
+    // Other clients of a shard are answered while the coordinator stays connected
+    EXPECT_TRUE(QueryClient(socket_paths[0]).Query(request).ok);
+
+    // Connections closed by the shards after their read timeout are opened again
+    std::this_thread::sleep_for(2*kReadTimeout);
+    const auto kReconnected = kCoordinator.Query(request);
+    EXPECT_TRUE(kReconnected.ok);
+    EXPECT_EQ(kReconnected.results.size(), kExpected.size());
+  }
+
+  for (const auto& kServer: servers) {kServer->Stop();}
+  for (auto& server_thread: server_threads) {server_thread.join();}
+}
+
+} // namespace igg
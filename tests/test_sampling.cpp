@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <random>
+#include <set>
 
 #include "tools/sampling.hpp"
 
@@ -16,6 +18,48 @@ TEST(SamplingTest, SampleIndices) {
     (kNumElementsInSample, kNumElementsTotal, engine);
 
   EXPECT_EQ(sample.size(), kNumElementsInSample);
+  EXPECT_EQ(std::set<size_t>(sample.begin(), sample.end()).size(), kNumElementsInSample);
+  for (const auto kIndex: sample) {EXPECT_LT(kIndex, kNumElementsTotal);}
+
+  // Memory does not depend on the total number
+  const size_t kHugeTotal = static_cast<size_t>(1)<<40;
+  const auto kSample = igg::SampleIndicesWithoutReplacement<size_t>
+    (kNumElementsInSample, kHugeTotal, engine);
+  EXPECT_EQ(std::set<size_t>(kSample.begin(), kSample.end()).size(), kNumElementsInSample);
+}
+
+
+TEST(SamplingTest, ReservoirSampler) {
+  std::mt19937 engine(0);
+
+  // Fewer items than capacity, all are kept
+  ReservoirSampler<int> small_sampler(10, engine);
+  for (int item = 0; item<5; item++) {small_sampler.Add(item);}
+  EXPECT_EQ(small_sampler.Sample(), (std::vector<int>{0, 1, 2, 3, 4}));
+
+  // Each item should end up in the sample with probability capacity/total
+  const int kNumItems = 100;
+  const size_t kCapacity = 10;
+  const int kNumRepetitions = 2000;
+  std::vector<int> counts(kNumItems, 0);
+  for (int repetition = 0; repetition<kNumRepetitions; repetition++) {
+    ReservoirSampler<int> sampler(kCapacity, engine);
+    for (int item = 0; item<kNumItems; item++) {sampler.Add(item);}
+    ASSERT_EQ(sampler.Sample().size(), kCapacity);
+    EXPECT_EQ(sampler.NumSeen(), static_cast<size_t>(kNumItems));
+    for (const auto kItem: sampler.Sample()) {counts[kItem]++;}
+  }
+
+  // Expected count is 200 for every item
+  EXPECT_GT(*std::min_element(counts.begin(), counts.end()), 130);
+  EXPECT_LT(*std::max_element(counts.begin(), counts.end()), 270);
+}
+
+
+TEST(SamplingTest, StratifiedSampleSizes) {
+  EXPECT_EQ(StratifiedSampleSizes({100, 2, 50, 10}, 40), (std::vector<size_t>{14, 2, 14, 10}));
+  EXPECT_EQ(StratifiedSampleSizes({3, 4}, 100), (std::vector<size_t>{3, 4}));
+  EXPECT_EQ(StratifiedSampleSizes({30, 30, 30}, 10), (std::vector<size_t>{4, 3, 3}));
 }
 
 } // namespace igg
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <boost/filesystem.hpp>
+
+#include "vlad/vlad_encoder.hpp"
+#include "tools/linalg.hpp"
+
+#include "get_tests_data_path.hpp"
+
+
+namespace igg {
+
+TEST(VladTest, Encode) {
+  const VladEncoder kEncoder({{0.0f, 0.0f}, {10.0f, 0.0f}});
+  EXPECT_EQ(kEncoder.NumClusters(), 2u);
+  EXPECT_EQ(kEncoder.DescriptorDimension(), 2u);
+  EXPECT_EQ(kEncoder.Dimension(), 4u);
+  EXPECT_FALSE(kEncoder.HasPca());
+
+  // Residuals (1, 4) and (-1, 0) + (0, 0), signed square root and L2 norm
+  const auto kVector = kEncoder.Encode({{1.0f, 4.0f}, {9.0f, 0.0f}, {10.0f, 0.0f}});
+  ASSERT_EQ(kVector.size(), 4u);
+  const float kNorm = std::sqrt(1.0f+2.0f*2.0f+1.0f);
+  EXPECT_FLOAT_EQ(kVector[0], 1.0f/kNorm);
+  EXPECT_FLOAT_EQ(kVector[1], 2.0f/kNorm);
+  EXPECT_FLOAT_EQ(kVector[2], -1.0f/kNorm);
+  EXPECT_FLOAT_EQ(kVector[3], 0.0f);
+
+  EXPECT_EQ(kEncoder.Encode({}), std::vector<float>(4, 0.0f));
+  EXPECT_THROW(kEncoder.Encode({{1.0f}}), std::invalid_argument);
+  EXPECT_THROW(kEncoder.Project(kVector), std::invalid_argument);
+  EXPECT_THROW(VladEncoder({}), std::invalid_argument);
+  EXPECT_THROW(VladEncoder({{0.0f, 0.0f}, {0.0f}}), std::invalid_argument);
+}
+
+
+TEST(VladTest, Pca) {
+  // Images with descriptors around one of two points, distinguished in few dimensions
+  std::mt19937 engine(0);
+  std::normal_distribution<float> noise(0.0f, 0.1f);
+  const VladEncoder kRawEncoder({{0.0f, 0.0f, 0.0f}, {5.0f, 5.0f, 5.0f}, {-5.0f, 0.0f, 5.0f}});
+  std::vector<std::vector<float>> raw_vectors;
+  std::vector<std::vector<FeaturePoint<float>>> images;
+  for (size_t image = 0; image<40; image++) {
+    std::vector<FeaturePoint<float>> descriptors;
+    for (size_t index = 0; index<20; index++) {
+      const float kCenter = image%2==0 ? 1.0f : 4.0f;
+      descriptors.push_back({kCenter+noise(engine), kCenter+noise(engine), kCenter+noise(engine)});
+    }
+    raw_vectors.emplace_back(kRawEncoder.EncodeRaw(descriptors));
+    images.emplace_back(std::move(descriptors));
+  }
+
+  // Fewer vectors than dimensions (Gram matrix) and more (covariance)
+  for (const size_t kNumVectors: {5, 40}) {
+    VladEncoder encoder = kRawEncoder;
+    const std::vector<std::vector<float>> kTrainingVectors(raw_vectors.begin(), raw_vectors.begin()+kNumVectors);
+    encoder.TrainPca(kTrainingVectors, 2);
+    ASSERT_TRUE(encoder.HasPca());
+    EXPECT_EQ(encoder.Dimension(), 2u);
+
+    // Images of the same kind stay similar, the others do not
+    const auto kFirst = encoder.Encode(images[0]);
+    EXPECT_NEAR(L2Norm(kFirst), 1.0f, 1e-5f);
+    EXPECT_GT(DotProduct(kFirst, encoder.Encode(images[2])), 0.5f);
+    EXPECT_LT(DotProduct(kFirst, encoder.Encode(images[1])), 0.0f);
+    EXPECT_EQ(encoder.Project(raw_vectors[0]), kFirst);
+  }
+
+  VladEncoder encoder = kRawEncoder;
+  EXPECT_THROW(encoder.TrainPca(raw_vectors, 0), std::invalid_argument);
+  EXPECT_THROW(encoder.TrainPca(raw_vectors, 10), std::invalid_argument);
+  EXPECT_THROW(encoder.TrainPca({raw_vectors[0], raw_vectors[1]}, 2), std::invalid_argument);
+  EXPECT_FALSE(encoder.HasPca());
+}
+
+
+TEST(VladTest, WriteReadBinary) {
+  const auto kBinaryPath = GetTestsOutputPath()/"vlad_encoder.binary";
+  if (fs::exists(kBinaryPath)) {fs::remove(kBinaryPath);}
+
+  VladEncoder encoder({{0.0f, 1.0f}, {1.0f, 0.0f}});
+  ASSERT_TRUE(encoder.WriteToBinary(kBinaryPath.string()));
+  const std::vector<FeaturePoint<float>> kDescriptors = {{0.5f, 2.0f}, {3.0f, -1.0f}};
+  EXPECT_EQ(VladEncoder::ReadFromBinary(kBinaryPath.string()).Encode(kDescriptors), encoder.Encode(kDescriptors));
+
+  encoder.TrainPca({{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 1.0f}}, 2);
+  ASSERT_TRUE(encoder.WriteToBinary(kBinaryPath.string()));
+  const auto kReadEncoder = VladEncoder::ReadFromBinary(kBinaryPath.string());
+  EXPECT_EQ(kReadEncoder.Dimension(), 2u);
+  EXPECT_EQ(kReadEncoder.Encode(kDescriptors), encoder.Encode(kDescriptors));
+
+  EXPECT_THROW(VladEncoder::ReadFromBinary((GetTestsOutputPath()/"missing.binary").string()), std::runtime_error);
+}
+
+} // namespace igg
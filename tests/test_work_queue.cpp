@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "bag_of_words.hpp"
+#include "features/features.hpp"
+#include "work_queue/file_work_queue.hpp"
+
+#include "get_tests_data_path.hpp"
+#include "make_test_dataset.hpp"
+
+
+namespace igg {
+
+TEST(WorkQueueTest, Leases) {
+  const auto kQueueDir = GetTestsOutputPath()/"work_queue";
+  if (fs::exists(kQueueDir)) {fs::remove_all(kQueueDir);}
+  const std::chrono::milliseconds kShortLease(200);
+
+  // The second worker joins with the batches of the first
+  FileWorkQueue queue_1(kQueueDir.string(), 10, 4, std::chrono::seconds(60), "worker_1");
+  FileWorkQueue queue_2(kQueueDir.string(), 10, 8, kShortLease, "worker_2");
+  EXPECT_EQ(queue_2.NumBatches(), 3u);
+  EXPECT_THROW(FileWorkQueue(kQueueDir.string(), 11, 4, kShortLease, "worker_3"), std::runtime_error);
+  EXPECT_THROW(FileWorkQueue(kQueueDir.string(), 10, 0, kShortLease, "worker_3"), std::invalid_argument);
+
+  // Each batch is claimed once
+  WorkBatch batch_1, batch_2, batch_3, batch;
+  ASSERT_TRUE(queue_1.Claim(batch_1));
+  ASSERT_TRUE(queue_2.Claim(batch_2));
+  ASSERT_TRUE(queue_1.Claim(batch_3));
+  EXPECT_FALSE(queue_2.Claim(batch));
+  std::vector<bool> claimed(3, false);
+  for (const auto& kBatch: {batch_1, batch_2, batch_3}) {claimed[kBatch.index] = true;}
+  EXPECT_EQ(claimed, std::vector<bool>(3, true));
+  EXPECT_EQ(batch_1.end-batch_1.begin, batch_1.index==2 ? 2u : 4u);
+
+  queue_1.Complete(batch_1);
+  EXPECT_EQ(queue_2.NumDone(), 1u);
+  EXPECT_FALSE(queue_2.Renew(batch_1));
+  EXPECT_TRUE(queue_1.Renew(batch_3));
+
+  // The second worker stops, its batch is claimed again once the lease expired
+  std::this_thread::sleep_for(kShortLease+kShortLease/2);
+  ASSERT_TRUE(queue_1.Claim(batch));
+  EXPECT_EQ(batch.index, batch_2.index);
+  EXPECT_FALSE(queue_2.Renew(batch_2));
+  EXPECT_FALSE(queue_1.Claim(batch_2));
+
+  queue_1.Complete(batch);
+  queue_1.Complete(batch_3);
+  EXPECT_TRUE(queue_2.Done());
+}
+
+
+TEST(WorkQueueTest, ExtractFeatures) {
+  const auto kDataset = std::make_shared<const Dataset>(MakeTestDataset());
+  const BagOfWords kBagOfWords(kDataset, false);
+  const auto kQueueDir = (GetTestsOutputPath()/"extract_features_queue").string();
+  if (fs::exists(kQueueDir)) {fs::remove_all(kQueueDir);}
+  const std::chrono::milliseconds kLeaseDuration(1000);
+
+  // A worker which stopped right after claiming a batch
+  FileWorkQueue stopped_queue(kQueueDir, kDataset->Items().size(), 4, kLeaseDuration, "stopped");
+  WorkBatch stopped_batch;
+  ASSERT_TRUE(stopped_queue.Claim(stopped_batch));
+
+  std::vector<std::thread> workers;
+  for (size_t worker = 0; worker<3; worker++) {
+    workers.emplace_back([&kBagOfWords, &kQueueDir, kLeaseDuration, worker]() {
+      kBagOfWords.ExtractFeatures(kQueueDir, 4, kLeaseDuration, "worker_"+std::to_string(worker));
+    });
+  }
+  for (auto& worker: workers) {worker.join();}
+
+  EXPECT_TRUE(stopped_queue.Done());
+  EXPECT_TRUE(kDataset->AllItemsHaveFeatures());
+  const auto kItem = kDataset->Items()[stopped_batch.begin];
+  EXPECT_EQ(FromMat<float>(kItem->LoadFeatures()), FromMat<float>(ComputeFeatures(kItem->LoadImage())));
+  for (const auto& kDirEntry: fs::directory_iterator(kDataset->ResultsDir())) {
+    EXPECT_NE(kDirEntry.path().extension(), ".tmp");
+  }
+}
+
+} // namespace igg